@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+#include "common/time_utils.h"
+
+#include "exchange/matcher/me_order_store.h"
+
+/*
+Compares how fast an aggressive order can trade through deep price levels with the orders of MEOrderBook kept in an MEOrderStore,
+against the 80 byte MEOrders linked into a circular list per level it replaced. Those came from a MemPool, whose ASSERTs format
+their messages on every call and would hide the difference in memory access, so here they come from a free list like the store's.
+NumOrders orders are spread over NumOrders / depth levels, arriving in random order of levels like orders from many clients do,
+so the orders of a level are scattered over the pool / store. Then every level is swept front to back, each fill reading the order's quantity and the ids MEOrderBook puts
+into the fill responses and removing the order, as MEOrderBook::match() does, without the responses themselves.
+The store is run with and without prefetching the orders MEOrderBook::MatchPrefetchDistance places behind the front of the level.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t NumOrders = 512 * 1024;
+constexpr size_t Repetitions = 5;
+constexpr size_t PrefetchDistance = 4; // MEOrderBook::MatchPrefetchDistance.
+
+/// MEOrder as it was before MEOrderStore.
+struct ListOrder {
+  TickerId ticker_id_ = TickerId_INVALID;
+  ClientId client_id_ = ClientId_INVALID;
+  OrderId client_order_id_ = OrderId_INVALID;
+  OrderId market_order_id_ = OrderId_INVALID;
+  Side side_ = Side::INVALID;
+  Price price_ = Price_INVALID;
+  Qty qty_ = Qty_INVALID;
+  Priority priority_ = Priority_INVALID;
+
+  ListOrder *prev_order_ = nullptr;
+  ListOrder *next_order_ = nullptr;
+
+  ListOrder() = default;
+
+  ListOrder(ClientId client_id, OrderId client_order_id, OrderId market_order_id, Price price, Qty qty, Priority priority) noexcept
+      : ticker_id_(0), client_id_(client_id), client_order_id_(client_order_id), market_order_id_(market_order_id), side_(Side::SELL),
+        price_(price), qty_(qty), priority_(priority) {}
+};
+
+/// The levels of the book as circular doubly linked lists of ListOrders, as MEOrderBook's addOrder() / removeOrder() kept them.
+class ListLevels {
+public:
+  ListLevels(size_t num_levels) : orders_(NumOrders), first_orders_(num_levels, nullptr) {
+    for (size_t i = 0; i < NumOrders; ++i)
+      free_orders_.push_back(&orders_[NumOrders - 1 - i]);
+  }
+
+  auto add(size_t level, ClientId client_id, OrderId client_order_id, OrderId market_order_id, Qty qty) noexcept {
+    auto order = free_orders_.back();
+    free_orders_.pop_back();
+    *order = {client_id, client_order_id, market_order_id, static_cast<Price>(level), qty, market_order_id};
+    auto &first_order = first_orders_[level];
+    if (!first_order) {
+      order->next_order_ = order->prev_order_ = first_order = order;
+    } else {
+      first_order->prev_order_->next_order_ = order;
+      order->prev_order_ = first_order->prev_order_;
+      order->next_order_ = first_order;
+      first_order->prev_order_ = order;
+    }
+  }
+
+  auto sweep(size_t level, uint64_t *checksum) noexcept {
+    size_t fills = 0;
+    for (auto &first_order = first_orders_[level]; first_order; ++fills) {
+      const auto order = first_order;
+      *checksum += order->qty_ + order->client_id_ + order->client_order_id_ + order->market_order_id_;
+      order->qty_ = 0;
+
+      if (order->next_order_ == order) {
+        first_order = nullptr;
+      } else {
+        order->prev_order_->next_order_ = order->next_order_;
+        order->next_order_->prev_order_ = order->prev_order_;
+        first_order = order->next_order_;
+      }
+      free_orders_.push_back(order);
+    }
+    return fills;
+  }
+
+private:
+  std::vector<ListOrder> orders_;
+  std::vector<ListOrder *> free_orders_;
+  std::vector<ListOrder *> first_orders_;
+};
+
+/// The levels of the book as queues of handles into an MEOrderStore, as MEOrderBook keeps them.
+template<bool Prefetch>
+class StoreLevels {
+public:
+  StoreLevels(size_t num_levels) : store_(NumOrders), levels_(num_levels) {
+  }
+
+  auto add(size_t level, ClientId client_id, OrderId client_order_id, OrderId market_order_id, Qty qty) noexcept {
+    const auto handle = store_.allocate({client_id, client_order_id, market_order_id, Side::SELL, static_cast<Price>(level), market_order_id}, qty);
+    store_.enqueue(&levels_[level], handle);
+  }
+
+  auto sweep(size_t level, uint64_t *checksum) noexcept {
+    size_t fills = 0;
+    for (auto orders_at_price = &levels_[level]; orders_at_price->num_orders_; ++fills) {
+      if (Prefetch)
+        store_.prefetch(orders_at_price, PrefetchDistance);
+      const auto handle = orders_at_price->front();
+      const auto &order = store_.order(handle);
+      *checksum += store_.qty(handle) + order.client_id_ + order.client_order_id_ + order.market_order_id_;
+      store_.reduceQty(orders_at_price, handle, store_.qty(handle));
+
+      store_.dequeue(orders_at_price, handle);
+      store_.deallocate(handle);
+    }
+    return fills;
+  }
+
+private:
+  MEOrderStore store_;
+  std::vector<MEOrdersAtPrice> levels_;
+};
+
+/// Runs the workload for one depth and returns the ns per fill, the checksum has to be the same for all implementations.
+template<typename Levels>
+auto benchmark(size_t depth, uint64_t *checksum) -> double {
+  const auto num_levels = NumOrders / depth;
+  std::vector<size_t> arrivals(NumOrders);
+  for (size_t i = 0; i < NumOrders; ++i)
+    arrivals[i] = i % num_levels;
+  std::shuffle(arrivals.begin(), arrivals.end(), std::mt19937_64(depth));
+
+  Nanos elapsed = 0;
+  *checksum = 0;
+  for (size_t repetition = 0; repetition < Repetitions; ++repetition) {
+    auto levels = std::make_unique<Levels>(num_levels);
+    for (size_t i = 0; i < NumOrders; ++i)
+      levels->add(arrivals[i], static_cast<ClientId>(i % 64), i, i + 1, static_cast<Qty>(i % 100 + 1));
+
+    size_t fills = 0;
+    const auto start = getCurrentNanos();
+    for (size_t level = 0; level < num_levels; ++level)
+      fills += levels->sweep(level, checksum);
+    elapsed += getCurrentNanos() - start;
+    ASSERT(fills == NumOrders, "Swept " + std::to_string(fills) + " orders.");
+  }
+
+  return static_cast<double>(elapsed) / (Repetitions * NumOrders);
+}
+
+int main(int, char **) {
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  printf("%8s %12s %12s %12s\n", "depth", "list-ns", "store-ns", "prefetch-ns");
+
+  for (const size_t depth: {16ul, 256ul, 4096ul}) {
+    uint64_t list_checksum, store_checksum, prefetch_checksum;
+    const auto list = benchmark<ListLevels>(depth, &list_checksum);
+    const auto store = benchmark<StoreLevels<false>>(depth, &store_checksum);
+    const auto prefetch = benchmark<StoreLevels<true>>(depth, &prefetch_checksum);
+    ASSERT(list_checksum == store_checksum && list_checksum == prefetch_checksum, "Implementations disagree on the orders swept.");
+
+    printf("%8zu %12.1f %12.1f %12.1f\n", depth, list, store, prefetch);
+  }
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/time_utils.h"
+
+#include "exchange/matcher/matching_engine.h"
+
+/*
+Measures checkpointing the books of a MatchingEngine and restoring them. NumOrders resting orders of NumClients clients are put on the
+book of ticker 0 by replaying journal records of new orders which do not cross, spread over NumLevels levels per side, and the time
+that takes is what recovering from the journal alone would take. Then the engine checkpoints: the pause is what the fork() in
+checkpoint() costs the engine, the write is how long the child takes to write the file. The checkpoint is restored into a new
+MatchingEngine, which checkpoints again, and the two files have to be the same. The checkpoint files are <path> and <path>.2,
+the path from the command line, /tmp/me_checkpoint_benchmark by default, and deleted afterwards.
+The pause follows the memory the fork() copies the page tables of, which is mostly the books, so it is measured first for an engine
+with only FewOrders resting, and the records are freed before the engine with NumOrders checkpoints. The engines run with logging off.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t NumOrders = 1000 * 1000;
+constexpr size_t NumClients = 64;
+constexpr Price NumLevels = 1000;
+constexpr size_t FewOrders = 5;
+
+auto fileBytes(const std::string &path) -> size_t {
+  struct stat st;
+  ASSERT(stat(path.c_str(), &st) == 0, "No checkpoint at:" + path);
+  return static_cast<size_t>(st.st_size);
+}
+
+auto sameFiles(const std::string &path1, const std::string &path2) -> bool {
+  FILE *file1 = fopen(path1.c_str(), "r"), *file2 = fopen(path2.c_str(), "r");
+  ASSERT(file1 && file2, "Unable to open the checkpoints.");
+  int c1, c2;
+  do {
+    c1 = fgetc(file1);
+    c2 = fgetc(file2);
+  } while (c1 == c2 && c1 != EOF);
+  fclose(file1);
+  fclose(file2);
+  return c1 == c2;
+}
+
+/// Checkpoints matching_engine to path, printing the pause of the engine and the time the child takes.
+auto checkpoint(MatchingEngine *matching_engine, const std::string &path, const char *name) {
+  matching_engine->enableCheckpoints(path, 0);
+  auto start = getCurrentNanos();
+  ASSERT(matching_engine->checkpoint(), "checkpoint() failed.");
+  const auto pause = getCurrentNanos() - start;
+  ASSERT(matching_engine->reapCheckpoint(true), "reapCheckpoint() failed.");
+  const auto write = getCurrentNanos() - start;
+  printf("%-10s pause: %ld us, write: %ld ms, %zu MB\n", name, pause / NANO_TO_MICROS, write / NANOS_TO_MILLIS, fileBytes(path) >> 20);
+}
+
+/// Journal records of num_orders new orders which rest on the book of ticker 0 without crossing.
+auto restingOrders(size_t num_orders) {
+  std::vector<MEJournalRecord> records(num_orders);
+  std::mt19937_64 rng(42);
+  for (size_t i = 0; i < num_orders; ++i) {
+    auto &request = records[i].request_;
+    records[i].type_ = JournalRecordType::CLIENT_REQUEST;
+    request.type_ = ClientRequestType::NEW;
+    request.client_id_ = static_cast<ClientId>(i % NumClients);
+    request.ticker_id_ = 0;
+    request.order_id_ = i;
+    request.side_ = (rng() % 2 ? Side::BUY : Side::SELL);
+    request.price_ = NumLevels + (request.side_ == Side::BUY ? -1 : 1) * static_cast<Price>(1 + rng() % NumLevels);
+    request.qty_ = static_cast<Qty>(1 + rng() % 100);
+  }
+  return records;
+}
+
+int main(int argc, char **argv) {
+  const std::string path = (argc > 1 ? argv[1] : "/tmp/me_checkpoint_benchmark");
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
+  ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
+  MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+  const auto newMatchingEngine = [&]() {
+    return std::make_unique<MatchingEngine>(&client_requests, &client_responses, &market_updates, 0, 1, false, AuctionSchedule{}, nullptr, false);
+  };
+
+  auto matching_engine = newMatchingEngine();
+  auto records = restingOrders(FewOrders);
+  matching_engine->replay(records.data(), records.size());
+  printf("%zu orders\n", FewOrders);
+  checkpoint(matching_engine.get(), path, "checkpoint");
+  checkpoint(matching_engine.get(), path, "again");
+  matching_engine.reset();
+
+  matching_engine = newMatchingEngine();
+  records = restingOrders(NumOrders);
+  auto start = getCurrentNanos();
+  matching_engine->replay(records.data(), records.size());
+  printf("%zu orders, replay: %ld ms\n", NumOrders, (getCurrentNanos() - start) / NANOS_TO_MILLIS);
+  records = {};
+  checkpoint(matching_engine.get(), path, "checkpoint");
+  matching_engine.reset();
+
+  auto restored = newMatchingEngine();
+  start = getCurrentNanos();
+  const auto journal_seq_num = restored->restore(path, NumOrders);
+  printf("restore: %ld ms\n", (getCurrentNanos() - start) / NANOS_TO_MILLIS);
+  ASSERT(journal_seq_num == NumOrders, "Restored journal record " + std::to_string(journal_seq_num));
+
+  checkpoint(restored.get(), path + ".2", "again");
+  ASSERT(sameFiles(path, path + ".2"), "The checkpoint of the restored books differs.");
+
+  unlink(path.c_str());
+  unlink((path + ".2").c_str());
+  return 0;
+}
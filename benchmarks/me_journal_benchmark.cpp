@@ -0,0 +1,207 @@
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <unistd.h>
+
+#include "common/time_utils.h"
+
+#include "exchange/matcher/matching_engine.h"
+#include "exchange/matcher/me_journal.h"
+#include "exchange/order_server/fifo_sequencer.h"
+
+/*
+Measures the journal of the matching engine. A stream of NumRequests client requests, new orders around a common price of which
+some trade and CancelShare cancels of earlier orders, is written through an MEJournal as the MatchingEngine writes it, once for
+every sync policy, reporting the records per second until the journal thread has taken all of them. The MatchingEngine only
+waits for the journal when the queue is full, here the writer already waits when the queue is half full. The journal is then
+opened again, as the exchange does on restart, the records found in it are checked against the stream and replayed into a
+MatchingEngine, reporting how long the recovery of a shard takes.
+Finally the first SlowNumRequests go through the whole path the exchange takes them, a FIFOSequencer taking requests only while it
+has room, as the order server does, the MatchingEngine and its journal, whose syncs take SlowSyncDelay longer, with queues of
+SlowQueueSize between them. The journal falls behind, the engine
+stops taking requests until it caught up, the sequencer holds them back and its hasRoom() turns false. It reports how often and for
+how long that happened, and checks every request was answered once and is in the journal in order. The journal files are <path>.0,
+the path from the command line, /tmp/me_journal_benchmark by default, and deleted afterwards.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t NumRequests = 1024 * 1024;
+constexpr double CancelShare = 0.3;
+constexpr size_t NumClients = 16;
+constexpr Nanos SlowSyncDelay = 100 * NANOS_TO_MILLIS;
+constexpr size_t SlowQueueSize = 4 * 1024;
+constexpr size_t SlowNumRequests = 64 * 1024;
+
+auto workload() -> std::vector<MEClientRequest> {
+  std::vector<MEClientRequest> requests;
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::vector<MEClientRequest> orders;
+  for (OrderId order_id = 0; requests.size() < NumRequests; ++order_id) {
+    if (!orders.empty() && uniform(rng) < CancelShare) {
+      auto cancel = orders[rng() % orders.size()];
+      cancel.type_ = ClientRequestType::CANCEL;
+      requests.push_back(cancel);
+      continue;
+    }
+    const auto side = (rng() % 2 ? Side::BUY : Side::SELL);
+    const auto price = static_cast<Price>(100 + (side == Side::BUY ? -1 : 1) * (static_cast<int64_t>(rng() % 10) - 2));
+    MEClientRequest request;
+    request.type_ = ClientRequestType::NEW;
+    request.client_id_ = static_cast<ClientId>(order_id % NumClients);
+    request.ticker_id_ = static_cast<TickerId>(rng() % ME_MAX_TICKERS);
+    request.order_id_ = order_id;
+    request.side_ = side;
+    request.price_ = price;
+    request.qty_ = static_cast<Qty>(1 + rng() % 100);
+    requests.push_back(request);
+    orders.push_back(request);
+  }
+  return requests;
+}
+
+/// Writes the requests through a new journal and returns the records per second.
+auto write(const std::vector<MEClientRequest> &requests, const MEJournalConfig &config) -> double {
+  unlink((config.path_ + ".0").c_str());
+  MEJournal journal(config, 0, 1);
+  journal.start();
+  auto records = journal.records();
+
+  const auto start = getCurrentNanos();
+  for (const auto &request: requests) {
+    while (records->size() >= ME_MAX_CLIENT_UPDATES / 2)
+      std::this_thread::yield();
+    auto next_write = records->getNextToWriteTo();
+    next_write->type_ = JournalRecordType::CLIENT_REQUEST;
+    next_write->request_ = request;
+    records->updateWriteIndex();
+  }
+  while (records->size())
+    std::this_thread::yield();
+  const auto elapsed = getCurrentNanos() - start;
+
+  journal.stop();
+  return static_cast<double>(requests.size()) * NANOS_TO_SECS / elapsed;
+}
+
+/// Requests the sequencer did not take, and how long it took none, in the end to end run.
+struct HeldBack {
+  size_t times_ = 0;
+  Nanos longest_ = 0;
+  Nanos total_ = 0;
+};
+
+/// Sends the requests through a FIFOSequencer into a MatchingEngine journaling them with config, as the exchange does, until every
+/// one of them was answered, and returns the requests per second. The sequencer is fed one batch of requests per round, like one read
+/// from a connection, requests it has no room for are sent again in the next round, like a client sends them again after the
+/// SESSION_REJECTED the order server answers them with.
+auto endToEnd(const std::vector<MEClientRequest> &requests, const MEJournalConfig &config, HeldBack *held_back) -> double {
+  unlink((config.path_ + ".0").c_str());
+  MEJournal journal(config, 0, 1);
+  ClientRequestLFQueue client_requests(config.queue_size_);
+  ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
+  MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+  auto matching_engine = std::make_unique<MatchingEngine>(&client_requests, &client_responses, &market_updates, 0, 1, false, AuctionSchedule{},
+                                                          journal.records(), false);
+  Logger logger("");
+  FIFOSequencer fifo_sequencer({&client_requests}, &logger);
+  journal.start();
+  matching_engine->start();
+
+  // Every request is answered by exactly one ACCEPTED, CANCELED or CANCEL_REJECTED response, FILLED responses come on top.
+  size_t sent = 0, completed = 0;
+  Nanos held_back_since = 0;
+  const auto start = getCurrentNanos();
+  while (completed < requests.size()) {
+    for (const auto batch_end = std::min(sent + 64, requests.size()); sent < batch_end && fifo_sequencer.hasRoom(); ++sent)
+      fifo_sequencer.addClientRequest(getCurrentNanos(), requests[sent]);
+    if (sent < requests.size() && !fifo_sequencer.hasRoom() && !held_back_since) {
+      held_back_since = getCurrentNanos();
+      ++held_back->times_;
+    } else if (held_back_since && fifo_sequencer.hasRoom()) {
+      const auto held = getCurrentNanos() - held_back_since;
+      held_back->longest_ = std::max(held_back->longest_, held);
+      held_back->total_ += held;
+      held_back_since = 0;
+    }
+    fifo_sequencer.sequenceAndPublish();
+
+    for (auto pending = client_responses.size(); pending; --pending) {
+      const auto type = client_responses.getNextToRead()->type_;
+      completed += (type == ClientResponseType::ACCEPTED || type == ClientResponseType::CANCELED || type == ClientResponseType::CANCEL_REJECTED);
+      client_responses.updateReadIndex();
+    }
+    for (auto pending = market_updates.size(); pending; --pending)
+      market_updates.updateReadIndex();
+  }
+  const auto elapsed = getCurrentNanos() - start;
+  ASSERT(completed == requests.size(), "Answered " + std::to_string(completed) + " of " + std::to_string(requests.size()) + " requests.");
+
+  while (journal.records()->size())
+    std::this_thread::yield();
+  matching_engine->stop();
+  journal.stop();
+  matching_engine.reset();
+  return static_cast<double>(requests.size()) * NANOS_TO_SECS / elapsed;
+}
+
+int main(int argc, char **argv) {
+  const std::string path = (argc > 1 ? argv[1] : "/tmp/me_journal_benchmark");
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  const auto requests = workload();
+  printf("%zu requests, %zu byte records.\n", requests.size(), sizeof(MEJournalRecord));
+
+  printf("%10s %12s\n", "sync", "records/s");
+  for (const auto &[policy, interval]: {std::pair{JournalSyncPolicy::NONE, Nanos{0}}, {JournalSyncPolicy::BATCH, 0},
+                                        {JournalSyncPolicy::INTERVAL, 100 * NANO_TO_MICROS}, {JournalSyncPolicy::INTERVAL, 1000 * NANO_TO_MICROS}}) {
+    const MEJournalConfig config{path, policy, interval};
+    const auto throughput = write(requests, config);
+    const auto name = (policy == JournalSyncPolicy::INTERVAL ? std::to_string(interval / NANO_TO_MICROS) + "us" : journalSyncPolicyToString(policy));
+    printf("%10s %12.0f\n", name.c_str(), throughput);
+  }
+
+  // What the last run wrote is what the exchange finds when it restarts.
+  const MEJournalConfig config{path, JournalSyncPolicy::NONE, 0};
+  const auto open_start = getCurrentNanos();
+  MEJournal journal(config, 0, 1);
+  const auto open_elapsed = getCurrentNanos() - open_start;
+  ASSERT(journal.numReplayRecords() == requests.size(), "Journal has " + std::to_string(journal.numReplayRecords()) + " records.");
+  size_t i = 0;
+  journal.replay(0, [&](const MEJournalRecord *records, size_t num_records) {
+    for (size_t j = 0; j < num_records; ++i, ++j) {
+      ASSERT(!memcmp(&records[j].request_, &requests[i], sizeof(MEClientRequest)), "Record " + std::to_string(i) + " differs:" + records[j].toString());
+    }
+  });
+
+  ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
+  ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
+  MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+  auto matching_engine = std::make_unique<MatchingEngine>(&client_requests, &client_responses, &market_updates);
+  const auto replay_start = getCurrentNanos();
+  journal.replay(0, [&](const MEJournalRecord *records, size_t num_records) { matching_engine->replay(records, num_records); });
+  const auto replay_elapsed = getCurrentNanos() - replay_start;
+  printf("open and scan: %ld ms, replay: %ld ms, %.0f records/s\n", open_elapsed / NANOS_TO_MILLIS, replay_elapsed / NANOS_TO_MILLIS,
+         static_cast<double>(requests.size()) * NANOS_TO_SECS / replay_elapsed);
+
+  HeldBack held_back;
+  const std::vector<MEClientRequest> slow_requests(requests.begin(), requests.begin() + SlowNumRequests);
+  const MEJournalConfig slow_config{path, JournalSyncPolicy::BATCH, 0, SlowSyncDelay, SlowQueueSize};
+  const auto throughput = endToEnd(slow_requests, slow_config, &held_back);
+  const MEJournal slow_journal({path, JournalSyncPolicy::NONE, 0}, 0, 1);
+  ASSERT(slow_journal.numReplayRecords() == slow_requests.size(), "Journal has " + std::to_string(slow_journal.numReplayRecords()) + " records.");
+  i = 0;
+  slow_journal.replay(0, [&](const MEJournalRecord *records, size_t num_records) {
+    for (size_t j = 0; j < num_records; ++i, ++j) {
+      ASSERT(!memcmp(&records[j].request_, &requests[i], sizeof(MEClientRequest)), "Record " + std::to_string(i) + " differs:" + records[j].toString());
+    }
+  });
+  printf("end to end, %zu requests with %ld ms syncs: %.0f requests/s, all answered and journaled in order, held back %zu times, longest %ld ms, "
+         "total %ld ms\n", slow_requests.size(), SlowSyncDelay / NANOS_TO_MILLIS, throughput, held_back.times_, held_back.longest_ / NANOS_TO_MILLIS, held_back.total_ / NANOS_TO_MILLIS);
+
+  unlink((path + ".0").c_str());
+  return 0;
+}
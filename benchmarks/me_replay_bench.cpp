@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <unistd.h>
+
+#include "common/thread_utils.h"
+#include "common/time_utils.h"
+
+#include "exchange/matcher/matching_engine.h"
+#include "exchange/matcher/me_journal.h"
+
+/*
+Replays a stream of client requests through MatchingEngine::processClientRequest() on the calling thread, pinned to a core, without
+the rest of the exchange and with logging off, draining the response and market update queues after every request. Reports the requests per second and
+percentiles of the time processClientRequest() takes per request, and an FNV-1a hash of every response and market update in the
+order the engine sent them, which has to stay the same for a change of the engine that is not meant to change its output.
+Every run uses a new MatchingEngine, so all runs of a stream have to produce the same hash.
+
+The stream is generated, or loaded from a file an earlier run saved it to, or from the journal of a single shard exchange. Generated
+streams are new orders and, with the given shares, cancels and modifies of earlier new orders of the same ticker and aggressive IOC
+orders which cross up to -s levels into the other side. Passive orders rest up to -w ticks away from the first price of their side,
+uniformly or exponentially distributed, for books with the most orders near the top. Options:
+  -n requests   (1048576)     -t tickers           (ME_MAX_TICKERS)  -C clients (16)
+  -c cancels    (0.3)         -m modifies          (0.05)            -a aggressive orders (0.1)
+  -d uniform|exponential      -w price width       (20)              -s levels an aggressive order crosses (5)
+  -S seed       (42)          -r runs              (3)               -p core (0, -1 to not pin)
+  -o file       save the stream   -i file  load a saved stream       -j path  load the journal LLPETM_JOURNAL=path wrote
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+enum class PriceDistribution : uint8_t {
+  UNIFORM,
+  EXPONENTIAL
+};
+
+struct StreamConfig {
+  size_t num_requests_ = 1024 * 1024;
+  size_t num_tickers_ = ME_MAX_TICKERS;
+  size_t num_clients_ = 16;
+  double cancel_share_ = 0.3;
+  double modify_share_ = 0.05;
+  double aggressive_share_ = 0.1;
+  PriceDistribution prices_ = PriceDistribution::EXPONENTIAL;
+  Price width_ = 20;
+  Price sweep_levels_ = 5;
+  uint64_t seed_ = 42;
+};
+
+/// Books are centered on this price, bids below and asks above it.
+constexpr Price MidPrice = 10000;
+
+auto generate(const StreamConfig &config) -> std::vector<MEJournalRecord> {
+  std::vector<MEJournalRecord> records(config.num_requests_);
+  std::mt19937_64 rng(config.seed_);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::exponential_distribution<double> exponential(4.0 / static_cast<double>(config.width_));
+  std::vector<std::vector<MEClientRequest>> live(config.num_tickers_);
+
+  for (size_t i = 0; i < records.size(); ++i) {
+    records[i].type_ = JournalRecordType::CLIENT_REQUEST;
+    auto &request = records[i].request_;
+    const auto ticker_id = static_cast<TickerId>(rng() % config.num_tickers_);
+    auto &ticker_live = live[ticker_id];
+    const auto action = uniform(rng);
+
+    if (!ticker_live.empty() && action < config.cancel_share_ + config.modify_share_) {
+      const auto index = rng() % ticker_live.size();
+      request = ticker_live[index];
+      if (action < config.cancel_share_) {
+        request.type_ = ClientRequestType::CANCEL;
+        ticker_live[index] = ticker_live.back();
+        ticker_live.pop_back();
+      } else {
+        request.type_ = ClientRequestType::MODIFY;
+        request.qty_ = static_cast<Qty>(1 + rng() % 100);
+        ticker_live[index] = request;
+        ticker_live[index].type_ = ClientRequestType::NEW;
+      }
+      continue;
+    }
+
+    request.type_ = ClientRequestType::NEW;
+    request.client_id_ = static_cast<ClientId>(rng() % config.num_clients_);
+    request.ticker_id_ = ticker_id;
+    request.order_id_ = i;
+    request.side_ = (rng() % 2 ? Side::BUY : Side::SELL);
+    const auto direction = (request.side_ == Side::BUY ? -1 : 1);
+    if (uniform(rng) < config.aggressive_share_) {
+      request.price_ = MidPrice - direction * static_cast<Price>(1 + rng() % config.sweep_levels_);
+      request.qty_ = static_cast<Qty>(1 + rng() % 400);
+      request.time_in_force_ = TimeInForce::IOC;
+      continue;
+    }
+    const auto offset = (config.prices_ == PriceDistribution::UNIFORM ? static_cast<Price>(rng() % config.width_)
+                                                                      : std::min(static_cast<Price>(exponential(rng)), config.width_ - 1));
+    request.price_ = MidPrice + direction * (1 + offset);
+    request.qty_ = static_cast<Qty>(1 + rng() % 100);
+    ticker_live.push_back(request);
+  }
+  return records;
+}
+
+auto save(const std::string &path, const std::vector<MEJournalRecord> &records) {
+  FILE *file = fopen(path.c_str(), "w");
+  ASSERT(file && fwrite(records.data(), sizeof(MEJournalRecord), records.size(), file) == records.size(), "Unable to write:" + path);
+  fclose(file);
+}
+
+auto load(const std::string &path) -> std::vector<MEJournalRecord> {
+  FILE *file = fopen(path.c_str(), "r");
+  ASSERT(file, "Unable to read:" + path);
+  std::vector<MEJournalRecord> records;
+  MEJournalRecord record;
+  while (fread(&record, sizeof(record), 1, file) == 1)
+    records.push_back(record);
+  fclose(file);
+  return records;
+}
+
+auto loadJournal(const std::string &path) -> std::vector<MEJournalRecord> {
+  ASSERT(access((path + ".0").c_str(), R_OK) == 0, "No journal at:" + path + ".0");
+  const MEJournal journal({path, JournalSyncPolicy::NONE, 0}, 0, 1);
+  std::vector<MEJournalRecord> records;
+  journal.replay(0, [&](const MEJournalRecord *run, size_t num_records) { records.insert(records.end(), run, run + num_records); });
+  return records;
+}
+
+struct RunResult {
+  double requests_per_sec_ = 0;
+  std::vector<Nanos> latencies_;
+  size_t num_responses_ = 0, num_updates_ = 0;
+  uint64_t hash_ = 14695981039346656037ull;
+
+  template<typename T>
+  auto add(const T &output) noexcept {
+    const auto bytes = reinterpret_cast<const uint8_t *>(&output);
+    for (size_t i = 0; i < sizeof(T); ++i)
+      hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+  }
+
+  auto percentile(double p) noexcept -> Nanos {
+    const auto nth = latencies_.begin() + static_cast<ptrdiff_t>(p * static_cast<double>(latencies_.size() - 1));
+    std::nth_element(latencies_.begin(), nth, latencies_.end());
+    return *nth;
+  }
+};
+
+auto run(const std::vector<MEJournalRecord> &records) -> RunResult {
+  ClientRequestLFQueue client_requests(1);
+  ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
+  MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+  auto matching_engine = std::make_unique<MatchingEngine>(&client_requests, &client_responses, &market_updates, 0, 1, false, AuctionSchedule{}, nullptr, false);
+
+  RunResult result;
+  result.latencies_.resize(records.size());
+  Nanos total = 0;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const auto &record = records[i];
+    const auto start = getCurrentNanos();
+    if (UNLIKELY(record.type_ == JournalRecordType::TRADING_PHASE))
+      matching_engine->setTradingPhase(record.trading_phase_);
+    else
+      matching_engine->processClientRequest(&record.request_);
+    result.latencies_[i] = getCurrentNanos() - start;
+    total += result.latencies_[i];
+
+    for (auto pending = client_responses.size(); pending; --pending, ++result.num_responses_) {
+      result.add(*client_responses.getNextToRead());
+      client_responses.updateReadIndex();
+    }
+    for (auto pending = market_updates.size(); pending; --pending, ++result.num_updates_) {
+      result.add(*market_updates.getNextToRead());
+      market_updates.updateReadIndex();
+    }
+  }
+  result.requests_per_sec_ = static_cast<double>(records.size()) * NANOS_TO_SECS / static_cast<double>(std::max<Nanos>(total, 1));
+  return result;
+}
+
+int main(int argc, char **argv) {
+  StreamConfig config;
+  size_t num_runs = 3;
+  int core = 0;
+  std::string save_path, load_path, journal_path;
+  for (int opt; (opt = getopt(argc, argv, "n:t:C:c:m:a:d:w:s:S:r:p:o:i:j:")) != -1;) {
+    switch (opt) {
+      case 'n': config.num_requests_ = strtoul(optarg, nullptr, 10); break;
+      case 't': config.num_tickers_ = std::clamp<size_t>(strtoul(optarg, nullptr, 10), 1, ME_MAX_TICKERS); break;
+      case 'C': config.num_clients_ = std::clamp<size_t>(strtoul(optarg, nullptr, 10), 1, ME_MAX_NUM_CLIENTS); break;
+      case 'c': config.cancel_share_ = atof(optarg); break;
+      case 'm': config.modify_share_ = atof(optarg); break;
+      case 'a': config.aggressive_share_ = atof(optarg); break;
+      case 'd': config.prices_ = (std::string(optarg) == "uniform" ? PriceDistribution::UNIFORM : PriceDistribution::EXPONENTIAL); break;
+      case 'w': config.width_ = std::max<Price>(atol(optarg), 1); break;
+      case 's': config.sweep_levels_ = std::max<Price>(atol(optarg), 1); break;
+      case 'S': config.seed_ = strtoul(optarg, nullptr, 10); break;
+      case 'r': num_runs = std::max<size_t>(strtoul(optarg, nullptr, 10), 1); break;
+      case 'p': core = atoi(optarg); break;
+      case 'o': save_path = optarg; break;
+      case 'i': load_path = optarg; break;
+      case 'j': journal_path = optarg; break;
+      default:
+        FATAL("Unknown option, see the comment at the top of me_replay_bench.cpp.");
+    }
+  }
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  const auto records = (!journal_path.empty() ? loadJournal(journal_path) : !load_path.empty() ? load(load_path) : generate(config));
+  if (!save_path.empty())
+    save(save_path, records);
+  if (journal_path.empty() && load_path.empty()) {
+    printf("generated %zu requests: tickers:%zu clients:%zu cancels:%.2f modifies:%.2f aggressive:%.2f prices:%s width:%ld sweep:%ld seed:%lu\n",
+           records.size(), config.num_tickers_, config.num_clients_, config.cancel_share_, config.modify_share_, config.aggressive_share_,
+           config.prices_ == PriceDistribution::UNIFORM ? "uniform" : "exponential", config.width_, config.sweep_levels_, config.seed_);
+  } else {
+    printf("loaded %zu requests from %s\n", records.size(), (journal_path.empty() ? load_path : journal_path + ".0").c_str());
+  }
+  printf("pinned to core %d: %s\n", core, (core >= 0 && setThreadCore(core)) ? "yes" : "no");
+
+  printf("%4s %12s %8s %8s %8s %9s %10s %10s %10s %16s\n", "run", "requests/s", "p50-ns", "p90-ns", "p99-ns", "p99.9-ns", "max-ns",
+         "responses", "updates", "hash");
+  uint64_t first_hash = 0;
+  for (size_t i = 0; i < num_runs; ++i) {
+    auto result = run(records);
+    printf("%4zu %12.0f %8ld %8ld %8ld %9ld %10ld %10zu %10zu %016lx\n", i, result.requests_per_sec_, result.percentile(0.5),
+           result.percentile(0.9), result.percentile(0.99), result.percentile(0.999), result.percentile(1.0), result.num_responses_,
+           result.num_updates_, result.hash_);
+    if (!i)
+      first_hash = result.hash_;
+    ASSERT(result.hash_ == first_hash, "Run " + std::to_string(i) + " produced different output, the engine is not deterministic.");
+  }
+
+  return 0;
+}
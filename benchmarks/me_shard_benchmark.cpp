@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+#include "common/time_utils.h"
+
+#include "exchange/matcher/matching_engine.h"
+#include "exchange/order_server/fifo_sequencer.h"
+
+/*
+Measures how the matching engine scales when the tickers are partitioned over 1 to N MatchingEngine threads, N from the command line,
+ME_MAX_TICKERS by default. For every number of shards the same stream of requests is written through a FIFOSequencer into the
+per shard queues, as the OrderServer does, while the responses and market updates are drained from every shard's queues, as the
+OrderServer and MarketDataPublisher do. HotShare of the requests are for ticker 0, the rest are spread over the other tickers, and
+CancelShare of them cancel an earlier order of the same ticker. At most InFlight requests are outstanding at any time, the queues
+having no way to push back. The benchmark reports the requests per second and the latency from handing a new order to the
+FIFOSequencer until its ACCEPTED response is read back, for the hot ticker and the others. The shards can only run in parallel
+with as many cores as shards plus the one running the benchmark.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t NumRequests = 64 * 1024;
+constexpr size_t InFlight = 1024;
+constexpr size_t BatchSize = 16;
+constexpr double HotShare = 0.5;
+constexpr double CancelShare = 0.3;
+constexpr size_t NumClients = 16;
+
+struct Workload {
+  std::vector<MEClientRequest> requests_;
+
+  Workload() {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::array<std::vector<MEClientRequest>, ME_MAX_TICKERS> orders;
+    for (OrderId order_id = 0; order_id < NumRequests; ++order_id) {
+      const auto ticker_id = static_cast<TickerId>(uniform(rng) < HotShare ? 0 : 1 + rng() % (ME_MAX_TICKERS - 1));
+      auto &ticker_orders = orders[ticker_id];
+      if (!ticker_orders.empty() && uniform(rng) < CancelShare) {
+        auto cancel = ticker_orders[rng() % ticker_orders.size()];
+        cancel.type_ = ClientRequestType::CANCEL;
+        requests_.push_back(cancel);
+        continue;
+      }
+      const auto side = (rng() % 2 ? Side::BUY : Side::SELL);
+      const auto price = static_cast<Price>(100 + (side == Side::BUY ? -1 : 1) * (static_cast<int64_t>(rng() % 10) - 2));
+      const MEClientRequest request{ClientRequestType::NEW, static_cast<ClientId>(order_id % NumClients), ticker_id, order_id, side, price,
+                                    static_cast<Qty>(1 + rng() % 100)};
+      requests_.push_back(request);
+      ticker_orders.push_back(request);
+    }
+  }
+};
+
+struct Latencies {
+  std::vector<Nanos> hot_, other_;
+
+  static auto percentile(std::vector<Nanos> &latencies, double p) -> Nanos {
+    if (latencies.empty())
+      return 0;
+    const auto nth = latencies.begin() + static_cast<ptrdiff_t>(p * (latencies.size() - 1));
+    std::nth_element(latencies.begin(), nth, latencies.end());
+    return *nth;
+  }
+};
+
+auto benchmark(const Workload &workload, size_t num_shards, Logger *logger, Latencies *latencies) -> double {
+  std::vector<std::unique_ptr<ClientRequestLFQueue>> client_request_queues;
+  std::vector<std::unique_ptr<ClientResponseLFQueue>> client_response_queues;
+  std::vector<std::unique_ptr<MEMarketUpdateLFQueue>> market_update_queues;
+  std::vector<ClientRequestLFQueue *> client_requests;
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    client_requests.push_back(client_request_queues.emplace_back(std::make_unique<ClientRequestLFQueue>(ME_MAX_CLIENT_UPDATES)).get());
+    client_response_queues.emplace_back(std::make_unique<ClientResponseLFQueue>(ME_MAX_CLIENT_UPDATES));
+    market_update_queues.emplace_back(std::make_unique<MEMarketUpdateLFQueue>(ME_MAX_MARKET_UPDATES));
+  }
+
+  std::vector<std::unique_ptr<MatchingEngine>> matching_engines;
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    matching_engines.emplace_back(std::make_unique<MatchingEngine>(client_requests[shard], client_response_queues[shard].get(),
+                                                                   market_update_queues[shard].get(), shard, num_shards));
+    matching_engines.back()->start();
+  }
+
+  FIFOSequencer fifo_sequencer(client_requests, logger);
+  std::vector<Nanos> send_time(NumRequests, 0);
+  latencies->hot_.clear();
+  latencies->other_.clear();
+
+  // Every request is answered by exactly one ACCEPTED, CANCELED or CANCEL_REJECTED response, FILLED responses come on top.
+  size_t sent = 0, completed = 0;
+  const auto start = getCurrentNanos();
+  while (completed < NumRequests) {
+    if (sent < NumRequests && sent - completed + BatchSize <= InFlight) {
+      const auto batch_end = std::min(sent + BatchSize, NumRequests);
+      for (; sent < batch_end; ++sent) {
+        const auto &request = workload.requests_[sent];
+        const auto now = getCurrentNanos();
+        if (request.type_ == ClientRequestType::NEW)
+          send_time[request.order_id_] = now;
+        fifo_sequencer.addClientRequest(now, request);
+      }
+      fifo_sequencer.sequenceAndPublish();
+    }
+
+    for (auto &client_responses: client_response_queues) {
+      for (auto pending = client_responses->size(); pending; --pending) {
+        const auto client_response = client_responses->getNextToRead();
+        switch (client_response->type_) {
+          case ClientResponseType::ACCEPTED:
+            (client_response->ticker_id_ == 0 ? latencies->hot_ : latencies->other_).push_back(
+                getCurrentNanos() - send_time[client_response->client_order_id_]);
+            ++completed;
+            break;
+          case ClientResponseType::CANCELED:
+          case ClientResponseType::CANCEL_REJECTED:
+            ++completed;
+            break;
+          default:
+            break;
+        }
+        client_responses->updateReadIndex();
+      }
+    }
+    for (auto &market_updates: market_update_queues) {
+      for (auto pending = market_updates->size(); pending; --pending)
+        market_updates->updateReadIndex();
+    }
+  }
+  const auto elapsed = getCurrentNanos() - start;
+
+  for (auto &matching_engine: matching_engines)
+    matching_engine->stop();
+  return static_cast<double>(NumRequests) * NANOS_TO_SECS / elapsed;
+}
+
+int main(int argc, char **argv) {
+  const auto max_shards = std::clamp<size_t>(argc > 1 ? strtoul(argv[1], nullptr, 10) : ME_MAX_TICKERS, 1, ME_MAX_TICKERS);
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  Logger logger("me_shard_benchmark.log");
+  const Workload workload;
+  Latencies latencies;
+
+  printf("%6s %12s %12s %12s %12s %12s\n", "shards", "requests/s", "hot-p50-us", "hot-p99-us", "other-p50-us", "other-p99-us");
+  for (size_t num_shards = 1; num_shards <= max_shards; ++num_shards) {
+    const auto throughput = benchmark(workload, num_shards, &logger, &latencies);
+    printf("%6zu %12.0f %12.1f %12.1f %12.1f %12.1f\n", num_shards, throughput,
+           Latencies::percentile(latencies.hot_, 0.5) / 1000.0, Latencies::percentile(latencies.hot_, 0.99) / 1000.0,
+           Latencies::percentile(latencies.other_, 0.5) / 1000.0, Latencies::percentile(latencies.other_, 0.99) / 1000.0);
+  }
+
+  return 0;
+}
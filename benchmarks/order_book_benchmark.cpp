@@ -0,0 +1,442 @@
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <random>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common/time_utils.h"
+
+#include "exchange/matcher/matching_engine.h"
+#include "trading/strategy/trade_engine.h"
+
+/*
+Microbenchmarks of the two order books, the exchange's MEOrderBook, driven through MatchingEngine::processClientRequest() as the
+engine drives it, and the trading side's Trading::MarketOrderBook, driven with the market updates it would receive for the same
+operations through onMarketUpdate(), with a TradeEngine without a strategy behind it. Both keep their logging, which is part of
+what the books cost as they are.
+
+Every case starts from the same book, NumLevels levels per side of OrdersPerLevel orders each, the best bid and ask Spread ticks
+apart, and times batches of operations, undoing each batch untimed before the next one:
+  add-best     a new order at the best bid, behind the orders there.
+  add-deep     a new order DeepLevel levels behind the best bid.
+  cancel-head  cancelling the orders of a level of QueueLength orders front to back, every cancel at the head of the queue.
+  cancel-mid   cancelling all but the first and last order of such a level in random order, every cancel in the middle of the queue.
+  sweep-N      an aggressive buy which trades against every order of the N best ask levels.
+  bbo          a new order inside the spread, which becomes the best bid, and its cancel, each op one change of the BBO.
+Reports ns per operation and, where perf_event_open() is allowed, last level cache misses and L1 data cache read misses per
+operation, counted in user space. The configuration and the random numbers are fixed, so runs on different commits compare.
+*/
+
+using namespace Common;
+
+constexpr size_t NumLevels = 100;
+constexpr size_t OrdersPerLevel = 10;
+constexpr Price Spread = 20;
+constexpr size_t DeepLevel = 50;
+constexpr size_t QueueLength = 1000;
+constexpr size_t BatchSize = 1000;
+constexpr size_t Batches = 50;
+constexpr size_t SweepRepetitions = 500;
+constexpr Price BestBid = 10000;
+constexpr Price BestAsk = BestBid + Spread;
+constexpr Qty OrderQty = 10;
+constexpr TickerId Ticker = 0;
+constexpr size_t NumClients = 16;
+
+/// Counts cache misses of this thread in user space while started, if perf_event_open() is allowed.
+class PerfCounters {
+public:
+  PerfCounters() {
+    fds_[0] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds_[1] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  }
+
+  ~PerfCounters() {
+    for (auto fd: fds_) {
+      if (fd >= 0)
+        close(fd);
+    }
+  }
+
+  auto available() const noexcept {
+    return fds_[0] >= 0;
+  }
+
+  auto start() noexcept {
+    for (auto fd: fds_) {
+      if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  auto stop() noexcept {
+    for (size_t i = 0; i < fds_.size(); ++i) {
+      if (fds_[i] >= 0) {
+        ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(fds_[i], &count, sizeof(count)) == sizeof(count))
+          counts_[i] += count;
+        ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      }
+    }
+  }
+
+  auto reset() noexcept {
+    counts_.fill(0);
+  }
+
+  auto count(size_t i) const noexcept {
+    return (fds_[i] >= 0 ? static_cast<double>(counts_[i]) : -1);
+  }
+
+private:
+  static auto open(uint32_t type, uint64_t config) -> int {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  std::array<int, 2> fds_;
+  std::array<uint64_t, 2> counts_ = {};
+};
+
+/// A resting order as the benchmark tracks it.
+struct Ref {
+  ClientId client_id_ = 0;
+  OrderId order_id_ = OrderId_INVALID;
+  Side side_ = Side::INVALID;
+  Price price_ = Price_INVALID;
+  Qty qty_ = 0;
+};
+
+/// MEOrderBook behind a MatchingEngine which owns only the book of Ticker.
+class MEBook {
+public:
+  static constexpr auto Name = "ME";
+
+  MEBook() : client_requests_(1), client_responses_(ME_MAX_CLIENT_UPDATES), market_updates_(ME_MAX_MARKET_UPDATES),
+             matching_engine_(std::make_unique<Exchange::MatchingEngine>(&client_requests_, &client_responses_, &market_updates_, 0, ME_MAX_TICKERS)) {
+  }
+
+  auto add(const Ref &ref) noexcept {
+    send({Exchange::ClientRequestType::NEW, ref.client_id_, Ticker, ref.order_id_, ref.side_, ref.price_, ref.qty_});
+  }
+
+  auto cancel(const Ref &ref) noexcept {
+    send({Exchange::ClientRequestType::CANCEL, ref.client_id_, Ticker, ref.order_id_, ref.side_, ref.price_, ref.qty_});
+  }
+
+  /// The aggressor, a buy of the quantity of all fills limited to the price of the last one, trades against exactly the fills.
+  auto sweep(const Ref &aggressor, const std::vector<Ref> &fills) noexcept {
+    Exchange::MEClientRequest request{Exchange::ClientRequestType::NEW, aggressor.client_id_, Ticker, aggressor.order_id_, Side::BUY,
+                                      fills.back().price_, 0};
+    for (const auto &fill: fills)
+      request.qty_ += fill.qty_;
+    request.time_in_force_ = Exchange::TimeInForce::IOC;
+    send(request);
+  }
+
+  auto drain() noexcept {
+    for (auto pending = client_responses_.size(); pending; --pending)
+      client_responses_.updateReadIndex();
+    for (auto pending = market_updates_.size(); pending; --pending)
+      market_updates_.updateReadIndex();
+  }
+
+private:
+  auto send(const Exchange::MEClientRequest &request) noexcept -> void {
+    matching_engine_->processClientRequest(&request);
+  }
+
+  Exchange::ClientRequestLFQueue client_requests_;
+  Exchange::ClientResponseLFQueue client_responses_;
+  Exchange::MEMarketUpdateLFQueue market_updates_;
+  std::unique_ptr<Exchange::MatchingEngine> matching_engine_;
+};
+
+/// Trading::MarketOrderBook fed the market updates of the same operations, the order ids being the market order ids.
+class MarketBook {
+public:
+  static constexpr auto Name = "Market";
+
+  MarketBook() : client_requests_(1), client_responses_(1), market_updates_(1), logger_("order_book_benchmark_market.log"),
+                 trade_engine_(std::make_unique<Trading::TradeEngine>(1, AlgoType::RANDOM, TradeEngineCfgHashMap{}, &client_requests_,
+                                                                      &client_responses_, &market_updates_)),
+                 book_(std::make_unique<Trading::MarketOrderBook>(Ticker, &logger_)) {
+    book_->setTradeEngine(trade_engine_.get());
+  }
+
+  auto add(const Ref &ref) noexcept {
+    send({Exchange::MarketUpdateType::ADD, ref.order_id_, Ticker, ref.side_, ref.price_, ref.qty_, ++priority_});
+  }
+
+  auto cancel(const Ref &ref) noexcept {
+    send({Exchange::MarketUpdateType::CANCEL, ref.order_id_, Ticker, ref.side_, ref.price_, ref.qty_, Priority_INVALID});
+  }
+
+  auto sweep(const Ref &, const std::vector<Ref> &fills) noexcept {
+    for (const auto &fill: fills) {
+      Exchange::MEMarketUpdate execution{Exchange::MarketUpdateType::EXECUTION, fill.order_id_, Ticker, Side::BUY, fill.price_, fill.qty_, Priority_INVALID};
+      execution.leaves_qty_ = 0;
+      send(execution);
+    }
+  }
+
+  auto drain() noexcept {
+  }
+
+private:
+  auto send(const Exchange::MEMarketUpdate &market_update) noexcept -> void {
+    book_->onMarketUpdate(&market_update);
+  }
+
+  Exchange::ClientRequestLFQueue client_requests_;
+  Exchange::ClientResponseLFQueue client_responses_;
+  Exchange::MEMarketUpdateLFQueue market_updates_;
+  Logger logger_;
+  std::unique_ptr<Trading::TradeEngine> trade_engine_;
+  std::unique_ptr<Trading::MarketOrderBook> book_;
+  Priority priority_ = 0;
+};
+
+struct CaseResult {
+  double ns_per_op_ = 0;
+  double llc_misses_per_op_ = -1;
+  double l1d_misses_per_op_ = -1;
+};
+
+/// Runs the cases against one book, keeping track of its orders level by level to know what to cancel, sweep and put back.
+template<typename Book>
+class Harness {
+public:
+  Harness() : rng_(42) {
+    for (OrderId order_id = ME_MAX_ORDER_IDS - 1; order_id > 0; --order_id)
+      free_ids_.push_back(order_id);
+    for (size_t level = 0; level < NumLevels; ++level) {
+      for (size_t i = 0; i < OrdersPerLevel; ++i) {
+        add(Side::BUY, BestBid - static_cast<Price>(level));
+        add(Side::SELL, BestAsk + static_cast<Price>(level));
+      }
+    }
+    book_.drain();
+  }
+
+  auto addBest() {
+    return addAt(BestBid);
+  }
+
+  auto addDeep() {
+    return addAt(BestBid - static_cast<Price>(DeepLevel));
+  }
+
+  auto cancelHead() {
+    return cancelQueue(false);
+  }
+
+  auto cancelMid() {
+    return cancelQueue(true);
+  }
+
+  auto sweep(size_t num_levels) {
+    Timer timer(this);
+    std::vector<Ref> fills;
+    for (size_t repetition = 0; repetition < SweepRepetitions; ++repetition) {
+      fills.clear();
+      for (size_t level = 0; level < num_levels; ++level) {
+        auto &queue = levels_[{Side::SELL, BestAsk + static_cast<Price>(level)}];
+        fills.insert(fills.end(), queue.begin(), queue.end());
+        queue.clear();
+      }
+      const Ref aggressor{nextClient(), nextId(), Side::BUY, fills.back().price_, 0};
+
+      timer.start();
+      book_.sweep(aggressor, fills);
+      timer.stop(1);
+
+      freeId(aggressor.order_id_);
+      for (const auto &fill: fills) {
+        freeId(fill.order_id_);
+        add(Side::SELL, fill.price_);
+      }
+      book_.drain();
+    }
+    return timer.result();
+  }
+
+  /// Pairs of an order which improves the best bid by one tick and its cancel.
+  auto bbo() {
+    Timer timer(this);
+    std::vector<Ref> refs(BatchSize);
+    for (size_t batch = 0; batch < Batches; ++batch) {
+      for (auto &ref: refs)
+        ref = {nextClient(), nextId(), Side::BUY, BestBid + 1, OrderQty};
+
+      timer.start();
+      for (const auto &ref: refs) {
+        book_.add(ref);
+        book_.cancel(ref);
+      }
+      timer.stop(2 * refs.size());
+
+      for (const auto &ref: refs)
+        freeId(ref.order_id_);
+      book_.drain();
+    }
+    return timer.result();
+  }
+
+private:
+  /// Times the started sections and counts their cache misses.
+  class Timer {
+  public:
+    explicit Timer(Harness *harness) : harness_(harness) {
+      harness_->counters_.reset();
+    }
+
+    auto start() noexcept {
+      harness_->counters_.start();
+      start_ = getCurrentNanos();
+    }
+
+    auto stop(size_t num_ops) noexcept {
+      elapsed_ += getCurrentNanos() - start_;
+      harness_->counters_.stop();
+      num_ops_ += num_ops;
+    }
+
+    auto result() const noexcept {
+      const auto ops = static_cast<double>(num_ops_);
+      const auto llc = harness_->counters_.count(0), l1d = harness_->counters_.count(1);
+      return CaseResult{static_cast<double>(elapsed_) / ops, llc < 0 ? -1 : llc / ops, l1d < 0 ? -1 : l1d / ops};
+    }
+
+  private:
+    Harness *harness_;
+    Nanos start_ = 0, elapsed_ = 0;
+    size_t num_ops_ = 0;
+  };
+
+  auto nextClient() noexcept {
+    return static_cast<ClientId>(rng_() % NumClients);
+  }
+
+  auto nextId() noexcept {
+    const auto order_id = free_ids_.back();
+    free_ids_.pop_back();
+    return order_id;
+  }
+
+  auto freeId(OrderId order_id) noexcept {
+    free_ids_.push_back(order_id);
+  }
+
+  auto add(Side side, Price price) -> Ref {
+    const Ref ref{nextClient(), nextId(), side, price, OrderQty};
+    book_.add(ref);
+    levels_[{side, price}].push_back(ref);
+    return ref;
+  }
+
+  auto addAt(Price price) {
+    Timer timer(this);
+    std::vector<Ref> refs(BatchSize);
+    for (size_t batch = 0; batch < Batches; ++batch) {
+      for (auto &ref: refs)
+        ref = {nextClient(), nextId(), Side::BUY, price, OrderQty};
+
+      timer.start();
+      for (const auto &ref: refs)
+        book_.add(ref);
+      timer.stop(refs.size());
+
+      for (const auto &ref: refs) {
+        book_.cancel(ref);
+        freeId(ref.order_id_);
+      }
+      book_.drain();
+    }
+    return timer.result();
+  }
+
+  /// A level of QueueLength orders inside the spread, cancelled front to back or, with mid, all but its ends in random order.
+  auto cancelQueue(bool mid) {
+    Timer timer(this);
+    std::vector<Ref> refs(QueueLength);
+    for (size_t batch = 0; batch < Batches; ++batch) {
+      for (auto &ref: refs) {
+        ref = {nextClient(), nextId(), Side::BUY, BestBid + 1, OrderQty};
+        book_.add(ref);
+      }
+      if (mid)
+        std::shuffle(refs.begin() + 1, refs.end() - 1, rng_);
+      book_.drain();
+
+      const auto begin = refs.begin() + (mid ? 1 : 0), end = refs.end() - (mid ? 1 : 0);
+      timer.start();
+      for (auto ref = begin; ref != end; ++ref)
+        book_.cancel(*ref);
+      timer.stop(static_cast<size_t>(end - begin));
+
+      if (mid) {
+        book_.cancel(refs.front());
+        book_.cancel(refs.back());
+      }
+      for (const auto &ref: refs)
+        freeId(ref.order_id_);
+      book_.drain();
+    }
+    return timer.result();
+  }
+
+  Book book_;
+  std::mt19937_64 rng_;
+  PerfCounters counters_;
+  std::vector<OrderId> free_ids_;
+  std::map<std::pair<Side, Price>, std::deque<Ref>> levels_;
+};
+
+auto print(const char *name, const char *book, const CaseResult &result) {
+  printf("%-12s %-7s %10.1f", name, book, result.ns_per_op_);
+  if (result.llc_misses_per_op_ >= 0)
+    printf(" %12.2f", result.llc_misses_per_op_);
+  else
+    printf(" %12s", "-");
+  if (result.l1d_misses_per_op_ >= 0)
+    printf(" %12.2f\n", result.l1d_misses_per_op_);
+  else
+    printf(" %12s\n", "-");
+}
+
+template<typename Book>
+auto runAll() {
+  Harness<Book> harness;
+  print("add-best", Book::Name, harness.addBest());
+  print("add-deep", Book::Name, harness.addDeep());
+  print("cancel-head", Book::Name, harness.cancelHead());
+  print("cancel-mid", Book::Name, harness.cancelMid());
+  for (const size_t num_levels: {1ul, 5ul, 50ul})
+    print(("sweep-" + std::to_string(num_levels)).c_str(), Book::Name, harness.sweep(num_levels));
+  print("bbo", Book::Name, harness.bbo());
+}
+
+int main(int, char **) {
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  printf("%zu levels of %zu orders per side, spread %ld, deep level %zu, queues of %zu, batches of %zu x %zu, %zu sweeps.\n", NumLevels,
+         OrdersPerLevel, Spread, DeepLevel, QueueLength, Batches, BatchSize, SweepRepetitions);
+  if (!PerfCounters().available())
+    printf("perf_event_open() is not available, no cache misses.\n");
+  printf("%-12s %-7s %10s %12s %12s\n", "case", "book", "ns/op", "llc-miss/op", "l1d-miss/op");
+
+  runAll<MEBook>();
+  runAll<MarketBook>();
+  return 0;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <unistd.h>
+
+#include "common/time_utils.h"
+
+#include "exchange/matcher/me_order_index.h"
+
+/*
+Compares the index MEOrderBook keeps of its live orders by (client_id, client_order_id), the open addressing MEOrderIndex,
+against the ME_MAX_NUM_CLIENTS x ME_MAX_ORDER_IDS array of pointers it replaced. The array is 2GB of address space per book,
+allocated here the way the kernel hands it out, zero pages which only become resident once written to. The live orders
+belong to Clients clients which number their orders from 1, either densely or one id per Stride, as clients do which encode
+something in their order ids. For every number of live orders the benchmark reports:
+  resident - memory the index occupies, for the array the pages holding at least one written slot.
+  hit      - looking up a random live order, the lookup of a cancel request.
+  miss     - looking up an order id which is not live, the lookup of a cancel which gets rejected.
+  churn    - cancelling a random live order and adding a new one for the same client, so the number of live orders stays the same,
+             skipped for the array when the new order ids would run past ME_MAX_ORDER_IDS.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t Clients = 64;
+constexpr size_t Lookups = 2 * 1024 * 1024;
+constexpr OrderId Stride = 512; // one id per 4KB page of the array.
+
+struct Key {
+  ClientId client_id_;
+  OrderId client_order_id_;
+};
+
+/// The array of pointers MEOrderBook used before MEOrderIndex, into the orders of an MEOrderStore-like array here, so it has the same interface.
+class ArrayOrderIndex {
+public:
+  typedef std::array<MEOrder *, ME_MAX_ORDER_IDS> OrderHashMap;
+  typedef std::array<OrderHashMap, ME_MAX_NUM_CLIENTS> ClientOrderHashMap;
+
+  explicit ArrayOrderIndex(MEOrder *orders) : orders_(orders), cid_oid_to_order_(static_cast<ClientOrderHashMap *>(std::calloc(1, sizeof(ClientOrderHashMap)))) {
+    ASSERT(cid_oid_to_order_, "Unable to allocate " + std::to_string(sizeof(ClientOrderHashMap)) + " bytes.");
+  }
+
+  ~ArrayOrderIndex() {
+    std::free(cid_oid_to_order_);
+  }
+
+  auto find(ClientId client_id, OrderId client_order_id) const noexcept {
+    const auto order = (*cid_oid_to_order_)[client_id][client_order_id];
+    return (order ? static_cast<OrderHandle>(order - orders_) : OrderHandle_INVALID);
+  }
+
+  auto insert(ClientId client_id, OrderId client_order_id, OrderHandle handle) noexcept {
+    (*cid_oid_to_order_)[client_id][client_order_id] = orders_ + handle;
+  }
+
+  auto erase(ClientId client_id, OrderId client_order_id) noexcept {
+    (*cid_oid_to_order_)[client_id][client_order_id] = nullptr;
+  }
+
+  /// What MEOrderBook's destructor did.
+  auto clear() noexcept {
+    for (auto &itr: *cid_oid_to_order_)
+      itr.fill(nullptr);
+  }
+
+private:
+  MEOrder *orders_ = nullptr;
+  ClientOrderHashMap *cid_oid_to_order_ = nullptr;
+};
+
+struct RunResult {
+  size_t resident_ = 0;
+  double hit_ = 0, miss_ = 0, churn_ = 0;
+
+  auto print(size_t live, const char *ids, const char *name, size_t resident) const {
+    printf("%8zu %-6s %-6s %12zu %10.1f %10.1f ", live, ids, name, resident >> 10, hit_, miss_);
+    if (churn_ > 0)
+      printf("%10.1f\n", churn_);
+    else
+      printf("%10s\n", "-");
+  }
+};
+
+auto residentBytes() -> size_t {
+  size_t pages = 0, resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  ASSERT(statm && fscanf(statm, "%zu %zu", &pages, &resident) == 2, "Unable to read /proc/self/statm.");
+  fclose(statm);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+template<typename Index>
+auto benchmark(Index &index, size_t live, OrderId stride, std::vector<MEOrder> &orders) -> RunResult {
+  RunResult result;
+  std::mt19937_64 rng(live);
+  std::array<OrderId, Clients> next_order_id;
+  next_order_id.fill(1);
+
+  // Orders are handed out round robin, so every client has about live / Clients of them.
+  std::vector<Key> keys(live);
+  const auto resident_before = residentBytes();
+  for (size_t i = 0; i < live; ++i) {
+    const auto client_id = static_cast<ClientId>(i % Clients);
+    keys[i] = {client_id, next_order_id[client_id]};
+    next_order_id[client_id] += stride;
+    orders[i].client_id_ = client_id;
+    orders[i].client_order_id_ = keys[i].client_order_id_;
+    orders[i].priority_ = i;
+    index.insert(client_id, keys[i].client_order_id_, static_cast<OrderHandle>(i));
+  }
+  result.resident_ = residentBytes() - resident_before;
+
+  std::vector<Key> lookups(Lookups);
+  for (auto &lookup: lookups)
+    lookup = keys[rng() % live];
+
+  Priority sum = 0;
+  auto start = getCurrentNanos();
+  for (const auto &lookup: lookups) {
+    const auto handle = index.find(lookup.client_id_, lookup.client_order_id_);
+    if (UNLIKELY(handle == OrderHandle_INVALID))
+      FATAL("Live order not found.");
+    sum += orders[handle].priority_;
+  }
+  result.hit_ = static_cast<double>(getCurrentNanos() - start) / Lookups;
+
+  for (auto &lookup: lookups)
+    lookup.client_order_id_ = next_order_id[lookup.client_id_] + rng() % 1024 * stride;
+  start = getCurrentNanos();
+  for (const auto &lookup: lookups) {
+    if (UNLIKELY(index.find(lookup.client_id_, lookup.client_order_id_) != OrderHandle_INVALID))
+      FATAL("Order which is not live found.");
+  }
+  result.miss_ = static_cast<double>(getCurrentNanos() - start) / Lookups;
+
+  if (std::is_same_v<Index, ArrayOrderIndex> && (live + Lookups) / Clients * stride >= ME_MAX_ORDER_IDS)
+    return result;
+
+  std::vector<size_t> victims(Lookups);
+  for (auto &victim: victims)
+    victim = rng() % live;
+  start = getCurrentNanos();
+  for (const auto victim: victims) {
+    auto &key = keys[victim];
+    const auto handle = index.find(key.client_id_, key.client_order_id_);
+    if (UNLIKELY(handle == OrderHandle_INVALID))
+      FATAL("Live order not found.");
+    index.erase(key.client_id_, key.client_order_id_);
+    key.client_order_id_ = next_order_id[key.client_id_];
+    next_order_id[key.client_id_] += stride;
+    index.insert(key.client_id_, key.client_order_id_, handle);
+  }
+  result.churn_ = static_cast<double>(getCurrentNanos() - start) / Lookups;
+
+  if (sum == Priority_INVALID)
+    printf("%lu\n", sum);
+  return result;
+}
+
+int main(int, char **) {
+  printf("array index: %zu MB of address space per book, MEOrderIndex: %zu MB initially.\n",
+         sizeof(ArrayOrderIndex::ClientOrderHashMap) >> 20, MEOrderIndex().memoryBytes() >> 20);
+  printf("%8s %-6s %-6s %12s %10s %10s %10s\n", "live", "ids", "index", "resident-KB", "hit-ns", "miss-ns", "churn-ns");
+
+  for (const auto &[live, stride]: {std::pair{1024ul, OrderId{1}}, {64 * 1024ul, 1}, {ME_MAX_ORDER_IDS, 1}, {1024ul, Stride}, {64 * 1024ul, Stride}}) {
+    const auto ids = (stride == 1 ? "dense" : "sparse");
+    std::vector<MEOrder> orders(live);
+
+    auto array_index = std::make_unique<ArrayOrderIndex>(orders.data());
+    const auto array = benchmark(*array_index, live, stride, orders);
+    array.print(live, ids, "array", array.resident_);
+    array_index.reset();
+
+    MEOrderIndex open_index;
+    const auto open = benchmark(open_index, live, stride, orders);
+    open.print(live, ids, "open", open_index.memoryBytes());
+  }
+
+  const auto start = getCurrentNanos();
+  ArrayOrderIndex(nullptr).clear();
+  printf("array index: clearing it as MEOrderBook's destructor did takes %ld ms and makes all of it resident.\n",
+         (getCurrentNanos() - start) / NANOS_TO_MILLIS);
+
+  return 0;
+}
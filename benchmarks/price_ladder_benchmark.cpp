@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+#include "common/time_utils.h"
+#include "common/mem_pool.h"
+
+#include "exchange/matcher/me_price_ladder.h"
+
+/*
+Compares the price level bookkeeping of MEOrderBook, the dense MEPriceLadder with its bitmaps, against the sorted circular
+linked list of levels it replaced, which had to be walked to find where a new level goes. The list version below is the previous
+MEOrderBook code, except that its price to level map is an array covering the whole price range rather than price % 256,
+which would collide on books this wide. Both sides of the book hold `depth` levels spread over about 1.5 * depth prices, and are:
+  insert - built from empty, with the levels added in random order.
+  churn  - kept at that depth while random levels are removed and new ones added at random free prices.
+  sweep  - emptied best level first, like an aggressive order trading through the book.
+  walk   - traversed from the best level to the last, like a snapshot of the book.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr Price MidPrice = 1000000;
+constexpr size_t Repetitions = 20;
+
+/// The linked list of price levels MEOrderBook used before MEPriceLadder.
+class ListPriceLevels {
+public:
+  struct Level {
+    Side side_ = Side::INVALID;
+    Price price_ = Price_INVALID;
+    Level *prev_entry_ = nullptr;
+    Level *next_entry_ = nullptr;
+
+    Level() = default;
+
+    Level(Side side, Price price, Level *prev_entry, Level *next_entry)
+        : side_(side), price_(price), prev_entry_(prev_entry), next_entry_(next_entry) {}
+  };
+
+  ListPriceLevels(Price min_price, size_t num_prices) : pool_(num_prices), min_price_(min_price), levels_(num_prices, nullptr) {
+  }
+
+  auto getOrdersAtPrice(Price price) const noexcept {
+    return levels_[price - min_price_];
+  }
+
+  auto addOrdersAtPrice(Side side, Price price) noexcept {
+    auto new_orders_at_price = pool_.allocate(side, price, nullptr, nullptr);
+    levels_[price - min_price_] = new_orders_at_price;
+
+    const auto best_orders_by_price = (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_);
+    if (UNLIKELY(!best_orders_by_price)) {
+      (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_) = new_orders_at_price;
+      new_orders_at_price->prev_entry_ = new_orders_at_price->next_entry_ = new_orders_at_price;
+    } else {
+      auto target = best_orders_by_price;
+      bool add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
+                        (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
+      if (add_after) {
+        target = target->next_entry_;
+        add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
+                     (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
+      }
+      while (add_after && target != best_orders_by_price) {
+        add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
+                     (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
+        if (add_after)
+          target = target->next_entry_;
+      }
+
+      if (add_after) { // add new_orders_at_price after target.
+        if (target == best_orders_by_price) {
+          target = best_orders_by_price->prev_entry_;
+        }
+        new_orders_at_price->prev_entry_ = target;
+        target->next_entry_->prev_entry_ = new_orders_at_price;
+        new_orders_at_price->next_entry_ = target->next_entry_;
+        target->next_entry_ = new_orders_at_price;
+      } else { // add new_orders_at_price before target.
+        new_orders_at_price->prev_entry_ = target->prev_entry_;
+        new_orders_at_price->next_entry_ = target;
+        target->prev_entry_->next_entry_ = new_orders_at_price;
+        target->prev_entry_ = new_orders_at_price;
+
+        if ((new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ > best_orders_by_price->price_) ||
+            (new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ < best_orders_by_price->price_)) {
+          target->next_entry_ = (target->next_entry_ == best_orders_by_price ? new_orders_at_price : target->next_entry_);
+          (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_) = new_orders_at_price;
+        }
+      }
+    }
+  }
+
+  auto removeOrdersAtPrice(Side side, Price price) noexcept {
+    const auto best_orders_by_price = (side == Side::BUY ? bids_by_price_ : asks_by_price_);
+    auto orders_at_price = getOrdersAtPrice(price);
+
+    if (UNLIKELY(orders_at_price->next_entry_ == orders_at_price)) { // empty side of book.
+      (side == Side::BUY ? bids_by_price_ : asks_by_price_) = nullptr;
+    } else {
+      orders_at_price->prev_entry_->next_entry_ = orders_at_price->next_entry_;
+      orders_at_price->next_entry_->prev_entry_ = orders_at_price->prev_entry_;
+
+      if (orders_at_price == best_orders_by_price) {
+        (side == Side::BUY ? bids_by_price_ : asks_by_price_) = orders_at_price->next_entry_;
+      }
+
+      orders_at_price->prev_entry_ = orders_at_price->next_entry_ = nullptr;
+    }
+
+    levels_[price - min_price_] = nullptr;
+    pool_.deallocate(orders_at_price);
+  }
+
+  auto best(Side side) const noexcept -> const Level * {
+    return (side == Side::BUY ? bids_by_price_ : asks_by_price_);
+  }
+
+  auto nextLevel(const Level *level) const noexcept -> const Level * {
+    return (level->next_entry_ == best(level->side_) ? nullptr : level->next_entry_);
+  }
+
+private:
+  MemPool<Level> pool_;
+  Level *bids_by_price_ = nullptr;
+  Level *asks_by_price_ = nullptr;
+  Price min_price_ = 0;
+  std::vector<Level *> levels_;
+};
+
+/// The same interface on top of MEPriceLadder, every level gets an order count of one so the ladder considers it live.
+class LadderPriceLevels {
+public:
+  LadderPriceLevels(Price, size_t) {
+  }
+
+  auto getOrdersAtPrice(Side side, Price price) noexcept {
+    return ladder_.getOrdersAtPrice(side, price);
+  }
+
+  auto addOrdersAtPrice(Side side, Price price) noexcept {
+    if (UNLIKELY(!ladder_.makeRoom(price)))
+      FATAL("Price does not fit into the ladder:" + priceToString(price));
+    ladder_.addOrdersAtPrice(side, price)->num_orders_ = 1;
+  }
+
+  auto removeOrdersAtPrice(Side side, Price price) noexcept {
+    ladder_.removeOrdersAtPrice(side, price);
+  }
+
+  auto best(Side side) const noexcept {
+    return ladder_.best(side);
+  }
+
+  auto nextLevel(const MEOrdersAtPrice *level) const noexcept {
+    return ladder_.nextLevel(level);
+  }
+
+private:
+  MEPriceLadder ladder_;
+};
+
+/// Random operations for one depth, generated up front so both implementations see the same sequence and no RNG is timed.
+struct Workload {
+  struct Op {
+    Side side_;
+    Price remove_, add_;
+  };
+
+  Price min_price_ = 0;
+  size_t num_prices_ = 0;
+  std::vector<std::pair<Side, Price>> initial_;
+  std::vector<Op> churn_;
+
+  explicit Workload(size_t depth) {
+    std::mt19937_64 rng(depth);
+    const auto band = static_cast<Price>(depth + depth / 2); // prices per side, so about a third of them are empty.
+    min_price_ = MidPrice - band;
+    num_prices_ = 2 * band + 1;
+
+    std::array<std::vector<Price>, sideToIndex(Side::MAX)> live, free;
+    for (auto side: {Side::BUY, Side::SELL}) {
+      std::vector<Price> prices;
+      for (Price i = 1; i <= band; ++i)
+        prices.push_back(side == Side::BUY ? MidPrice - i : MidPrice + i);
+      std::shuffle(prices.begin(), prices.end(), rng);
+      live[sideToIndex(side)].assign(prices.begin(), prices.begin() + depth);
+      free[sideToIndex(side)].assign(prices.begin() + depth, prices.end());
+      for (auto price: live[sideToIndex(side)])
+        initial_.emplace_back(side, price);
+    }
+    std::shuffle(initial_.begin(), initial_.end(), rng);
+
+    for (size_t i = 0; i < 4 * depth; ++i) {
+      const auto side = (i % 2 ? Side::SELL : Side::BUY);
+      auto &side_live = live[sideToIndex(side)];
+      auto &side_free = free[sideToIndex(side)];
+      const auto live_index = rng() % side_live.size(), free_index = rng() % side_free.size();
+      churn_.push_back({side, side_live[live_index], side_free[free_index]});
+      std::swap(side_live[live_index], side_free[free_index]);
+    }
+  }
+};
+
+struct Result {
+  double insert_ = 0, churn_ = 0, sweep_ = 0, walk_ = 0;
+};
+
+template<typename Levels>
+auto runWorkload(const Workload &workload) -> Result {
+  Result result;
+  for (size_t repetition = 0; repetition < Repetitions; ++repetition) {
+    Levels levels(workload.min_price_, workload.num_prices_);
+
+    auto start = getCurrentNanos();
+    for (const auto &[side, price]: workload.initial_)
+      levels.addOrdersAtPrice(side, price);
+    result.insert_ += static_cast<double>(getCurrentNanos() - start) / workload.initial_.size();
+
+    start = getCurrentNanos();
+    for (const auto &op: workload.churn_) {
+      levels.removeOrdersAtPrice(op.side_, op.remove_);
+      levels.addOrdersAtPrice(op.side_, op.add_);
+    }
+    result.churn_ += static_cast<double>(getCurrentNanos() - start) / workload.churn_.size();
+
+    size_t walked = 0;
+    Price checksum = 0;
+    start = getCurrentNanos();
+    for (auto side: {Side::BUY, Side::SELL}) {
+      for (auto level = levels.best(side); level; level = levels.nextLevel(level), ++walked)
+        checksum += level->price_;
+    }
+    result.walk_ += static_cast<double>(getCurrentNanos() - start) / walked;
+    ASSERT(walked == workload.initial_.size(), "Walked " + std::to_string(walked) + " levels, checksum:" + std::to_string(checksum));
+
+    start = getCurrentNanos();
+    for (auto side: {Side::BUY, Side::SELL}) {
+      for (auto level = levels.best(side); level; level = levels.best(side))
+        levels.removeOrdersAtPrice(side, level->price_);
+    }
+    result.sweep_ += static_cast<double>(getCurrentNanos() - start) / walked;
+  }
+
+  return {result.insert_ / Repetitions, result.churn_ / Repetitions, result.sweep_ / Repetitions, result.walk_ / Repetitions};
+}
+
+/// Both implementations have to agree on the book after every operation before their timings mean anything.
+auto verify(const Workload &workload) {
+  ListPriceLevels list(workload.min_price_, workload.num_prices_);
+  LadderPriceLevels ladder(workload.min_price_, workload.num_prices_);
+  auto check = [&]() {
+    for (auto side: {Side::BUY, Side::SELL}) {
+      auto list_level = list.best(side);
+      auto ladder_level = ladder.best(side);
+      for (; list_level && ladder_level; list_level = list.nextLevel(list_level), ladder_level = ladder.nextLevel(ladder_level))
+        ASSERT(list_level->price_ == ladder_level->price_, "Books differ at " + priceToString(list_level->price_));
+      ASSERT(!list_level && !ladder_level, "Books differ in depth.");
+    }
+  };
+
+  for (const auto &[side, price]: workload.initial_) {
+    list.addOrdersAtPrice(side, price);
+    ladder.addOrdersAtPrice(side, price);
+  }
+  check();
+  for (const auto &op: workload.churn_) {
+    list.removeOrdersAtPrice(op.side_, op.remove_);
+    ladder.removeOrdersAtPrice(op.side_, op.remove_);
+    list.addOrdersAtPrice(op.side_, op.add_);
+    ladder.addOrdersAtPrice(op.side_, op.add_);
+  }
+  check();
+}
+
+int main(int, char **) {
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  printf("%8s %-8s %12s %12s %12s %12s\n", "depth", "levels", "insert-ns", "churn-ns", "sweep-ns", "walk-ns");
+  for (size_t depth: {16, 64, 256, 1024}) {
+    const Workload workload(depth);
+    verify(workload);
+
+    const auto list = runWorkload<ListPriceLevels>(workload);
+    const auto ladder = runWorkload<LadderPriceLevels>(workload);
+    printf("%8zu %-8s %12.1f %12.1f %12.1f %12.1f\n", depth, "list", list.insert_, list.churn_, list.sweep_, list.walk_);
+    printf("%8zu %-8s %12.1f %12.1f %12.1f %12.1f\n", depth, "ladder", ladder.insert_, ladder.churn_, ladder.sweep_, ladder.walk_);
+  }
+
+  return 0;
+}
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "common/time_utils.h"
+#include "common/logging.h"
+#include "common/mcast_socket.h"
+#include "common/tcp_server.h"
+
+#include "exchange/market_data/market_update.h"
+#include "exchange/order_server/shm_order_sessions.h"
+
+/*
+Compares the socket and shared memory transports between a co-located client and the exchange on the two paths they cover:
+an order request / response round trip (TCP on loopback vs. a ShmOrderSession) and the one way delivery of an incremental
+market data packet (multicast on loopback vs. the MDPShmRing). Both ends run on a single thread and map the shared memory segments
+separately, like two processes would, so the numbers are the transport cost without any cross-core cache line transfers.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t Iterations = 5000;
+
+struct LatencySamples {
+  std::vector<Nanos> samples_;
+
+  auto print(const char *name) {
+    std::sort(samples_.begin(), samples_.end());
+    Nanos total = 0;
+    for (auto sample: samples_)
+      total += sample;
+    printf("%-24s %10.0f %10ld %10ld\n", name, static_cast<double>(total) / samples_.size(),
+           samples_[samples_.size() / 2], samples_[samples_.size() * 99 / 100]);
+  }
+};
+
+auto benchmarkTcpOrders(Logger &logger, int port) -> LatencySamples {
+  TCPServer server(logger, TCPServerBackend::EPOLL);
+  server.recv_callback_ = [](TCPSocket *socket, Nanos) noexcept {
+    for (size_t i = 0; i + sizeof(OMClientRequest) <= socket->next_rcv_valid_index_; i += sizeof(OMClientRequest)) {
+      const auto request = reinterpret_cast<const OMClientRequest *>(socket->inbound_data_.get() + i);
+      OMClientResponse response;
+      response.seq_num_ = request->seq_num_;
+      response.me_client_response_.client_order_id_ = request->me_client_request_.order_id_;
+      socket->send(&response, sizeof(response));
+    }
+    socket->next_rcv_valid_index_ = 0;
+  };
+  server.recv_finished_callback_ = []() noexcept {};
+  server.listen("lo", port);
+
+  const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  const sockaddr_in addr{AF_INET, htons(port), {htonl(INADDR_LOOPBACK)}, {}};
+  ASSERT(fd >= 0 && connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0,
+         "connect() failed. error:" + std::string(std::strerror(errno)));
+  ASSERT(disableNagle(fd) && setNonBlocking(fd), "Failed to set no-delay or non-blocking on client socket.");
+
+  LatencySamples result;
+  OMClientRequest request;
+  OMClientResponse response;
+  for (size_t i = 0; i < Iterations + Iterations / 10; ++i) {
+    request.seq_num_ = i + 1;
+    const auto start = getCurrentNanos();
+    ASSERT(::send(fd, &request, sizeof(request), MSG_NOSIGNAL) == sizeof(request), "Client send failed.");
+
+    size_t received = 0;
+    while (received < sizeof(response)) {
+      server.poll();
+      server.sendAndRecv();
+      const auto n = recv(fd, reinterpret_cast<char *>(&response) + received, sizeof(response) - received, MSG_DONTWAIT);
+      if (n > 0)
+        received += n;
+    }
+    if (i >= Iterations / 10) // the first iterations are warm up and also accept the connection.
+      result.samples_.push_back(getCurrentNanos() - start);
+  }
+
+  close(fd);
+  return result;
+}
+
+auto benchmarkShmOrders() -> LatencySamples {
+  const std::string name = "/llpetm_shm_transport_benchmark_orders";
+  ShmSegment server_segment(name, sizeof(ShmOrderSessions), true);
+  ShmSegment client_segment(name, sizeof(ShmOrderSessions), false);
+  auto server_sessions = server_segment.as<ShmOrderSessions>();
+  auto client_sessions = client_segment.as<ShmOrderSessions>();
+
+  const ClientId client_id = 1;
+  ASSERT(client_sessions->attach(client_id), "Unable to attach to shared memory order session.");
+  auto &client = client_sessions->sessions_[client_id];
+  auto &server = server_sessions->sessions_[client_id];
+
+  LatencySamples result;
+  for (size_t i = 0; i < Iterations + Iterations / 10; ++i) {
+    const auto start = getCurrentNanos();
+    auto request = client.requests_.getNextToWriteTo();
+    request->seq_num_ = i + 1;
+    client.requests_.updateWriteIndex();
+
+    const OMClientRequest *server_request = nullptr;
+    while (!(server_request = server.requests_.getNextToRead()));
+    auto response = server.responses_.getNextToWriteTo();
+    response->seq_num_ = server_request->seq_num_;
+    response->me_client_response_.client_order_id_ = server_request->me_client_request_.order_id_;
+    server.requests_.updateReadIndex();
+    server.responses_.updateWriteIndex();
+
+    while (!client.responses_.getNextToRead());
+    client.responses_.updateReadIndex();
+    if (i >= Iterations / 10)
+      result.samples_.push_back(getCurrentNanos() - start);
+  }
+
+  client_sessions->detach(client_id);
+  return result;
+}
+
+auto benchmarkMcastMarketData(Logger &logger, int port) -> LatencySamples {
+  const std::string ip = "233.252.14.5";
+  McastSocket publisher(logger), subscriber(logger);
+  ASSERT(publisher.init(ip, "lo", port, false) >= 0, "Unable to create publisher mcast socket. error:" + std::string(std::strerror(errno)));
+  ASSERT(subscriber.init(ip, "lo", port, true) >= 0 && subscriber.join(ip),
+         "Unable to create subscriber mcast socket. error:" + std::string(std::strerror(errno)));
+
+  bool received = false;
+  subscriber.recv_callback_ = [&received](McastSocket *socket) {
+    socket->next_rcv_valid_index_ = 0;
+    received = true;
+  };
+
+  LatencySamples result;
+  char packet[sizeof(MDPPacketHeader) + sizeof(MEMarketUpdate)] = {};
+  for (size_t i = 0; i < Iterations + Iterations / 10; ++i) {
+    const auto start = getCurrentNanos();
+    publisher.sendDatagram(packet, sizeof(packet));
+    for (received = false; !received;)
+      subscriber.sendAndRecv();
+    if (i >= Iterations / 10)
+      result.samples_.push_back(getCurrentNanos() - start);
+  }
+
+  subscriber.leave(ip, port);
+  publisher.leave(ip, port);
+  return result;
+}
+
+auto benchmarkShmMarketData() -> LatencySamples {
+  const std::string name = "/llpetm_shm_transport_benchmark_market_data";
+  ShmSegment publisher_segment(name, sizeof(MDPShmRing), true);
+  ShmSegment subscriber_segment(name, sizeof(MDPShmRing), false);
+  auto ring = publisher_segment.as<MDPShmRing>();
+  MDPShmReader reader(subscriber_segment.as<MDPShmRing>());
+
+  LatencySamples result;
+  char packet[sizeof(MDPPacketHeader) + sizeof(MEMarketUpdate)] = {};
+  char copy[MDP_MAX_PACKET_SIZE];
+  for (size_t i = 0; i < Iterations + Iterations / 10; ++i) {
+    const auto start = getCurrentNanos();
+    auto slot = ring->getNextToWriteTo();
+    memcpy(slot->data_.data(), packet, sizeof(packet));
+    slot->size_ = sizeof(packet);
+    ring->updateWriteIndex();
+
+    while (reader.read([&copy](const MDPShmPacket &p) { memcpy(copy, p.data_.data(), p.size_); }) != ShmReadResult::READ);
+    if (i >= Iterations / 10)
+      result.samples_.push_back(getCurrentNanos() - start);
+  }
+
+  return result;
+}
+
+int main(int, char **) {
+  Logger logger("shm_transport_benchmark.log");
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  printf("%-24s %10s %10s %10s\n", "transport", "mean-ns", "p50-ns", "p99-ns");
+  benchmarkTcpOrders(logger, 13500).print("tcp order round trip");
+  benchmarkShmOrders().print("shm order round trip");
+  benchmarkMcastMarketData(logger, 13501).print("mcast market data");
+  benchmarkShmMarketData().print("shm market data");
+
+  return 0;
+}
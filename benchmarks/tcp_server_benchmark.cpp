@@ -0,0 +1,114 @@
+#include <cstdio>
+
+#include "common/time_utils.h"
+#include "common/logging.h"
+#include "common/tcp_server.h"
+
+/*
+Compares the epoll and io_uring TCPServer backends at 8, 64 and 256 connections on loopback.
+Everything runs on a single thread: every round each client sends one order sized message, the server loop (poll() + sendAndRecv())
+runs until it has echoed all of them back, and the clients read the echoes. We report the cost of an idle server loop iteration,
+which is dominated by per-socket syscalls with epoll, and the time for a full round of messages across all connections.
+*/
+
+using namespace Common;
+
+constexpr size_t MessageSize = 64;
+constexpr size_t IdleIterations = 2000;
+constexpr size_t Rounds = 500;
+
+struct BenchmarkResult {
+  TCPServerBackend backend_ = TCPServerBackend::EPOLL;
+  double idle_loop_ns_ = 0, round_ns_ = 0, loops_per_round_ = 0;
+};
+
+auto connectClient(int port) -> int {
+  const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT(fd >= 0, "socket() failed. error:" + std::string(std::strerror(errno)));
+
+  const sockaddr_in addr{AF_INET, htons(port), {htonl(INADDR_LOOPBACK)}, {}};
+  ASSERT(connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0, "connect() failed. error:" + std::string(std::strerror(errno)));
+  ASSERT(disableNagle(fd) && setNonBlocking(fd), "Failed to set no-delay or non-blocking on client socket.");
+  return fd;
+}
+
+auto runBenchmark(Logger &logger, TCPServerBackend backend, size_t num_connections, int port) -> BenchmarkResult {
+  TCPServer server(logger, backend);
+  server.recv_callback_ = [](TCPSocket *socket, Nanos) noexcept {
+    socket->send(socket->inbound_data_.get(), socket->next_rcv_valid_index_);
+    socket->next_rcv_valid_index_ = 0;
+  };
+  server.recv_finished_callback_ = []() noexcept {};
+  server.listen("lo", port);
+
+  std::vector<int> clients;
+  for (size_t i = 0; i < num_connections; ++i) {
+    clients.push_back(connectClient(port));
+    server.poll();
+  }
+
+  const auto server_loop = [&server]() noexcept {
+    server.poll();
+    server.sendAndRecv();
+  };
+
+  // Every round: send a message on every connection and spin the server loop until every echo came back.
+  char message[MessageSize] = {};
+  char reply[MessageSize * 16];
+  size_t loops = 0;
+  const auto run_round = [&]() noexcept {
+    for (auto fd: clients)
+      ASSERT(::send(fd, message, MessageSize, MSG_NOSIGNAL) == static_cast<ssize_t>(MessageSize), "Client send failed.");
+
+    size_t pending = clients.size() * MessageSize;
+    while (pending) {
+      server_loop();
+      ++loops;
+      for (auto fd: clients) {
+        const auto n = recv(fd, reply, sizeof(reply), MSG_DONTWAIT);
+        if (n > 0)
+          pending -= n;
+      }
+    }
+  };
+
+  for (size_t i = 0; i < Rounds / 10; ++i) // warm up, this also makes sure all connections have been accepted.
+    run_round();
+
+  BenchmarkResult result;
+  result.backend_ = server.backend_;
+
+  auto start = getCurrentNanos();
+  for (size_t i = 0; i < IdleIterations; ++i)
+    server_loop();
+  result.idle_loop_ns_ = static_cast<double>(getCurrentNanos() - start) / IdleIterations;
+
+  loops = 0;
+  start = getCurrentNanos();
+  for (size_t i = 0; i < Rounds; ++i)
+    run_round();
+  result.round_ns_ = static_cast<double>(getCurrentNanos() - start) / Rounds;
+  result.loops_per_round_ = static_cast<double>(loops) / Rounds;
+
+  for (auto fd: clients)
+    close(fd);
+
+  return result;
+}
+
+int main(int, char **) {
+  Logger logger("tcp_server_benchmark.log");
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  int port = 13000;
+  printf("%-10s %12s %14s %14s %14s %14s\n", "backend", "connections", "idle-loop-ns", "round-ns", "ns-per-msg", "loops-per-round");
+  for (auto backend: {TCPServerBackend::EPOLL, TCPServerBackend::IO_URING}) {
+    for (size_t num_connections: {8, 64, 256}) {
+      const auto result = runBenchmark(logger, backend, num_connections, port++);
+      printf("%-10s %12zu %14.0f %14.0f %14.0f %14.1f\n", tcpServerBackendToString(result.backend_).c_str(), num_connections,
+             result.idle_loop_ns_, result.round_ns_, result.round_ns_ / num_connections, result.loops_per_round_);
+    }
+  }
+
+  return 0;
+}
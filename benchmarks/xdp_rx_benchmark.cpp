@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sched.h>
+
+#include "common/time_utils.h"
+#include "common/logging.h"
+#include "common/mcast_socket.h"
+#include "common/xdp_socket.h"
+
+#include "exchange/market_data/market_update.h"
+
+/*
+Compares receiving incremental market data packets through a McastSocket, i.e. the kernel UDP stack, with receiving them through
+an XdpSocket whose XDP program steers the multicast flow into an AF_XDP ring, on the veth pair set up by scripts/xdp_veth_setup.sh:
+  sudo bash scripts/xdp_veth_setup.sh && sudo ip netns exec llpetm_xdp_sub ./xdp_rx_benchmark
+The benchmark runs in the subscriber namespace and creates its publisher socket in the publisher namespace, so every datagram
+crosses the veth pair. Everything runs on a single thread: latency is from before the send until the datagram was read,
+throughput is measured by sending a burst and then timing only how long the receiver takes to drain it. On a veth the kernel
+processes the datagrams during the publisher's send, so the drain time is purely the cost of handing a datagram to user space.
+*/
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t Iterations = 20000;
+constexpr size_t BurstSize = 128; // small enough to fit into the default socket receive buffer, so neither path drops.
+constexpr size_t Bursts = 500;
+const std::string PublisherNamespace = "/var/run/netns/llpetm_xdp_pub";
+const std::string SubscriberIface = "veth_sub";
+const std::string McastIp = "233.252.14.9";
+
+struct RunResult {
+  std::vector<Nanos> latencies_;
+  Nanos drain_time_ = 0;
+  size_t drained_ = 0;
+
+  auto print(const char *name) {
+    std::sort(latencies_.begin(), latencies_.end());
+    printf("%-8s %10ld %10ld %10ld %14.0f %10.2f %10zu\n", name, latencies_[latencies_.size() / 2], latencies_[latencies_.size() * 99 / 100],
+           latencies_[latencies_.size() * 999 / 1000], static_cast<double>(drain_time_) / drained_,
+           static_cast<double>(drained_) * 1000 / drain_time_, Bursts * BurstSize - drained_);
+  }
+};
+
+/// Create the publisher's socket inside the publisher namespace, it stays there after we switch back.
+auto createPublisher(McastSocket &publisher, int port) {
+  const int own_ns = open("/proc/self/ns/net", O_RDONLY);
+  const int publisher_ns = open(PublisherNamespace.c_str(), O_RDONLY);
+  ASSERT(own_ns >= 0 && publisher_ns >= 0 && setns(publisher_ns, CLONE_NEWNET) == 0,
+         "Unable to enter " + PublisherNamespace + ", run scripts/xdp_veth_setup.sh first. error:" + std::string(std::strerror(errno)));
+  ASSERT(publisher.init(McastIp, "veth_pub", port, false) >= 0, "Unable to create publisher mcast socket. error:" + std::string(std::strerror(errno)));
+  ASSERT(setns(own_ns, CLONE_NEWNET) == 0, "Unable to return to own namespace. error:" + std::string(std::strerror(errno)));
+  close(publisher_ns);
+  close(own_ns);
+}
+
+/// Sends the packets and calls receive() until it returns the number of datagrams it read, for both the latency and the throughput runs.
+template<typename F>
+auto benchmark(McastSocket &publisher, F &&receive) -> RunResult {
+  char packet[sizeof(MDPPacketHeader) + sizeof(MEMarketUpdate)] = {};
+  RunResult result;
+  for (size_t i = 0; i < Iterations + Iterations / 10; ++i) {
+    const auto start = getCurrentNanos();
+    publisher.sendDatagram(packet, sizeof(packet));
+    while (!receive());
+    if (i >= Iterations / 10) // the first iterations are warm up.
+      result.latencies_.push_back(getCurrentNanos() - start);
+  }
+
+  for (size_t burst = 0; burst < Bursts; ++burst) {
+    for (size_t i = 0; i < BurstSize; ++i)
+      publisher.sendDatagram(packet, sizeof(packet));
+
+    size_t drained = 0;
+    const auto start = getCurrentNanos();
+    for (auto last_read = start; drained < BurstSize && getCurrentNanos() - last_read < 10 * NANOS_TO_MILLIS;) {
+      if (const auto n = receive()) {
+        drained += n;
+        last_read = getCurrentNanos();
+      }
+    }
+    result.drain_time_ += getCurrentNanos() - start;
+    result.drained_ += drained;
+  }
+
+  return result;
+}
+
+auto benchmarkSocket(Logger &logger, int port) -> RunResult {
+  McastSocket publisher(logger), subscriber(logger);
+  createPublisher(publisher, port);
+  ASSERT(subscriber.init(McastIp, SubscriberIface, port, true) >= 0 && subscriber.join(McastIp),
+         "Unable to create subscriber mcast socket. error:" + std::string(std::strerror(errno)));
+
+  // Read the socket directly rather than through sendAndRecv(), which logs every read, so both paths do the same work per datagram.
+  char buffer[MDP_MAX_PACKET_SIZE];
+  auto result = benchmark(publisher, [&subscriber, &buffer]() -> size_t {
+    return recv(subscriber.socket_fd_, buffer, sizeof(buffer), MSG_DONTWAIT) > 0;
+  });
+  subscriber.leave(McastIp, port);
+  publisher.leave(McastIp, port);
+  return result;
+}
+
+auto benchmarkXdp(Logger &logger, int port) -> RunResult {
+  McastSocket publisher(logger);
+  createPublisher(publisher, port);
+  XdpSocket subscriber;
+  ASSERT(subscriber.init(SubscriberIface, 0, {{McastIp, port}}), "Unable to set up AF_XDP socket. " + subscriber.error_);
+  printf("AF_XDP socket on %s\n", subscriber.toString().c_str());
+
+  MDPPacketHeader header;
+  auto result = benchmark(publisher, [&subscriber, &header]() {
+    return subscriber.recv([&header](uint32_t, uint16_t, const char *payload, size_t) { memcpy(&header, payload, sizeof(header)); });
+  });
+  publisher.leave(McastIp, port);
+  return result;
+}
+
+int main(int, char **) {
+  Logger logger("xdp_rx_benchmark.log");
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  if (!if_nametoindex(SubscriberIface.c_str())) {
+    printf("%s not found, run: sudo bash scripts/xdp_veth_setup.sh && sudo ip netns exec llpetm_xdp_sub ./xdp_rx_benchmark\n", SubscriberIface.c_str());
+    return 1;
+  }
+
+  auto socket = benchmarkSocket(logger, 13700);
+  auto xdp = benchmarkXdp(logger, 13701);
+  printf("%-8s %10s %10s %10s %14s %10s %10s\n", "path", "p50-ns", "p99-ns", "p99.9-ns", "rx-ns/packet", "Mpps", "dropped");
+  socket.print("socket");
+  xdp.print("xdp");
+
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include <cstdio>
+
+#include "common/time_utils.h"
+#include "common/logging.h"
+#include "common/mcast_socket.h"
+#include "common/tcp_socket.h"
+
+/*
+Locates the message size from which MSG_ZEROCOPY sends beat copying sends, for a TCPSocket and a McastSocket on loopback.
+For every size the same amount of data is pushed through the socket once with copying sends and once with every send zerocopy,
+on a single thread which drains the receiving end after every send. We report the cost per send and the throughput of both,
+along with how many zerocopy completions reported that the kernel fell back to copying anyway, which loopback always does:
+the payload is copied when it is delivered to the local receiver, so the crossover found here is an upper bound for real NICs.
+*/
+
+using namespace Common;
+
+constexpr size_t BytesPerRun = 64 * 1024 * 1024;
+
+struct RunResult {
+  double ns_per_send_ = 0, gbps_ = 0;
+  size_t zerocopy_copied_ = 0;
+};
+
+auto tcpConnectionPair(int port) -> std::pair<int, int> {
+  const int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  const int one = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  const sockaddr_in addr{AF_INET, htons(port), {htonl(INADDR_LOOPBACK)}, {}};
+  ASSERT(bind(listener, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0 && ::listen(listener, 1) == 0,
+         "Unable to listen on port:" + std::to_string(port) + " error:" + std::string(std::strerror(errno)));
+
+  const int client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ASSERT(connect(client, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0, "connect() failed. error:" + std::string(std::strerror(errno)));
+  const int server = accept(listener, nullptr, nullptr);
+  close(listener);
+  ASSERT(server >= 0 && setNonBlocking(server) && setNonBlocking(client) && disableNagle(server), "Unable to set up connection.");
+  return {server, client};
+}
+
+auto benchmarkTcp(Logger &logger, size_t message_size, bool zerocopy, int port) -> RunResult {
+  const auto [server, client] = tcpConnectionPair(port);
+  TCPSocket socket(logger);
+  socket.socket_fd_ = server;
+  if (zerocopy)
+    ASSERT(socket.enableZeroCopy(1), "MSG_ZEROCOPY not supported. error:" + std::string(std::strerror(errno)));
+
+  std::vector<char> message(message_size, 'x'), sink(1024 * 1024);
+  const auto num_sends = BytesPerRun / message_size;
+  const auto start = getCurrentNanos();
+  for (size_t i = 0; i < num_sends; ++i) {
+    ASSERT(socket.send(message.data(), message_size), "TCPSocket send buffer full.");
+    socket.sendData();
+    while (recv(client, sink.data(), sink.size(), MSG_DONTWAIT) > 0);
+  }
+  while (socket.outboundQueuedBytes() || socket.zerocopy_.pending()) { // everything has to be sent and released for a fair comparison.
+    socket.sendData();
+    while (recv(client, sink.data(), sink.size(), MSG_DONTWAIT) > 0);
+  }
+  const auto elapsed = static_cast<double>(getCurrentNanos() - start);
+
+  close(client);
+  close(server);
+  return {elapsed / num_sends, static_cast<double>(num_sends * message_size) / elapsed, socket.zerocopy_.copied_};
+}
+
+auto benchmarkMcast(Logger &logger, size_t message_size, bool zerocopy, int port) -> RunResult {
+  const std::string ip = "233.252.14.7";
+  McastSocket publisher(logger), subscriber(logger);
+  ASSERT(publisher.init(ip, "lo", port, false) >= 0, "Unable to create publisher mcast socket. error:" + std::string(std::strerror(errno)));
+  ASSERT(subscriber.init(ip, "lo", port, true) >= 0 && subscriber.join(ip),
+         "Unable to create subscriber mcast socket. error:" + std::string(std::strerror(errno)));
+  subscriber.recv_callback_ = [](McastSocket *socket) { socket->next_rcv_valid_index_ = 0; };
+  if (zerocopy)
+    ASSERT(publisher.enableZeroCopy(1), "MSG_ZEROCOPY not supported. error:" + std::string(std::strerror(errno)));
+
+  std::vector<char> message(message_size, 'x');
+  const auto num_sends = BytesPerRun / message_size;
+  const auto start = getCurrentNanos();
+  for (size_t i = 0; i < num_sends; ++i) {
+    publisher.send(message.data(), message_size);
+    publisher.sendAndRecv();
+    while (subscriber.sendAndRecv());
+  }
+  while (publisher.zerocopy_.pending())
+    readErrorQueue(publisher.socket_fd_, publisher.timestamps_, &publisher.zerocopy_);
+  const auto elapsed = static_cast<double>(getCurrentNanos() - start);
+
+  const RunResult result{elapsed / num_sends, static_cast<double>(num_sends * message_size) / elapsed, publisher.zerocopy_.copied_};
+  subscriber.leave(ip, port);
+  publisher.leave(ip, port);
+  return result;
+}
+
+template<typename F>
+auto findCrossover(const char *name, const std::vector<size_t> &sizes, F &&run) {
+  printf("%s\n%10s %14s %14s %12s %12s %16s\n", name, "bytes", "copy-ns/send", "zc-ns/send", "copy-GB/s", "zc-GB/s", "zc-copied");
+  size_t crossover = 0; // smallest size from which zerocopy is faster at every larger size too, so a single noisy run does not count.
+  for (auto size: sizes) {
+    const auto copy = run(size, false);
+    const auto zerocopy = run(size, true);
+    printf("%10zu %14.0f %14.0f %12.2f %12.2f %16zu\n", size, copy.ns_per_send_, zerocopy.ns_per_send_, copy.gbps_, zerocopy.gbps_,
+           zerocopy.zerocopy_copied_);
+    if (zerocopy.ns_per_send_ >= copy.ns_per_send_)
+      crossover = 0;
+    else if (!crossover)
+      crossover = size;
+  }
+
+  if (crossover)
+    printf("%s crossover: zerocopy is faster from %zu bytes\n\n", name, crossover);
+  else
+    printf("%s crossover: zerocopy is never faster here\n\n", name);
+}
+
+int main(int, char **) {
+  Logger logger("zerocopy_benchmark.log");
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  int port = 13600;
+  findCrossover("TCPSocket", {1024, 4096, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024},
+                [&](size_t size, bool zerocopy) { return benchmarkTcp(logger, size, zerocopy, port++); });
+  findCrossover("McastSocket", {1024, 4096, 16 * 1024, 32 * 1024, 60 * 1024},
+                [&](size_t size, bool zerocopy) { return benchmarkMcast(logger, size, zerocopy, port++); });
+
+  return 0;
+}
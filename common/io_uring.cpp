@@ -0,0 +1,140 @@
+#include "io_uring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
+namespace Common {
+  IoUring::~IoUring() {
+    if (buffers_)
+      munmap(buffers_, buffers_size_);
+    if (buffer_ring_)
+      munmap(buffer_ring_, buffer_ring_size_);
+    if (sqes_)
+      munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_)
+      munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ >= 0)
+      close(ring_fd_);
+  }
+
+  /// Create the ring and map the submission and completion queues.
+  auto IoUring::init(unsigned entries) -> bool {
+    io_uring_params params{};
+    // Completions are only needed when we next enter the kernel, so avoid interrupting the thread for them. Not IORING_SETUP_SINGLE_ISSUER:
+    // the ring is set up and first submitted to by the thread calling listen(), which is usually not the one polling it afterwards.
+    params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG | IORING_SETUP_SUBMIT_ALL;
+    ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd_ < 0)
+      return false;
+
+    // Multishot recvmsg with provided buffers needs a 6.0 kernel, which is also when IORING_OP_SEND_ZC was added, so use that as the probe.
+    std::vector<char> probe_storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+    auto probe = reinterpret_cast<io_uring_probe *>(probe_storage.data());
+    if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, 256) < 0 || probe->last_op < IORING_OP_SEND_ZC ||
+        !(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+      return false;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+      sq_ring_ = nullptr;
+      return false;
+    }
+    cq_ring_ = sq_ring_;
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = reinterpret_cast<io_uring_sqe *>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+      sqes_ = nullptr;
+      return false;
+    }
+
+    auto sq_base = reinterpret_cast<char *>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq_base + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+    sq_flags_ = reinterpret_cast<unsigned *>(sq_base + params.sq_off.flags);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_entries);
+    sqe_tail_ = sqe_submitted_ = *sq_tail_;
+
+    // Submission queue entries are always used in ring order, so the indirection array is set up once as the identity mapping.
+    auto sq_array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i)
+      sq_array[i] = i;
+
+    auto cq_base = reinterpret_cast<char *>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+
+    return true;
+  }
+
+  /// Register a sparse table of num_files fixed file slots, populated later with updateFile().
+  auto IoUring::registerFiles(unsigned num_files) -> bool {
+    io_uring_rsrc_register reg{};
+    reg.nr = num_files;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    return syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_FILES2, &reg, sizeof(reg)) >= 0;
+  }
+
+  /// Install fd into the fixed file slot, or clear the slot if fd is -1.
+  auto IoUring::updateFile(unsigned slot, int fd) -> bool {
+    io_uring_files_update update{};
+    update.offset = slot;
+    update.fds = reinterpret_cast<uint64_t>(&fd);
+    return syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+  }
+
+  /// Register a ring of num_buffers buffers of buffer_size bytes each as provided buffer group group_id, and hand all of them to the kernel.
+  auto IoUring::registerBufferRing(uint16_t group_id, unsigned num_buffers, unsigned buffer_size) -> bool {
+    ASSERT(num_buffers && !(num_buffers & (num_buffers - 1)) && num_buffers <= 32768,
+           "Provided buffer ring size must be a power of 2 no larger than 32768:" + std::to_string(num_buffers));
+
+    buffer_ring_size_ = num_buffers * sizeof(io_uring_buf);
+    auto ring = mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (ring == MAP_FAILED)
+      return false;
+    buffer_ring_ = reinterpret_cast<io_uring_buf_ring *>(ring);
+
+    buffers_size_ = static_cast<size_t>(num_buffers) * buffer_size;
+    auto buffers = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (buffers == MAP_FAILED)
+      return false;
+    buffers_ = reinterpret_cast<char *>(buffers);
+    buffer_size_ = buffer_size;
+
+    // Like noForkAlloc() memory, a fork()ed child has no use for the ring and buffers the kernel writes into.
+    madvise(ring, buffer_ring_size_, MADV_DONTFORK);
+    madvise(buffers, buffers_size_, MADV_DONTFORK);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buffer_ring_);
+    reg.ring_entries = num_buffers;
+    reg.bgid = group_id;
+    if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+      return false;
+
+    buffer_ring_mask_ = num_buffers - 1;
+    for (unsigned i = 0; i < num_buffers; ++i)
+      recycleBuffer(i);
+
+    return true;
+  }
+
+  /// Hand all prepared submission queue entries to the kernel and run any deferred completion work, in a single syscall.
+  auto IoUring::submit() noexcept -> int {
+    const auto to_submit = pendingSubmissions();
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    const int n = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (LIKELY(n >= 0))
+      sqe_submitted_ += n;
+    return n;
+  }
+}
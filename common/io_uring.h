@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace Common {
+  /// Minimal io_uring wrapper built directly on the io_uring_setup / io_uring_enter / io_uring_register syscalls.
+  /// Provides a submission queue, a completion queue, a sparse registered file table and provided buffer rings,
+  /// which is everything the io_uring TCPServer backend needs. It is meant to be used from a single thread.
+  struct IoUring {
+    IoUring() = default;
+
+    ~IoUring();
+
+    /// Create the ring and map the submission and completion queues.
+    /// Returns false if the kernel does not support io_uring or the features we rely on, callers are expected to fall back to epoll then.
+    auto init(unsigned entries) -> bool;
+
+    /// Register a sparse table of num_files fixed file slots, populated later with updateFile().
+    auto registerFiles(unsigned num_files) -> bool;
+
+    /// Install fd into the fixed file slot, or clear the slot if fd is -1.
+    auto updateFile(unsigned slot, int fd) -> bool;
+
+    /// Register a ring of num_buffers buffers of buffer_size bytes each as provided buffer group group_id, and hand all of them to the kernel.
+    auto registerBufferRing(uint16_t group_id, unsigned num_buffers, unsigned buffer_size) -> bool;
+
+    /// Address of the provided buffer with the given buffer id.
+    auto bufferAddress(uint16_t buffer_id) const noexcept {
+      return buffers_ + static_cast<size_t>(buffer_id) * buffer_size_;
+    }
+
+    /// Give a provided buffer back to the kernel once its contents have been consumed.
+    auto recycleBuffer(uint16_t buffer_id) noexcept {
+      // Index off the start of the ring rather than io_uring_buf_ring::bufs, the flexible array member is declared through an empty struct which
+      // has a non zero size in C++ and would shift the entries.
+      auto buf = reinterpret_cast<io_uring_buf *>(buffer_ring_) + (buffer_ring_tail_ & buffer_ring_mask_);
+      buf->addr = reinterpret_cast<uint64_t>(bufferAddress(buffer_id));
+      buf->len = buffer_size_;
+      buf->bid = buffer_id;
+      ++buffer_ring_tail_;
+      __atomic_store_n(&buffer_ring_->tail, buffer_ring_tail_, __ATOMIC_RELEASE);
+    }
+
+    /// Next free submission queue entry, zeroed out, or nullptr if the submission queue is full.
+    auto getSqe() noexcept -> io_uring_sqe * {
+      const auto head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+      if (UNLIKELY(sqe_tail_ - head >= sq_entries_))
+        return nullptr;
+
+      auto sqe = &sqes_[sqe_tail_ & sq_mask_];
+      memset(sqe, 0, sizeof(io_uring_sqe));
+      ++sqe_tail_;
+      return sqe;
+    }
+
+    /// Number of prepared submission queue entries not yet handed to the kernel.
+    auto pendingSubmissions() const noexcept {
+      return sqe_tail_ - sqe_submitted_;
+    }
+
+    /// True if the kernel has deferred work (completions) waiting to be run on the next io_uring_enter().
+    auto needsEnter() const noexcept {
+      return pendingSubmissions() || (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW));
+    }
+
+    /// Hand all prepared submission queue entries to the kernel and run any deferred completion work, in a single syscall.
+    auto submit() noexcept -> int;
+
+    /// Invoke callback(const io_uring_cqe *) on every available completion and mark them as consumed. Returns the number of completions.
+    template<typename T>
+    auto forEachCqe(T &&callback) noexcept {
+      auto head = *cq_head_;
+      const auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      const auto n = tail - head;
+      for (; head != tail; ++head)
+        callback(&cqes_[head & cq_mask_]);
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      return n;
+    }
+
+    /// Deleted copy & move constructors and assignment-operators.
+    IoUring(const IoUring &) = delete;
+
+    IoUring(const IoUring &&) = delete;
+
+    IoUring &operator=(const IoUring &) = delete;
+
+    IoUring &operator=(const IoUring &&) = delete;
+
+    int ring_fd_ = -1;
+
+  private:
+    /// Submission queue.
+    void *sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_flags_ = nullptr;
+    unsigned sq_mask_ = 0, sq_entries_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned sqe_tail_ = 0, sqe_submitted_ = 0;
+
+    /// Completion queue, shares the mapping with the submission queue when the kernel supports IORING_FEAT_SINGLE_MMAP.
+    void *cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+
+    /// Provided buffer ring and the memory backing the buffers.
+    io_uring_buf_ring *buffer_ring_ = nullptr;
+    size_t buffer_ring_size_ = 0;
+    uint16_t buffer_ring_tail_ = 0, buffer_ring_mask_ = 0;
+    char *buffers_ = nullptr;
+    size_t buffers_size_ = 0;
+    unsigned buffer_size_ = 0;
+  };
+}
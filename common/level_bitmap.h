@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace Common {
+  /// Two level bitmap over N slots, e.g. the price levels of an order book, answering lowest / highest set slot and the next set slot
+  /// above / below a given one with a couple of count-trailing / count-leading-zero instructions (tzcnt / lzcnt).
+  /// Each bit of the summary word says whether the corresponding 64 bit word has any bit set.
+  template<size_t N>
+  class LevelBitmap final {
+  public:
+    static_assert(N && N % 64 == 0 && N <= 64 * 64, "LevelBitmap size must be a multiple of 64 no larger than 4096.");
+
+    /// Returned by the lookups when no slot qualifies.
+    static constexpr size_t NotFound = N;
+
+    auto set(size_t index) noexcept {
+      words_[index / 64] |= (1ull << (index % 64));
+      summary_ |= (1ull << (index / 64));
+    }
+
+    auto clear(size_t index) noexcept {
+      auto &word = words_[index / 64];
+      word &= ~(1ull << (index % 64));
+      if (!word)
+        summary_ &= ~(1ull << (index / 64));
+    }
+
+    auto test(size_t index) const noexcept -> bool {
+      return (words_[index / 64] >> (index % 64)) & 1;
+    }
+
+    auto empty() const noexcept {
+      return !summary_;
+    }
+
+    auto reset() noexcept {
+      summary_ = 0;
+      words_.fill(0);
+    }
+
+    auto lowest() const noexcept -> size_t {
+      return lowestFrom(summary_);
+    }
+
+    auto highest() const noexcept -> size_t {
+      return highestFrom(summary_);
+    }
+
+    /// Lowest set slot above index.
+    auto nextAbove(size_t index) const noexcept -> size_t {
+      const auto word_index = index / 64, bit = index % 64;
+      const auto bits = (bit == 63 ? 0 : words_[word_index] & (~0ull << (bit + 1)));
+      if (bits)
+        return word_index * 64 + std::countr_zero(bits);
+      return lowestFrom(word_index == 63 ? 0 : summary_ & (~0ull << (word_index + 1)));
+    }
+
+    /// Highest set slot below index.
+    auto nextBelow(size_t index) const noexcept -> size_t {
+      const auto word_index = index / 64, bit = index % 64;
+      const auto bits = words_[word_index] & ((1ull << bit) - 1);
+      if (bits)
+        return word_index * 64 + 63 - std::countl_zero(bits);
+      return highestFrom(summary_ & ((1ull << word_index) - 1));
+    }
+
+  private:
+    auto lowestFrom(uint64_t summary) const noexcept -> size_t {
+      if (!summary)
+        return NotFound;
+      const auto word_index = std::countr_zero(summary);
+      return word_index * 64 + std::countr_zero(words_[word_index]);
+    }
+
+    auto highestFrom(uint64_t summary) const noexcept -> size_t {
+      if (!summary)
+        return NotFound;
+      const auto word_index = 63 - std::countl_zero(summary);
+      return word_index * 64 + 63 - std::countl_zero(words_[word_index]);
+    }
+
+    uint64_t summary_ = 0;
+    std::array<uint64_t, N / 64> words_ = {};
+  };
+}
@@ -7,12 +7,13 @@
 #include <atomic>
 
 #include "macros.h"
+#include "no_fork_allocator.h"
 
 namespace Common {
   template<typename T>
   class LFQueue final {
   private:
-    std::vector<T> store_;
+    std::vector<T, NoForkAllocator<T>> store_;
     std::atomic<size_t> next_write_index_ = {0};
     std::atomic<size_t> next_read_index_ = {0};
     std::atomic<size_t> num_elements_ = {0};
@@ -52,6 +53,10 @@ namespace Common {
       return num_elements_.load();
     }
 
+    auto capacity() const noexcept {
+      return store_.size();
+    }
+
     // Deleted default, copy & move constructors and assignment-operators.
     LFQueue() = delete;
 
@@ -85,8 +85,13 @@ namespace Common {
       }
     }
 
+    /// A Logger writing to file_name from a thread of its own, or with an empty file_name one which discards everything, without a
+    /// file or thread, for benchmarks measuring the code around it rather than its logging.
     explicit Logger(const std::string &file_name)
-        : file_name_(file_name), queue_(LOG_QUEUE_SIZE) {
+        : file_name_(file_name), queue_(file_name.empty() ? 1 : LOG_QUEUE_SIZE) {
+      if (file_name.empty())
+        return;
+
       file_.open(file_name);
       ASSERT(file_.is_open(), "Could not open log file:" + file_name);
       logger_thread_ = createAndStartThread(-1, "Common/Logger " + file_name_, [this]() { flushQueue(); });
@@ -94,6 +99,9 @@ namespace Common {
     }
 
     ~Logger() {
+      if (!enabled())
+        return;
+
       std::string time_str;
       std::cerr << Common::getCurrentTimeStr(&time_str) << " Flushing and closing Logger for " << file_name_ << std::endl;
 
@@ -108,6 +116,11 @@ namespace Common {
       std::cerr << Common::getCurrentTimeStr(&time_str) << " Logger for " << file_name_ << " exiting." << std::endl;
     }
 
+    /// Whether logged lines go anywhere, callers skip formatting the arguments of lines which would be discarded.
+    auto enabled() const noexcept -> bool {
+      return logger_thread_ != nullptr;
+    }
+
     auto pushValue(const LogElement &log_element) noexcept {
       *(queue_.getNextToWriteTo()) = log_element;
       queue_.updateWriteIndex();
@@ -162,6 +175,9 @@ namespace Common {
 
     template<typename T, typename... A>
     auto log(const char *s, const T &value, A... args) noexcept {
+      if (UNLIKELY(!enabled()))
+        return;
+
       while (*s) {
         if (*s == '%') {
           if (UNLIKELY(*(s + 1) == '%')) { // to allow %% -> % escape character.
@@ -179,6 +195,9 @@ namespace Common {
 
     // note that this is overloading not specialization. gcc does not allow inline specializations.
     auto log(const char *s) noexcept {
+      if (UNLIKELY(!enabled()))
+        return;
+
       while (*s) {
         if (*s == '%') {
           if (UNLIKELY(*(s + 1) == '%')) { // to allow %% -> % escape character.
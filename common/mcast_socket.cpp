@@ -9,11 +9,33 @@ namespace Common {
   /// Initialize multicast socket to read from or publish to a stream.
   /// Does not join the multicast stream yet.
   auto McastSocket::init(const std::string &ip, const std::string &iface, int port, bool is_listening) -> int {
-    const SocketCfg socket_cfg{ip, iface, port, true, is_listening, false};
+    const SocketCfg socket_cfg{ip, iface, port, true, is_listening, true};
     socket_fd_ = createSocket(logger_, socket_cfg);
+
+    if (!is_listening && txTimestampSampleIntervalFromEnv())
+      ASSERT(enableTxTimestamps(txTimestampSampleIntervalFromEnv()), "setTxTimestamping() failed. errno:" + std::string(strerror(errno)));
+
     return socket_fd_;
   }
 
+  /// Publish the data in the send buffer with MSG_ZEROCOPY if it is at least threshold bytes.
+  auto McastSocket::enableZeroCopy(size_t threshold) -> bool {
+    if (!setZeroCopy(socket_fd_))
+      return false;
+
+    zerocopy_threshold_ = threshold;
+    return true;
+  }
+
+  /// Ask for the kernel TX timestamp of one of every sample_interval datagrams.
+  auto McastSocket::enableTxTimestamps(size_t sample_interval) -> bool {
+    if (!setTxTimestamping(socket_fd_))
+      return false;
+
+    timestamps_.tx_sample_interval_ = sample_interval;
+    return true;
+  }
+
   /// Add / Join membership / subscription to a multicast stream.
   bool McastSocket::join(const std::string &ip) {
     return Common::join(socket_fd_, ip);
@@ -21,6 +43,8 @@ namespace Common {
 
   /// Remove / Leave membership / subscription to a multicast stream.
   auto McastSocket::leave(const std::string &, int) -> void {
+    logger_.log("%:% %() % socket:% % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_,
+                timestamps_.toString(), zerocopy_.toString());
     close(socket_fd_);
     socket_fd_ = -1;
   }
@@ -28,29 +52,84 @@ namespace Common {
   /// Publish outgoing data and read incoming data.
   auto McastSocket::sendAndRecv() noexcept -> bool {
     // Read data and dispatch callbacks if data is available - non blocking.
-    const ssize_t n_rcv = recv(socket_fd_, inbound_data_.data() + next_rcv_valid_index_, McastBufferSize - next_rcv_valid_index_, MSG_DONTWAIT);
+    char ctrl[RxTimestampControlSize];
+    iovec iov{inbound_data_.data() + next_rcv_valid_index_, McastBufferSize - next_rcv_valid_index_};
+    msghdr msg{nullptr, 0, &iov, 1, ctrl, sizeof(ctrl), 0};
+    const ssize_t n_rcv = recvmsg(socket_fd_, &msg, MSG_DONTWAIT);
     if (n_rcv > 0) {
       next_rcv_valid_index_ += n_rcv;
-      logger_.log("%:% %() % read socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_,
-                  next_rcv_valid_index_);
+      last_rx_time_ = getRxTimestamp(&msg);
+      timestamps_.onRecv(last_rx_time_, getCurrentNanos());
+      logger_.log("%:% %() % read socket:% len:% ktime:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_,
+                  next_rcv_valid_index_, last_rx_time_);
       recv_callback_(this);
     }
 
     // Publish market data in the send buffer to the multicast stream.
-    if (next_send_valid_index_ > 0) {
-      ssize_t n = ::send(socket_fd_, outbound_data_.data(), next_send_valid_index_, MSG_DONTWAIT | MSG_NOSIGNAL);
-
-      logger_.log("%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_, n);
+    // A zerocopy send leaves its data pinned, so the next datagram is built after it until the kernel released everything.
+    const auto len = next_send_valid_index_ - send_start_;
+    if (len > 0) {
+      const bool zerocopy = (zerocopy_threshold_ && len >= zerocopy_threshold_ && !zerocopy_.full());
+      sendMsg(outbound_data_.data() + send_start_, len, zerocopy);
+      send_start_ = next_send_valid_index_;
     }
-    next_send_valid_index_ = 0;
+    if (!zerocopy_.pending())
+      send_start_ = next_send_valid_index_ = 0;
 
     return (n_rcv > 0);
   }
 
   /// Copy data to send buffers - does not send them out yet.
   auto McastSocket::send(const void *data, size_t len) noexcept -> void {
+    if (UNLIKELY(next_send_valid_index_ + len >= McastBufferSize && zerocopy_.pending())) {
+      // The start of the buffer is still pinned by zerocopy sends, wait for them to complete and move the unsent data back to the start.
+      while (zerocopy_.pending())
+        readErrorQueue(socket_fd_, timestamps_, &zerocopy_);
+      memmove(outbound_data_.data(), outbound_data_.data() + send_start_, next_send_valid_index_ - send_start_);
+      next_send_valid_index_ -= send_start_;
+      send_start_ = 0;
+    }
+
     memcpy(outbound_data_.data() + next_send_valid_index_, data, len);
     next_send_valid_index_ += len;
     ASSERT(next_send_valid_index_ < McastBufferSize, "Mcast socket buffer filled up and sendAndRecv() not called.");
   }
-}
\ No newline at end of file
+
+  /// Publish a single datagram right away, bypassing the send buffer.
+  auto McastSocket::sendDatagram(const void *data, size_t len) noexcept -> void {
+    sendMsg(data, len, false);
+  }
+
+  /// Send a datagram, with MSG_ZEROCOPY if zerocopy is set.
+  auto McastSocket::sendMsg(const void *data, size_t len, bool zerocopy) noexcept -> bool {
+    const bool sample_tx = timestamps_.txSampleDue();
+    if (UNLIKELY(sample_tx) || zerocopy_.pending()) // the last sampled TX timestamp and zerocopy completions of earlier datagrams.
+      readErrorQueue(socket_fd_, timestamps_, &zerocopy_);
+
+    iovec iov{const_cast<void *>(data), len};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char tx_control[TxTimestampRequestSize];
+    const bool request_tx = (UNLIKELY(sample_tx) && timestamps_.canSampleTx());
+    if (UNLIKELY(request_tx))
+      requestTxTimestamp(&msg, tx_control);
+
+    const auto user_time = getCurrentNanos();
+    ssize_t n = sendmsg(socket_fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+    if (UNLIKELY(zerocopy && n < 0 && errno == ENOBUFS)) { // out of locked memory to pin the pages with, copy instead.
+      zerocopy = false;
+      n = sendmsg(socket_fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    if (n > 0) {
+      if (UNLIKELY(request_tx))
+        timestamps_.onSampledSend(user_time);
+      if (zerocopy)
+        zerocopy_.onSend(static_cast<const char *>(data) - outbound_data_.data());
+    }
+    logger_.log("%:% %() % send socket:% len:% zerocopy:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_,
+                n, zerocopy);
+    return (n > 0 && zerocopy);
+  }
+}
@@ -6,7 +6,8 @@ NOT YET READ
 
 #include <functional>
 
-#include "socket_utils.h"
+#include "no_fork_allocator.h"
+#include "socket_timestamps.h"
 
 #include "logging.h"
 
@@ -37,17 +38,44 @@ namespace Common {
     /// Copy data to send buffers - does not send them out yet.
     auto send(const void *data, size_t len) noexcept -> void;
 
+    /// Publish a single datagram right away, bypassing the send buffer.
+    /// Used by publishers which frame their own MTU sized packets.
+    auto sendDatagram(const void *data, size_t len) noexcept -> void;
+
+    /// Publish the data in the send buffer as a single datagram with MSG_ZEROCOPY if it is at least threshold bytes,
+    /// the part of the send buffer it was sent from is not reused before the completion for it was read from the error queue.
+    auto enableZeroCopy(size_t threshold) -> bool;
+
+    /// Ask for the kernel TX timestamp of one of every sample_interval datagrams, for the tx_latency_ stats. Off by default since reading
+    /// each one back off the error queue is a syscall, init() turns it on for publishers with LLPETM_TX_TIMESTAMPS.
+    auto enableTxTimestamps(size_t sample_interval) -> bool;
+
     int socket_fd_ = -1;
 
     /// Send and receive buffers, typically only one or the other is needed, not both.
-    std::vector<char> outbound_data_;
-    size_t next_send_valid_index_ = 0;
-    std::vector<char> inbound_data_;
+    /// Data before send_start_ has been sent but may still be pinned by zerocopy sends, the buffer starts over once they completed.
+    std::vector<char, NoForkAllocator<char>> outbound_data_;
+    size_t send_start_ = 0, next_send_valid_index_ = 0;
+    std::vector<char, NoForkAllocator<char>> inbound_data_;
     size_t next_rcv_valid_index_ = 0;
 
     /// Function wrapper for the method to call when data is read.
     std::function<void(McastSocket *s)> recv_callback_ = nullptr;
 
+    /// Kernel receive timestamp of the last datagram read, and kernel RX / TX timestamp latency stats for this socket.
+    Nanos last_rx_time_ = 0;
+    SocketTimestamps timestamps_;
+
+    /// MSG_ZEROCOPY sends not completed yet, and the datagram size from which the send buffer is sent with MSG_ZEROCOPY, 0 if it never is.
+    ZeroCopyTracker zerocopy_;
+    size_t zerocopy_threshold_ = 0;
+
+  private:
+    /// Send a datagram, with MSG_ZEROCOPY if zerocopy is set. Returns true if it was sent zerocopy, data must not be modified until it completed then.
+    auto sendMsg(const void *data, size_t len, bool zerocopy) noexcept -> bool;
+
+  public:
+
     std::string time_str_;
     Logger &logger_;
   };
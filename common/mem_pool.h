@@ -9,6 +9,8 @@ Not yet read
 #include <string>
 
 #include "macros.h"
+#include "no_fork_allocator.h"
+
 namespace Common {
   template<typename T>
   class MemPool final {
@@ -73,7 +75,7 @@ namespace Common {
     // We could've chosen to use a std::array that would allocate the memory on the stack instead of the heap.
     // We would have to measure to see which one yields better performance.
     // It is good to have objects on the stack but performance starts getting worse as the size of the pool increases.
-    std::vector<ObjectBlock> store_;
+    std::vector<ObjectBlock, NoForkAllocator<ObjectBlock>> store_;
 
     size_t next_free_index_ = 0;
   };
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+
+#include "macros.h"
+
+namespace Common {
+  /// Map size bytes of zeroed memory of their own, marked MADV_DONTFORK: a fork() of the process, which MatchingEngine::checkpoint()
+  /// does, neither copies the page tables of it nor leaves copy on write faults behind on it. The child does not have it mapped.
+  inline auto noForkAlloc(size_t size) -> void * {
+    const auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT(memory != MAP_FAILED, "mmap() failed for " + std::to_string(size) + " bytes. error:" + std::string(std::strerror(errno)));
+    ASSERT(!madvise(memory, size, MADV_DONTFORK), "madvise(MADV_DONTFORK) failed. error:" + std::string(std::strerror(errno)));
+    return memory;
+  }
+
+  inline auto noForkFree(void *memory, size_t size) noexcept -> void {
+    munmap(memory, size);
+  }
+
+  /// Allocator of the large buffers of queues, loggers and sockets, which only the threads of the process that allocated them use.
+  /// Every allocation is a noForkAlloc() mapping. That memory is zeroed already, so default constructed elements are left as they are
+  /// instead of being written, and buffers only take up memory once they are used.
+  template<typename T>
+  struct NoForkAllocator {
+    using value_type = T;
+
+    NoForkAllocator() noexcept = default;
+
+    template<typename U>
+    NoForkAllocator(const NoForkAllocator<U> &) noexcept {
+    }
+
+    auto allocate(size_t n) -> T * {
+      return static_cast<T *>(noForkAlloc(n * sizeof(T)));
+    }
+
+    auto deallocate(T *memory, size_t n) noexcept -> void {
+      noForkFree(memory, n * sizeof(T));
+    }
+
+    template<typename U, typename... Args>
+    auto construct(U *p, Args &&... args) -> void {
+      if constexpr (sizeof...(Args) == 0)
+        ::new(static_cast<void *>(p)) U;
+      else
+        ::new(static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    auto operator==(const NoForkAllocator<U> &) const noexcept {
+      return true;
+    }
+  };
+
+  /// Deleter of a std::unique_ptr<char[]> to a noForkAlloc() buffer.
+  struct NoForkDeleter {
+    size_t size_ = 0;
+
+    auto operator()(char *memory) const noexcept {
+      noForkFree(memory, size_);
+    }
+  };
+
+  using NoForkBuffer = std::unique_ptr<char[], NoForkDeleter>;
+
+  inline auto makeNoForkBuffer(size_t size) -> NoForkBuffer {
+    return NoForkBuffer(static_cast<char *>(noForkAlloc(size)), NoForkDeleter{size});
+  }
+}
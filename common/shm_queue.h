@@ -0,0 +1,228 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace Common {
+  /// Transport used between co-located trading clients and the exchange for order sessions and incremental market data.
+  enum class TransportType : uint8_t {
+    SOCKET = 0,
+    SHM = 1
+  };
+
+  inline auto transportTypeToString(TransportType type) -> std::string {
+    switch (type) {
+      case TransportType::SOCKET:
+        return "SOCKET";
+      case TransportType::SHM:
+        return "SHM";
+    }
+    return "UNKNOWN";
+  }
+
+  /// Transport selected by the LLPETM_TRANSPORT environment variable, "shm" selects shared memory, anything else sockets.
+  inline auto transportTypeFromEnv() -> TransportType {
+    const auto value = getenv("LLPETM_TRANSPORT");
+    return (value && std::string(value) == "shm") ? TransportType::SHM : TransportType::SOCKET;
+  }
+
+  /// A named POSIX shared memory segment mapped into this process.
+  /// The creator sizes it, which zero fills it, and unlinks the name again on destruction, other processes open the existing segment.
+  class ShmSegment {
+  public:
+    ShmSegment(const std::string &name, size_t size, bool create)
+        : name_(name), size_(size), create_(create) {
+      const int fd = shm_open(name_.c_str(), create_ ? (O_CREAT | O_TRUNC | O_RDWR) : O_RDWR, 0600);
+      ASSERT(fd >= 0, "shm_open() failed for:" + name_ + " error:" + std::string(std::strerror(errno)));
+      ASSERT(!create_ || ftruncate(fd, size_) == 0, "ftruncate() failed for:" + name_ + " error:" + std::string(std::strerror(errno)));
+
+      addr_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      ASSERT(addr_ != MAP_FAILED, "mmap() failed for:" + name_ + " error:" + std::string(std::strerror(errno)));
+    }
+
+    ~ShmSegment() {
+      munmap(addr_, size_);
+      if (create_)
+        shm_unlink(name_.c_str());
+    }
+
+    template<typename T>
+    auto as() const noexcept {
+      return reinterpret_cast<T *>(addr_);
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    ShmSegment() = delete;
+
+    ShmSegment(const ShmSegment &) = delete;
+
+    ShmSegment(const ShmSegment &&) = delete;
+
+    ShmSegment &operator=(const ShmSegment &) = delete;
+
+    ShmSegment &operator=(const ShmSegment &&) = delete;
+
+  private:
+    const std::string name_;
+    const size_t size_ = 0;
+    const bool create_ = false;
+    void *addr_ = nullptr;
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory queues need address free atomics.");
+
+  /// Single producer single consumer queue living in shared memory, with the same interface as LFQueue.
+  /// It is never constructed: zero filled memory from a freshly created ShmSegment is an empty queue.
+  /// The producer and consumer indices live on separate cache lines, and each side caches the other side's index
+  /// so it only touches the shared cache line when the queue looks full / empty.
+  template<typename T, size_t N>
+  struct ShmSPSCQueue {
+    static_assert(N && !(N & (N - 1)), "ShmSPSCQueue size must be a power of 2.");
+
+    /// Next element to write to, or nullptr if the queue is full.
+    auto getNextToWriteTo() noexcept -> T * {
+      const auto write_index = write_index_.load(std::memory_order_relaxed);
+      if (UNLIKELY(write_index - cached_read_index_ == N)) {
+        cached_read_index_ = read_index_.load(std::memory_order_acquire);
+        if (write_index - cached_read_index_ == N)
+          return nullptr;
+      }
+      return &store_[write_index & (N - 1)];
+    }
+
+    auto updateWriteIndex() noexcept {
+      write_index_.store(write_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /// Next element to read, or nullptr if the queue is empty.
+    auto getNextToRead() noexcept -> const T * {
+      const auto read_index = read_index_.load(std::memory_order_relaxed);
+      if (read_index == cached_write_index_) {
+        cached_write_index_ = write_index_.load(std::memory_order_acquire);
+        if (read_index == cached_write_index_)
+          return nullptr;
+      }
+      return &store_[read_index & (N - 1)];
+    }
+
+    auto updateReadIndex() noexcept {
+      read_index_.store(read_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    auto size() const noexcept {
+      return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_acquire);
+    }
+
+    /// Empty the queue, only valid while neither side is using it.
+    auto reset() noexcept {
+      write_index_ = read_index_ = cached_read_index_ = cached_write_index_ = 0;
+    }
+
+    /// Producer cache line.
+    alignas(64) std::atomic<uint64_t> write_index_;
+    uint64_t cached_read_index_;
+
+    /// Consumer cache line.
+    alignas(64) std::atomic<uint64_t> read_index_;
+    uint64_t cached_write_index_;
+
+    alignas(64) std::array<T, N> store_;
+  };
+
+  /// Single producer, multiple consumer broadcast ring living in shared memory, zero filled memory is an empty ring.
+  /// The producer never waits for consumers: every slot carries a sequence word written seqlock style,
+  /// odd while the slot is being written and 2 * (index + 1) once element index is complete,
+  /// which lets a consumer tell an element not published yet from one it was lapped on.
+  template<typename T, size_t N>
+  struct ShmBroadcastRing {
+    static_assert(N && !(N & (N - 1)), "ShmBroadcastRing size must be a power of 2.");
+
+    struct alignas(64) Slot {
+      std::atomic<uint64_t> seq_;
+      T data_;
+    };
+
+    /// Slot to build the next element in, marked as being written.
+    auto getNextToWriteTo() noexcept -> T * {
+      const auto write_index = write_index_.load(std::memory_order_relaxed);
+      auto &slot = slots_[write_index & (N - 1)];
+      slot.seq_.store(2 * write_index + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release); // the odd sequence must be visible before any of the new data.
+      return &slot.data_;
+    }
+
+    /// Publish the element built in the slot returned by getNextToWriteTo().
+    auto updateWriteIndex() noexcept {
+      const auto write_index = write_index_.load(std::memory_order_relaxed);
+      slots_[write_index & (N - 1)].seq_.store(2 * write_index + 2, std::memory_order_release);
+      write_index_.store(write_index + 1, std::memory_order_release);
+    }
+
+    alignas(64) std::atomic<uint64_t> write_index_;
+    std::array<Slot, N> slots_;
+  };
+
+  enum class ShmReadResult : uint8_t {
+    EMPTY = 0,
+    READ = 1,
+    OVERRUN = 2
+  };
+
+  /// A consumer's position in a ShmBroadcastRing, every consumer keeps its own.
+  template<typename T, size_t N>
+  class ShmBroadcastReader {
+  public:
+    /// Starts at the next element the producer publishes.
+    explicit ShmBroadcastReader(const ShmBroadcastRing<T, N> *ring)
+        : ring_(ring), read_index_(ring->write_index_.load(std::memory_order_acquire)) {
+    }
+
+    /// Copy out the next element by calling copy(const T &), what was copied is only valid if READ is returned.
+    /// OVERRUN means the producer lapped this reader, the reader then skips to the newest element and the ones in between are lost.
+    template<typename F>
+    auto read(F &&copy) noexcept -> ShmReadResult {
+      const auto &slot = ring_->slots_[read_index_ & (N - 1)];
+      const auto expected_seq = 2 * read_index_ + 2;
+
+      const auto seq = slot.seq_.load(std::memory_order_acquire);
+      if (seq < expected_seq) // not published yet, or being written.
+        return ShmReadResult::EMPTY;
+
+      if (LIKELY(seq == expected_seq)) {
+        copy(slot.data_);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (LIKELY(slot.seq_.load(std::memory_order_relaxed) == expected_seq)) {
+          ++read_index_;
+          return ShmReadResult::READ;
+        }
+      }
+
+      read_index_ = ring_->write_index_.load(std::memory_order_acquire);
+      return ShmReadResult::OVERRUN;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    ShmBroadcastReader() = delete;
+
+    ShmBroadcastReader(const ShmBroadcastReader &) = delete;
+
+    ShmBroadcastReader(const ShmBroadcastReader &&) = delete;
+
+    ShmBroadcastReader &operator=(const ShmBroadcastReader &) = delete;
+
+    ShmBroadcastReader &operator=(const ShmBroadcastReader &&) = delete;
+
+  private:
+    const ShmBroadcastRing<T, N> *ring_ = nullptr;
+    uint64_t read_index_ = 0;
+  };
+}
@@ -12,7 +12,7 @@ int main(int, char **) {
     logger_.log("TCPServer::defaultRecvCallback() socket:% len:% rx:%\n",
                 socket->socket_fd_, socket->next_rcv_valid_index_, rx_time);
 
-    const std::string reply = "TCPServer received msg:" + std::string(socket->inbound_data_.data(), socket->next_rcv_valid_index_);
+    const std::string reply = "TCPServer received msg:" + std::string(socket->inbound_data_.get(), socket->next_rcv_valid_index_);
     socket->next_rcv_valid_index_ = 0;
 
     socket->send(reply.data(), reply.length());
@@ -23,7 +23,7 @@ int main(int, char **) {
   };
 
   auto tcpClientRecvCallback = [&](TCPSocket *socket, Nanos rx_time) noexcept {
-    const std::string recv_msg = std::string(socket->inbound_data_.data(), socket->next_rcv_valid_index_);
+    const std::string recv_msg = std::string(socket->inbound_data_.get(), socket->next_rcv_valid_index_);
     socket->next_rcv_valid_index_ = 0;
 
     logger_.log("TCPSocket::defaultRecvCallback() socket:% len:% rx:% msg:%\n",
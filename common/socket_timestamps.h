@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <linux/errqueue.h>
+
+#include "socket_utils.h"
+#include "time_utils.h"
+
+namespace Common {
+  /// Room for the control messages carrying a receive timestamp, and a TX timestamp along with its sock_extended_err.
+  constexpr size_t RxTimestampControlSize = CMSG_SPACE(sizeof(scm_timestamping));
+  constexpr size_t TxTimestampControlSize = CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6));
+
+  /// Room for the control message asking for the TX timestamp of a single send.
+  constexpr size_t TxTimestampRequestSize = CMSG_SPACE(sizeof(uint32_t));
+
+  /// Have the kernel report software TX timestamps on the error queue, on top of RX timestamps.
+  /// No send gets one unless it asks for it with requestTxTimestamp(), so this alone costs nothing per send.
+  inline auto setTxTimestamping(int fd) -> bool {
+    const int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_TSONLY;
+    return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != -1);
+  }
+
+  /// Ask for the software TX timestamp of the send made with msg, control is TxTimestampRequestSize bytes the message points to.
+  inline auto requestTxTimestamp(msghdr *msg, char *control) noexcept -> void {
+    msg->msg_control = control;
+    msg->msg_controllen = TxTimestampRequestSize;
+    auto cmsg = CMSG_FIRSTHDR(msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SO_TIMESTAMPING;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+    const uint32_t flags = SOF_TIMESTAMPING_TX_SOFTWARE;
+    memcpy(CMSG_DATA(cmsg), &flags, sizeof(flags));
+  }
+
+  /// TX timestamp sample interval selected by the LLPETM_TX_TIMESTAMPS environment variable: one of every that many sends
+  /// on sockets which send to the outside world is timestamped, TX timestamps are off if it is not set.
+  inline auto txTimestampSampleIntervalFromEnv() -> size_t {
+    const auto value = getenv("LLPETM_TX_TIMESTAMPS");
+    return value ? static_cast<size_t>(std::max(atol(value), 0L)) : 0;
+  }
+
+  inline auto timespecToNanos(const timespec &ts) noexcept -> Nanos {
+    return ts.tv_sec * NANOS_TO_SECS + ts.tv_nsec;
+  }
+
+  /// Kernel software receive timestamp in nanoseconds from the SCM_TIMESTAMPING control message of a received message, 0 if there is none.
+  inline auto getRxTimestamp(msghdr *msg) noexcept -> Nanos {
+    for (auto cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING && cmsg->cmsg_len >= CMSG_LEN(sizeof(scm_timestamping))) {
+        scm_timestamping timestamps;
+        memcpy(&timestamps, CMSG_DATA(cmsg), sizeof(timestamps));
+        return timespecToNanos(timestamps.ts[0]); // ts[0] is the software timestamp, ts[2] would be the hardware one.
+      }
+    }
+    return 0;
+  }
+
+  /// Count, mean, min and max of a series of latencies.
+  struct LatencyStats {
+    size_t count_ = 0;
+    Nanos total_ = 0;
+    Nanos min_ = std::numeric_limits<Nanos>::max();
+    Nanos max_ = 0;
+
+    auto add(Nanos latency) noexcept {
+      ++count_;
+      total_ += latency;
+      min_ = std::min(min_, latency);
+      max_ = std::max(max_, latency);
+    }
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "count:" << count_
+         << " mean:" << (count_ ? total_ / static_cast<Nanos>(count_) : 0)
+         << " min:" << (count_ ? min_ : 0)
+         << " max:" << max_;
+      return ss.str();
+    }
+  };
+
+  /// Kernel timestamping state of a socket:
+  /// rx_latency_ is the time from the kernel receiving data to user space reading it,
+  /// tx_latency_ is the time from user space handing data to send() to the kernel transmitting it.
+  /// Reading a TX timestamp off the error queue is a syscall, so they are sampled: only one send out of every tx_sample_interval_
+  /// asks for one, and none while the last sample's timestamp is still outstanding, which needs no ids to match them up.
+  struct SocketTimestamps {
+    LatencyStats rx_latency_, tx_latency_;
+
+    /// Sends per TX timestamp sample, 0 while TX timestamps are off, which they are unless the owning socket enabled them.
+    size_t tx_sample_interval_ = 0;
+
+    /// Samples whose TX timestamp never arrived, e.g. TCP data the kernel transmitted before it got to mark it for timestamping.
+    size_t tx_lost_ = 0;
+
+    auto onRecv(Nanos kernel_time, Nanos user_time) noexcept {
+      if (LIKELY(kernel_time))
+        rx_latency_.add(user_time - kernel_time);
+    }
+
+    /// Count a send about to be made, true if it is due to be sampled. The caller reads the error queue first then,
+    /// so the last sample's timestamp is in by the time it checks canSampleTx().
+    auto txSampleDue() noexcept {
+      if (LIKELY(!tx_sample_interval_) || ++sends_since_sample_ < tx_sample_interval_)
+        return false;
+      sends_since_sample_ = 0;
+      return true;
+    }
+
+    /// Whether a send due to be sampled can ask for its TX timestamp, which it cannot while the last sample's has not arrived yet.
+    /// A sample still outstanding a whole interval later than that is given up on.
+    auto canSampleTx() noexcept {
+      if (LIKELY(!pending_tx_time_))
+        return true;
+      if (!pending_tx_late_) {
+        pending_tx_late_ = true;
+        return false;
+      }
+      ++tx_lost_;
+      pending_tx_time_ = 0;
+      return true;
+    }
+
+    /// Remember when user space made the send which asked for its TX timestamp.
+    auto onSampledSend(Nanos user_time) noexcept {
+      pending_tx_time_ = user_time;
+      pending_tx_late_ = false;
+    }
+
+    /// A TX timestamp read from the error queue, which belongs to the one sampled send unless it predates it,
+    /// in which case it is a sample given up on which turned up after all.
+    auto onTxTimestamp(Nanos kernel_time) noexcept {
+      if (LIKELY(pending_tx_time_ && kernel_time >= pending_tx_time_)) {
+        tx_latency_.add(kernel_time - pending_tx_time_);
+        pending_tx_time_ = 0;
+      }
+    }
+
+    auto pendingTxTimestamps() const noexcept {
+      return static_cast<size_t>(pending_tx_time_ != 0);
+    }
+
+    /// Start over on a new connection, the sample sent on the old one never gets its timestamp.
+    auto restart() noexcept {
+      pending_tx_time_ = 0;
+      sends_since_sample_ = 0;
+    }
+
+    auto toString() const {
+      return "rx_latency[" + rx_latency_.toString() + "] tx_latency[" + tx_latency_.toString() + " lost:" + std::to_string(tx_lost_) + "]";
+    }
+
+  private:
+    size_t sends_since_sample_ = 0;
+    Nanos pending_tx_time_ = 0;
+    bool pending_tx_late_ = false;
+  };
+
+  /// Maximum number of MSG_ZEROCOPY sends per socket whose buffers the kernel has not released yet, further sends copy until some complete.
+  constexpr size_t MaxPendingZeroCopySends = 1024;
+
+  /// MSG_ZEROCOPY sends whose buffers are still pinned by the kernel. The kernel numbers a socket's zerocopy sends from 0 and reports
+  /// completions on the error queue as ranges of those numbers, a send's buffer must not be written to before its completion arrived.
+  /// Every send records where its data starts in the owner's byte stream, so the owner knows which part of its buffer is still pinned.
+  struct ZeroCopyTracker {
+    /// Number of zerocopy sends, completions, and completions where the kernel fell back to copying the data (always the case on loopback).
+    size_t sends_ = 0, completions_ = 0, copied_ = 0;
+
+    auto pending() const noexcept {
+      return pending_end_ - pending_start_;
+    }
+
+    auto full() const noexcept {
+      return pending() == MaxPendingZeroCopySends;
+    }
+
+    /// Start of the data of the oldest send still pinned, only valid if pending().
+    auto oldestPinned() const noexcept {
+      return pending_[pending_start_ % MaxPendingZeroCopySends].start_;
+    }
+
+    /// Record a zerocopy send of the data starting at start, the caller checks full() first.
+    auto onSend(size_t start) noexcept {
+      pending_[pending_end_++ % MaxPendingZeroCopySends] = {next_id_++, start};
+      ++sends_;
+    }
+
+    /// Completion of the sends numbered up to last, the kernel completes a socket's sends in order so the start of the range is not needed.
+    auto onCompletion(uint32_t last, bool copied) noexcept {
+      for (; pending_start_ != pending_end_ && static_cast<int32_t>(pending_[pending_start_ % MaxPendingZeroCopySends].id_ - last) <= 0; ++pending_start_) {
+        ++completions_;
+        copied_ += copied;
+      }
+    }
+
+    auto toString() const {
+      return "zerocopy[sends:" + std::to_string(sends_) + " completions:" + std::to_string(completions_) + " copied:" + std::to_string(copied_) +
+             " pending:" + std::to_string(pending()) + "]";
+    }
+
+  private:
+    struct PendingSend {
+      uint32_t id_ = 0;
+      size_t start_ = 0;
+    };
+
+    std::array<PendingSend, MaxPendingZeroCopySends> pending_;
+    size_t pending_start_ = 0, pending_end_ = 0;
+    uint32_t next_id_ = 0;
+  };
+
+  /// Read the socket's error queue: the TX timestamp of the sampled send is recorded, and MSG_ZEROCOPY completions release their buffers.
+  /// Stops as soon as nothing more is expected, so this costs a single syscall per notification.
+  inline auto readErrorQueue(int fd, SocketTimestamps &timestamps, ZeroCopyTracker *zerocopy = nullptr) noexcept -> void {
+    char control[TxTimestampControlSize];
+    while (timestamps.pendingTxTimestamps() || (zerocopy && zerocopy->pending())) {
+      msghdr msg{};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        break;
+
+      Nanos kernel_time = 0;
+      const sock_extended_err *error = nullptr;
+      for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING && cmsg->cmsg_len >= CMSG_LEN(sizeof(scm_timestamping))) {
+          scm_timestamping ts;
+          memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+          kernel_time = timespecToNanos(ts.ts[0]);
+        } else if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+          error = reinterpret_cast<const sock_extended_err *>(CMSG_DATA(cmsg));
+        }
+      }
+
+      if (error && error->ee_origin == SO_EE_ORIGIN_TIMESTAMPING && kernel_time)
+        timestamps.onTxTimestamp(kernel_time);
+      else if (error && error->ee_origin == SO_EE_ORIGIN_ZEROCOPY && zerocopy)
+        zerocopy->onCompletion(error->ee_data, error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+    }
+  }
+}
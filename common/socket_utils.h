@@ -15,6 +15,7 @@
 #include <ifaddrs.h>
 #include <sys/socket.h>
 #include <fcntl.h>
+#include <linux/net_tstamp.h>
 
 #include "macros.h"
 
@@ -28,6 +29,8 @@ namespace Common {
     bool is_udp_ = false;
     bool is_listening_ = false;
     bool needs_so_timestamp_ =  false;
+    /// Listening TCP sockets only, lets several sockets listen on the same port, the kernel spreads new connections over them.
+    bool reuse_port_ = false;
 
     auto toString() const {
       std::stringstream ss;
@@ -37,6 +40,7 @@ namespace Common {
       << " is_udp:" << is_udp_
       << " is_listening:" << is_listening_
       << " needs_SO_timestamp:" << needs_so_timestamp_
+      << " reuse_port:" << reuse_port_
       << "]";
 
       return ss.str();
@@ -78,10 +82,16 @@ namespace Common {
     return (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<void *>(&one), sizeof(one)) != -1);
   }
 
-  /// Allow software receive timestamps on incoming packets.
-  inline auto setSOTimestamp(int fd) -> bool {
-    int one = 1;
-    return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, reinterpret_cast<void *>(&one), sizeof(one)) != -1);
+  /// Allow nanosecond software receive timestamps on incoming packets, delivered as SCM_TIMESTAMPING control messages.
+  inline auto setSOTimestamping(int fd) -> bool {
+    const int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != -1);
+  }
+
+  /// Allow MSG_ZEROCOPY sends on the socket, their completions are delivered on the error queue.
+  inline auto setZeroCopy(int fd) -> bool {
+    const int one = 1;
+    return (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != -1);
   }
 
   /// Add / Join membership / subscription to the multicast stream specified and on the interface specified.
@@ -125,6 +135,10 @@ namespace Common {
         ASSERT(setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&one), sizeof(one)) == 0, "setsockopt() SO_REUSEADDR failed. errno:" + std::string(strerror(errno)));
       }
 
+      if (socket_cfg.is_listening_ && socket_cfg.reuse_port_) {
+        ASSERT(setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char *>(&one), sizeof(one)) == 0, "setsockopt() SO_REUSEPORT failed. errno:" + std::string(strerror(errno)));
+      }
+
       if (socket_cfg.is_listening_) {
         // bind to the specified port number.
         const sockaddr_in addr{AF_INET, htons(socket_cfg.port_), {htonl(INADDR_ANY)}, {}};
@@ -136,7 +150,7 @@ namespace Common {
       }
 
       if (socket_cfg.needs_so_timestamp_) { // enable software receive timestamps.
-        ASSERT(setSOTimestamp(socket_fd), "setSOTimestamp() failed. errno:" + std::string(strerror(errno)));
+        ASSERT(setSOTimestamping(socket_fd), "setSOTimestamping() failed. errno:" + std::string(strerror(errno)));
       }
     }
 
@@ -7,70 +7,208 @@ namespace Common {
     return !epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket->socket_fd_, &ev);
   }
 
-  /// Start listening for connections on the provided interface and port.
-  auto TCPServer::listen(const std::string &iface, int port) -> void {
-    epoll_fd_ = epoll_create(1);
-    ASSERT(epoll_fd_ >= 0, "epoll_create() failed error:" + std::string(std::strerror(errno)));
+  /// Watch a connection for EPOLLOUT while the kernel's send buffer is full, and stop watching once everything queued has been sent.
+  auto TCPServer::waitForEpollOut(TCPSocket *socket, bool wait) noexcept -> void {
+    if (socket->waiting_for_epollout_ == wait)
+      return;
+
+    socket->waiting_for_epollout_ = wait;
+    epoll_event ev{EPOLLET | EPOLLIN | (wait ? EPOLLOUT : 0u), {reinterpret_cast<void *>(socket)}};
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket->socket_fd_, &ev);
+  }
+
+  /// Accept a new connection and set up a TCPSocket for it.
+  auto TCPServer::acceptSocket(int fd) noexcept -> TCPSocket * {
+    ASSERT(setNonBlocking(fd) && disableNagle(fd), "Failed to set non-blocking or no-delay on socket:" + std::to_string(fd));
+
+    logger_.log("%:% %() % accepted socket:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), fd);
+
+    auto socket = new TCPSocket(logger_);
+    socket->socket_fd_ = fd;
+    if (zerocopy_threshold_ && backend_ == TCPServerBackend::EPOLL && !socket->enableZeroCopy(zerocopy_threshold_))
+      logger_.log("%:% %() % MSG_ZEROCOPY not supported on socket:% error:%\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), fd, std::strerror(errno));
+    if (tx_timestamp_sample_interval_)
+      ASSERT(socket->enableTxTimestamps(tx_timestamp_sample_interval_), "Failed to set timestamping on socket:" + std::to_string(fd));
+    socket->recv_callback_ = recv_callback_;
+    socket->send_list_ = &send_sockets_;
+    return socket;
+  }
+
+  /// Tear down a dead connection: stop watching it, close it and notify disconnect_callback_.
+  auto TCPServer::disconnectSocket(TCPSocket *socket) noexcept -> void {
+    if (socket->is_disconnected_)
+      return;
+
+    logger_.log("%:% %() % disconnecting socket:% % % queued:% max_queued:% partial_sends:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, socket->timestamps_.toString(), socket->zerocopy_.toString(),
+                socket->outboundQueuedBytes(), socket->max_outbound_queued_, socket->partial_sends_);
+
+    socket->is_disconnected_ = true;
+    if (backend_ == TCPServerBackend::IO_URING)
+      io_uring_.updateFile(socket->io_uring_slot_, -1);
+    else
+      epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket->socket_fd_, nullptr);
+    shutdown(socket->socket_fd_, SHUT_RDWR); // fails an io_uring send still waiting for a peer which stopped reading, so it completes.
+    close(socket->socket_fd_);
+
+    if (disconnect_callback_)
+      disconnect_callback_(socket);
+
+    disconnected_sockets_.push_back(socket);
+  }
 
-    ASSERT(listener_socket_.connect("", iface, port, true) >= 0,
+  /// Free the TCPSockets of torn down connections, called once they have been dropped from the ready lists.
+  auto TCPServer::releaseDisconnectedSockets() noexcept -> void {
+    std::erase_if(disconnected_sockets_, [this](TCPSocket *socket) {
+      if (socket->in_recv_list_ || socket->in_send_list_)
+        return false;
+
+      if (backend_ == TCPServerBackend::IO_URING) {
+        auto &connection = uring_connections_[socket->io_uring_slot_];
+        if (connection.send_in_flight_) // the kernel is still reading from the send buffer.
+          return false;
+        connection = {};
+        free_uring_slots_.push_back(socket->io_uring_slot_);
+      }
+
+      logger_.log("%:% %() % released socket:%\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
+      delete socket;
+      return true;
+    });
+  }
+
+  /// Start listening for connections on the provided interface and port.
+  auto TCPServer::listen(const std::string &iface, int port, bool reuse_port) -> void {
+    ASSERT(listener_socket_.connect("", iface, port, true, reuse_port) >= 0,
            "Listener socket failed to connect. iface:" + iface + " port:" + std::to_string(port) + " error:" +
            std::string(std::strerror(errno)));
 
+    if (backend_ == TCPServerBackend::IO_URING && !listenIoUring()) {
+      logger_.log("%:% %() % io_uring not available error:%, falling back to epoll.\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), std::strerror(errno));
+      backend_ = TCPServerBackend::EPOLL;
+    }
+
+    logger_.log("%:% %() % listening on iface:% port:% backend:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), iface, port, tcpServerBackendToString(backend_));
+    if (backend_ == TCPServerBackend::IO_URING)
+      return;
+
+    epoll_fd_ = epoll_create(1);
+    ASSERT(epoll_fd_ >= 0, "epoll_create() failed error:" + std::string(std::strerror(errno)));
+
     ASSERT(addToEpollList(&listener_socket_), "epoll_ctl() failed. error:" + std::string(std::strerror(errno)));
   }
 
   /// Publish outgoing data from the send buffer and read incoming data from the receive buffer.
   auto TCPServer::sendAndRecv() noexcept -> void {
+    if (backend_ == TCPServerBackend::IO_URING) {
+      sendAndRecvIoUring();
+      return;
+    }
+
     auto recv = false;
 
-    std::for_each(receive_sockets_.begin(), receive_sockets_.end(), [&recv](auto socket) {
-      recv |= socket->sendAndRecv();
-    });
+    // With edge triggered notifications epoll only reports new data arriving, so a socket stays on the ready list until a read
+    // no longer fills all the space left in its receive buffer, i.e. until everything the kernel had queued has been read.
+    size_t num_still_ready = 0;
+    for (auto socket: receive_sockets_) {
+      if (LIKELY(!socket->is_disconnected_)) {
+        const auto space = TCPBufferSize - socket->next_rcv_valid_index_;
+        const auto read_size = socket->recvData();
+        recv |= (read_size > 0);
+
+        if (UNLIKELY((read_size == 0 && space) || (read_size < 0 && errno != EAGAIN && errno != EWOULDBLOCK))) {
+          disconnectSocket(socket);
+        } else if (UNLIKELY(read_size > 0 && static_cast<size_t>(read_size) == space)) {
+          receive_sockets_[num_still_ready++] = socket;
+          continue;
+        }
+      }
+      socket->in_recv_list_ = false;
+    }
+    receive_sockets_.resize(num_still_ready);
 
     if (recv) // There were some events and they have all been dispatched, inform listener.
       recv_finished_callback_();
 
-    std::for_each(send_sockets_.begin(), send_sockets_.end(), [](auto socket) {
-      socket->sendAndRecv();
-    });
+    // A partial send means the kernel's send buffer is full, the rest stays queued and the connection waits for EPOLLOUT
+    // instead of retrying on every call.
+    for (auto socket: send_sockets_) {
+      socket->in_send_list_ = false;
+      if (UNLIKELY(socket->is_disconnected_))
+        continue;
+
+      const auto n = socket->sendData();
+      if (UNLIKELY(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        disconnectSocket(socket);
+      else
+        waitForEpollOut(socket, socket->outboundQueuedBytes() != 0);
+    }
+    send_sockets_.clear();
+
+    if (UNLIKELY(!disconnected_sockets_.empty()))
+      releaseDisconnectedSockets();
   }
 
   /// Check for new connections or dead connections and update containers that track the sockets.
   auto TCPServer::poll() noexcept -> void {
-    const int max_events = 1 + send_sockets_.size() + receive_sockets_.size();
+    if (backend_ == TCPServerBackend::IO_URING) {
+      pollIoUring();
+      return;
+    }
 
-    const int n = epoll_wait(epoll_fd_, events_, max_events, 0);
+    const int n = epoll_wait(epoll_fd_, events_, sizeof(events_) / sizeof(events_[0]), 0);
     bool have_new_connection = false;
     for (int i = 0; i < n; ++i) {
       const auto &event = events_[i];
       auto socket = reinterpret_cast<TCPSocket *>(event.data.ptr);
 
       // Check for new connections.
-      if (event.events & EPOLLIN) {
-        if (socket == &listener_socket_) {
+      if (socket == &listener_socket_) {
+        if (event.events & EPOLLIN) {
           logger_.log("%:% %() % EPOLLIN listener_socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                       Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
           have_new_connection = true;
+        }
+        continue;
+      }
+
+      // EPOLLERR is also raised when TX timestamps or zerocopy completions are queued on the error queue,
+      // only a pending socket error means the connection failed.
+      if (event.events & EPOLLERR) {
+        readErrorQueue(socket->socket_fd_, socket->timestamps_, &socket->zerocopy_);
+
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (getsockopt(socket->socket_fd_, SOL_SOCKET, SO_ERROR, &error, &error_len) || error) {
+          logger_.log("%:% %() % EPOLLERR socket:% error:%\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, std::strerror(error));
+          disconnectSocket(socket);
           continue;
         }
+      }
+
+      // On EPOLLHUP any data the peer sent before hanging up is still read and dispatched, the read that returns 0 after it tears the connection down.
+      if (event.events & (EPOLLIN | EPOLLHUP)) {
         logger_.log("%:% %() % EPOLLIN socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
+        if (!socket->in_recv_list_) {
+          socket->in_recv_list_ = true;
           receive_sockets_.push_back(socket);
+        }
       }
 
       if (event.events & EPOLLOUT) {
         logger_.log("%:% %() % EPOLLOUT socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(send_sockets_.begin(), send_sockets_.end(), socket) == send_sockets_.end())
+        if (socket->outboundQueuedBytes() && !socket->in_send_list_) {
+          socket->in_send_list_ = true;
           send_sockets_.push_back(socket);
-      }
-
-      if (event.events & (EPOLLERR | EPOLLHUP)) {
-        logger_.log("%:% %() % EPOLLERR socket:%\n", __FILE__, __LINE__, __FUNCTION__,
-                    Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
-          receive_sockets_.push_back(socket);
+        }
       }
     }
 
@@ -84,19 +222,12 @@ namespace Common {
       if (fd == -1)
         break;
 
-      ASSERT(setNonBlocking(fd) && disableNagle(fd),
-             "Failed to set non-blocking or no-delay on socket:" + std::to_string(fd));
-
-      logger_.log("%:% %() % accepted socket:%\n", __FILE__, __LINE__, __FUNCTION__,
-                  Common::getCurrentTimeStr(&time_str_), fd);
-
-      auto socket = new TCPSocket(logger_);
-      socket->socket_fd_ = fd;
-      socket->recv_callback_ = recv_callback_;
+      auto socket = acceptSocket(fd);
       ASSERT(addToEpollList(socket), "Unable to add socket. error:" + std::string(std::strerror(errno)));
 
-      if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
-        receive_sockets_.push_back(socket);
+      // Data may have arrived before the socket was added to the epoll list, so check it once.
+      socket->in_recv_list_ = true;
+      receive_sockets_.push_back(socket);
     }
   }
 }
\ No newline at end of file
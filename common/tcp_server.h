@@ -1,15 +1,43 @@
 #pragma once
 
+#include <array>
+
 #include "tcp_socket.h"
+#include "io_uring.h"
 
 namespace Common {
+  /// Mechanism the TCPServer uses to find out about new connections and data on its sockets.
+  enum class TCPServerBackend : uint8_t {
+    EPOLL = 0,
+    IO_URING = 1
+  };
+
+  inline auto tcpServerBackendToString(TCPServerBackend backend) -> std::string {
+    switch (backend) {
+      case TCPServerBackend::EPOLL:
+        return "EPOLL";
+      case TCPServerBackend::IO_URING:
+        return "IO_URING";
+    }
+    return "UNKNOWN";
+  }
+
+  /// Maximum number of simultaneous connections the io_uring backend supports, this is the size of the registered file table.
+  constexpr size_t IoUringMaxConnections = 1024;
+
+  /// Number and size of the provided buffers the kernel fills with received data in the io_uring backend.
+  constexpr unsigned IoUringNumRecvBuffers = 4096;
+  constexpr unsigned IoUringRecvBufferSize = 4096;
+
   struct TCPServer {
-    explicit TCPServer(Logger &logger)
-        : listener_socket_(logger), logger_(logger) {
+    /// The IO_URING backend falls back to EPOLL in listen() if the kernel does not support the io_uring features it needs.
+    explicit TCPServer(Logger &logger, TCPServerBackend backend = TCPServerBackend::EPOLL)
+        : listener_socket_(logger), backend_(backend), logger_(logger) {
     }
 
     /// Start listening for connections on the provided interface and port.
-    auto listen(const std::string &iface, int port) -> void;
+    /// With reuse_port several TCPServers, e.g. one per thread, listen on the same port and the kernel spreads the connections over them.
+    auto listen(const std::string &iface, int port, bool reuse_port = false) -> void;
 
     /// Check for new connections or dead connections and update containers that track the sockets.
     auto poll() noexcept -> void;
@@ -17,10 +45,51 @@ namespace Common {
     /// Publish outgoing data from the send buffer and read incoming data from the receive buffer.
     auto sendAndRecv() noexcept -> void;
 
+    /// Tear down a connection: stop watching it, close it and notify disconnect_callback_.
+    /// The TCPSocket itself is freed by releaseDisconnectedSockets() once nothing references it any more.
+    /// Called for dead connections, and by users of the server to drop connections, e.g. a peer which does not keep up with its data.
+    auto disconnectSocket(TCPSocket *socket) noexcept -> void;
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    TCPServer() = delete;
+
+    TCPServer(const TCPServer &) = delete;
+
+    TCPServer(const TCPServer &&) = delete;
+
+    TCPServer &operator=(const TCPServer &) = delete;
+
+    TCPServer &operator=(const TCPServer &&) = delete;
+
   private:
     /// Add and remove socket file descriptors to and from the EPOLL list.
     auto addToEpollList(TCPSocket *socket);
 
+    /// Watch a connection for EPOLLOUT while the kernel's send buffer is full, and stop watching once everything queued has been sent.
+    auto waitForEpollOut(TCPSocket *socket, bool wait) noexcept -> void;
+
+    /// Accept a new connection and set up a TCPSocket for it.
+    auto acceptSocket(int fd) noexcept -> TCPSocket *;
+
+    /// Free the TCPSockets of torn down connections, called once they have been dropped from the ready lists.
+    auto releaseDisconnectedSockets() noexcept -> void;
+
+    /// Set up the io_uring backend, returns false if the kernel does not support it.
+    auto listenIoUring() -> bool;
+
+    /// io_uring implementations of poll() and sendAndRecv().
+    auto pollIoUring() noexcept -> void;
+
+    auto sendAndRecvIoUring() noexcept -> void;
+
+    /// Queue the multishot accept and multishot receive operations on the io_uring.
+    auto armIoUringAccept() noexcept -> bool;
+
+    auto armIoUringRecv(size_t slot) noexcept -> bool;
+
+    /// Consume a single io_uring completion.
+    auto processIoUringCompletion(const io_uring_cqe *cqe) noexcept -> void;
+
   public:
     /// Socket on which this server is listening for new connections on.
     int epoll_fd_ = -1;
@@ -28,15 +97,63 @@ namespace Common {
 
     epoll_event events_[1024];
 
-    /// Collection of all sockets, sockets for incoming data, sockets for outgoing data and dead connections.
+    /// Ready lists: sockets with incoming data to read and dispatch, and sockets with outgoing data to send.
+    /// Membership is tracked by the TCPSocket::in_recv_list_ / in_send_list_ flags, so idle connections cost nothing per loop.
     std::vector<TCPSocket *> receive_sockets_, send_sockets_;
 
+    /// Connections which have been torn down but whose TCPSocket has not been freed yet.
+    std::vector<TCPSocket *> disconnected_sockets_;
+
     /// Function wrapper to call back when data is available.
     std::function<void(TCPSocket *s, Nanos rx_time)> recv_callback_ = nullptr;
     /// Function wrapper to call back when all data across all TCPSockets has been read and dispatched this round.
     std::function<void()> recv_finished_callback_ = nullptr;
+    /// Function wrapper to call back when a connection is torn down, the TCPSocket must not be used after this returns.
+    std::function<void(TCPSocket *s)> disconnect_callback_ = nullptr;
+
+    /// Sends of at least this many bytes on accepted connections use MSG_ZEROCOPY, 0 disables it. Only used by the epoll backend,
+    /// the io_uring backend sends straight out of the TCPSocket send buffers with its own operations.
+    size_t zerocopy_threshold_ = 0;
+
+    /// Sends per kernel TX timestamp sample on accepted connections, 0 (the default unless LLPETM_TX_TIMESTAMPS is set) for none.
+    size_t tx_timestamp_sample_interval_ = txTimestampSampleIntervalFromEnv();
+
+    /// Backend in use, IO_URING is replaced by EPOLL in listen() if io_uring is not available.
+    TCPServerBackend backend_ = TCPServerBackend::EPOLL;
 
     std::string time_str_;
     Logger &logger_;
+
+  private:
+    /// State kept by the io_uring backend for every connection, indexed by the connection's registered file slot.
+    struct IoUringConnection {
+      TCPSocket *socket_ = nullptr;
+
+      /// Number of bytes at the front of the socket's send buffer handed to the kernel and not completed yet.
+      size_t send_in_flight_ = 0;
+
+      /// Kernel receive timestamp of the last data copied into the socket's receive buffer.
+      Nanos rx_time_ = 0;
+
+      /// Set when the multishot receive ended because the peer closed the connection or it failed.
+      bool peer_closed_ = false;
+
+      /// A send sampled for its TX timestamp goes out as a sendmsg() asking for it, whose message is kept here while in flight,
+      /// along with the time it was queued, 0 while the send in flight is not sampled.
+      Nanos tx_sample_time_ = 0;
+      msghdr tx_msg_{};
+      iovec tx_iov_{};
+      alignas(cmsghdr) char tx_control_[TxTimestampRequestSize] = {};
+    };
+
+    IoUring io_uring_;
+    std::array<IoUringConnection, IoUringMaxConnections> uring_connections_;
+
+    /// Registered file slots never used yet start at next_uring_slot_, slots of freed connections are reused first.
+    size_t next_uring_slot_ = 0;
+    std::vector<size_t> free_uring_slots_;
+
+    /// Template message header for multishot recvmsg, only the control buffer size is used to lay out the provided buffers.
+    msghdr uring_recv_msg_{};
   };
-}
\ No newline at end of file
+}
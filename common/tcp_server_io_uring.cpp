@@ -0,0 +1,267 @@
+#include "tcp_server.h"
+
+namespace Common {
+  /// Provided buffer group used for all receives on the server.
+  constexpr uint16_t IoUringRecvBufferGroup = 0;
+
+  /// The operation a completion belongs to is encoded in the upper 32 bits of the user data and the connection slot in the lower 32 bits.
+  enum class IoUringOp : uint64_t {
+    ACCEPT = 1,
+    RECV = 2,
+    SEND = 3
+  };
+
+  inline auto ioUringUserData(IoUringOp op, size_t slot) noexcept {
+    return (static_cast<uint64_t>(op) << 32) | slot;
+  }
+
+  /// Set up the io_uring backend, returns false if the kernel does not support it.
+  auto TCPServer::listenIoUring() -> bool {
+    if (!io_uring_.init(2 * IoUringMaxConnections) ||
+        !io_uring_.registerFiles(IoUringMaxConnections) ||
+        !io_uring_.registerBufferRing(IoUringRecvBufferGroup, IoUringNumRecvBuffers, IoUringRecvBufferSize))
+      return false;
+
+    // Room for the SCM_TIMESTAMPING control message the FIFOSequencer needs, acceptSocket() enables timestamping on every connection.
+    uring_recv_msg_.msg_controllen = RxTimestampControlSize;
+
+    return armIoUringAccept() && io_uring_.submit() >= 0;
+  }
+
+  /// Queue the multishot accept operation on the listener socket, it keeps producing a completion per accepted connection.
+  auto TCPServer::armIoUringAccept() noexcept -> bool {
+    auto sqe = io_uring_.getSqe();
+    if (UNLIKELY(!sqe)) {
+      io_uring_.submit();
+      sqe = io_uring_.getSqe();
+    }
+    if (UNLIKELY(!sqe))
+      return false;
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listener_socket_.socket_fd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK;
+    sqe->user_data = ioUringUserData(IoUringOp::ACCEPT, 0);
+    return true;
+  }
+
+  /// Queue a multishot recvmsg on the registered file in the slot, the kernel picks a provided buffer for every chunk of data it receives.
+  auto TCPServer::armIoUringRecv(size_t slot) noexcept -> bool {
+    auto sqe = io_uring_.getSqe();
+    if (UNLIKELY(!sqe)) {
+      io_uring_.submit();
+      sqe = io_uring_.getSqe();
+    }
+    if (UNLIKELY(!sqe))
+      return false;
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->addr = reinterpret_cast<uint64_t>(&uring_recv_msg_);
+    sqe->len = 1;
+    sqe->buf_group = IoUringRecvBufferGroup;
+    sqe->user_data = ioUringUserData(IoUringOp::RECV, slot);
+    return true;
+  }
+
+  /// Consume a single io_uring completion.
+  auto TCPServer::processIoUringCompletion(const io_uring_cqe *cqe) noexcept -> void {
+    const auto op = static_cast<IoUringOp>(cqe->user_data >> 32);
+    const size_t slot = cqe->user_data & 0xFFFFFFFF;
+    const bool more = (cqe->flags & IORING_CQE_F_MORE);
+
+    switch (op) {
+      case IoUringOp::ACCEPT: {
+        if (cqe->res >= 0) {
+          if (UNLIKELY(free_uring_slots_.empty() && next_uring_slot_ == IoUringMaxConnections)) {
+            logger_.log("%:% %() % ERROR too many connections, closing socket:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        Common::getCurrentTimeStr(&time_str_), cqe->res);
+            close(cqe->res);
+          } else {
+            size_t new_slot = next_uring_slot_;
+            if (free_uring_slots_.empty()) {
+              ++next_uring_slot_;
+            } else {
+              new_slot = free_uring_slots_.back();
+              free_uring_slots_.pop_back();
+            }
+
+            auto socket = acceptSocket(cqe->res);
+            socket->io_uring_slot_ = new_slot;
+            ASSERT(io_uring_.updateFile(new_slot, socket->socket_fd_), "Unable to register socket. error:" + std::string(std::strerror(errno)));
+            uring_connections_[new_slot] = {socket, 0, 0, false};
+            ASSERT(armIoUringRecv(new_slot), "Unable to queue recvmsg on socket:" + std::to_string(socket->socket_fd_));
+          }
+        } else {
+          logger_.log("%:% %() % accept error:%\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), std::strerror(-cqe->res));
+        }
+
+        if (UNLIKELY(!more))
+          ASSERT(armIoUringAccept(), "Unable to queue accept on listener socket.");
+      }
+        break;
+
+      case IoUringOp::RECV: {
+        auto &connection = uring_connections_[slot];
+        auto socket = connection.socket_;
+        bool closed = (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS));
+
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+          const uint16_t buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+          const auto buffer = io_uring_.bufferAddress(buffer_id);
+          const auto out = reinterpret_cast<const io_uring_recvmsg_out *>(buffer);
+          const auto control = buffer + sizeof(io_uring_recvmsg_out) + uring_recv_msg_.msg_namelen;
+          const auto payload = control + uring_recv_msg_.msg_controllen;
+
+          if (out->payloadlen > 0) {
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = out->controllen;
+            const auto kernel_time = getRxTimestamp(&msg);
+            socket->timestamps_.onRecv(kernel_time, getCurrentNanos());
+
+            memcpy(socket->inbound_data_.get() + socket->next_rcv_valid_index_, payload, out->payloadlen);
+            socket->next_rcv_valid_index_ += out->payloadlen;
+            connection.rx_time_ = kernel_time;
+            if (!socket->in_recv_list_) {
+              socket->in_recv_list_ = true;
+              receive_sockets_.push_back(socket);
+            }
+
+            logger_.log("%:% %() % read socket:% len:% ktime:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, socket->next_rcv_valid_index_, kernel_time);
+          } else {
+            closed = true;
+          }
+
+          io_uring_.recycleBuffer(buffer_id);
+        }
+
+        if (!more) {
+          if (closed) {
+            logger_.log("%:% %() % connection closed socket:% res:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, cqe->res);
+            // Data received before the peer went away is dispatched first, sendAndRecv() tears the connection down after that.
+            connection.peer_closed_ = true;
+            if (!socket->in_recv_list_)
+              disconnectSocket(socket);
+          } else { // multishot receive stops when it runs out of provided buffers, so queue it again.
+            ASSERT(armIoUringRecv(slot), "Unable to queue recvmsg on socket:" + std::to_string(socket->socket_fd_));
+          }
+        }
+      }
+        break;
+
+      case IoUringOp::SEND: {
+        auto &connection = uring_connections_[slot];
+        auto socket = connection.socket_;
+
+        if (LIKELY(cqe->res > 0)) { // any data which was not sent or which was added while the send was in flight stays queued.
+          const size_t n = cqe->res;
+          socket->consumeOutbound(n);
+          if (UNLIKELY(n < connection.send_in_flight_))
+            ++socket->partial_sends_;
+          if (UNLIKELY(connection.tx_sample_time_))
+            socket->timestamps_.onSampledSend(connection.tx_sample_time_);
+        } else { // the connection is gone, nothing queued will ever be sent.
+          socket->consumeOutbound(socket->outboundQueuedBytes());
+        }
+        connection.send_in_flight_ = 0;
+        connection.tx_sample_time_ = 0;
+
+        if (socket->outboundQueuedBytes() && !socket->in_send_list_ && !socket->is_disconnected_) {
+          socket->in_send_list_ = true;
+          send_sockets_.push_back(socket);
+        }
+
+        logger_.log("%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, cqe->res);
+      }
+        break;
+    }
+  }
+
+  /// Reap completions for new connections and received data, received data is copied into the sockets' receive buffers.
+  auto TCPServer::pollIoUring() noexcept -> void {
+    if (io_uring_.needsEnter())
+      io_uring_.submit();
+
+    io_uring_.forEachCqe([this](const io_uring_cqe *cqe) { processIoUringCompletion(cqe); });
+  }
+
+  /// Dispatch received data to the callbacks and queue sends for every connection with pending data, all submitted in a single syscall.
+  /// io_uring waits for room in the kernel's send buffer itself, so a connection whose peer does not keep up keeps its send in flight
+  /// while the rest of its data stays queued in the socket's send buffer.
+  auto TCPServer::sendAndRecvIoUring() noexcept -> void {
+    for (auto socket: receive_sockets_) {
+      auto &connection = uring_connections_[socket->io_uring_slot_];
+      socket->in_recv_list_ = false;
+      socket->recv_callback_(socket, connection.rx_time_);
+      if (UNLIKELY(connection.peer_closed_))
+        disconnectSocket(socket);
+    }
+
+    if (!receive_sockets_.empty()) // There were some events and they have all been dispatched, inform listener.
+      recv_finished_callback_();
+    receive_sockets_.clear();
+
+    // A connection with a send in flight is dropped from the list here, the send completion puts it back if it has more data by then.
+    size_t num_pending = 0;
+    for (auto socket: send_sockets_) {
+      auto &connection = uring_connections_[socket->io_uring_slot_];
+      if (socket->is_disconnected_ || connection.send_in_flight_ || !socket->outboundQueuedBytes()) {
+        socket->in_send_list_ = false;
+        continue;
+      }
+
+      auto sqe = io_uring_.getSqe();
+      if (UNLIKELY(!sqe)) {
+        io_uring_.submit();
+        sqe = io_uring_.getSqe();
+      }
+      if (UNLIKELY(!sqe)) { // retry on the next call.
+        send_sockets_[num_pending++] = socket;
+        continue;
+      }
+
+      // Only the bytes up to the end of the ring are sent, the completion queues the rest if the queued data wraps around.
+      // A send sampled for its TX timestamp reads the last sample's off the error queue first, the only error queue read this backend does.
+      const auto [data, len] = socket->outboundContiguous();
+      const bool sample_tx = socket->timestamps_.txSampleDue();
+      if (UNLIKELY(sample_tx))
+        readErrorQueue(socket->socket_fd_, socket->timestamps_);
+      if (UNLIKELY(sample_tx && socket->timestamps_.canSampleTx())) {
+        connection.tx_iov_ = {const_cast<char *>(data), len};
+        connection.tx_msg_ = {};
+        connection.tx_msg_.msg_iov = &connection.tx_iov_;
+        connection.tx_msg_.msg_iovlen = 1;
+        requestTxTimestamp(&connection.tx_msg_, connection.tx_control_);
+        connection.tx_sample_time_ = getCurrentNanos();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = reinterpret_cast<uint64_t>(&connection.tx_msg_);
+        sqe->len = 1;
+      } else {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = len;
+      }
+      sqe->fd = socket->io_uring_slot_;
+      sqe->flags = IOSQE_FIXED_FILE;
+      sqe->msg_flags = MSG_NOSIGNAL;
+      sqe->user_data = ioUringUserData(IoUringOp::SEND, socket->io_uring_slot_);
+      connection.send_in_flight_ = len;
+      socket->in_send_list_ = false;
+    }
+    send_sockets_.resize(num_pending);
+
+    if (io_uring_.needsEnter())
+      io_uring_.submit();
+
+    if (UNLIKELY(!disconnected_sockets_.empty()))
+      releaseDisconnectedSockets();
+  }
+}
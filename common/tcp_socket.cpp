@@ -2,11 +2,17 @@
 
 namespace Common {
   /// Create TCPSocket with provided attributes to either listen-on / connect-to.
-  auto TCPSocket::connect(const std::string &ip, const std::string &iface, int port, bool is_listening) -> int {
+  auto TCPSocket::connect(const std::string &ip, const std::string &iface, int port, bool is_listening, bool reuse_port) -> int {
     // Note that needs_so_timestamp=true for FIFOSequencer.
-    const SocketCfg socket_cfg{ip, iface, port, false, is_listening, true};
+    const SocketCfg socket_cfg{ip, iface, port, false, is_listening, true, reuse_port};
     socket_fd_ = createSocket(logger_, socket_cfg);
 
+    if (!is_listening) { // connections accepted by a TCPServer enable TX timestamps in TCPServer::acceptSocket(), a reconnect keeps its interval.
+      const auto tx_sample_interval = (timestamps_.tx_sample_interval_ ? timestamps_.tx_sample_interval_ : txTimestampSampleIntervalFromEnv());
+      if (tx_sample_interval)
+        ASSERT(enableTxTimestamps(tx_sample_interval), "setTxTimestamping() failed. errno:" + std::string(strerror(errno)));
+    }
+
     socket_attrib_.sin_addr.s_addr = INADDR_ANY;
     socket_attrib_.sin_port = htons(port);
     socket_attrib_.sin_family = AF_INET;
@@ -14,12 +20,48 @@ namespace Common {
     return socket_fd_;
   }
 
+  /// Close the connection of a socket created with connect() and drop whatever it had not sent or processed yet.
+  auto TCPSocket::close() noexcept -> void {
+    if (socket_fd_ >= 0)
+      ::close(socket_fd_);
+    socket_fd_ = -1;
+
+    send_head_ = send_tail_;
+    next_rcv_valid_index_ = 0;
+    timestamps_.restart();
+  }
+
+  /// Send with MSG_ZEROCOPY whenever at least threshold bytes are queued.
+  auto TCPSocket::enableZeroCopy(size_t threshold) -> bool {
+    if (!setZeroCopy(socket_fd_))
+      return false;
+
+    zerocopy_threshold_ = threshold;
+    return true;
+  }
+
+  /// Ask for the kernel TX timestamp of one of every sample_interval sends.
+  auto TCPSocket::enableTxTimestamps(size_t sample_interval) -> bool {
+    if (!setTxTimestamping(socket_fd_))
+      return false;
+
+    timestamps_.tx_sample_interval_ = sample_interval;
+    return true;
+  }
+
   /// Called to publish outgoing data from the buffers as well as check for and callback if data is available in the read buffers.
   auto TCPSocket::sendAndRecv() noexcept -> bool {
-    char ctrl[CMSG_SPACE(sizeof(struct timeval))];
-    auto cmsg = reinterpret_cast<struct cmsghdr *>(&ctrl);
+    const auto read_size = recvData();
+    sendData();
+
+    return (read_size > 0);
+  }
 
-    iovec iov{inbound_data_.data() + next_rcv_valid_index_, TCPBufferSize - next_rcv_valid_index_};
+  /// Read available data into the receive buffer and callback if any was read.
+  auto TCPSocket::recvData() noexcept -> ssize_t {
+    char ctrl[RxTimestampControlSize];
+
+    iovec iov{inbound_data_.get() + next_rcv_valid_index_, TCPBufferSize - next_rcv_valid_index_};
     msghdr msg{&socket_attrib_, sizeof(socket_attrib_), &iov, 1, ctrl, sizeof(ctrl), 0};
 
     // Non-blocking call to read available data.
@@ -27,35 +69,84 @@ namespace Common {
     if (read_size > 0) {
       next_rcv_valid_index_ += read_size;
 
-      Nanos kernel_time = 0;
-      timeval time_kernel;
-      if (cmsg->cmsg_level == SOL_SOCKET &&
-          cmsg->cmsg_type == SCM_TIMESTAMP &&
-          cmsg->cmsg_len == CMSG_LEN(sizeof(time_kernel))) {
-        memcpy(&time_kernel, CMSG_DATA(cmsg), sizeof(time_kernel));
-        kernel_time = time_kernel.tv_sec * NANOS_TO_SECS + time_kernel.tv_usec * NANO_TO_MICROS; // convert timestamp to nanoseconds.
-      }
-
+      const auto kernel_time = getRxTimestamp(&msg);
       const auto user_time = getCurrentNanos();
+      timestamps_.onRecv(kernel_time, user_time);
 
       logger_.log("%:% %() % read socket:% len:% utime:% ktime:% diff:%\n", __FILE__, __LINE__, __FUNCTION__,
                   Common::getCurrentTimeStr(&time_str_), socket_fd_, next_rcv_valid_index_, user_time, kernel_time, (user_time - kernel_time));
       recv_callback_(this, kernel_time);
     }
 
-    if (next_send_valid_index_ > 0) {
-      // Non-blocking call to send data.
-      const auto n = ::send(socket_fd_, outbound_data_.data(), next_send_valid_index_, MSG_DONTWAIT | MSG_NOSIGNAL);
-      logger_.log("%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_, n);
+    return read_size;
+  }
+
+  /// Publish as much outgoing data from the send buffer as the kernel takes, whatever it does not take stays queued for the next call.
+  auto TCPSocket::sendData() noexcept -> ssize_t {
+    const auto queued = outboundQueuedBytes();
+    const bool sample_tx = (queued && timestamps_.txSampleDue());
+    if (UNLIKELY(sample_tx) || zerocopy_.pending()) // the last sampled TX timestamp and zerocopy completions of earlier sends.
+      readErrorQueue(socket_fd_, timestamps_, &zerocopy_);
+
+    if (!queued)
+      return 0;
+
+    // The queued bytes wrap around the end of the ring at most once, so they are sent with a single sendmsg() of at most two iovecs.
+    const auto [data, len] = outboundContiguous();
+    iovec iov[2] = {{const_cast<char *>(data), len}, {outbound_data_.get(), queued - len}};
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (queued > len ? 2 : 1);
+    alignas(cmsghdr) char tx_control[TxTimestampRequestSize];
+    const bool request_tx = (UNLIKELY(sample_tx) && timestamps_.canSampleTx());
+    if (UNLIKELY(request_tx))
+      requestTxTimestamp(&msg, tx_control);
+
+    // Non-blocking call to send data, large sends are made zerocopy unless too many of them are still waiting for their completion.
+    // Pinning pages costs more than copying small amounts of data, which is what zerocopy_threshold_ is for.
+    const auto user_time = getCurrentNanos();
+    bool zerocopy = (zerocopy_threshold_ && queued >= zerocopy_threshold_ && !zerocopy_.full());
+    auto n = sendmsg(socket_fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+    if (UNLIKELY(zerocopy && n < 0 && errno == ENOBUFS)) { // out of locked memory to pin the pages with, copy instead.
+      zerocopy = false;
+      n = sendmsg(socket_fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    if (n > 0) {
+      if (zerocopy)
+        zerocopy_.onSend(send_head_);
+      consumeOutbound(n);
+      if (UNLIKELY(request_tx))
+        timestamps_.onSampledSend(user_time);
+    } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) { // the connection is gone, nothing queued will ever be sent.
+      send_head_ = send_tail_;
     }
-    next_send_valid_index_ = 0;
 
-    return (read_size > 0);
+    if (UNLIKELY(outboundQueuedBytes()))
+      ++partial_sends_;
+
+    logger_.log("%:% %() % send socket:% len:% queued:% zerocopy:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                socket_fd_, n, outboundQueuedBytes(), zerocopy);
+    return n;
   }
 
   /// Write outgoing data to the send buffers.
-  auto TCPSocket::send(const void *data, size_t len) noexcept -> void {
-    memcpy(outbound_data_.data() + next_send_valid_index_, data, len);
-    next_send_valid_index_ += len;
+  auto TCPSocket::send(const void *data, size_t len) noexcept -> bool {
+    if (UNLIKELY(send_tail_ - outboundInUseStart() + len > TCPBufferSize))
+      return false;
+
+    const auto tail = send_tail_ & (TCPBufferSize - 1);
+    const auto first = std::min(len, TCPBufferSize - tail);
+    memcpy(outbound_data_.get() + tail, data, first);
+    memcpy(outbound_data_.get(), static_cast<const char *>(data) + first, len - first);
+    send_tail_ += len;
+    max_outbound_queued_ = std::max(max_outbound_queued_, outboundQueuedBytes());
+
+    // Let the owning TCPServer know this connection has data to send, unless it is waiting for the kernel to make room for what is queued already.
+    if (send_list_ && !in_send_list_ && !waiting_for_epollout_) {
+      in_send_list_ = true;
+      send_list_->push_back(this);
+    }
+    return true;
   }
 }
\ No newline at end of file
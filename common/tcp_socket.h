@@ -1,29 +1,73 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
+#include <memory>
+#include <vector>
 
-#include "socket_utils.h"
+#include "no_fork_allocator.h"
+#include "socket_timestamps.h"
 #include "logging.h"
 
 namespace Common {
   /// Size of our send and receive buffers in bytes.
   constexpr size_t TCPBufferSize = 64 * 1024 * 1024;
+  static_assert(!(TCPBufferSize & (TCPBufferSize - 1)), "TCPBufferSize must be a power of 2, the send buffer is a ring.");
 
   struct TCPSocket {
     explicit TCPSocket(Logger &logger)
-        : logger_(logger) {
-      outbound_data_.resize(TCPBufferSize);
-      inbound_data_.resize(TCPBufferSize);
+        : outbound_data_(makeNoForkBuffer(TCPBufferSize)), inbound_data_(makeNoForkBuffer(TCPBufferSize)), logger_(logger) {
     }
 
-    /// Create TCPSocket with provided attributes to either listen-on / connect-to.
-    auto connect(const std::string &ip, const std::string &iface, int port, bool is_listening) -> int;
+    /// Create TCPSocket with provided attributes to either listen-on / connect-to, reuse_port to listen on a port other sockets listen on too.
+    auto connect(const std::string &ip, const std::string &iface, int port, bool is_listening, bool reuse_port = false) -> int;
+
+    /// Close the connection of a socket created with connect() and drop whatever it had not sent or processed yet, so it can connect() again.
+    auto close() noexcept -> void;
+
+    /// Send with MSG_ZEROCOPY whenever at least threshold bytes are queued, the kernel then sends straight out of the send buffer
+    /// instead of copying it, and that part of the buffer is not reused before the completion for it was read from the error queue.
+    auto enableZeroCopy(size_t threshold) -> bool;
+
+    /// Ask for the kernel TX timestamp of one of every sample_interval sends, for the tx_latency_ stats. Off by default since reading
+    /// each one back off the error queue is a syscall, connect() turns it on for LLPETM_TX_TIMESTAMPS.
+    auto enableTxTimestamps(size_t sample_interval) -> bool;
 
     /// Called to publish outgoing data from the buffers as well as check for and callback if data is available in the read buffers.
     auto sendAndRecv() noexcept -> bool;
 
+    /// Read available data into the receive buffer and callback if any was read.
+    /// Returns the number of bytes read, 0 if the peer closed the connection and -1 (with errno set) if nothing could be read.
+    auto recvData() noexcept -> ssize_t;
+
+    /// Publish as much outgoing data from the send buffer as the kernel takes, whatever it does not take stays queued for the next call.
+    /// Returns the number of bytes sent, 0 if nothing was queued and -1 (with errno set) if nothing could be sent.
+    auto sendData() noexcept -> ssize_t;
+
     /// Write outgoing data to the send buffers.
-    auto send(const void *data, size_t len) noexcept -> void;
+    /// Returns false without queueing anything if the send buffer does not have room for all of it.
+    auto send(const void *data, size_t len) noexcept -> bool;
+
+    /// Number of bytes queued in the send buffer and not accepted by the kernel yet.
+    auto outboundQueuedBytes() const noexcept {
+      return send_tail_ - send_head_;
+    }
+
+    /// The oldest queued bytes which are contiguous in the send buffer, up to the point where the ring wraps around.
+    auto outboundContiguous() const noexcept -> std::pair<const char *, size_t> {
+      const auto head = send_head_ & (TCPBufferSize - 1);
+      return {outbound_data_.get() + head, std::min(outboundQueuedBytes(), TCPBufferSize - head)};
+    }
+
+    /// Mark len bytes at the front of the send buffer as sent.
+    auto consumeOutbound(size_t len) noexcept {
+      send_head_ += len;
+    }
+
+    /// Start of the part of the send buffer which cannot be written to: the oldest byte not sent yet or still pinned by a zerocopy send.
+    auto outboundInUseStart() const noexcept {
+      return zerocopy_.pending() ? zerocopy_.oldestPinned() : send_head_;
+    }
 
     /// Deleted default, copy & move constructors and assignment-operators.
     TCPSocket() = delete;
@@ -40,17 +84,37 @@ namespace Common {
     int socket_fd_ = -1;
 
     /// Send and receive buffers and trackers for read/write indices.
-    std::vector<char> outbound_data_;
-    size_t next_send_valid_index_ = 0;
-    std::vector<char> inbound_data_;
+    /// Left uninitialized, so only the pages actually written to take up physical memory and a server can hold many connections.
+    /// The send buffer is a ring, send_head_ and send_tail_ count the bytes sent and queued over the lifetime of the connection.
+    NoForkBuffer outbound_data_;
+    size_t send_head_ = 0, send_tail_ = 0;
+    NoForkBuffer inbound_data_;
     size_t next_rcv_valid_index_ = 0;
 
+    /// Send buffer stats: the most bytes ever queued, and the number of sends the kernel did not take in full because its buffer was full,
+    /// which is how a peer that does not keep up with what we send shows up.
+    size_t max_outbound_queued_ = 0, partial_sends_ = 0;
+
     /// Socket attributes.
     struct sockaddr_in socket_attrib_{};
 
     /// Function wrapper to callback when there is data to be processed.
     std::function<void(TCPSocket *s, Nanos rx_time)> recv_callback_ = nullptr;
 
+    /// Kernel RX / TX timestamp latency stats for this connection.
+    SocketTimestamps timestamps_;
+
+    /// MSG_ZEROCOPY sends not completed yet, and the number of queued bytes from which sends use MSG_ZEROCOPY, 0 if they never do.
+    ZeroCopyTracker zerocopy_;
+    size_t zerocopy_threshold_ = 0;
+
+    /// Bookkeeping for sockets accepted by a TCPServer: intrusive flags for O(1) membership checks of the server's ready lists,
+    /// the server's list of sockets with outgoing data which send() adds this socket to, whether the connection has been torn down,
+    /// whether the epoll backend is waiting for EPOLLOUT after a partial send, and the registered file slot used by the io_uring backend.
+    bool in_recv_list_ = false, in_send_list_ = false, is_disconnected_ = false, waiting_for_epollout_ = false;
+    std::vector<TCPSocket *> *send_list_ = nullptr;
+    size_t io_uring_slot_ = 0;
+
     std::string time_str_;
     Logger &logger_;
   };
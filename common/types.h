@@ -190,6 +190,12 @@ namespace Common {
   /// Maximum price level depth in the order books.
   constexpr size_t ME_MAX_PRICE_LEVELS = 256;
 
+  /// Number of consecutive prices the matching engine order books hold as a dense ladder of levels, recentered as prices drift.
+  constexpr size_t ME_PRICE_LADDER_LEVELS = 4096;
+
+  /// Records a matching engine journal file is pre-allocated for, about 200MB.
+  constexpr size_t ME_MAX_JOURNAL_RECORDS = 4 * 1024 * 1024;
+
   typedef uint64_t OrderId;
   constexpr auto OrderId_INVALID = std::numeric_limits<OrderId>::max();
 
@@ -212,6 +218,11 @@ namespace Common {
     return std::to_string(ticker_id);
   }
 
+  /// Matching engine shard which owns ticker_id when the tickers are partitioned over num_shards matching engine threads.
+  inline auto tickerToShard(TickerId ticker_id, size_t num_shards) noexcept -> size_t {
+    return ticker_id % num_shards;
+  }
+
   typedef uint32_t ClientId;
   constexpr auto ClientId_INVALID = std::numeric_limits<ClientId>::max();
 
@@ -0,0 +1,280 @@
+#include "xdp_socket.h"
+
+#include <cerrno>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Common {
+  namespace {
+    auto bpf(int cmd, bpf_attr &attr) noexcept {
+      return static_cast<int>(syscall(__NR_bpf, cmd, &attr, sizeof(attr)));
+    }
+
+    /// Builds the instructions of a BPF program, the equivalent of the BPF_* instruction macros of the kernel's samples.
+    struct BpfProgram {
+      std::vector<bpf_insn> insns_;
+
+      auto emit(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+        bpf_insn insn{};
+        insn.code = code;
+        insn.dst_reg = dst;
+        insn.src_reg = src;
+        insn.off = off;
+        insn.imm = imm;
+        insns_.push_back(insn);
+        return insns_.size() - 1;
+      }
+
+      auto movReg(uint8_t dst, uint8_t src) {
+        return emit(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0);
+      }
+
+      auto movImm(uint8_t dst, int32_t imm) {
+        return emit(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm);
+      }
+
+      auto addImm(uint8_t dst, int32_t imm) {
+        return emit(BPF_ALU64 | BPF_ADD | BPF_K, dst, 0, 0, imm);
+      }
+
+      auto andImm(uint8_t dst, int32_t imm) {
+        return emit(BPF_ALU64 | BPF_AND | BPF_K, dst, 0, 0, imm);
+      }
+
+      auto load(uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+        return emit(BPF_LDX | size | BPF_MEM, dst, src, off, 0);
+      }
+
+      auto loadMapFd(uint8_t dst, int fd) {
+        emit(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, fd);
+        return emit(0, 0, 0, 0, 0);
+      }
+
+      /// Conditional jumps comparing the lower 32 bits of a register with an immediate, and unconditional jumps, the target is set with patch().
+      auto jump32Imm(uint8_t op, uint8_t dst, int32_t imm) {
+        return emit(BPF_JMP32 | op | BPF_K, dst, 0, 0, imm);
+      }
+
+      auto jumpReg(uint8_t op, uint8_t dst, uint8_t src) {
+        return emit(BPF_JMP | op | BPF_X, dst, src, 0, 0);
+      }
+
+      auto jump() {
+        return emit(BPF_JMP | BPF_JA, 0, 0, 0, 0);
+      }
+
+      auto patch(size_t jump, size_t target) {
+        insns_[jump].off = static_cast<int16_t>(target - jump - 1);
+      }
+
+      auto call(int32_t helper) {
+        return emit(BPF_JMP | BPF_CALL, 0, 0, 0, helper);
+      }
+
+      auto exit() {
+        return emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+      }
+    };
+  }
+
+  XdpSocket::~XdpSocket() {
+    for (auto fd: {link_fd_, prog_fd_, map_fd_, xsk_fd_}) {
+      if (fd >= 0)
+        close(fd);
+    }
+    if (rx_ring_)
+      munmap(rx_ring_, rx_ring_size_);
+    if (fill_ring_)
+      munmap(fill_ring_, fill_ring_size_);
+    if (umem_)
+      munmap(umem_, umem_size_);
+  }
+
+  auto XdpSocket::toString() const -> std::string {
+    xdp_options options{};
+    socklen_t options_len = sizeof(options);
+    const auto zerocopy = !getsockopt(xsk_fd_, SOL_XDP, XDP_OPTIONS, &options, &options_len) && (options.flags & XDP_OPTIONS_ZEROCOPY);
+    return iface_ + " queue:" + std::to_string(queue_id_) + (native_ ? " native" : " generic") + (zerocopy ? " zerocopy" : " copy");
+  }
+
+  auto XdpSocket::fail(const std::string &what) -> bool {
+    error_ = what + " error:" + std::strerror(errno);
+    return false;
+  }
+
+  /// Set up the UMEM and the AF_XDP socket on queue_id of iface, then steer the flows into it.
+  auto XdpSocket::init(const std::string &iface, unsigned queue_id, const std::vector<XdpFlow> &flows) -> bool {
+    iface_ = iface;
+    queue_id_ = queue_id;
+    const auto ifindex = if_nametoindex(iface.c_str());
+    if (!ifindex)
+      return fail("if_nametoindex(" + iface + ")");
+
+    umem_size_ = static_cast<size_t>(XdpNumFrames) * XdpFrameSize;
+    auto umem = mmap(nullptr, umem_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (umem == MAP_FAILED)
+      return fail("mmap(umem)");
+    umem_ = static_cast<char *>(umem);
+
+    xsk_fd_ = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (xsk_fd_ < 0)
+      return fail("socket(AF_XDP)");
+
+    xdp_umem_reg umem_reg{};
+    umem_reg.addr = reinterpret_cast<uint64_t>(umem_);
+    umem_reg.len = umem_size_;
+    umem_reg.chunk_size = XdpFrameSize;
+    if (setsockopt(xsk_fd_, SOL_XDP, XDP_UMEM_REG, &umem_reg, sizeof(umem_reg)))
+      return fail("XDP_UMEM_REG");
+
+    // The completion ring is only used for transmits, but binding requires one.
+    const unsigned ring_size = XdpNumFrames;
+    if (setsockopt(xsk_fd_, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) ||
+        setsockopt(xsk_fd_, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) ||
+        setsockopt(xsk_fd_, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)))
+      return fail("XDP ring setup");
+
+    xdp_mmap_offsets offsets{};
+    socklen_t offsets_len = sizeof(offsets);
+    if (getsockopt(xsk_fd_, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsets_len))
+      return fail("XDP_MMAP_OFFSETS");
+
+    fill_ring_size_ = offsets.fr.desc + ring_size * sizeof(uint64_t);
+    fill_ring_ = mmap(nullptr, fill_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xsk_fd_, XDP_UMEM_PGOFF_FILL_RING);
+    if (fill_ring_ == MAP_FAILED) {
+      fill_ring_ = nullptr;
+      return fail("mmap(fill ring)");
+    }
+    auto fill_base = static_cast<char *>(fill_ring_);
+    fill_producer_ = reinterpret_cast<uint32_t *>(fill_base + offsets.fr.producer);
+    fill_addrs_ = reinterpret_cast<uint64_t *>(fill_base + offsets.fr.desc);
+    fill_mask_ = ring_size - 1;
+
+    rx_ring_size_ = offsets.rx.desc + ring_size * sizeof(xdp_desc);
+    rx_ring_ = mmap(nullptr, rx_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xsk_fd_, XDP_PGOFF_RX_RING);
+    if (rx_ring_ == MAP_FAILED) {
+      rx_ring_ = nullptr;
+      return fail("mmap(rx ring)");
+    }
+    auto rx_base = static_cast<char *>(rx_ring_);
+    rx_producer_ = reinterpret_cast<uint32_t *>(rx_base + offsets.rx.producer);
+    rx_consumer_ = reinterpret_cast<uint32_t *>(rx_base + offsets.rx.consumer);
+    rx_descs_ = reinterpret_cast<xdp_desc *>(rx_base + offsets.rx.desc);
+    rx_mask_ = ring_size - 1;
+
+    // Hand every frame to the kernel to receive into.
+    for (unsigned i = 0; i < XdpNumFrames; ++i)
+      fill_addrs_[fill_producer_cached_++ & fill_mask_] = static_cast<uint64_t>(i) * XdpFrameSize;
+    __atomic_store_n(fill_producer_, fill_producer_cached_, __ATOMIC_RELEASE);
+
+    // Let the kernel use zero copy mode if the driver supports it, and copy mode otherwise (e.g. veth).
+    sockaddr_xdp addr{};
+    addr.sxdp_family = AF_XDP;
+    addr.sxdp_ifindex = ifindex;
+    addr.sxdp_queue_id = queue_id;
+    if (bind(xsk_fd_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr))) {
+      addr.sxdp_flags = XDP_COPY;
+      if (bind(xsk_fd_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)))
+        return fail("bind(" + iface + " queue:" + std::to_string(queue_id) + ")");
+    }
+
+    return attachProgram(ifindex, queue_id, flows);
+  }
+
+  /// Create the XSKMAP holding our socket, load the XDP program redirecting the flows to it and attach it to the interface.
+  auto XdpSocket::attachProgram(unsigned ifindex, unsigned queue_id, const std::vector<XdpFlow> &flows) -> bool {
+    bpf_attr attr{};
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = queue_id + 1;
+    if ((map_fd_ = bpf(BPF_MAP_CREATE, attr)) < 0)
+      return fail("BPF_MAP_CREATE(XSKMAP)");
+
+    const uint32_t key = queue_id, value = xsk_fd_;
+    attr = {};
+    attr.map_fd = map_fd_;
+    attr.key = reinterpret_cast<uint64_t>(&key);
+    attr.value = reinterpret_cast<uint64_t>(&value);
+    if (bpf(BPF_MAP_UPDATE_ELEM, attr))
+      return fail("BPF_MAP_UPDATE_ELEM(XSKMAP)");
+
+    // r1 = xdp_md, r2 = data, r3 = data_end. Headers are compared as loaded from the packet, i.e. in network byte order.
+    BpfProgram program;
+    std::vector<size_t> to_pass, to_redirect;
+    program.movReg(BPF_REG_6, BPF_REG_1);
+    program.load(BPF_W, BPF_REG_2, BPF_REG_1, offsetof(xdp_md, data));
+    program.load(BPF_W, BPF_REG_3, BPF_REG_1, offsetof(xdp_md, data_end));
+    program.movReg(BPF_REG_4, BPF_REG_2);
+    program.addImm(BPF_REG_4, 14 + 20 + 8); // ethernet + IPv4 without options + UDP headers.
+    to_pass.push_back(program.jumpReg(BPF_JGT, BPF_REG_4, BPF_REG_3));
+    program.load(BPF_H, BPF_REG_5, BPF_REG_2, 12); // ethertype.
+    to_pass.push_back(program.jump32Imm(BPF_JNE, BPF_REG_5, htons(ETH_P_IP)));
+    program.load(BPF_B, BPF_REG_5, BPF_REG_2, 14); // IPv4 version and header length.
+    to_pass.push_back(program.jump32Imm(BPF_JNE, BPF_REG_5, 0x45));
+    program.load(BPF_B, BPF_REG_5, BPF_REG_2, 14 + 9); // protocol.
+    to_pass.push_back(program.jump32Imm(BPF_JNE, BPF_REG_5, IPPROTO_UDP));
+    program.load(BPF_H, BPF_REG_5, BPF_REG_2, 14 + 6); // fragments go to the kernel, it reassembles them.
+    program.andImm(BPF_REG_5, htons(IP_MF | IP_OFFMASK));
+    to_pass.push_back(program.jump32Imm(BPF_JNE, BPF_REG_5, 0));
+    program.load(BPF_W, BPF_REG_5, BPF_REG_2, 14 + 16); // destination address.
+    program.load(BPF_H, BPF_REG_7, BPF_REG_2, 14 + 20 + 2); // destination port.
+    for (const auto &flow: flows) {
+      const auto ip_mismatch = program.jump32Imm(BPF_JNE, BPF_REG_5, static_cast<int32_t>(inet_addr(flow.ip_.c_str())));
+      const auto port_mismatch = program.jump32Imm(BPF_JNE, BPF_REG_7, htons(flow.port_));
+      to_redirect.push_back(program.jump());
+      program.patch(ip_mismatch, program.insns_.size());
+      program.patch(port_mismatch, program.insns_.size());
+    }
+
+    const auto pass = program.movImm(BPF_REG_0, XDP_PASS);
+    program.exit();
+
+    // Redirect into the socket bound to the queue the packet arrived on, which passes it on to the kernel if there is none.
+    const auto redirect = program.load(BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, rx_queue_index));
+    program.loadMapFd(BPF_REG_1, map_fd_);
+    program.movImm(BPF_REG_3, XDP_PASS);
+    program.call(BPF_FUNC_redirect_map);
+    program.exit();
+
+    for (auto jump: to_pass)
+      program.patch(jump, pass);
+    for (auto jump: to_redirect)
+      program.patch(jump, redirect);
+
+    static char license[] = "Dual MIT/GPL";
+    char log[16 * 1024] = {};
+    attr = {};
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = reinterpret_cast<uint64_t>(program.insns_.data());
+    attr.insn_cnt = program.insns_.size();
+    attr.license = reinterpret_cast<uint64_t>(license);
+    attr.log_buf = reinterpret_cast<uint64_t>(log);
+    attr.log_size = sizeof(log);
+    attr.log_level = 1;
+    if ((prog_fd_ = bpf(BPF_PROG_LOAD, attr)) < 0)
+      return fail("BPF_PROG_LOAD verifier:" + std::string(log));
+
+    // Prefer the driver's native XDP support, generic XDP works on any interface.
+    for (const uint32_t flags: {0u, static_cast<uint32_t>(XDP_FLAGS_SKB_MODE)}) {
+      attr = {};
+      attr.link_create.prog_fd = prog_fd_;
+      attr.link_create.target_ifindex = ifindex;
+      attr.link_create.attach_type = BPF_XDP;
+      attr.link_create.flags = flags;
+      if ((link_fd_ = bpf(BPF_LINK_CREATE, attr)) >= 0) {
+        native_ = !flags;
+        return true;
+      }
+    }
+
+    return fail("BPF_LINK_CREATE(XDP)");
+  }
+}
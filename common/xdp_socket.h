@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <linux/if_xdp.h>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace Common {
+  /// How multicast market data is received: through the kernel UDP stack, or steered by an XDP program straight into an AF_XDP socket.
+  enum class McastRxPath : uint8_t {
+    SOCKET = 0,
+    XDP = 1
+  };
+
+  inline auto mcastRxPathToString(McastRxPath path) -> std::string {
+    switch (path) {
+      case McastRxPath::SOCKET:
+        return "SOCKET";
+      case McastRxPath::XDP:
+        return "XDP";
+    }
+    return "UNKNOWN";
+  }
+
+  /// Receive path selected by the LLPETM_MCAST_RX environment variable, "xdp" selects AF_XDP, anything else the kernel sockets.
+  inline auto mcastRxPathFromEnv() -> McastRxPath {
+    const auto value = getenv("LLPETM_MCAST_RX");
+    return (value && std::string(value) == "xdp") ? McastRxPath::XDP : McastRxPath::SOCKET;
+  }
+
+  /// Number and size of the UMEM frames the kernel writes received packets into, every frame is always either on the fill ring or the RX ring.
+  constexpr unsigned XdpNumFrames = 4096;
+  constexpr unsigned XdpFrameSize = 2048;
+
+  /// An IPv4 UDP destination, multicast group and port, which the XDP program steers into the AF_XDP socket.
+  struct XdpFlow {
+    std::string ip_;
+    int port_ = 0;
+  };
+
+  /// Minimal AF_XDP receive socket built directly on the socket / bpf syscalls, without libbpf / libxdp.
+  /// init() sets up a UMEM with its fill ring and an RX ring on one queue of an interface, and attaches a small XDP program to the interface
+  /// which redirects the UDP datagrams of the requested flows into the socket and passes everything else on to the kernel stack.
+  /// The program is attached through a BPF link, so it is detached again when this is destroyed or the process exits.
+  /// Meant to be used from a single thread.
+  struct XdpSocket {
+    XdpSocket() = default;
+
+    ~XdpSocket();
+
+    /// Returns false if the kernel, the interface or our privileges do not support any of it, error_ says why.
+    /// Callers are expected to fall back to kernel sockets then.
+    auto init(const std::string &iface, unsigned queue_id, const std::vector<XdpFlow> &flows) -> bool;
+
+    /// Invoke callback(uint32_t ip, uint16_t port, const char *payload, size_t len) on every received datagram, with the destination
+    /// address in network byte order and the port in host byte order, and hand the frames back to the kernel. Returns the number of datagrams.
+    /// The payload points into the UMEM and is only valid during the callback.
+    template<typename T>
+    auto recv(T &&callback) noexcept -> size_t {
+      const auto producer = __atomic_load_n(rx_producer_, __ATOMIC_ACQUIRE);
+      auto consumer = *rx_consumer_;
+      if (consumer == producer)
+        return 0;
+
+      const auto n = producer - consumer;
+      for (; consumer != producer; ++consumer) {
+        const auto &desc = rx_descs_[consumer & rx_mask_];
+        const auto frame = umem_ + desc.addr;
+
+        // The XDP program only redirects option-less IPv4 UDP datagrams, so the headers are at fixed offsets.
+        const auto udp = frame + 14 + 20;
+        uint32_t ip;
+        uint16_t port, udp_len;
+        memcpy(&ip, frame + 30, sizeof(ip));
+        memcpy(&port, udp + 2, sizeof(port));
+        memcpy(&udp_len, udp + 4, sizeof(udp_len));
+        const size_t len = std::min<size_t>(ntohs(udp_len), desc.len - 14 - 20) - 8;
+        callback(ip, ntohs(port), udp + 8, len);
+
+        fill_addrs_[fill_producer_cached_++ & fill_mask_] = desc.addr - (desc.addr % XdpFrameSize);
+      }
+
+      __atomic_store_n(rx_consumer_, consumer, __ATOMIC_RELEASE);
+      __atomic_store_n(fill_producer_, fill_producer_cached_, __ATOMIC_RELEASE);
+      return n;
+    }
+
+    /// Deleted copy & move constructors and assignment-operators.
+    XdpSocket(const XdpSocket &) = delete;
+
+    XdpSocket(const XdpSocket &&) = delete;
+
+    XdpSocket &operator=(const XdpSocket &) = delete;
+
+    XdpSocket &operator=(const XdpSocket &&) = delete;
+
+    /// e.g. "veth0 queue:0 native copy": whether the XDP program runs in the driver or generically, and whether frames are copied into the UMEM.
+    auto toString() const -> std::string;
+
+    int xsk_fd_ = -1;
+
+    /// Why init() failed.
+    std::string error_;
+
+  private:
+    /// Create the XSKMAP holding our socket, load the XDP program redirecting the flows to it and attach it to the interface.
+    auto attachProgram(unsigned ifindex, unsigned queue_id, const std::vector<XdpFlow> &flows) -> bool;
+
+    auto fail(const std::string &what) -> bool;
+
+    std::string iface_;
+    unsigned queue_id_ = 0;
+    bool native_ = false;
+
+    /// Packet buffer shared with the kernel.
+    char *umem_ = nullptr;
+    size_t umem_size_ = 0;
+
+    /// Fill ring: frames handed to the kernel to receive into.
+    void *fill_ring_ = nullptr;
+    size_t fill_ring_size_ = 0;
+    uint32_t *fill_producer_ = nullptr;
+    uint64_t *fill_addrs_ = nullptr;
+    uint32_t fill_mask_ = 0, fill_producer_cached_ = 0;
+
+    /// RX ring: frames the kernel received a packet into.
+    void *rx_ring_ = nullptr;
+    size_t rx_ring_size_ = 0;
+    uint32_t *rx_producer_ = nullptr, *rx_consumer_ = nullptr;
+    xdp_desc *rx_descs_ = nullptr;
+    uint32_t rx_mask_ = 0;
+
+    /// XSKMAP, XDP program and the link attaching it to the interface.
+    int map_fd_ = -1, prog_fd_ = -1, link_fd_ = -1;
+  };
+}
@@ -1,11 +1,14 @@
 #include <csignal>
+#include <memory>
+#include <vector>
 
 #include "matcher/matching_engine.h"
 #include "market_data/market_data_publisher.h"
 #include "order_server/order_server.h"
 
 Common::Logger *logger = nullptr;
-Exchange::MatchingEngine *matching_engine = nullptr;
+std::vector<Exchange::MatchingEngine *> matching_engines;
+std::vector<Exchange::MEJournal *> journals;
 Exchange::MarketDataPublisher *market_data_publisher = nullptr;
 Exchange::OrderServer *order_server = nullptr;
 
@@ -25,8 +28,14 @@ void signal_handler(int) {
 
   delete logger;
   logger = nullptr;
-  delete matching_engine;
-  matching_engine = nullptr;
+  for (auto &matching_engine: matching_engines) {
+    delete matching_engine;
+    matching_engine = nullptr;
+  }
+  for (auto &journal: journals) {
+    delete journal;
+    journal = nullptr;
+  }
   delete market_data_publisher;
   market_data_publisher = nullptr;
   delete order_server;
@@ -44,16 +53,61 @@ int main(int, char **) {
 
   const int sleep_time = 100 * 1000;
 
-  Exchange::ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
-  Exchange::ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
-  Exchange::MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
-
   std::string time_str;
-  
+
+  // The tickers can be partitioned over several matching engine threads with LLPETM_ME_SHARDS, each with its own queues.
+  const auto num_shards = Exchange::matchingEngineShardsFromEnv();
+  logger->log("%:% %() % Matching Engine shards:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), num_shards);
+
+  // Aggressive orders get one fill per price level instead of one per resting order with LLPETM_ME_LEVEL_FILLS=1.
+  const auto aggregate_aggressor_fills = Exchange::aggregateAggressorFillsFromEnv();
+  logger->log("%:% %() % Aggregate aggressor fills:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), aggregate_aggressor_fills);
+  const auto auction_schedule = Exchange::auctionScheduleFromEnv();
+  logger->log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), auction_schedule.toString());
+  // Every shard journals the requests it processes to LLPETM_JOURNAL.<shard> and replays them on restart, synced per LLPETM_JOURNAL_SYNC.
+  const auto journal_config = Exchange::journalConfigFromEnv();
+  logger->log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), journal_config.toString());
+  // With a journal, every shard also checkpoints its books every LLPETM_CHECKPOINT seconds, so a restart only replays what came after.
+  const auto checkpoint_interval = Exchange::checkpointIntervalFromEnv();
+  logger->log("%:% %() % Checkpoint interval:%s\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+              checkpoint_interval / Common::NANOS_TO_SECS);
+
+  std::vector<std::unique_ptr<Exchange::ClientRequestLFQueue>> client_request_queues;
+  std::vector<std::unique_ptr<Exchange::ClientResponseLFQueue>> client_response_queues;
+  std::vector<std::unique_ptr<Exchange::MEMarketUpdateLFQueue>> market_update_queues;
+  std::vector<Exchange::ClientRequestLFQueue *> client_requests;
+  std::vector<Exchange::ClientResponseLFQueue *> client_responses;
+  std::vector<Exchange::MEMarketUpdateLFQueue *> market_updates;
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    client_requests.push_back(client_request_queues.emplace_back(std::make_unique<Exchange::ClientRequestLFQueue>(ME_MAX_CLIENT_UPDATES)).get());
+    client_responses.push_back(client_response_queues.emplace_back(std::make_unique<Exchange::ClientResponseLFQueue>(ME_MAX_CLIENT_UPDATES)).get());
+    market_updates.push_back(market_update_queues.emplace_back(std::make_unique<Exchange::MEMarketUpdateLFQueue>(ME_MAX_MARKET_UPDATES)).get());
+  }
+
   /* Initialising matching engine. */
-  logger->log("%:% %() % Starting Matching Engine...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  matching_engine = new Exchange::MatchingEngine(&client_requests, &client_responses, &market_updates);
-  matching_engine->start();
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    logger->log("%:% %() % Starting Matching Engine %...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), shard);
+    journals.push_back(journal_config.enabled() ? new Exchange::MEJournal(journal_config, shard, num_shards) : nullptr);
+    matching_engines.push_back(new Exchange::MatchingEngine(client_requests[shard], client_responses[shard], market_updates[shard], shard, num_shards,
+                                                            aggregate_aggressor_fills, auction_schedule,
+                                                            journals[shard] ? journals[shard]->records() : nullptr));
+    if (journals[shard]) {
+      const auto checkpoint_path = journals[shard]->checkpointPath();
+      const auto restored_records = matching_engines.back()->restore(checkpoint_path, journals[shard]->numReplayRecords());
+      journals[shard]->replay(restored_records, [&](const Exchange::MEJournalRecord *records, size_t num_records) {
+        matching_engines.back()->replay(records, num_records);
+      });
+      if (checkpoint_interval)
+        matching_engines.back()->enableCheckpoints(checkpoint_path, checkpoint_interval);
+      journals[shard]->start();
+    }
+    matching_engines.back()->start();
+  }
+
+  // Co-located clients can talk to us over shared memory instead of sockets, selected with LLPETM_TRANSPORT=shm.
+  const auto transport = Common::transportTypeFromEnv();
+  logger->log("%:% %() % Transport:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+              Common::transportTypeToString(transport));
 
   const std::string mkt_pub_iface = "lo";
   const std::string snap_pub_ip = "233.252.14.1", inc_pub_ip = "233.252.14.3";
@@ -61,19 +115,32 @@ int main(int, char **) {
   
   /* Initialising market data publisher. */
   logger->log("%:% %() % Starting Market Data Publisher...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  market_data_publisher = new Exchange::MarketDataPublisher(&market_updates, mkt_pub_iface, snap_pub_ip, snap_pub_port, inc_pub_ip, inc_pub_port);
+  market_data_publisher = new Exchange::MarketDataPublisher(market_updates, mkt_pub_iface, snap_pub_ip, snap_pub_port, inc_pub_ip, inc_pub_port, transport);
   market_data_publisher->start();
 
   const std::string order_gw_iface = "lo";
   const int order_gw_port = 12345;
+  const auto order_gw_backend = Common::TCPServerBackend::IO_URING; // falls back to epoll if io_uring is not supported.
   
   /* Initialising order server. */
   logger->log("%:% %() % Starting Order Server...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  order_server = new Exchange::OrderServer(&client_requests, &client_responses, order_gw_iface, order_gw_port);
+  // The orders of a client which disconnects are cancelled with LLPETM_CANCEL_ON_DISCONNECT=1.
+  const auto cancel_on_disconnect = Exchange::cancelOnDisconnectFromEnv();
+  logger->log("%:% %() % Cancel on disconnect:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), cancel_on_disconnect);
+  // LLPETM_ORDER_SERVER_THREADS=N spreads the TCP connections over N network threads, the order server thread then only sequences and routes.
+  const auto order_server_threads = Exchange::orderServerThreadsFromEnv();
+  logger->log("%:% %() % Order Server network threads:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), order_server_threads);
+  // Every client is limited to LLPETM_THROTTLE=rate[:burst] requests per second, the order server rejects those over it with THROTTLED.
+  const auto throttle_config = Exchange::throttleConfigFromEnv();
+  logger->log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), throttle_config.toString());
+  order_server = new Exchange::OrderServer(client_requests, client_responses, order_gw_iface, order_gw_port, order_gw_backend, transport,
+                                           cancel_on_disconnect, order_server_threads, throttle_config);
   order_server->start();
 
   while (true) {
     logger->log("%:% %() % Sleeping for a few milliseconds..\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
+    if (throttle_config.enabled())
+      logger->log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), order_server->throttlesToString());
     usleep(sleep_time * 1000);
   }
 }
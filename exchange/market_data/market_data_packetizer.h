@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+
+#include "common/macros.h"
+#include "common/mcast_socket.h"
+#include "common/time_utils.h"
+
+#include "market_data/market_update.h"
+
+namespace Exchange {
+  /// Packs consecutive market updates into MTU sized datagrams, each led by a MDPPacketHeader.
+  /// A packet is sent out when it is full or when flush() is called, so every datagram fits the MTU and the
+  /// publishers make one send() syscall per packet instead of one per update.
+  /// With a shared memory ring every packet is also published there, ahead of the datagram, for co-located consumers.
+  class MarketDataPacketizer {
+  public:
+    explicit MarketDataPacketizer(McastSocket *socket, MDPShmRing *ring = nullptr)
+        : socket_(socket), ring_(ring) {
+    }
+
+    /// Append a market update with the provided sequence number, sequence numbers within a packet must be consecutive.
+    auto add(size_t seq_num, const MEMarketUpdate &market_update) noexcept -> void {
+      if (UNLIKELY(header_.count_ == MDP_MAX_UPDATES_PER_PACKET))
+        flush();
+
+      if (!header_.count_)
+        header_.first_seq_num_ = seq_num;
+
+      memcpy(packet_.data() + sizeof(MDPPacketHeader) + header_.count_ * sizeof(MEMarketUpdate), &market_update, sizeof(MEMarketUpdate));
+      ++header_.count_;
+    }
+
+    /// Stamp the send time on the pending packet, if any, and publish it as a single datagram.
+    auto flush() noexcept -> void {
+      if (!header_.count_)
+        return;
+
+      header_.send_time_ = getCurrentNanos();
+      memcpy(packet_.data(), &header_, sizeof(MDPPacketHeader));
+      const auto size = sizeof(MDPPacketHeader) + header_.count_ * sizeof(MEMarketUpdate);
+
+      if (ring_) {
+        auto shm_packet = ring_->getNextToWriteTo();
+        shm_packet->size_ = size;
+        memcpy(shm_packet->data_.data(), packet_.data(), size);
+        ring_->updateWriteIndex();
+      }
+
+      socket_->sendDatagram(packet_.data(), size);
+      header_.count_ = 0;
+    }
+
+    // Deleted default, copy & move constructors and assignment-operators.
+    MarketDataPacketizer() = delete;
+
+    MarketDataPacketizer(const MarketDataPacketizer &) = delete;
+
+    MarketDataPacketizer(const MarketDataPacketizer &&) = delete;
+
+    MarketDataPacketizer &operator=(const MarketDataPacketizer &) = delete;
+
+    MarketDataPacketizer &operator=(const MarketDataPacketizer &&) = delete;
+
+  private:
+    McastSocket *socket_ = nullptr;
+    MDPShmRing *ring_ = nullptr;
+
+    /// Header of the packet currently being built, copied in front of the updates on flush().
+    MDPPacketHeader header_;
+    std::array<char, MDP_MAX_PACKET_SIZE> packet_;
+  };
+}
@@ -1,13 +1,21 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "market_data/snapshot_synthesizer.h"
+#include "market_data/market_data_packetizer.h"
 
 namespace Exchange {
   class MarketDataPublisher {
   public:
-    MarketDataPublisher(MEMarketUpdateLFQueue *market_updates, const std::string &iface,const std::string &snapshot_ip, int snapshot_port,const std::string &incremental_ip, int incremental_port);
+    /*
+    transport SHM also publishes the incremental stream on a shared memory ring for co-located clients, the snapshot stream stays on multicast
+    market_updates holds one queue per matching engine shard, they are merged into the one incremental stream
+    */
+    MarketDataPublisher(const std::vector<MEMarketUpdateLFQueue *> &market_updates, const std::string &iface,const std::string &snapshot_ip, int snapshot_port,const std::string &incremental_ip, int incremental_port,
+                        Common::TransportType transport = Common::TransportType::SOCKET);
     
     /*
     The destructor calls the stop() method to stop the running MarketDataPublisher thread, then waits a short amount of time 
@@ -64,7 +72,7 @@ namespace Exchange {
 
 
     size_t next_inc_seq_num_ = 1; //represents the sequence number to set on the next outgoing incremental market data message
-    MEMarketUpdateLFQueue *outgoing_md_updates_ = nullptr; //a lock-free queue of MEMarketUpdate messages
+    std::vector<MEMarketUpdateLFQueue *> outgoing_md_updates_; //lock-free queues of MEMarketUpdate messages, one per matching engine shard
 
     MDPMarketUpdateLFQueue snapshot_md_updates_; 
     /*
@@ -86,6 +94,10 @@ namespace Exchange {
 
     Common::McastSocket incremental_socket_; //to be used to publish UDP messages on the incremental multicast stream
 
+    std::unique_ptr<Common::ShmSegment> shm_segment_; //shared memory incremental stream, only created with TransportType::SHM
+
+    MarketDataPacketizer incremental_packetizer_; //packs the incremental updates into MTU sized datagrams on incremental_socket_
+
     SnapshotSynthesizer *snapshot_synthesizer_ = nullptr;
     /*
     This object will be responsible for generating a snapshot of the limit
@@ -109,11 +109,17 @@
 #include <sstream>
 
 #include "common/types.h"
+#include "common/time_utils.h"
+#include "common/shm_queue.h"
 
 using namespace Common;
 
 namespace Exchange {
   /// Represents the type / action in the market update message.
+  /// An EXECUTION is a trade against the resting order order_id_, in place of a TRADE followed by a MODIFY or CANCEL of that order:
+  /// side_ is the aggressor's side, price_ and qty_ the trade's, and leaves_qty_ what is left of the resting order, which is gone at 0.
+  /// An AUCTION_INDICATIVE is published while a book is in a call auction: price_ and qty_ are the price the book would uncross at
+  /// and the quantity which would trade, Price_INVALID and 0 while the book is not crossed.
   enum class MarketUpdateType : uint8_t {
     INVALID = 0,
     CLEAR = 1,
@@ -122,7 +128,9 @@ namespace Exchange {
     CANCEL = 4,
     TRADE = 5,
     SNAPSHOT_START = 6,
-    SNAPSHOT_END = 7
+    SNAPSHOT_END = 7,
+    EXECUTION = 8,
+    AUCTION_INDICATIVE = 9
   };
 
   inline std::string marketUpdateTypeToString(MarketUpdateType type) {
@@ -141,6 +149,10 @@ namespace Exchange {
         return "SNAPSHOT_START";
       case MarketUpdateType::SNAPSHOT_END:
         return "SNAPSHOT_END";
+      case MarketUpdateType::EXECUTION:
+        return "EXECUTION";
+      case MarketUpdateType::AUCTION_INDICATIVE:
+        return "AUCTION_INDICATIVE";
       case MarketUpdateType::INVALID:
         return "INVALID";
     }
@@ -160,6 +172,7 @@ namespace Exchange {
     Price price_ = Price_INVALID;
     Qty qty_ = Qty_INVALID;
     Priority priority_ = Priority_INVALID;
+    Qty leaves_qty_ = Qty_INVALID; // EXECUTION only.
 
     auto toString() const {
       std::stringstream ss;
@@ -172,6 +185,7 @@ namespace Exchange {
          << " qty:" << qtyToString(qty_)
          << " price:" << priceToString(price_)
          << " priority:" << priorityToString(priority_)
+         << " leaves:" << qtyToString(leaves_qty_)
          << "]";
       return ss.str();
     }
@@ -193,8 +207,46 @@ namespace Exchange {
     }
   };
 
+  /// Header leading every datagram published on the incremental and snapshot multicast streams.
+  /// It is followed by count_ MEMarketUpdate messages carrying sequence numbers first_seq_num_, first_seq_num_ + 1, ...
+  struct MDPPacketHeader {
+    size_t first_seq_num_ = 0;
+    uint16_t count_ = 0;
+    Nanos send_time_ = 0;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MDPPacketHeader"
+         << " ["
+         << " first_seq:" << first_seq_num_
+         << " count:" << count_
+         << " send_time:" << send_time_
+         << "]";
+      return ss.str();
+    }
+  };
+
 #pragma pack(pop) // Undo the packed binary structure directive moving forward.
 
+  /// Largest UDP payload which fits a 1500 byte Ethernet MTU without IP fragmentation (20 bytes IPv4 + 8 bytes UDP header).
+  constexpr size_t MDP_MAX_PACKET_SIZE = 1500 - 20 - 8;
+
+  /// Number of market updates which fit into a single market data packet after the packet header.
+  constexpr size_t MDP_MAX_UPDATES_PER_PACKET = (MDP_MAX_PACKET_SIZE - sizeof(MDPPacketHeader)) / sizeof(MEMarketUpdate);
+  static_assert(MDP_MAX_UPDATES_PER_PACKET > 0, "Market data packet cannot hold a single update.");
+
+  /// A market data packet as published on the shared memory incremental stream, the first size_ bytes of data_ are valid.
+  struct MDPShmPacket {
+    size_t size_ = 0;
+    std::array<char, MDP_MAX_PACKET_SIZE> data_;
+  };
+
+  /// Shared memory segment the market data publisher creates for co-located clients with TransportType::SHM, and the number of packets it holds.
+  constexpr auto MDP_SHM_NAME = "/llpetm_market_data";
+  constexpr size_t MDP_SHM_RING_SIZE = 4 * 1024;
+  typedef Common::ShmBroadcastRing<MDPShmPacket, MDP_SHM_RING_SIZE> MDPShmRing;
+  typedef Common::ShmBroadcastReader<MDPShmPacket, MDP_SHM_RING_SIZE> MDPShmReader;
+
   /// Lock free queues of matching engine market update messages and market data publisher market updates messages respectively.
   typedef Common::LFQueue<Exchange::MEMarketUpdate> MEMarketUpdateLFQueue;
   typedef Common::LFQueue<Exchange::MDPMarketUpdate> MDPMarketUpdateLFQueue;
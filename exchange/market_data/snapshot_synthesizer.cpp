@@ -13,7 +13,8 @@ namespace Exchange {
   */
   SnapshotSynthesizer::SnapshotSynthesizer(MDPMarketUpdateLFQueue *market_updates, const std::string &iface,
                                            const std::string &snapshot_ip, int snapshot_port)
-      : snapshot_md_updates_(market_updates), logger_("exchange_snapshot_synthesizer.log"), snapshot_socket_(logger_), order_pool_(ME_MAX_ORDER_IDS) {
+      : snapshot_md_updates_(market_updates), logger_("exchange_snapshot_synthesizer.log"), snapshot_socket_(logger_),
+        snapshot_packetizer_(&snapshot_socket_), ticker_orders_(ME_MAX_TICKERS), order_pool_(ME_MAX_ORDER_IDS) {
     ASSERT(snapshot_socket_.init(snapshot_ip, iface, snapshot_port, /*is_listening*/ false) >= 0,
            "Unable to create snapshot mcast socket. error:" + std::string(std::strerror(errno)));
     for(auto& orders : ticker_orders_)
@@ -72,7 +73,8 @@ namespace Exchange {
       case MarketUpdateType::MODIFY: {
         /*
         Similar to ADD ;
-        The minor difference here is that we just update the qty_ and price_ fields and leave the type_ field on the entry as is
+        The minor difference here is that we just update the qty_, price_ and priority_ fields and leave the type_ field on the entry as is,
+        a cancel/replaced order can come with a new price and priority
         */
         auto order = orders->at(me_market_update.order_id_);
         ASSERT(order != nullptr, "Received:" + me_market_update.toString() + " but order does not exist.");
@@ -81,6 +83,7 @@ namespace Exchange {
 
         order->qty_ = me_market_update.qty_;
         order->price_ = me_market_update.price_;
+        order->priority_ = me_market_update.priority_;
       }
         break;
 
@@ -106,10 +109,29 @@ namespace Exchange {
         the last sequence number we have seen on the incremental market data stream, which is stored 
         in the last_inc_seq_num_ data members
         */
+      case MarketUpdateType::EXECUTION: {
+        /*
+        An EXECUTION leaves the resting order it traded against with leaves_qty_, so it is handled like a MODIFY of the quantity, or like
+        a CANCEL when nothing is left. Its side_ is the aggressor's, opposite to the resting order's
+        */
+        auto order = orders->at(me_market_update.order_id_);
+        ASSERT(order != nullptr, "Received:" + me_market_update.toString() + " but order does not exist.");
+        ASSERT(order->order_id_ == me_market_update.order_id_, "Expecting existing order to match new one.");
+
+        if (me_market_update.leaves_qty_) {
+          order->qty_ = me_market_update.leaves_qty_;
+        } else {
+          order_pool_.deallocate(order);
+          orders->at(me_market_update.order_id_) = nullptr;
+        }
+      }
+        break;
+
       case MarketUpdateType::SNAPSHOT_START:
       case MarketUpdateType::CLEAR:
       case MarketUpdateType::SNAPSHOT_END:
       case MarketUpdateType::TRADE:
+      case MarketUpdateType::AUCTION_INDICATIVE:
       case MarketUpdateType::INVALID:
         break;
     }
@@ -147,7 +169,7 @@ namespace Exchange {
    */
     const MDPMarketUpdate start_market_update{snapshot_size++, {MarketUpdateType::SNAPSHOT_START, last_inc_seq_num_}};
     logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), start_market_update.toString());
-    snapshot_socket_.send(&start_market_update, sizeof(MDPMarketUpdate));
+    snapshot_packetizer_.add(start_market_update.seq_num_, start_market_update.me_market_update_);
 
 
   /* Now below,
@@ -163,7 +185,7 @@ namespace Exchange {
 
       const MDPMarketUpdate clear_market_update{snapshot_size++, me_market_update};
       logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), clear_market_update.toString());
-      snapshot_socket_.send(&clear_market_update, sizeof(MDPMarketUpdate));
+      snapshot_packetizer_.add(clear_market_update.seq_num_, clear_market_update.me_market_update_);
 
       /*
       we iterate through all the orders for this trading instrument and check for live orders – entries that do not have nullptr values. 
@@ -173,8 +195,7 @@ namespace Exchange {
         if (order) {
           const MDPMarketUpdate market_update{snapshot_size++, *order};
           logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), market_update.toString());
-          snapshot_socket_.send(&market_update, sizeof(MDPMarketUpdate));
-          snapshot_socket_.sendAndRecv();
+          snapshot_packetizer_.add(market_update.seq_num_, market_update.me_market_update_);
         }
       }
     }
@@ -185,8 +206,8 @@ namespace Exchange {
      */
     const MDPMarketUpdate end_market_update{snapshot_size++, {MarketUpdateType::SNAPSHOT_END, last_inc_seq_num_}};
     logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), end_market_update.toString());
-    snapshot_socket_.send(&end_market_update, sizeof(MDPMarketUpdate));
-    snapshot_socket_.sendAndRecv();
+    snapshot_packetizer_.add(end_market_update.seq_num_, end_market_update.me_market_update_);
+    snapshot_packetizer_.flush();
 
     logger_.log("%:% %() % Published snapshot of % orders.\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), snapshot_size - 1);
   }
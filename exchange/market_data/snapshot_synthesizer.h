@@ -11,6 +11,7 @@
 #include "common/logging.h"
 
 #include "market_data/market_update.h"
+#include "market_data/market_data_packetizer.h"
 #include "matcher/me_order.h"
 
 using namespace Common;
@@ -58,9 +59,11 @@ namespace Exchange {
 
     McastSocket snapshot_socket_; //an McastSocket to be used to publish snapshot market data updates to the snapshot multicast stream
 
-    std::array<std::array<MEMarketUpdate *, ME_MAX_ORDER_IDS>, ME_MAX_TICKERS> ticker_orders_;
+    MarketDataPacketizer snapshot_packetizer_; //packs the snapshot updates into MTU sized datagrams on snapshot_socket_
+
+    std::vector<std::array<MEMarketUpdate *, ME_MAX_ORDER_IDS>, NoForkAllocator<std::array<MEMarketUpdate *, ME_MAX_ORDER_IDS>>> ticker_orders_;
     /*
-    a std::array of size ME_MAX_TICKERS to represent the snapshot of the book for each trading instrument. Each 
+    a std::vector of size ME_MAX_TICKERS, allocated so the matching engine's checkpoints do not fork it, to represent the snapshot of the book for each trading instrument. Each 
     element of this array is a std::array of MEMarketUpdate pointers and a maximum size of ME_MAX_ORDER_IDS to represent 
     a hash map from OrderId to the order corresponding to that OrderId. As we have done before, we use the 
     first std::array as a hash map from TickerId to the snapshot of the limit order book. The second std::array is 
@@ -1,16 +1,23 @@
 
 #include "matcher/matching_engine.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
 namespace Exchange{
 
     /*
     Creating the constructor
     */
     MatchingEngine::MatchingEngine(ClientRequestLFQueue *client_requests, 
-    ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates)
-    :incoming_requests_(client_requests), outgoing_ogw_responses_(client_responses),
-    outgoing_md_updates_(market_updates),logger_("exchange_matching_engine.log"){
+    ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates, size_t shard, size_t num_shards,
+    bool aggregate_aggressor_fills, const AuctionSchedule &auction_schedule, MEJournalLFQueue *journal_records, bool logging)
+    :shard_(shard), num_shards_(num_shards), incoming_requests_(client_requests), outgoing_ogw_responses_(client_responses),
+    outgoing_md_updates_(market_updates), auction_schedule_(auction_schedule), journal_records_(journal_records),
+    logger_(!logging ? "" : num_shards == 1 ? "exchange_matching_engine.log" : "exchange_matching_engine_" + std::to_string(shard) + ".log"){
+        ticker_order_book_.fill(nullptr);
         for(size_t i = 0; i < ticker_order_book_.size(); ++i) {
-            ticker_order_book_[i] = new MEOrderBook(i, &logger_, this);
+            if (tickerToShard(i, num_shards) == shard)
+                ticker_order_book_[i] = new MEOrderBook(i, &logger_, this, aggregate_aggressor_fills);
         }
     }
 
@@ -49,7 +56,7 @@ namespace Exchange{
     /*
     The ASSERT macro is used to check the result of the thread creation and to handle any failure.
     */
-    ASSERT(Common::createAndStartThread(-1, "Exchange/MatchingEngine", [this](){run();}) 
+    ASSERT(Common::createAndStartThread(-1, "Exchange/MatchingEngine/" + std::to_string(shard_), [this](){run();}) 
     != nullptr, "Failed to start MatchingEngine thread.");
    }
 
@@ -57,4 +64,118 @@ namespace Exchange{
     run_ = false ;
    }
 
+   auto MatchingEngine::replay(const MEJournalRecord *records, size_t num_records) noexcept -> void {
+    output_mode_ = OutputMode::REPLAY;
+    const auto start_time = getCurrentNanos();
+    for (size_t i = 0; i < num_records; ++i) {
+        if (records[i].type_ == JournalRecordType::TRADING_PHASE)
+            setTradingPhase(records[i].trading_phase_);
+        else
+            processClientRequest(&records[i].request_);
+    }
+    const auto elapsed = std::max<Nanos>(getCurrentNanos() - start_time, 1);
+    output_mode_ = OutputMode::LIVE;
+    publish_replayed_books_ |= (num_records > 0);
+    journal_seq_num_ += num_records;
+
+    logger_.log("%:% %() % Replayed % records in % ms, % M records/s\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                num_records, elapsed / NANOS_TO_MILLIS, static_cast<double>(num_records) * 1000.0 / static_cast<double>(elapsed));
+   }
+
+   auto MatchingEngine::restore(const std::string &path, size_t num_journal_records) noexcept -> size_t {
+    MECheckpointReader reader(path);
+    if (reader.empty())
+        return 0;
+
+    const auto start_time = getCurrentNanos();
+    const auto header = reader.read<MECheckpointHeader>();
+    ASSERT(header->magic_ == MECheckpointMagic, "Not a checkpoint:" + path);
+    ASSERT(header->shard_ == shard_ && header->num_shards_ == num_shards_,
+           "Checkpoint:" + path + " is for shard " + std::to_string(header->shard_) + " of " + std::to_string(header->num_shards_) + ".");
+    if (header->journal_seq_num_ > num_journal_records) {
+        logger_.log("%:% %() % Ignoring % at journal record %, the journal has % records\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), path, header->journal_seq_num_, num_journal_records);
+        return 0;
+    }
+
+    size_t num_orders = 0;
+    for (uint32_t i = 0; i < header->num_books_; ++i) {
+        const auto book = reader.read<MECheckpointBook>();
+        ASSERT(book->ticker_id_ < ticker_order_book_.size() && ticker_order_book_[book->ticker_id_],
+               "Checkpoint:" + path + " has a book for ticker:" + tickerIdToString(book->ticker_id_) + " of another shard.");
+        num_orders += ticker_order_book_[book->ticker_id_]->restoreCheckpoint(*book, &reader);
+    }
+    trading_phase_ = header->trading_phase_;
+    journal_seq_num_ = checkpoint_seq_num_ = header->journal_seq_num_;
+    publish_replayed_books_ = true;
+
+    logger_.log("%:% %() % Restored % orders at journal record % from % in % ms\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), num_orders, journal_seq_num_, path, (getCurrentNanos() - start_time) / NANOS_TO_MILLIS);
+    return journal_seq_num_;
+   }
+
+   auto MatchingEngine::enableCheckpoints(const std::string &path, Nanos interval) noexcept -> void {
+    checkpoint_path_ = path;
+    checkpoint_interval_ = interval;
+   }
+
+   auto MatchingEngine::checkpoint() noexcept -> bool {
+    const auto start_time = getCurrentNanos();
+    const auto pid = fork();
+    if (pid == 0) // Only this thread runs in the child, which must leave without running the destructors of the process.
+        _exit(writeCheckpoint() ? EXIT_SUCCESS : EXIT_FAILURE);
+
+    if (UNLIKELY(pid < 0)) {
+        logger_.log("%:% %() % fork() failed error:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    std::strerror(errno));
+        return false;
+    }
+    checkpoint_pid_ = pid;
+    checkpoint_seq_num_ = journal_seq_num_;
+    logger_.log("%:% %() % Checkpointing journal record % to % in pid:%, fork took % us\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), checkpoint_seq_num_, checkpoint_path_, pid, (getCurrentNanos() - start_time) / NANO_TO_MICROS);
+    return true;
+   }
+
+   auto MatchingEngine::reapCheckpoint(bool wait) noexcept -> bool {
+    if (checkpoint_pid_ <= 0)
+        return true;
+    int status = 0;
+    const auto pid = waitpid(checkpoint_pid_, &status, wait ? 0 : WNOHANG);
+    if (!pid)
+        return false;
+
+    const auto ok = (pid == checkpoint_pid_ && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    logger_.log("%:% %() % Checkpoint of journal record % to % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                checkpoint_seq_num_, checkpoint_path_, ok ? "written" : "FAILED");
+    if (!ok)
+        checkpoint_seq_num_ = 0;
+    checkpoint_pid_ = -1;
+    return true;
+   }
+
+   auto MatchingEngine::writeCheckpoint() const noexcept -> bool {
+    MECheckpointWriter writer(checkpoint_path_);
+    MECheckpointHeader header{MECheckpointMagic, static_cast<uint32_t>(shard_), static_cast<uint32_t>(num_shards_), journal_seq_num_,
+                              trading_phase_, 0};
+    for (auto order_book : ticker_order_book_)
+        header.num_books_ += (order_book != nullptr);
+    writer.write(header);
+    for (auto order_book : ticker_order_book_) {
+        if (order_book && !order_book->writeCheckpoint(&writer))
+            return false;
+    }
+    return writer.ok() && writer.commit();
+   }
+
+   auto MatchingEngine::publishBooks() noexcept -> void {
+    output_mode_ = OutputMode::PUBLISH_BOOKS;
+    for (auto order_book : ticker_order_book_) {
+        if (order_book)
+            order_book->publishBook();
+    }
+    output_mode_ = OutputMode::LIVE;
+    publish_replayed_books_ = false;
+   }
+
 }
\ No newline at end of file
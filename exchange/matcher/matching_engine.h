@@ -1,27 +1,127 @@
 #pragma once
 
+#include <algorithm>
+
 #include "common/lf_queue.h"
 #include "common/macros.h"
 #include "order_server/client_response.h"
 #include "order_server/client_request.h"
 #include "market_data/market_update.h"
 #include "common/thread_utils.h"
+#include "common/time_utils.h"
 /*
 Not read yet
 */
 #include "me_order_book.h"
+#include "me_journal.h"
+#include "me_checkpoint.h"
 
 namespace Exchange
 {
+    /// Number of matching engine threads the tickers are partitioned over, from the LLPETM_ME_SHARDS environment variable,
+    /// 1 if it is not set, at most ME_MAX_TICKERS.
+    inline auto matchingEngineShardsFromEnv() -> size_t
+    {
+        const auto value = getenv("LLPETM_ME_SHARDS");
+        const auto num_shards = (value ? strtoul(value, nullptr, 10) : 1);
+        return std::clamp<size_t>(num_shards, 1, ME_MAX_TICKERS);
+    }
+
+    /// Whether aggressive orders get one fill per price level they trade at instead of one per resting order, from the
+    /// LLPETM_ME_LEVEL_FILLS environment variable, off unless it is set to 1.
+    inline auto aggregateAggressorFillsFromEnv() -> bool
+    {
+        const auto value = getenv("LLPETM_ME_LEVEL_FILLS");
+        return (value && std::string(value) == "1");
+    }
+
+    /// When the books are in which TradingPhase, as seconds from the start of the MatchingEngine: an opening call auction of open_,
+    /// continuous trading for continuous_ and a closing call auction of close_, after which the books are closed. With continuous_ 0
+    /// the books trade continuously after the opening auction for good.
+    struct AuctionSchedule
+    {
+        Nanos open_ = 0;
+        Nanos continuous_ = 0;
+        Nanos close_ = 0;
+
+        auto enabled() const noexcept
+        {
+            return (open_ || continuous_);
+        }
+
+        auto phaseAt(Nanos elapsed) const noexcept -> TradingPhase
+        {
+            if (elapsed < open_)
+                return TradingPhase::AUCTION;
+            if (!continuous_ || elapsed < open_ + continuous_)
+                return TradingPhase::CONTINUOUS;
+            return (elapsed < open_ + continuous_ + close_ ? TradingPhase::AUCTION : TradingPhase::CLOSED);
+        }
+
+        auto toString() const
+        {
+            std::stringstream ss;
+            ss << "AuctionSchedule[open:" << open_ / NANOS_TO_SECS << "s continuous:" << continuous_ / NANOS_TO_SECS
+               << "s close:" << close_ / NANOS_TO_SECS << "s]";
+            return ss.str();
+        }
+    };
+
+    /// The AuctionSchedule from the LLPETM_AUCTIONS environment variable, "open,continuous,close" in seconds,
+    /// continuous trading from the start if it is not set.
+    inline auto auctionScheduleFromEnv() -> AuctionSchedule
+    {
+        const auto value = getenv("LLPETM_AUCTIONS");
+        unsigned long open = 0, continuous = 0, close = 0;
+        if (value && sscanf(value, "%lu,%lu,%lu", &open, &continuous, &close) < 1)
+            FATAL("LLPETM_AUCTIONS is not open,continuous,close seconds:" + std::string(value));
+        return {static_cast<Nanos>(open) * NANOS_TO_SECS, static_cast<Nanos>(continuous) * NANOS_TO_SECS, static_cast<Nanos>(close) * NANOS_TO_SECS};
+    }
 
+    /// Matches the books of the tickers owned by one shard, tickerToShard(ticker_id, num_shards) == shard, on its own thread.
+    /// With a single shard that is every ticker. Each shard reads its own client request queue and writes its own response and market update queues.
     class MatchingEngine final
     {
     private:
-        OrderBookHashMap ticker_order_book_;
+        OrderBookHashMap ticker_order_book_; // nullptr for the tickers of other shards.
+        size_t shard_ = 0;
+        size_t num_shards_ = 1;
         ClientRequestLFQueue *incoming_requests_ = nullptr;
         ClientResponseLFQueue *outgoing_ogw_responses_ = nullptr;
         MEMarketUpdateLFQueue *outgoing_md_updates_ = nullptr;
         volatile bool run_ = false;
+
+        const AuctionSchedule auction_schedule_;
+
+        /// Every request is written here before it is processed, as is every change of the trading phase, if journaling is on.
+        MEJournalLFQueue *journal_records_ = nullptr;
+
+        /// LIVE unless replay() is rebuilding the books, which sends nothing, or run() is publishing the rebuilt books, which waits
+        /// for the MarketDataPublisher to keep up rather than overrun its queue.
+        enum class OutputMode : uint8_t
+        {
+            LIVE,
+            REPLAY,
+            PUBLISH_BOOKS
+        };
+        OutputMode output_mode_ = OutputMode::LIVE;
+        bool publish_replayed_books_ = false;
+
+        /// Number of journal records the books reflect, those replayed or restored from a checkpoint and those written since.
+        size_t journal_seq_num_ = 0;
+
+        /// A child process forked every checkpoint_interval_ writes the books to checkpoint_path_, if checkpoints are enabled.
+        std::string checkpoint_path_;
+        Nanos checkpoint_interval_ = 0;
+        Nanos next_checkpoint_time_ = 0;
+        pid_t checkpoint_pid_ = -1;
+        size_t checkpoint_seq_num_ = 0;
+
+        TradingPhase trading_phase_ = TradingPhase::CONTINUOUS;
+
+        /// How often the books publish their indicative uncross during an auction, at most.
+        static constexpr Nanos IndicativeInterval = 100 * NANOS_TO_MILLIS;
+        Nanos next_indicative_time_ = 0;
         /*
         The volatile keyword is used here to indicate that the value of run_ might
         change at any time without any action being taken by the code that the compiler
@@ -52,23 +152,61 @@ namespace Exchange
         Logger logger_;
 
     public:
+        /// Without logging the engine and its books log to a Logger which discards everything, for benchmarks of the matching alone.
         MatchingEngine(ClientRequestLFQueue *client_requests,
                        ClientResponseLFQueue *client_responses,
-                       MEMarketUpdateLFQueue *market_updates);
+                       MEMarketUpdateLFQueue *market_updates,
+                       size_t shard = 0, size_t num_shards = 1, bool aggregate_aggressor_fills = false,
+                       const AuctionSchedule &auction_schedule = {}, MEJournalLFQueue *journal_records = nullptr, bool logging = true);
         ~MatchingEngine();
         auto start() -> void;
         auto stop() -> void;
 
-        
+        /// Rebuild the books from the records of a journal before start(), sending no responses or market updates, which makes the
+        /// same books as processing the requests did. run() publishes the resulting orders as ADDs before it takes new requests.
+        auto replay(const MEJournalRecord *records, size_t num_records) noexcept -> void;
+
+        /// Load the books from the checkpoint at path before replay() and start(), and return the number of journal records they reflect,
+        /// which replay() continues after. A checkpoint which reflects more than the num_journal_records the journal has, which it can
+        /// if the exchange stopped before the journal synced, is ignored like a missing one and 0 returned.
+        auto restore(const std::string &path, size_t num_journal_records) noexcept -> size_t;
+
+        /// Checkpoint the books to path every interval while running, from the first iteration of run() on.
+        auto enableCheckpoints(const std::string &path, Nanos interval) noexcept -> void;
+
+        /// Fork a child process which writes the books as they are now to the checkpoint path and exits, the books stay available to
+        /// this process throughout, sharing their pages with the child until either writes to them. False if the fork failed.
+        /// What the fork copies, and so how long it pauses matching, follows the live orders: the stores grow with them, and the queues,
+        /// loggers and socket buffers of the process are NoForkAllocator memory, which the child does not get and must not touch.
+        auto checkpoint() noexcept -> bool;
+
+        /// Collect the exit status of the child of the last checkpoint(), waiting for it to exit with wait. True if it is done.
+        auto reapCheckpoint(bool wait) noexcept -> bool;
+
 
         /*
         processClientRequest is a dispatcher function that determines the appropriate action to take based on the type
-        of client request (new order or order cancellation) and delegates the execution of that action to the corresponding
+        of client request (new order, order cancellation or modification) and delegates the execution of that action to the corresponding
         order book. If an invalid client request type is encountered, it logs a fatal error.
         */
         auto processClientRequest(const MEClientRequest *client_request) noexcept
         {
+            // A mass cancel for all tickers goes to every book of this shard, the FIFOSequencer sent it to every shard.
+            if (client_request->type_ == ClientRequestType::MASS_CANCEL && client_request->ticker_id_ == TickerId_INVALID)
+            {
+                for (auto order_book : ticker_order_book_)
+                {
+                    if (order_book)
+                        order_book->massCancel(client_request->client_id_, client_request->side_);
+                }
+                return;
+            }
+
             auto order_book = ticker_order_book_[client_request->ticker_id_];
+            if (UNLIKELY(!order_book))
+            {
+                FATAL("Received client-request for ticker of another shard : " + client_request->toString());
+            }
             /*
             It retrieves the order book associated with the provided ticker_id_. The ticker_order_book_
             is assumed to be some kind of mapping or array holding order books for different financial
@@ -80,7 +218,8 @@ namespace Exchange
             case ClientRequestType::NEW:
             {
                 order_book->add(client_request->client_id_, client_request->order_id_, client_request->ticker_id_,
-                                client_request->side_, client_request->price_, client_request->qty_);
+                                client_request->side_, client_request->price_, client_request->qty_,
+                                client_request->order_type_, client_request->time_in_force_);
             }
             break;
                 /*
@@ -96,6 +235,19 @@ namespace Exchange
                 order_book->cancel(client_request->client_id_, client_request->order_id_, client_request->ticker_id_);
             }
             break;
+
+            case ClientRequestType::MODIFY:
+            {
+                order_book->modify(client_request->client_id_, client_request->order_id_, client_request->ticker_id_,
+                                   client_request->side_, client_request->price_, client_request->qty_);
+            }
+            break;
+
+            case ClientRequestType::MASS_CANCEL:
+            {
+                order_book->massCancel(client_request->client_id_, client_request->side_);
+            }
+            break;
             default:
             {
                 FATAL("Received invalid client-request-type : " + clientRequestTypeToString(client_request->type_));
@@ -104,6 +256,39 @@ namespace Exchange
             }
         }
 
+        /// Move every book of this shard into phase, books leaving an auction uncross.
+        auto setTradingPhase(TradingPhase phase) noexcept
+        {
+            logger_.log("%:% %() % % -> %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                        tradingPhaseToString(trading_phase_), tradingPhaseToString(phase));
+            if (journal_records_ && output_mode_ != OutputMode::REPLAY)
+                journal(JournalRecordType::TRADING_PHASE, phase, nullptr);
+            for (auto order_book : ticker_order_book_)
+            {
+                if (order_book)
+                    order_book->setTradingPhase(phase);
+            }
+            trading_phase_ = phase;
+        }
+
+        /// Follow the auction_schedule_, elapsed into it at now, and publish the indicative uncross of the books throttled to IndicativeInterval.
+        auto updateTradingPhase(Nanos now, Nanos elapsed) noexcept
+        {
+            const auto phase = auction_schedule_.phaseAt(elapsed);
+            if (UNLIKELY(phase != trading_phase_) && journalHasRoom())
+                setTradingPhase(phase);
+
+            if (trading_phase_ == TradingPhase::AUCTION && now >= next_indicative_time_)
+            {
+                for (auto order_book : ticker_order_book_)
+                {
+                    if (order_book)
+                        order_book->publishIndicative();
+                }
+                next_indicative_time_ = now + IndicativeInterval;
+            }
+        }
+
         /*
         We will also define a method in the same class that the limit order book will use to publish order responses through MEClientResponse
         messages. This simply writes the response to the outgoing_ogw_responses_ lock-free queue and advances the writer index.
@@ -112,7 +297,10 @@ namespace Exchange
         */
         auto sendClientResponse(const MEClientResponse *client_response) noexcept
         {
-            logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), client_response->toString());
+            if (UNLIKELY(output_mode_ == OutputMode::REPLAY))
+                return;
+            if (LIKELY(logger_.enabled()))
+                logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), client_response->toString());
             auto next_write = outgoing_ogw_responses_->getNextToWriteTo();
             *next_write = std::move(*client_response);
             outgoing_ogw_responses_->updateWriteIndex();
@@ -124,7 +312,15 @@ namespace Exchange
         */
         auto sendMarketUpdate(const MEMarketUpdate *market_update) noexcept
         {
-            logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), market_update->toString());
+            if (UNLIKELY(output_mode_ != OutputMode::LIVE))
+            {
+                if (output_mode_ == OutputMode::REPLAY)
+                    return;
+                while (outgoing_md_updates_->size() >= ME_MAX_MARKET_UPDATES / 2)
+                    std::this_thread::yield();
+            }
+            if (LIKELY(logger_.enabled()))
+                logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), market_update->toString());
             auto next_write = outgoing_md_updates_->getNextToWriteTo();
             *next_write = *market_update;
             outgoing_md_updates_->updateWriteIndex();
@@ -134,18 +330,75 @@ namespace Exchange
         */
         auto run() noexcept
         {
-            logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
+            logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), auction_schedule_.toString());
+            if (publish_replayed_books_)
+                publishBooks();
+            // Books which a replay left in an auction or closed trade continuously again without a schedule.
+            if (!auction_schedule_.enabled() && trading_phase_ != TradingPhase::CONTINUOUS)
+                setTradingPhase(TradingPhase::CONTINUOUS);
+
+            const auto start_time = getCurrentNanos();
             while (run_)
             {
+                if (auction_schedule_.enabled())
+                {
+                    const auto now = getCurrentNanos();
+                    updateTradingPhase(now, now - start_time);
+                }
+                if (checkpoint_interval_)
+                    checkpointIfDue(getCurrentNanos());
+
                 const auto me_client_request = incoming_requests_->getNextToRead();
-                if (LIKELY(me_client_request))
+                if (LIKELY(me_client_request) && LIKELY(journalHasRoom()))
                 {
-                    logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), me_client_request->toString());
+                    if (LIKELY(logger_.enabled()))
+                        logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), me_client_request->toString());
+                    if (journal_records_)
+                        journal(JournalRecordType::CLIENT_REQUEST, trading_phase_, me_client_request);
                     processClientRequest(me_client_request);
                     incoming_requests_->updateReadIndex();
                 }
             }
         }
+    private:
+        /// Whether journal_records_, if journaling is on, can take another record. While it cannot, because the journal thread fell
+        /// behind, the engine takes no requests and makes no phase changes, which would have to overwrite records not written yet.
+        auto journalHasRoom() const noexcept -> bool
+        {
+            return (!journal_records_ || journal_records_->size() < journal_records_->capacity());
+        }
+
+        /// Queue a record for the journal, which journalHasRoom() has to have made sure it has room for.
+        auto journal(JournalRecordType type, TradingPhase trading_phase, const MEClientRequest *client_request) noexcept -> void
+        {
+            auto next_write = journal_records_->getNextToWriteTo();
+            next_write->type_ = type;
+            next_write->trading_phase_ = trading_phase;
+            if (client_request)
+                next_write->request_ = *client_request;
+            journal_records_->updateWriteIndex();
+            ++journal_seq_num_;
+        }
+
+        /// Reap the child of the previous checkpoint and fork the next one if checkpoint_interval_ is up and the books changed since.
+        auto checkpointIfDue(Nanos now) noexcept -> void
+        {
+            if (LIKELY(now < next_checkpoint_time_))
+                return;
+            if (checkpoint_pid_ > 0 && !reapCheckpoint(false))
+                return;
+            if (journal_seq_num_ != checkpoint_seq_num_)
+                checkpoint();
+            next_checkpoint_time_ = now + checkpoint_interval_;
+        }
+
+        /// Write the checkpoint, in the child process checkpoint() forks.
+        auto writeCheckpoint() const noexcept -> bool;
+
+        /// Publish the orders of all books as ADDs, in priority order per level.
+        auto publishBooks() noexcept -> void;
+
+    public:
         MatchingEngine() = delete;
 
         /*Copy constructor disabled*/
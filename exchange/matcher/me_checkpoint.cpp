@@ -0,0 +1,70 @@
+#include "me_checkpoint.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Exchange {
+  MECheckpointWriter::MECheckpointWriter(const std::string &path) : path_(path), tmp_path_(path + ".tmp") {
+    fd_ = open(tmp_path_.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    ok_ = (fd_ >= 0);
+  }
+
+  MECheckpointWriter::~MECheckpointWriter() {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  auto MECheckpointWriter::write(const void *data, size_t size) noexcept -> bool {
+    auto bytes = static_cast<const char *>(data);
+    while (ok_ && size) {
+      if (used_ == buffer_.size() && !flush())
+        break;
+      const auto chunk = std::min(size, buffer_.size() - used_);
+      memcpy(buffer_.data() + used_, bytes, chunk);
+      used_ += chunk;
+      bytes += chunk;
+      size -= chunk;
+    }
+    return ok_;
+  }
+
+  auto MECheckpointWriter::flush() noexcept -> bool {
+    for (size_t written = 0; ok_ && written < used_;) {
+      const auto n = ::write(fd_, buffer_.data() + written, used_ - written);
+      ok_ = (n > 0);
+      written += (n > 0 ? static_cast<size_t>(n) : 0);
+    }
+    used_ = 0;
+    return ok_;
+  }
+
+  auto MECheckpointWriter::commit() noexcept -> bool {
+    ok_ = flush() && fdatasync(fd_) == 0 && rename(tmp_path_.c_str(), path_.c_str()) == 0;
+    return ok_;
+  }
+
+  MECheckpointReader::MECheckpointReader(const std::string &path) : path_(path) {
+    const auto fd = open(path_.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+
+    struct stat st;
+    ASSERT(fstat(fd, &st) == 0, "fstat() failed for:" + path_ + " error:" + std::string(std::strerror(errno)));
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_) {
+      // Populated up front, the orders are read once front to back.
+      const auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+      ASSERT(data != MAP_FAILED, "mmap() failed for:" + path_ + " error:" + std::string(std::strerror(errno)));
+      data_ = static_cast<const char *>(data);
+    }
+    close(fd);
+  }
+
+  MECheckpointReader::~MECheckpointReader() {
+    if (data_)
+      munmap(const_cast<char *>(data_), size_);
+  }
+}
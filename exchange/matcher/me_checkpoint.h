@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "common/macros.h"
+#include "common/time_utils.h"
+#include "common/types.h"
+
+#include "me_order_book.h"
+
+using namespace Common;
+
+namespace Exchange {
+#pragma pack(push, 1)
+
+  /// A checkpoint file of a MatchingEngine shard is an MECheckpointHeader and num_books_ books, each an MECheckpointBook followed by
+  /// its num_orders_ MECheckpointOrders, bids from the best level down and then asks from the best level up, in priority order within
+  /// a level, and its num_clients_ MECheckpointClients, each followed by MECheckpointClientOrders for the client's orders in the
+  /// order of the client's list of orders. All of them are packed, so the reader can use them where they are in the file.
+  struct MECheckpointHeader {
+    uint64_t magic_ = 0;
+    uint32_t shard_ = 0;
+    uint32_t num_shards_ = 0;
+
+    /// Number of journal records the books reflect, replay continues with the record after them.
+    size_t journal_seq_num_ = 0;
+    TradingPhase trading_phase_ = TradingPhase::CONTINUOUS;
+    uint32_t num_books_ = 0;
+  };
+
+  struct MECheckpointBook {
+    TickerId ticker_id_ = TickerId_INVALID;
+    OrderId next_market_order_id_ = 1;
+    TradingPhase trading_phase_ = TradingPhase::CONTINUOUS;
+    Price last_trade_price_ = Price_INVALID;
+    size_t num_orders_ = 0;
+    uint32_t num_clients_ = 0;
+  };
+
+  struct MECheckpointOrder {
+    ClientId client_id_ = ClientId_INVALID;
+    OrderId client_order_id_ = OrderId_INVALID;
+    OrderId market_order_id_ = OrderId_INVALID;
+    Side side_ = Side::INVALID;
+    Price price_ = Price_INVALID;
+    Qty qty_ = Qty_INVALID;
+    Priority priority_ = Priority_INVALID;
+  };
+
+  struct MECheckpointClient {
+    ClientId client_id_ = ClientId_INVALID;
+    uint32_t num_orders_ = 0;
+  };
+
+  struct MECheckpointClientOrder {
+    OrderId client_order_id_ = OrderId_INVALID;
+  };
+
+#pragma pack(pop)
+
+  constexpr uint64_t MECheckpointMagic = 0x4c4c50455443434bull;
+
+  /// Seconds between the checkpoints of every MatchingEngine shard from the LLPETM_CHECKPOINT environment variable, 0 (no checkpoints)
+  /// if it is not set. Checkpoints are only taken with a journal to replay the requests after them.
+  inline auto checkpointIntervalFromEnv() -> Nanos {
+    const auto seconds = getenv("LLPETM_CHECKPOINT");
+    return (seconds ? static_cast<Nanos>(strtoul(seconds, nullptr, 10)) * NANOS_TO_SECS : 0);
+  }
+
+  /// Buffered writer of a checkpoint file, used in the child process the MatchingEngine forks, so it reports errors instead of exiting.
+  class MECheckpointWriter final {
+  public:
+    explicit MECheckpointWriter(const std::string &path);
+
+    ~MECheckpointWriter();
+
+    auto write(const void *data, size_t size) noexcept -> bool;
+
+    template<typename T>
+    auto write(const T &value) noexcept {
+      return write(&value, sizeof(T));
+    }
+
+    /// Write out what is buffered, make the file durable and move it over path, so the previous checkpoint is only replaced by a whole one.
+    auto commit() noexcept -> bool;
+
+    auto ok() const noexcept {
+      return ok_;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    MECheckpointWriter() = delete;
+
+    MECheckpointWriter(const MECheckpointWriter &) = delete;
+
+    MECheckpointWriter(const MECheckpointWriter &&) = delete;
+
+    MECheckpointWriter &operator=(const MECheckpointWriter &) = delete;
+
+    MECheckpointWriter &operator=(const MECheckpointWriter &&) = delete;
+
+  private:
+    auto flush() noexcept -> bool;
+
+    const std::string path_;
+    const std::string tmp_path_;
+    int fd_ = -1;
+    bool ok_ = false;
+
+    std::array<char, 64 * 1024> buffer_;
+    size_t used_ = 0;
+  };
+
+  /// Reads a checkpoint file in place from a read only mapping of it.
+  class MECheckpointReader final {
+  public:
+    /// An empty reader if there is no file at path.
+    explicit MECheckpointReader(const std::string &path);
+
+    ~MECheckpointReader();
+
+    auto empty() const noexcept {
+      return !size_;
+    }
+
+    /// The next num values of type T in the file.
+    template<typename T>
+    auto read(size_t num = 1) noexcept -> const T * {
+      ASSERT(offset_ + num * sizeof(T) <= size_, "Checkpoint:" + path_ + " is truncated at " + std::to_string(offset_) + " bytes.");
+      const auto values = reinterpret_cast<const T *>(data_ + offset_);
+      offset_ += num * sizeof(T);
+      return values;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    MECheckpointReader() = delete;
+
+    MECheckpointReader(const MECheckpointReader &) = delete;
+
+    MECheckpointReader(const MECheckpointReader &&) = delete;
+
+    MECheckpointReader &operator=(const MECheckpointReader &) = delete;
+
+    MECheckpointReader &operator=(const MECheckpointReader &&) = delete;
+
+  private:
+    const std::string path_;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+  };
+}
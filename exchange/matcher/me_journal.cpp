@@ -0,0 +1,154 @@
+#include "me_journal.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common/thread_utils.h"
+
+namespace Exchange {
+  MEJournal::MEJournal(const MEJournalConfig &config, size_t shard, size_t num_shards)
+      : config_(config), path_(config.path_ + "." + std::to_string(shard)), shard_(shard), num_shards_(num_shards), records_(config.queue_size_),
+        file_size_(HeaderSize + ME_MAX_JOURNAL_RECORDS * sizeof(MEJournalRecord)), logger_("exchange_journal_" + std::to_string(shard) + ".log") {
+    // A new journal must not continue into segments a journal at the same path left behind.
+    if (access(path_.c_str(), F_OK) != 0) {
+      for (size_t segment = 1; unlink(segmentPath(segment).c_str()) == 0; ++segment);
+    }
+    openSegment(0, true);
+
+    // The records of this run carry a new epoch, which is durable before the first of them.
+    auto header = static_cast<FileHeader *>(segments_[0].file_);
+    epoch_ = ++header->epoch_;
+    ASSERT(fdatasync(segments_[0].fd_) == 0, "fdatasync() failed for:" + path_ + " error:" + std::string(std::strerror(errno)));
+
+    // The journal ends at the first record which does not continue the sequence, is torn or was written by an earlier run than the
+    // record before it, segments after the one it ends in are left to be overwritten.
+    uint32_t last_epoch = 0;
+    for (;;) {
+      auto &segment = segments_.back();
+      while (segment.num_replay_records_ < ME_MAX_JOURNAL_RECORDS) {
+        const auto &record = segment.records_[segment.num_replay_records_];
+        if (record.seq_num_ != num_replay_records_ + 1 || record.checksum_ != record.computeChecksum() || record.epoch_ < last_epoch)
+          break;
+        last_epoch = record.epoch_;
+        ++segment.num_replay_records_;
+        ++num_replay_records_;
+      }
+      if (segment.num_replay_records_ < ME_MAX_JOURNAL_RECORDS || !openSegment(segments_.size(), false))
+        break;
+    }
+    file_records_ = segments_.back().records_;
+    next_index_ = segments_.back().num_replay_records_;
+    next_seq_num_ = num_replay_records_ + 1;
+
+    logger_.log("%:% %() % % % records:% segments:% epoch:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                path_, config_.toString(), num_replay_records_, segments_.size(), epoch_);
+  }
+
+  MEJournal::~MEJournal() {
+    stop();
+    using namespace std::literals::chrono_literals;
+    std::this_thread::sleep_for(1s);
+
+    sync();
+    for (const auto &segment: segments_) {
+      if (segment.file_) {
+        munmap(segment.file_, file_size_);
+        close(segment.fd_);
+      }
+    }
+  }
+
+  auto MEJournal::openSegment(size_t segment, bool create) -> bool {
+    const auto path = segmentPath(segment);
+    const auto fd = open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (fd < 0 && !create && errno == ENOENT)
+      return false;
+    ASSERT(fd >= 0, "open() failed for:" + path + " error:" + std::string(std::strerror(errno)));
+    // Allocate all the blocks up front, so appending never has to extend the file or wait for the file system to find space.
+    const auto error = posix_fallocate(fd, 0, static_cast<off_t>(file_size_));
+    ASSERT(!error, "posix_fallocate() failed for:" + path + " error:" + std::string(std::strerror(error)));
+
+    const auto file = mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT(file != MAP_FAILED, "mmap() failed for:" + path + " error:" + std::string(std::strerror(errno)));
+    segments_.push_back({fd, file, reinterpret_cast<MEJournalRecord *>(static_cast<char *>(file) + HeaderSize), 0});
+
+    auto header = static_cast<FileHeader *>(file);
+    if (header->magic_ != Magic) {
+      *header = {Magic, sizeof(MEJournalRecord), static_cast<uint32_t>(num_shards_), static_cast<uint32_t>(shard_)};
+      ASSERT(fdatasync(fd) == 0, "fdatasync() failed for:" + path + " error:" + std::string(std::strerror(errno)));
+    }
+    ASSERT(header->record_size_ == sizeof(MEJournalRecord), "Journal:" + path + " has records of " + std::to_string(header->record_size_) + " bytes.");
+    ASSERT(header->num_shards_ == num_shards_ && header->shard_ == shard_,
+           "Journal:" + path + " is for shard " + std::to_string(header->shard_) + " of " + std::to_string(header->num_shards_) + ".");
+    return true;
+  }
+
+  auto MEJournal::start() -> void {
+    run_ = true;
+    ASSERT(Common::createAndStartThread(-1, "Exchange/MEJournal", [this]() { run(); }) != nullptr, "Failed to start MEJournal thread.");
+  }
+
+  auto MEJournal::stop() -> void {
+    run_ = false;
+  }
+
+  auto MEJournal::rollOver() noexcept -> void {
+    if (config_.sync_policy_ != JournalSyncPolicy::NONE)
+      sync();
+    auto &full_segment = segments_.back();
+    munmap(full_segment.file_, file_size_);
+    close(full_segment.fd_);
+    full_segment.file_ = nullptr;
+
+    openSegment(segments_.size(), true);
+    file_records_ = segments_.back().records_;
+    next_index_ = 0;
+    logger_.log("%:% %() % Continuing in % at record %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                segmentPath(segments_.size() - 1), next_seq_num_);
+  }
+
+  auto MEJournal::sync() noexcept -> void {
+    if (UNLIKELY(fdatasync(segments_.back().fd_) != 0))
+      FATAL("fdatasync() failed for:" + path_ + " error:" + std::string(std::strerror(errno)));
+    if (UNLIKELY(config_.sync_delay_))
+      std::this_thread::sleep_for(std::chrono::nanoseconds(config_.sync_delay_));
+    unsynced_records_ = 0;
+    last_sync_time_ = getCurrentNanos();
+  }
+
+  auto MEJournal::run() noexcept -> void {
+    logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
+    while (run_) {
+      // Take everything queued so far as one batch, which the BATCH policy commits with a single fdatasync().
+      for (auto pending = records_.size(); pending; --pending) {
+        if (UNLIKELY(next_index_ == ME_MAX_JOURNAL_RECORDS))
+          rollOver();
+
+        auto &record = file_records_[next_index_++];
+        record = *records_.getNextToRead();
+        record.seq_num_ = next_seq_num_++;
+        record.epoch_ = epoch_;
+        record.checksum_ = record.computeChecksum();
+        records_.updateReadIndex();
+        ++unsynced_records_;
+      }
+
+      if (unsynced_records_) {
+        switch (config_.sync_policy_) {
+          case JournalSyncPolicy::BATCH:
+            sync();
+            break;
+          case JournalSyncPolicy::INTERVAL:
+            if (getCurrentNanos() - last_sync_time_ >= config_.sync_interval_)
+              sync();
+            break;
+          case JournalSyncPolicy::NONE:
+            unsynced_records_ = 0;
+            break;
+        }
+      }
+    }
+  }
+}
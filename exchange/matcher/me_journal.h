@@ -0,0 +1,263 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/lf_queue.h"
+#include "common/logging.h"
+#include "common/macros.h"
+#include "common/time_utils.h"
+#include "order_server/client_request.h"
+
+#include "me_order_book.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// What an MEJournalRecord holds.
+  enum class JournalRecordType : uint8_t {
+    INVALID = 0,
+    CLIENT_REQUEST = 1,
+    TRADING_PHASE = 2
+  };
+
+  inline auto journalRecordTypeToString(JournalRecordType type) -> std::string {
+    switch (type) {
+      case JournalRecordType::CLIENT_REQUEST:
+        return "CLIENT_REQUEST";
+      case JournalRecordType::TRADING_PHASE:
+        return "TRADING_PHASE";
+      case JournalRecordType::INVALID:
+        return "INVALID";
+    }
+    return "UNKNOWN";
+  }
+
+#pragma pack(push, 1)
+
+  /// One entry of the journal of a MatchingEngine: a client request in the order the engine processed it, or a change of the trading
+  /// phase of its books, which the auction schedule makes by time, so a replay has to make it at the same point of the request stream.
+  struct MEJournalRecord {
+    /// Numbers the records of a journal from 1, so the first slot of a journal file which does not continue the sequence ends it.
+    size_t seq_num_ = 0;
+
+    /// Run of the journal which wrote the record, every opening of the journal starts a later one. Runs never go down along the
+    /// journal, so a record an earlier run left past the tail of a later one, which out of order writeback can, ends the journal too.
+    uint32_t epoch_ = 0;
+    JournalRecordType type_ = JournalRecordType::INVALID;
+    TradingPhase trading_phase_ = TradingPhase::CONTINUOUS; // TRADING_PHASE only.
+    MEClientRequest request_;                                // CLIENT_REQUEST only.
+
+    /// Of all the fields before it, so a record the crash of the exchange left half written also ends the journal.
+    uint32_t checksum_ = 0;
+
+    /// FNV-1a over the bytes before checksum_.
+    auto computeChecksum() const noexcept -> uint32_t {
+      auto hash = 2166136261u;
+      const auto bytes = reinterpret_cast<const uint8_t *>(this);
+      for (size_t i = 0; i < offsetof(MEJournalRecord, checksum_); ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+      return hash;
+    }
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MEJournalRecord"
+         << " ["
+         << "seq:" << seq_num_
+         << " epoch:" << epoch_
+         << " type:" << journalRecordTypeToString(type_);
+      if (type_ == JournalRecordType::TRADING_PHASE)
+        ss << " phase:" << tradingPhaseToString(trading_phase_);
+      else
+        ss << " " << request_.toString();
+      ss << "]";
+      return ss.str();
+    }
+  };
+
+#pragma pack(pop)
+
+  typedef LFQueue<MEJournalRecord> MEJournalLFQueue;
+
+  /// When the journal makes what it wrote durable with fdatasync(): never, leaving it to the kernel's writeback, once for every batch of
+  /// records it finds queued (group commit), or at most once every sync_interval_ while there is something to sync.
+  enum class JournalSyncPolicy : uint8_t {
+    NONE = 0,
+    BATCH = 1,
+    INTERVAL = 2
+  };
+
+  inline auto journalSyncPolicyToString(JournalSyncPolicy policy) -> std::string {
+    switch (policy) {
+      case JournalSyncPolicy::NONE:
+        return "NONE";
+      case JournalSyncPolicy::BATCH:
+        return "BATCH";
+      case JournalSyncPolicy::INTERVAL:
+        return "INTERVAL";
+    }
+    return "UNKNOWN";
+  }
+
+  struct MEJournalConfig {
+    /// Journal files are path_.<shard>, journaling is off if path_ is empty.
+    std::string path_;
+    JournalSyncPolicy sync_policy_ = JournalSyncPolicy::BATCH;
+    Nanos sync_interval_ = 0;
+    /// Time every sync takes on top of fdatasync(), and the number of records queued for the journal thread, for benchmarks of a disk
+    /// slower than the one they run on.
+    Nanos sync_delay_ = 0;
+    size_t queue_size_ = ME_MAX_CLIENT_UPDATES;
+
+    auto enabled() const noexcept {
+      return !path_.empty();
+    }
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MEJournalConfig[path:" << (enabled() ? path_ : "off") << " sync:" << journalSyncPolicyToString(sync_policy_);
+      if (sync_policy_ == JournalSyncPolicy::INTERVAL)
+        ss << " every:" << sync_interval_ / NANO_TO_MICROS << "us";
+      if (sync_delay_)
+        ss << " delay:" << sync_delay_ / NANO_TO_MICROS << "us";
+      ss << "]";
+      return ss.str();
+    }
+  };
+
+  /// The MEJournalConfig from the LLPETM_JOURNAL environment variable, the path of the journal files, and LLPETM_JOURNAL_SYNC,
+  /// "none", "batch" or the interval between syncs in microseconds, "batch" if it is not set.
+  inline auto journalConfigFromEnv() -> MEJournalConfig {
+    MEJournalConfig config;
+    const auto path = getenv("LLPETM_JOURNAL");
+    config.path_ = (path ? path : "");
+
+    const std::string sync = (getenv("LLPETM_JOURNAL_SYNC") ? getenv("LLPETM_JOURNAL_SYNC") : "batch");
+    if (sync == "none") {
+      config.sync_policy_ = JournalSyncPolicy::NONE;
+    } else if (sync != "batch") {
+      config.sync_policy_ = JournalSyncPolicy::INTERVAL;
+      config.sync_interval_ = static_cast<Nanos>(strtoul(sync.c_str(), nullptr, 10)) * NANO_TO_MICROS;
+    }
+    return config;
+  }
+
+  /// Append only journal of the records a MatchingEngine shard queues for it, on its own thread. The journal is a series of segment
+  /// files, each pre-allocated to hold ME_MAX_JOURNAL_RECORDS and memory mapped, so appending a record is a copy into the page cache,
+  /// and the sync policy decides how often that is made durable. When a segment is full the journal syncs it and continues in the
+  /// next one, the first segment is path_, the ones after it path_.<segment>. Records already in the files are kept, the
+  /// MatchingEngine replays them before it starts and the journal appends behind them.
+  class MEJournal final {
+  public:
+    MEJournal(const MEJournalConfig &config, size_t shard, size_t num_shards);
+
+    ~MEJournal();
+
+    auto start() -> void;
+
+    auto stop() -> void;
+
+    /// Queue the MatchingEngine writes the records to.
+    auto records() noexcept {
+      return &records_;
+    }
+
+    /// Number of records found in the journal files when the journal was opened.
+    auto numReplayRecords() const noexcept {
+      return num_replay_records_;
+    }
+
+    /// Call replay(records, num_records) with the records found in the journal files when the journal was opened but the first skip,
+    /// which a restored checkpoint reflects already, in order, one run of records per segment. Only before start().
+    template<typename T>
+    auto replay(size_t skip, T &&replay) const noexcept -> void {
+      for (const auto &segment: segments_) {
+        if (skip >= segment.num_replay_records_) {
+          skip -= segment.num_replay_records_;
+          continue;
+        }
+        replay(segment.records_ + skip, segment.num_replay_records_ - skip);
+        skip = 0;
+      }
+    }
+
+    /// Where the MatchingEngine of this shard checkpoints its books, next to the journal.
+    auto checkpointPath() const noexcept {
+      return path_ + ".checkpoint";
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    MEJournal() = delete;
+
+    MEJournal(const MEJournal &) = delete;
+
+    MEJournal(const MEJournal &&) = delete;
+
+    MEJournal &operator=(const MEJournal &) = delete;
+
+    MEJournal &operator=(const MEJournal &&) = delete;
+
+  private:
+    /// First bytes of a journal file, the records follow.
+    struct FileHeader {
+      uint64_t magic_ = 0;
+      uint32_t record_size_ = 0;
+      uint32_t num_shards_ = 0;
+      uint32_t shard_ = 0;
+      /// Of the last run to open the journal, in the first segment only.
+      uint32_t epoch_ = 0;
+    };
+
+    static constexpr uint64_t Magic = 0x4c4c50455443474aull;
+    static constexpr size_t HeaderSize = 64;
+
+    /// One journal file, memory mapped.
+    struct Segment {
+      int fd_ = -1;
+      void *file_ = nullptr;
+      MEJournalRecord *records_ = nullptr;
+
+      /// Records found in it when the journal was opened.
+      size_t num_replay_records_ = 0;
+    };
+
+    auto segmentPath(size_t segment) const {
+      return (segment ? path_ + "." + std::to_string(segment) : path_);
+    }
+
+    /// Map the file of segment and append it to segments_, creating the file if create is set. False if it does not exist otherwise.
+    auto openSegment(size_t segment, bool create) -> bool;
+
+    /// Sync the full segment written to, unmap it and continue in the next one.
+    auto rollOver() noexcept -> void;
+
+    auto run() noexcept -> void;
+
+    auto sync() noexcept -> void;
+
+    const MEJournalConfig config_;
+    const std::string path_;
+    const size_t shard_, num_shards_;
+
+    MEJournalLFQueue records_;
+
+    const size_t file_size_;
+    std::vector<Segment> segments_;
+
+    /// Records of the last segment, the one written to.
+    MEJournalRecord *file_records_ = nullptr;
+
+    size_t num_replay_records_ = 0;
+    size_t next_index_ = 0;
+    size_t next_seq_num_ = 1;
+    uint32_t epoch_ = 0;
+    size_t unsynced_records_ = 0;
+    Nanos last_sync_time_ = 0;
+
+    volatile bool run_ = false;
+
+    std::string time_str_;
+    Logger logger_;
+  };
+}
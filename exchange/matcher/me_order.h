@@ -1,70 +1,73 @@
 #pragma once
 #include <array>
 #include <sstream>
+#include <vector>
 #include "common/types.h"
 
 using namespace Common;
 
 namespace Exchange {
+  /// Handle of an order in the MEOrderStore of its book, the index of the order's slot there.
+  typedef uint32_t OrderHandle;
+  constexpr auto OrderHandle_INVALID = std::numeric_limits<OrderHandle>::max();
+
+  /// The fields of a resting order besides its quantity, which MEOrderStore keeps apart since matching reads it for every order it looks at.
+  /// The ticker is that of the book the order rests in.
   struct MEOrder {
-    /* Represent the instrument that this order corresponds to. */
-    TickerId ticker_id_ = TickerId_INVALID;
     /* Captures the market participant who owns this order. (Object: ClientId) */
     ClientId client_id_ = ClientId_INVALID;
+    /* Position of the order in the queue_ of its MEOrdersAtPrice. */
+    uint32_t queue_index_ = 0;
     /* Which is what the client sent on its order request. (Object: OrderId) */
     OrderId client_order_id_ = OrderId_INVALID;
     /* Which is generated by the matching engine and is unique across all client. (Object: OrderId)*/
     OrderId market_order_id_ = OrderId_INVALID;
-    Side side_ = Side::INVALID;
     Price price_ = Price_INVALID;
-    Qty qty_ = Qty_INVALID;
     Priority priority_ = Priority_INVALID;
+    Side side_ = Side::INVALID;
 
-    MEOrder *prev_order_ = nullptr;
-    MEOrder *next_order_ = nullptr;
-
-    // only needed for use with MemPool.
     MEOrder() = default;
 
-    MEOrder(TickerId ticker_id, ClientId client_id, OrderId client_order_id, OrderId market_order_id, Side side, Price price,
-                     Qty qty, Priority priority, MEOrder *prev_order, MEOrder *next_order) noexcept
-        : ticker_id_(ticker_id), client_id_(client_id), client_order_id_(client_order_id), market_order_id_(market_order_id), side_(side),
-          price_(price), qty_(qty), priority_(priority), prev_order_(prev_order), next_order_(next_order) {}
+    MEOrder(ClientId client_id, OrderId client_order_id, OrderId market_order_id, Side side, Price price, Priority priority) noexcept
+        : client_id_(client_id), client_order_id_(client_order_id), market_order_id_(market_order_id), price_(price), priority_(priority),
+          side_(side) {}
 
     auto toString() const -> std::string;
   };
 
-  typedef std::array<MEOrder *, ME_MAX_ORDER_IDS> OrderHashMap;
-  typedef std::array<OrderHashMap, ME_MAX_NUM_CLIENTS> ClientOrderHashMap;
-
+  /// A price level of the book: the FIFO of orders resting at one price on one side, as the handles of the orders in time priority,
+  /// so matching walks it front to back through consecutive memory. Removing an order from the middle leaves OrderHandle_INVALID
+  /// behind, MEOrderStore::dequeue() drops those from both ends right away and compacts the queue once they make up half of it.
   struct MEOrdersAtPrice {
     Side side_ = Side::INVALID;
     Price price_ = Price_INVALID;
 
-    MEOrder *first_me_order_ = nullptr;
-/*
-MEOrder objects are also maintained as a doubly linked list of orders arranged at a price levelin the MEOrdersAtPrice structure
-*/
-    MEOrdersAtPrice *prev_entry_ = nullptr;
-    MEOrdersAtPrice *next_entry_ = nullptr;
+    /// The live orders are those of queue_[head_ ...], the first and last of which are always live.
+    std::vector<OrderHandle> queue_;
+    size_t head_ = 0;
+    size_t num_orders_ = 0;
+
+    /// Open quantity of all orders at this level, so the depth of the book can be added up without walking its orders.
+    Qty qty_ = 0;
 
-    MEOrdersAtPrice() = default;
+    auto front() const noexcept {
+      return queue_[head_];
+    }
 
-    MEOrdersAtPrice(Side side, Price price, MEOrder *first_me_order, MEOrdersAtPrice *prev_entry, MEOrdersAtPrice *next_entry)
-        : side_(side), price_(price), first_me_order_(first_me_order), prev_entry_(prev_entry), next_entry_(next_entry) {}
+    auto back() const noexcept {
+      return queue_.back();
+    }
 
     auto toString() const {
       std::stringstream ss;
       ss << "MEOrdersAtPrice["
          << "side:" << sideToString(side_) << " "
          << "price:" << priceToString(price_) << " "
-         << "first_me_order:" << (first_me_order_ ? first_me_order_->toString() : "null") << " "
-         << "prev:" << priceToString(prev_entry_ ? prev_entry_->price_ : Price_INVALID) << " "
-         << "next:" << priceToString(next_entry_ ? next_entry_->price_ : Price_INVALID) << "]";
+         << "orders:" << num_orders_ << " "
+         << "qty:" << qtyToString(qty_) << " "
+         << "queued:" << (queue_.size() - head_) << "]";
 
       return ss.str();
     }
   };
-/* Represents a hash map, implemented through a std::array to represent a mapping from Price to MEOrdersAtPrice */
-  typedef std::array<MEOrdersAtPrice *, ME_MAX_PRICE_LEVELS> OrdersAtPriceHashMap;
 }
@@ -5,96 +5,332 @@ Not yet read
 #include "me_order_book.h"
 
 #include "matcher/matching_engine.h"
+#include "matcher/me_checkpoint.h"
 
 namespace Exchange {
-  MEOrderBook::MEOrderBook(TickerId ticker_id, Logger *logger, MatchingEngine *matching_engine)
-      : ticker_id_(ticker_id), matching_engine_(matching_engine), orders_at_price_pool_(ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS),
+  MEOrderBook::MEOrderBook(TickerId ticker_id, Logger *logger, MatchingEngine *matching_engine, bool aggregate_aggressor_fills)
+      : ticker_id_(ticker_id), aggregate_aggressor_fills_(aggregate_aggressor_fills), matching_engine_(matching_engine), order_store_(ME_MAX_ORDER_IDS),
         logger_(logger) {
   }
 
   MEOrderBook::~MEOrderBook() {
-    logger_->log("%:% %() % OrderBook\n%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
-                toString(false, true));
+    if (logger_->enabled())
+      logger_->log("%:% %() % OrderBook\n%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   toString(false, true));
 
     matching_engine_ = nullptr;
-    bids_by_price_ = asks_by_price_ = nullptr;
-    for (auto &itr: cid_oid_to_order_) {
-      itr.fill(nullptr);
-    }
   }
 
-  auto MEOrderBook::match(TickerId ticker_id, ClientId client_id, Side side, OrderId client_order_id, OrderId new_market_order_id, MEOrder* itr, Qty* leaves_qty) noexcept {
-    const auto order = itr;
-    const auto order_qty = order->qty_;
+  auto MEOrderBook::match(TickerId ticker_id, ClientId client_id, Side side, OrderId client_order_id, OrderId new_market_order_id, MEOrdersAtPrice *level, Qty* leaves_qty) noexcept {
+    const auto handle = level->front();
+    const auto &order = order_store_.order(handle);
+    const auto &order_qty = order_store_.qty(handle);
     const auto fill_qty = std::min(*leaves_qty, order_qty);
 
     *leaves_qty -= fill_qty;
-    order->qty_ -= fill_qty;
+    order_store_.reduceQty(level, handle, fill_qty);
+    last_trade_price_ = order.price_;
+
+    if (!aggregate_aggressor_fills_) { // otherwise checkForMatch() sends one fill per price level.
+      client_response_ = {ClientResponseType::FILLED, client_id, ticker_id, client_order_id,
+                          new_market_order_id, side, order.price_, fill_qty, *leaves_qty};
+      matching_engine_->sendClientResponse(&client_response_);
+    }
 
-    client_response_ = {ClientResponseType::FILLED, client_id, ticker_id, client_order_id,
-                        new_market_order_id, side, itr->price_, fill_qty, *leaves_qty};
+    client_response_ = {ClientResponseType::FILLED, order.client_id_, ticker_id, order.client_order_id_,
+                        order.market_order_id_, order.side_, order.price_, fill_qty, order_qty};
     matching_engine_->sendClientResponse(&client_response_);
 
-    client_response_ = {ClientResponseType::FILLED, order->client_id_, ticker_id, order->client_order_id_,
-                        order->market_order_id_, order->side_, itr->price_, fill_qty, order->qty_};
+    // One update carries the trade and what is left of the resting order, consumers remove the order when nothing is.
+    market_update_ = {MarketUpdateType::EXECUTION, order.market_order_id_, ticker_id, side, order.price_, fill_qty, order.priority_, order_qty};
+    matching_engine_->sendMarketUpdate(&market_update_);
+
+    if (!order_qty)
+      removeOrder(handle);
+  }
+
+  auto MEOrderBook::checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, Qty new_market_order_id) noexcept {
+    auto leaves_qty = qty;
+    Qty level_fill_qty = 0;
+    auto level_price = Price_INVALID;
+
+    // With aggregate_aggressor_fills_ the aggressor gets a single fill for everything it traded at a price level.
+    const auto sendLevelFill = [&]() {
+      client_response_ = {ClientResponseType::FILLED, client_id, ticker_id, client_order_id,
+                          new_market_order_id, side, level_price, level_fill_qty, leaves_qty};
+      matching_engine_->sendClientResponse(&client_response_);
+    };
+
+    // Orders are taken off the front of the best level, so the ones MatchPrefetchDistance places behind it are loaded while these trade.
+    for (MEOrdersAtPrice *level; leaves_qty && (level = price_ladder_.best(side == Side::BUY ? Side::SELL : Side::BUY));) {
+      if (LIKELY(side == Side::BUY ? price < level->price_ : price > level->price_)) {
+        break;
+      }
+
+      if (aggregate_aggressor_fills_ && level->price_ != level_price) {
+        if (level_fill_qty)
+          sendLevelFill();
+        level_fill_qty = 0;
+        level_price = level->price_;
+      }
+
+      order_store_.prefetch(level, MatchPrefetchDistance);
+      const auto level_leaves_qty = leaves_qty;
+      match(ticker_id, client_id, side, client_order_id, new_market_order_id, level, &leaves_qty);
+      level_fill_qty += level_leaves_qty - leaves_qty;
+    }
+
+    if (aggregate_aggressor_fills_ && level_fill_qty)
+      sendLevelFill();
+
+    return leaves_qty;
+  }
+
+  auto MEOrderBook::canFill(Side side, Price price, Qty qty) const noexcept -> bool {
+    Qty available = 0;
+    for (auto level = (side == Side::BUY ? price_ladder_.bestAsk() : price_ladder_.bestBid());
+         level && (side == Side::BUY ? level->price_ <= price : level->price_ >= price); level = price_ladder_.nextLevel(level)) {
+      if ((available += level->qty_) >= qty)
+        return true;
+    }
+    return false;
+  }
+
+  auto MEOrderBook::findUncross() const noexcept -> Uncross {
+    // Trading the best bids against the best asks for as long as they cross trades the most quantity any single price can, and every price
+    // between the last bid and ask levels reached trades that much. So one pass over the crossed levels of both sides, using their qty_, finds both.
+    Uncross result;
+    auto bid = price_ladder_.bestBid();
+    auto ask = price_ladder_.bestAsk();
+    auto bid_qty = (bid ? bid->qty_ : 0), ask_qty = (ask ? ask->qty_ : 0);
+    auto bid_price = Price_INVALID, ask_price = Price_INVALID;
+    while (bid && ask && bid->price_ >= ask->price_) {
+      const auto qty = std::min(bid_qty, ask_qty);
+      result.qty_ += qty;
+      bid_qty -= qty;
+      ask_qty -= qty;
+      bid_price = bid->price_;
+      ask_price = ask->price_;
+      if (!bid_qty && (bid = price_ladder_.nextLevel(bid)))
+        bid_qty = bid->qty_;
+      if (!ask_qty && (ask = price_ladder_.nextLevel(ask)))
+        ask_qty = ask->qty_;
+    }
+    if (!result.qty_)
+      return result;
+
+    // Quantity left over at the last level reached on one side is demand / supply which does not trade, it pushes the price to its end of the range.
+    if (bid && bid->price_ == bid_price && bid_qty)
+      result.price_ = bid_price;
+    else if (ask && ask->price_ == ask_price && ask_qty)
+      result.price_ = ask_price;
+    else if (last_trade_price_ != Price_INVALID)
+      result.price_ = std::clamp(last_trade_price_, ask_price, bid_price);
+    else
+      result.price_ = ask_price + (bid_price - ask_price) / 2;
+    return result;
+  }
+
+  auto MEOrderBook::auctionFill(MEOrdersAtPrice *level, OrderHandle handle, Price price, Qty fill_qty, bool execution) noexcept -> void {
+    const auto &order = order_store_.order(handle);
+    order_store_.reduceQty(level, handle, fill_qty);
+    const auto leaves_qty = order_store_.qty(handle);
+
+    client_response_ = {ClientResponseType::FILLED, order.client_id_, ticker_id_, order.client_order_id_,
+                        order.market_order_id_, order.side_, price, fill_qty, leaves_qty};
     matching_engine_->sendClientResponse(&client_response_);
 
-    market_update_ = {MarketUpdateType::TRADE, OrderId_INVALID, ticker_id, side, itr->price_, fill_qty, Priority_INVALID};
+    if (execution)
+      market_update_ = {MarketUpdateType::EXECUTION, order.market_order_id_, ticker_id_, (order.side_ == Side::BUY ? Side::SELL : Side::BUY),
+                        price, fill_qty, order.priority_, leaves_qty};
+    else if (leaves_qty)
+      market_update_ = {MarketUpdateType::MODIFY, order.market_order_id_, ticker_id_, order.side_, order.price_, leaves_qty, order.priority_};
+    else
+      market_update_ = {MarketUpdateType::CANCEL, order.market_order_id_, ticker_id_, order.side_, order.price_, 0, order.priority_};
     matching_engine_->sendMarketUpdate(&market_update_);
 
-    if (!order->qty_) {
-      market_update_ = {MarketUpdateType::CANCEL, order->market_order_id_, ticker_id, order->side_,
-                        order->price_, order_qty, Priority_INVALID};
-      matching_engine_->sendMarketUpdate(&market_update_);
+    if (!leaves_qty)
+      removeOrder(handle);
+  }
 
-      removeOrder(order);
-    } else {
-      market_update_ = {MarketUpdateType::MODIFY, order->market_order_id_, ticker_id, order->side_,
-                        order->price_, order->qty_, order->priority_};
-      matching_engine_->sendMarketUpdate(&market_update_);
+  auto MEOrderBook::uncross() noexcept -> void {
+    const auto result = findUncross();
+    logger_->log("%:% %() % ticker:% price:% qty:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                 tickerIdToString(ticker_id_), priceToString(result.price_), qtyToString(result.qty_));
+
+    for (auto qty = result.qty_; qty;) {
+      auto bid = price_ladder_.best(Side::BUY);
+      auto ask = price_ladder_.best(Side::SELL);
+      const auto bid_handle = bid->front(), ask_handle = ask->front();
+      const auto fill_qty = std::min({qty, order_store_.qty(bid_handle), order_store_.qty(ask_handle)});
+      qty -= fill_qty;
+
+      // The order which arrived later takes the place of the aggressor.
+      const auto bid_first = (order_store_.order(bid_handle).market_order_id_ < order_store_.order(ask_handle).market_order_id_);
+      auctionFill(bid, bid_handle, result.price_, fill_qty, bid_first);
+      auctionFill(ask, ask_handle, result.price_, fill_qty, !bid_first);
     }
+
+    if (result.qty_)
+      last_trade_price_ = result.price_;
   }
 
-  auto MEOrderBook::checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, Qty new_market_order_id) noexcept {
-    auto leaves_qty = qty;
+  auto MEOrderBook::setTradingPhase(TradingPhase phase) noexcept -> void {
+    if (phase == trading_phase_)
+      return;
 
-    if (side == Side::BUY) {
-      while (leaves_qty && asks_by_price_) {
-        const auto ask_itr = asks_by_price_->first_me_order_;
-        if (LIKELY(price < ask_itr->price_)) {
-          break;
-        }
+    logger_->log("%:% %() % ticker:% % -> %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                 tickerIdToString(ticker_id_), tradingPhaseToString(trading_phase_), tradingPhaseToString(phase));
+    if (trading_phase_ == TradingPhase::AUCTION)
+      uncross();
+
+    trading_phase_ = phase;
+    indicative_price_ = Price_INVALID;
+    indicative_qty_ = 0;
+  }
+
+  auto MEOrderBook::publishIndicative() noexcept -> void {
+    if (trading_phase_ != TradingPhase::AUCTION)
+      return;
 
-        match(ticker_id, client_id, side, client_order_id, new_market_order_id, ask_itr, &leaves_qty);
+    const auto result = findUncross();
+    if (result.price_ == indicative_price_ && result.qty_ == indicative_qty_)
+      return;
+
+    indicative_price_ = result.price_;
+    indicative_qty_ = result.qty_;
+    market_update_ = {MarketUpdateType::AUCTION_INDICATIVE, OrderId_INVALID, ticker_id_, Side::INVALID, result.price_, result.qty_, Priority_INVALID};
+    matching_engine_->sendMarketUpdate(&market_update_);
+  }
+
+  auto MEOrderBook::publishBook() noexcept -> void {
+    for (const auto side: {Side::BUY, Side::SELL}) {
+      for (const MEOrdersAtPrice *level = price_ladder_.best(side); level; level = price_ladder_.nextLevel(level)) {
+        for (auto i = level->head_; i < level->queue_.size(); ++i) {
+          const auto handle = level->queue_[i];
+          if (handle == OrderHandle_INVALID)
+            continue;
+          const auto &order = order_store_.order(handle);
+          market_update_ = {MarketUpdateType::ADD, order.market_order_id_, ticker_id_, side, order.price_, order_store_.qty(handle), order.priority_};
+          matching_engine_->sendMarketUpdate(&market_update_);
+        }
       }
     }
-    if (side == Side::SELL) {
-      while (leaves_qty && bids_by_price_) {
-        const auto bid_itr = bids_by_price_->first_me_order_;
-        if (LIKELY(price > bid_itr->price_)) {
-          break;
+  }
+
+  auto MEOrderBook::writeCheckpoint(MECheckpointWriter *writer) const noexcept -> bool {
+    MECheckpointBook book{ticker_id_, next_market_order_id_, trading_phase_, last_trade_price_, cid_oid_to_order_.size(), 0};
+    for (ClientId client_id = 0; client_id < ME_MAX_NUM_CLIENTS; ++client_id)
+      book.num_clients_ += (order_store_.firstClientOrder(client_id) != OrderHandle_INVALID);
+    writer->write(book);
+
+    for (const auto side: {Side::BUY, Side::SELL}) {
+      for (const MEOrdersAtPrice *level = price_ladder_.best(side); level; level = price_ladder_.nextLevel(level)) {
+        for (auto i = level->head_; i < level->queue_.size(); ++i) {
+          const auto handle = level->queue_[i];
+          if (handle == OrderHandle_INVALID)
+            continue;
+          const auto &order = order_store_.order(handle);
+          writer->write(MECheckpointOrder{order.client_id_, order.client_order_id_, order.market_order_id_, side, order.price_,
+                                          order_store_.qty(handle), order.priority_});
         }
+      }
+    }
 
-        match(ticker_id, client_id, side, client_order_id, new_market_order_id, bid_itr, &leaves_qty);
+    for (ClientId client_id = 0; client_id < ME_MAX_NUM_CLIENTS; ++client_id) {
+      const auto first = order_store_.firstClientOrder(client_id);
+      if (first == OrderHandle_INVALID)
+        continue;
+      MECheckpointClient client{client_id, 0};
+      for (auto handle = first; handle != OrderHandle_INVALID; handle = order_store_.nextClientOrder(handle))
+        ++client.num_orders_;
+      writer->write(client);
+      for (auto handle = first; handle != OrderHandle_INVALID; handle = order_store_.nextClientOrder(handle))
+        writer->write(MECheckpointClientOrder{order_store_.order(handle).client_order_id_});
+    }
+    return writer->ok();
+  }
+
+  auto MEOrderBook::restoreCheckpoint(const MECheckpointBook &book, MECheckpointReader *reader) noexcept -> size_t {
+    ASSERT(book.ticker_id_ == ticker_id_ && !cid_oid_to_order_.size(), "Cannot restore the checkpoint of ticker:" + tickerIdToString(book.ticker_id_) +
+                                                                        " into " + toString(false, false));
+
+    // Orders come level by level in priority order, so appending each to its level rebuilds the queues as they were. They land in
+    // random slots of the index, which is loaded into the cache IndexPrefetchDistance orders ahead.
+    const auto orders = reader->read<MECheckpointOrder>(book.num_orders_);
+    cid_oid_to_order_.reserve(book.num_orders_);
+    MEOrdersAtPrice *level = nullptr;
+    for (size_t i = 0; i < book.num_orders_; ++i) {
+      const auto &order = orders[i];
+      if (i + IndexPrefetchDistance < book.num_orders_)
+        cid_oid_to_order_.prefetch(orders[i + IndexPrefetchDistance].client_id_, orders[i + IndexPrefetchDistance].client_order_id_);
+      const auto handle = order_store_.allocate({order.client_id_, order.client_order_id_, order.market_order_id_, order.side_, order.price_,
+                                                 order.priority_}, order.qty_);
+      if (!level || level->side_ != order.side_ || level->price_ != order.price_) {
+        level = getOrdersAtPrice(order.side_, order.price_);
+        if (!level) {
+          // The checkpointed book fit into a ladder, so the restored one does too, once it has moved its window over the prices.
+          ASSERT(price_ladder_.makeRoom(order.price_), "Checkpointed order does not fit into the price ladder:" + priceToString(order.price_));
+          level = price_ladder_.addOrdersAtPrice(order.side_, order.price_);
+        }
       }
+      order_store_.enqueue(level, handle);
+      cid_oid_to_order_.insert(order.client_id_, order.client_order_id_, handle);
     }
 
-    return leaves_qty;
+    // linkClientOrder() adds to the front of a client's list, so the orders are linked last to first.
+    for (uint32_t i = 0; i < book.num_clients_; ++i) {
+      const auto client = reader->read<MECheckpointClient>();
+      const auto client_orders = reader->read<MECheckpointClientOrder>(client->num_orders_);
+      for (auto j = client->num_orders_; j--;)
+        order_store_.linkClientOrder(cid_oid_to_order_.find(client->client_id_, client_orders[j].client_order_id_));
+    }
+
+    next_market_order_id_ = book.next_market_order_id_;
+    trading_phase_ = book.trading_phase_;
+    last_trade_price_ = book.last_trade_price_;
+    indicative_price_ = Price_INVALID;
+    indicative_qty_ = 0;
+    return book.num_orders_;
   }
 
-  auto MEOrderBook::add(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void {
+  auto MEOrderBook::add(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty,
+                        OrderType order_type, TimeInForce time_in_force) noexcept -> void {
+    const auto rests = (order_type == OrderType::LIMIT && time_in_force == TimeInForce::GTC);
+    // An auction only takes orders which can wait for the uncross, a closed book takes none.
+    const auto phase_allows = (LIKELY(trading_phase_ == TradingPhase::CONTINUOUS) || (trading_phase_ == TradingPhase::AUCTION && rests));
+    if (UNLIKELY(!phase_allows)) {
+      client_response_ = {ClientResponseType::REJECTED, client_id, ticker_id, client_order_id, OrderId_INVALID, side, price, 0, qty};
+      matching_engine_->sendClientResponse(&client_response_);
+      return;
+    }
+
     const auto new_market_order_id = generateNewMarketOrderId();
     client_response_ = {ClientResponseType::ACCEPTED, client_id, ticker_id, client_order_id, new_market_order_id, side, price, 0, qty};
     matching_engine_->sendClientResponse(&client_response_);
 
-    const auto leaves_qty = checkForMatch(client_id, client_order_id, ticker_id, side, price, qty, new_market_order_id);
+    // A market order trades at whatever price the other side of the book offers.
+    const auto limit_price = (order_type == OrderType::MARKET ?
+                              (side == Side::BUY ? std::numeric_limits<Price>::max() : std::numeric_limits<Price>::min()) : price);
+    auto leaves_qty = qty;
+    if (LIKELY(trading_phase_ == TradingPhase::CONTINUOUS) && (time_in_force != TimeInForce::FOK || canFill(side, limit_price, qty)))
+      leaves_qty = checkForMatch(client_id, client_order_id, ticker_id, side, limit_price, qty, new_market_order_id);
+
+    // What is left of a resting order is canceled too if its price is too far away from the rest of the book to fit into the price ladder.
+    if (UNLIKELY(!rests || (leaves_qty && !price_ladder_.makeRoom(price)))) {
+      if (leaves_qty) {
+        client_response_ = {ClientResponseType::CANCELED, client_id, ticker_id, client_order_id, new_market_order_id, side, price,
+                            Qty_INVALID, leaves_qty};
+        matching_engine_->sendClientResponse(&client_response_);
+      }
+      return;
+    }
 
     if (LIKELY(leaves_qty)) {
-      const auto priority = getNextPriority(price);
+      const auto priority = getNextPriority(side, price);
 
-      auto order = order_pool_.allocate(ticker_id, client_id, client_order_id, new_market_order_id, side, price, leaves_qty, priority, nullptr,
-                                        nullptr);
-      addOrder(order);
+      const auto handle = order_store_.allocate({client_id, client_order_id, new_market_order_id, side, price, priority}, leaves_qty);
+      addOrder(handle);
 
       market_update_ = {MarketUpdateType::ADD, new_market_order_id, ticker_id, side, price, leaves_qty, priority};
       matching_engine_->sendMarketUpdate(&market_update_);
@@ -102,24 +338,19 @@ namespace Exchange {
   }
 
   auto MEOrderBook::cancel(ClientId client_id, OrderId order_id, TickerId ticker_id) noexcept -> void {
-    auto is_cancelable = (client_id < cid_oid_to_order_.size());
-    MEOrder *exchange_order = nullptr;
-    if (LIKELY(is_cancelable)) {
-      auto &co_itr = cid_oid_to_order_.at(client_id);
-      exchange_order = co_itr.at(order_id);
-      is_cancelable = (exchange_order != nullptr);
-    }
+    const auto handle = cid_oid_to_order_.find(client_id, order_id);
 
-    if (UNLIKELY(!is_cancelable)) {
+    if (UNLIKELY(handle == OrderHandle_INVALID)) {
       client_response_ = {ClientResponseType::CANCEL_REJECTED, client_id, ticker_id, order_id, OrderId_INVALID,
                           Side::INVALID, Price_INVALID, Qty_INVALID, Qty_INVALID};
     } else {
-      client_response_ = {ClientResponseType::CANCELED, client_id, ticker_id, order_id, exchange_order->market_order_id_,
-                          exchange_order->side_, exchange_order->price_, Qty_INVALID, exchange_order->qty_};
-      market_update_ = {MarketUpdateType::CANCEL, exchange_order->market_order_id_, ticker_id, exchange_order->side_, exchange_order->price_, 0,
-                        exchange_order->priority_};
+      const auto &exchange_order = order_store_.order(handle);
+      client_response_ = {ClientResponseType::CANCELED, client_id, ticker_id, order_id, exchange_order.market_order_id_,
+                          exchange_order.side_, exchange_order.price_, Qty_INVALID, order_store_.qty(handle)};
+      market_update_ = {MarketUpdateType::CANCEL, exchange_order.market_order_id_, ticker_id, exchange_order.side_, exchange_order.price_, 0,
+                        exchange_order.priority_};
 
-      removeOrder(exchange_order);
+      removeOrder(handle);
 
       matching_engine_->sendMarketUpdate(&market_update_);
     }
@@ -127,40 +358,114 @@ namespace Exchange {
     matching_engine_->sendClientResponse(&client_response_);
   }
 
+  auto MEOrderBook::modify(ClientId client_id, OrderId order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void {
+    const auto handle = cid_oid_to_order_.find(client_id, order_id);
+
+    if (UNLIKELY(handle == OrderHandle_INVALID)) {
+      client_response_ = {ClientResponseType::MODIFY_REJECTED, client_id, ticker_id, order_id, OrderId_INVALID,
+                          side, Price_INVALID, Qty_INVALID, Qty_INVALID};
+      matching_engine_->sendClientResponse(&client_response_);
+      return;
+    }
+
+    const auto order = order_store_.order(handle);
+    const auto &order_qty = order_store_.qty(handle);
+
+    // Rejected requests leave the order as it was, which the response reports.
+    if (UNLIKELY(trading_phase_ == TradingPhase::CLOSED || !qty || side != order.side_)) {
+      client_response_ = {ClientResponseType::MODIFY_REJECTED, client_id, ticker_id, order_id, order.market_order_id_,
+                          order.side_, order.price_, Qty_INVALID, order_qty};
+      matching_engine_->sendClientResponse(&client_response_);
+      return;
+    }
+
+    client_response_ = {ClientResponseType::MODIFIED, client_id, ticker_id, order_id, order.market_order_id_, order.side_, price, 0, qty};
+    matching_engine_->sendClientResponse(&client_response_);
+
+    if (price == order.price_ && qty <= order_qty) {
+      if (qty != order_qty) {
+        order_store_.reduceQty(getOrdersAtPrice(order.side_, order.price_), handle, order_qty - qty);
+        market_update_ = {MarketUpdateType::MODIFY, order.market_order_id_, ticker_id, order.side_, order.price_, qty, order.priority_};
+        matching_engine_->sendMarketUpdate(&market_update_);
+      }
+      return;
+    }
+
+    // Loses its priority: take it out of the book and let it match and rest like a new order, under the same market order id.
+    removeOrder(handle);
+    const auto leaves_qty = (LIKELY(trading_phase_ == TradingPhase::CONTINUOUS) ?
+                             checkForMatch(client_id, order_id, ticker_id, order.side_, price, qty, order.market_order_id_) : qty);
+
+    if (LIKELY(leaves_qty && price_ladder_.makeRoom(price))) {
+      const auto priority = getNextPriority(order.side_, price);
+      addOrder(order_store_.allocate({client_id, order_id, order.market_order_id_, order.side_, price, priority}, leaves_qty));
+
+      market_update_ = {MarketUpdateType::MODIFY, order.market_order_id_, ticker_id, order.side_, price, leaves_qty, priority};
+    } else {
+      // Filled, or what is left is too far away from the rest of the book to fit into the price ladder and is canceled.
+      if (UNLIKELY(leaves_qty)) {
+        client_response_ = {ClientResponseType::CANCELED, client_id, ticker_id, order_id, order.market_order_id_, order.side_, price,
+                            Qty_INVALID, leaves_qty};
+        matching_engine_->sendClientResponse(&client_response_);
+      }
+      market_update_ = {MarketUpdateType::CANCEL, order.market_order_id_, ticker_id, order.side_, order.price_, 0, order.priority_};
+    }
+    matching_engine_->sendMarketUpdate(&market_update_);
+  }
+
+  auto MEOrderBook::massCancel(ClientId client_id, Side side) noexcept -> void {
+    // The CANCEL market updates of a mass cancel follow each other, so the MarketDataPublisher packs them into as few packets as possible.
+    for (auto handle = order_store_.firstClientOrder(client_id); handle != OrderHandle_INVALID;) {
+      const auto next_handle = order_store_.nextClientOrder(handle);
+      const auto &order = order_store_.order(handle);
+      if (side == Side::INVALID || order.side_ == side) {
+        client_response_ = {ClientResponseType::CANCELED, client_id, ticker_id_, order.client_order_id_, order.market_order_id_,
+                            order.side_, order.price_, Qty_INVALID, order_store_.qty(handle)};
+        market_update_ = {MarketUpdateType::CANCEL, order.market_order_id_, ticker_id_, order.side_, order.price_, 0, order.priority_};
+
+        removeOrder(handle);
+
+        matching_engine_->sendClientResponse(&client_response_);
+        matching_engine_->sendMarketUpdate(&market_update_);
+      }
+      handle = next_handle;
+    }
+  }
+
   auto MEOrderBook::toString(bool detailed, bool validity_check) const -> std::string {
     std::stringstream ss;
     std::string time_str;
 
-    auto printer = [&](std::stringstream &ss, MEOrdersAtPrice *itr, Side side, Price &last_price, bool sanity_check) {
+    auto printer = [&](std::stringstream &ss, const MEOrdersAtPrice *itr, Side side, Price &last_price, bool sanity_check) {
       char buf[4096];
       Qty qty = 0;
       size_t num_orders = 0;
 
-      for (auto o_itr = itr->first_me_order_;; o_itr = o_itr->next_order_) {
-        qty += o_itr->qty_;
-        ++num_orders;
-        if (o_itr->next_order_ == itr->first_me_order_)
-          break;
+      for (auto i = itr->head_; i < itr->queue_.size(); ++i) {
+        if (itr->queue_[i] != OrderHandle_INVALID) {
+          qty += order_store_.qty(itr->queue_[i]);
+          ++num_orders;
+        }
       }
-      sprintf(buf, " <px:%3s p:%3s n:%3s> %-3s @ %-5s(%-4s)",
-              priceToString(itr->price_).c_str(), priceToString(itr->prev_entry_->price_).c_str(), priceToString(itr->next_entry_->price_).c_str(),
-              priceToString(itr->price_).c_str(), qtyToString(qty).c_str(), std::to_string(num_orders).c_str());
+      sprintf(buf, " <px:%3s> %-3s @ %-5s(%-4s)",
+              priceToString(itr->price_).c_str(), priceToString(itr->price_).c_str(), qtyToString(qty).c_str(), std::to_string(num_orders).c_str());
       ss << buf;
-      for (auto o_itr = itr->first_me_order_;; o_itr = o_itr->next_order_) {
-        if (detailed) {
-          sprintf(buf, "[oid:%s q:%s p:%s n:%s] ",
-                  orderIdToString(o_itr->market_order_id_).c_str(), qtyToString(o_itr->qty_).c_str(),
-                  orderIdToString(o_itr->prev_order_ ? o_itr->prev_order_->market_order_id_ : OrderId_INVALID).c_str(),
-                  orderIdToString(o_itr->next_order_ ? o_itr->next_order_->market_order_id_ : OrderId_INVALID).c_str());
+      for (auto i = itr->head_; detailed && i < itr->queue_.size(); ++i) {
+        if (itr->queue_[i] != OrderHandle_INVALID) {
+          const auto &order = order_store_.order(itr->queue_[i]);
+          sprintf(buf, "[oid:%s q:%s prio:%s] ",
+                  orderIdToString(order.market_order_id_).c_str(), qtyToString(order_store_.qty(itr->queue_[i])).c_str(),
+                  priorityToString(order.priority_).c_str());
           ss << buf;
         }
-        if (o_itr->next_order_ == itr->first_me_order_)
-          break;
       }
 
       ss << std::endl;
 
       if (sanity_check) {
+        if (num_orders != itr->num_orders_ || itr->front() == OrderHandle_INVALID || itr->back() == OrderHandle_INVALID) {
+          FATAL("Level queue inconsistent, counted " + std::to_string(num_orders) + " orders in " + itr->toString());
+        }
         if ((side == Side::SELL && last_price >= itr->price_) || (side == Side::BUY && last_price <= itr->price_)) {
           FATAL("Bids/Asks not sorted by ascending/descending prices last:" + priceToString(last_price) + " itr:" + itr->toString());
         }
@@ -170,26 +475,22 @@ namespace Exchange {
 
     ss << "Ticker:" << tickerIdToString(ticker_id_) << std::endl;
     {
-      auto ask_itr = asks_by_price_;
       auto last_ask_price = std::numeric_limits<Price>::min();
-      for (size_t count = 0; ask_itr; ++count) {
+      size_t count = 0;
+      for (auto ask_itr = price_ladder_.bestAsk(); ask_itr; ask_itr = price_ladder_.nextLevel(ask_itr), ++count) {
         ss << "ASKS L:" << count << " => ";
-        auto next_ask_itr = (ask_itr->next_entry_ == asks_by_price_ ? nullptr : ask_itr->next_entry_);
         printer(ss, ask_itr, Side::SELL, last_ask_price, validity_check);
-        ask_itr = next_ask_itr;
       }
     }
 
     ss << std::endl << "                          X" << std::endl << std::endl;
 
     {
-      auto bid_itr = bids_by_price_;
       auto last_bid_price = std::numeric_limits<Price>::max();
-      for (size_t count = 0; bid_itr; ++count) {
+      size_t count = 0;
+      for (auto bid_itr = price_ladder_.bestBid(); bid_itr; bid_itr = price_ladder_.nextLevel(bid_itr), ++count) {
         ss << "BIDS L:" << count << " => ";
-        auto next_bid_itr = (bid_itr->next_entry_ == bids_by_price_ ? nullptr : bid_itr->next_entry_);
         printer(ss, bid_itr, Side::BUY, last_bid_price, validity_check);
-        bid_itr = next_bid_itr;
       }
     }
 
@@ -5,28 +5,87 @@ Not yet read
 #pragma once
 
 #include "common/types.h"
-#include "common/mem_pool.h"
 #include "common/logging.h"
+#include "order_server/client_request.h"
 #include "order_server/client_response.h"
 #include "market_data/market_update.h"
 
 #include "me_order.h"
+#include "me_order_index.h"
+#include "me_order_store.h"
+#include "me_price_ladder.h"
 
 using namespace Common;
 
 namespace Exchange {
   class MatchingEngine;
+  class MECheckpointWriter;
+  class MECheckpointReader;
+  struct MECheckpointBook;
+
+  /// Trading phase of an MEOrderBook. During a call AUCTION orders rest without matching, so the book can cross, until it is uncrossed
+  /// on leaving the auction. A CLOSED book only takes cancels.
+  enum class TradingPhase : uint8_t {
+    CONTINUOUS = 0,
+    AUCTION = 1,
+    CLOSED = 2
+  };
+
+  inline auto tradingPhaseToString(TradingPhase phase) -> std::string {
+    switch (phase) {
+      case TradingPhase::CONTINUOUS:
+        return "CONTINUOUS";
+      case TradingPhase::AUCTION:
+        return "AUCTION";
+      case TradingPhase::CLOSED:
+        return "CLOSED";
+    }
+    return "UNKNOWN";
+  }
 
   class MEOrderBook final {
   public:
-    explicit MEOrderBook(TickerId ticker_id, Logger *logger, MatchingEngine *matching_engine);
+    /// With aggregate_aggressor_fills an aggressive order gets one FILLED response per price level it trades at, instead of one per resting order.
+    explicit MEOrderBook(TickerId ticker_id, Logger *logger, MatchingEngine *matching_engine, bool aggregate_aggressor_fills = false);
 
     ~MEOrderBook();
 
-    auto add(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void;
+    /// A new order trades against the book as far as its price allows, what is left rests on the book for a GTC LIMIT order and is
+    /// cancelled for IOC and MARKET orders, without being added to the book or published. A FOK order which the book cannot fill
+    /// completely is cancelled before trading. During an AUCTION GTC LIMIT orders rest without trading and all others are rejected.
+    auto add(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty,
+             OrderType order_type = OrderType::LIMIT, TimeInForce time_in_force = TimeInForce::GTC) noexcept -> void;
 
     auto cancel(ClientId client_id, OrderId order_id, TickerId ticker_id) noexcept -> void;
 
+    /// Cancel/replace the live order order_id of client_id with price and the new open quantity qty. Reducing the quantity at the same price
+    /// keeps the order's place in the queue, a new price or a larger quantity sends it to the back of the queue at the new price, where it can
+    /// trade like a new order. The order keeps its market order id.
+    auto modify(ClientId client_id, OrderId order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void;
+
+    /// Cancel all live orders of client_id on this book, only those on side unless it is Side::INVALID. Walks the client's own orders only.
+    auto massCancel(ClientId client_id, Side side) noexcept -> void;
+
+    /// Move the book into phase. Leaving an AUCTION uncrosses the book first, at the one price which trades the most quantity.
+    auto setTradingPhase(TradingPhase phase) noexcept -> void;
+
+    auto tradingPhase() const noexcept {
+      return trading_phase_;
+    }
+
+    /// During an AUCTION, publish the price and quantity the book would uncross at if they changed since they were last published.
+    auto publishIndicative() noexcept -> void;
+
+    /// Publish every order on the book as an ADD, level by level from the best and in priority order within a level.
+    auto publishBook() noexcept -> void;
+
+    /// Write the book to a checkpoint, see MECheckpointHeader for the layout, false if writing failed.
+    auto writeCheckpoint(MECheckpointWriter *writer) const noexcept -> bool;
+
+    /// Load the book, which has to be empty, from the checkpoint of it reader is at, straight into the order store, the ladder and the
+    /// index, and return the number of orders loaded.
+    auto restoreCheckpoint(const MECheckpointBook &book, MECheckpointReader *reader) noexcept -> size_t;
+
     auto toString(bool detailed, bool validity_check) const -> std::string;
 
     // Deleted default, copy & move constructors and assignment-operators.
@@ -43,160 +102,103 @@ namespace Exchange {
   private:
     TickerId ticker_id_ = TickerId_INVALID;
 
-    MatchingEngine *matching_engine_ = nullptr;
+    const bool aggregate_aggressor_fills_ = false;
 
-    ClientOrderHashMap cid_oid_to_order_;
+    MatchingEngine *matching_engine_ = nullptr;
 
-    MemPool<MEOrdersAtPrice> orders_at_price_pool_;
-    MEOrdersAtPrice *bids_by_price_ = nullptr;
-    MEOrdersAtPrice *asks_by_price_ = nullptr;
+    /// Live orders by (client_id, client_order_id).
+    MEOrderIndex cid_oid_to_order_;
 
-    OrdersAtPriceHashMap price_orders_at_price_;
+    /// Price levels of both sides.
+    MEPriceLadder price_ladder_;
 
-    MemPool<MEOrder> order_pool_;
+    MEOrderStore order_store_;
 
     MEClientResponse client_response_;
     MEMarketUpdate market_update_;
 
     OrderId next_market_order_id_ = 1;
 
+    TradingPhase trading_phase_ = TradingPhase::CONTINUOUS;
+
+    /// Price of the last trade, which an uncross falls back on when neither side has quantity left over at the uncross price.
+    Price last_trade_price_ = Price_INVALID;
+
+    /// What publishIndicative() published last.
+    Price indicative_price_ = Price_INVALID;
+    Qty indicative_qty_ = 0;
+
     std::string time_str_;
     Logger *logger_ = nullptr;
 
   private:
-    auto generateNewMarketOrderId() noexcept -> OrderId {
-      return next_market_order_id_++;
-    }
+    /// How many orders behind the one it trades against next checkForMatch() starts loading into the cache.
+    static constexpr size_t MatchPrefetchDistance = 4;
 
-    auto priceToIndex(Price price) const noexcept {
-      return (price % ME_MAX_PRICE_LEVELS);
-    }
+    /// How many orders ahead restoreCheckpoint() starts loading the index slots of the orders it inserts into the cache.
+    static constexpr size_t IndexPrefetchDistance = 16;
 
-    auto getOrdersAtPrice(Price price) const noexcept -> MEOrdersAtPrice * {
-      return price_orders_at_price_.at(priceToIndex(price));
+    auto generateNewMarketOrderId() noexcept -> OrderId {
+      return next_market_order_id_++;
     }
 
-    auto addOrdersAtPrice(MEOrdersAtPrice *new_orders_at_price) noexcept {
-      price_orders_at_price_.at(priceToIndex(new_orders_at_price->price_)) = new_orders_at_price;
-
-      const auto best_orders_by_price = (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_);
-      if (UNLIKELY(!best_orders_by_price)) {
-        (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_) = new_orders_at_price;
-        new_orders_at_price->prev_entry_ = new_orders_at_price->next_entry_ = new_orders_at_price;
-      } else {
-        auto target = best_orders_by_price;
-        bool add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
-                          (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
-        if (add_after) {
-          target = target->next_entry_;
-          add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
-                       (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
-        }
-        while (add_after && target != best_orders_by_price) {
-          add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
-                       (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
-          if (add_after)
-            target = target->next_entry_;
-        }
-
-        if (add_after) { // add new_orders_at_price after target.
-          if (target == best_orders_by_price) {
-            target = best_orders_by_price->prev_entry_;
-          }
-          new_orders_at_price->prev_entry_ = target;
-          target->next_entry_->prev_entry_ = new_orders_at_price;
-          new_orders_at_price->next_entry_ = target->next_entry_;
-          target->next_entry_ = new_orders_at_price;
-        } else { // add new_orders_at_price before target.
-          new_orders_at_price->prev_entry_ = target->prev_entry_;
-          new_orders_at_price->next_entry_ = target;
-          target->prev_entry_->next_entry_ = new_orders_at_price;
-          target->prev_entry_ = new_orders_at_price;
-
-          if ((new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ > best_orders_by_price->price_) ||
-              (new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ < best_orders_by_price->price_)) {
-            target->next_entry_ = (target->next_entry_ == best_orders_by_price ? new_orders_at_price : target->next_entry_);
-            (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_) = new_orders_at_price;
-          }
-        }
-      }
+    auto getOrdersAtPrice(Side side, Price price) noexcept -> MEOrdersAtPrice * {
+      return price_ladder_.getOrdersAtPrice(side, price);
     }
 
-    auto removeOrdersAtPrice(Side side, Price price) noexcept {
-      const auto best_orders_by_price = (side == Side::BUY ? bids_by_price_ : asks_by_price_);
-      auto orders_at_price = getOrdersAtPrice(price);
-
-      if (UNLIKELY(orders_at_price->next_entry_ == orders_at_price)) { // empty side of book.
-        (side == Side::BUY ? bids_by_price_ : asks_by_price_) = nullptr;
-      } else {
-        orders_at_price->prev_entry_->next_entry_ = orders_at_price->next_entry_;
-        orders_at_price->next_entry_->prev_entry_ = orders_at_price->prev_entry_;
-
-        if (orders_at_price == best_orders_by_price) {
-          (side == Side::BUY ? bids_by_price_ : asks_by_price_) = orders_at_price->next_entry_;
-        }
-
-        orders_at_price->prev_entry_ = orders_at_price->next_entry_ = nullptr;
-      }
-
-      price_orders_at_price_.at(priceToIndex(price)) = nullptr;
-
-      orders_at_price_pool_.deallocate(orders_at_price);
-    }
-
-    auto getNextPriority(Price price) noexcept {
-      const auto orders_at_price = getOrdersAtPrice(price);
+    auto getNextPriority(Side side, Price price) noexcept {
+      const auto orders_at_price = getOrdersAtPrice(side, price);
       if (!orders_at_price)
         return 1lu;
 
-      return orders_at_price->first_me_order_->prev_order_->priority_ + 1;
+      return order_store_.order(orders_at_price->back()).priority_ + 1;
     }
 
-    auto match(TickerId ticker_id, ClientId client_id, Side side, OrderId client_order_id, OrderId new_market_order_id, MEOrder* bid_itr, Qty* leaves_qty) noexcept;
+    auto match(TickerId ticker_id, ClientId client_id, Side side, OrderId client_order_id, OrderId new_market_order_id, MEOrdersAtPrice *level, Qty* leaves_qty) noexcept;
+
+    /// Whether the orders on the other side of the book at price or better add up to at least qty.
+    auto canFill(Side side, Price price, Qty qty) const noexcept -> bool;
 
     auto
     checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, Qty new_market_order_id) noexcept;
 
-    auto removeOrder(MEOrder *order) noexcept {
-      auto orders_at_price = getOrdersAtPrice(order->price_);
+    /// The price a crossed book uncrosses at and the quantity which trades there, Price_INVALID and 0 if the book is not crossed.
+    struct Uncross {
+      Price price_ = Price_INVALID;
+      Qty qty_ = 0;
+    };
 
-      if (order->prev_order_ == order) { // only one element.
-        removeOrdersAtPrice(order->side_, order->price_);
-      } else { // remove the link.
-        const auto order_before = order->prev_order_;
-        const auto order_after = order->next_order_;
-        order_before->next_order_ = order_after;
-        order_after->prev_order_ = order_before;
+    auto findUncross() const noexcept -> Uncross;
 
-        if (orders_at_price->first_me_order_ == order) {
-          orders_at_price->first_me_order_ = order_after;
-        }
+    /// Trade everything findUncross() finds at its price, in price-time priority on either side.
+    auto uncross() noexcept -> void;
 
-        order->prev_order_ = order->next_order_ = nullptr;
-      }
+    /// Fill the order handle at level for fill_qty at price in an uncross. The order which got there first gets an EXECUTION with the
+    /// trade, the other one a MODIFY or CANCEL, so consumers see every trade once.
+    auto auctionFill(MEOrdersAtPrice *level, OrderHandle handle, Price price, Qty fill_qty, bool execution) noexcept -> void;
 
-      cid_oid_to_order_.at(order->client_id_).at(order->client_order_id_) = nullptr;
-      order_pool_.deallocate(order);
-    }
-
-    auto addOrder(MEOrder *order) noexcept {
-      const auto orders_at_price = getOrdersAtPrice(order->price_);
+    auto removeOrder(OrderHandle handle) noexcept {
+      const auto &order = order_store_.order(handle);
+      auto orders_at_price = getOrdersAtPrice(order.side_, order.price_);
 
-      if (!orders_at_price) {
-        order->next_order_ = order->prev_order_ = order;
+      order_store_.dequeue(orders_at_price, handle);
+      if (!orders_at_price->num_orders_)
+        price_ladder_.removeOrdersAtPrice(order.side_, order.price_);
 
-        auto new_orders_at_price = orders_at_price_pool_.allocate(order->side_, order->price_, order, nullptr, nullptr);
-        addOrdersAtPrice(new_orders_at_price);
-      } else {
-        auto first_order = (orders_at_price ? orders_at_price->first_me_order_ : nullptr);
+      cid_oid_to_order_.erase(order.client_id_, order.client_order_id_);
+      order_store_.unlinkClientOrder(handle);
+      order_store_.deallocate(handle);
+    }
 
-        first_order->prev_order_->next_order_ = order;
-        order->prev_order_ = first_order->prev_order_;
-        order->next_order_ = first_order;
-        first_order->prev_order_ = order;
-      }
+    auto addOrder(OrderHandle handle) noexcept {
+      const auto &order = order_store_.order(handle);
+      auto orders_at_price = getOrdersAtPrice(order.side_, order.price_);
+      if (!orders_at_price)
+        orders_at_price = price_ladder_.addOrdersAtPrice(order.side_, order.price_);
 
-      cid_oid_to_order_.at(order->client_id_).at(order->client_order_id_) = order;
+      order_store_.enqueue(orders_at_price, handle);
+      cid_oid_to_order_.insert(order.client_id_, order.client_order_id_, handle);
+      order_store_.linkClientOrder(handle);
     }
   };
 
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+
+#include "common/types.h"
+#include "common/macros.h"
+
+#include "me_order.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// Index of the live orders of an MEOrderBook by (client_id, client_order_id), an open addressing hash map with linear probing.
+  /// Slots hold the key next to the order's handle, four to a cache line, so a probe sequence stays within a cache line or two, and erase shifts the following
+  /// entries of the probe sequence back instead of leaving tombstones. The table doubles whenever more than a quarter of it is in use,
+  /// which keeps probe sequences short while orders come and go, so its size follows the number of live orders, and client order ids
+  /// can take any value.
+  class MEOrderIndex final {
+  public:
+    static constexpr size_t InitialCapacity = 4 * 1024;
+
+    MEOrderIndex() : slots_(InitialCapacity), mask_(InitialCapacity - 1) {
+    }
+
+    /// The live order with this key, OrderHandle_INVALID if there is none.
+    auto find(ClientId client_id, OrderId client_order_id) const noexcept -> OrderHandle {
+      for (auto index = slotIndex(client_id, client_order_id);; index = (index + 1) & mask_) {
+        const auto &slot = slots_[index];
+        if (slot.handle_ == OrderHandle_INVALID)
+          return OrderHandle_INVALID;
+        if (slot.client_order_id_ == client_order_id && slot.client_id_ == client_id)
+          return slot.handle_;
+      }
+    }
+
+    /// Add order under this key, replacing any order already indexed under it.
+    auto insert(ClientId client_id, OrderId client_order_id, OrderHandle handle) noexcept -> void {
+      if (UNLIKELY(4 * (size_ + 1) > slots_.size()))
+        grow();
+
+      for (auto index = slotIndex(client_id, client_order_id);; index = (index + 1) & mask_) {
+        auto &slot = slots_[index];
+        if (slot.handle_ == OrderHandle_INVALID) {
+          slot = {client_order_id, client_id, handle};
+          ++size_;
+          return;
+        }
+        if (slot.client_order_id_ == client_order_id && slot.client_id_ == client_id) {
+          slot.handle_ = handle;
+          return;
+        }
+      }
+    }
+
+    auto erase(ClientId client_id, OrderId client_order_id) noexcept -> void {
+      auto index = slotIndex(client_id, client_order_id);
+      for (;; index = (index + 1) & mask_) {
+        const auto &slot = slots_[index];
+        if (slot.handle_ == OrderHandle_INVALID)
+          return;
+        if (slot.client_order_id_ == client_order_id && slot.client_id_ == client_id)
+          break;
+      }
+
+      // Move back every following entry of the cluster whose home slot does not lie between the hole and itself.
+      for (auto next = (index + 1) & mask_; slots_[next].handle_ != OrderHandle_INVALID; next = (next + 1) & mask_) {
+        const auto home = slotIndex(slots_[next].client_id_, slots_[next].client_order_id_);
+        if (((next - home) & mask_) >= ((next - index) & mask_)) {
+          slots_[index] = slots_[next];
+          index = next;
+        }
+      }
+      slots_[index] = {};
+      --size_;
+    }
+
+    /// Start loading the slot an insert or find of this key starts probing at into the cache.
+    auto prefetch(ClientId client_id, OrderId client_order_id) const noexcept {
+      __builtin_prefetch(&slots_[slotIndex(client_id, client_order_id)]);
+    }
+
+    /// Make room for num_orders live orders at once, so loading that many does not double the table over and over.
+    auto reserve(size_t num_orders) noexcept -> void {
+      auto capacity = slots_.size();
+      while (4 * num_orders > capacity)
+        capacity *= 2;
+      if (capacity != slots_.size())
+        rehash(capacity);
+    }
+
+    auto size() const noexcept {
+      return size_;
+    }
+
+    auto capacity() const noexcept {
+      return slots_.size();
+    }
+
+    /// Bytes used by the table.
+    auto memoryBytes() const noexcept {
+      return slots_.size() * sizeof(Slot);
+    }
+
+    /// Deleted copy & move constructors and assignment-operators.
+    MEOrderIndex(const MEOrderIndex &) = delete;
+
+    MEOrderIndex(const MEOrderIndex &&) = delete;
+
+    MEOrderIndex &operator=(const MEOrderIndex &) = delete;
+
+    MEOrderIndex &operator=(const MEOrderIndex &&) = delete;
+
+  private:
+    struct Slot {
+      OrderId client_order_id_ = OrderId_INVALID;
+      ClientId client_id_ = ClientId_INVALID;
+      OrderHandle handle_ = OrderHandle_INVALID; // marks an empty slot.
+    };
+
+    auto slotIndex(ClientId client_id, OrderId client_order_id) const noexcept -> size_t {
+      // Client order ids are mostly small sequential numbers per client, so mix both into all bits (the splitmix64 finalizer).
+      auto hash = client_order_id ^ (static_cast<uint64_t>(client_id) << 32 | client_id);
+      hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+      hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+      return (hash ^ (hash >> 31)) & mask_;
+    }
+
+    /// Double the table and reinsert every entry, amortized over the inserts that filled it.
+    auto grow() noexcept -> void {
+      rehash(slots_.size() * 2);
+    }
+
+    auto rehash(size_t capacity) noexcept -> void {
+      std::vector<Slot> old_slots(capacity);
+      old_slots.swap(slots_);
+      mask_ = slots_.size() - 1;
+      size_ = 0;
+      for (const auto &slot: old_slots) {
+        if (slot.handle_ != OrderHandle_INVALID)
+          insert(slot.client_id_, slot.client_order_id_, slot.handle_);
+      }
+    }
+
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+  };
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "common/types.h"
+#include "common/macros.h"
+
+#include "me_order.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// The resting orders of an MEOrderBook, addressed by 32 bit OrderHandles and stored as a struct of arrays: the quantities, which
+  /// matching reads and writes for every order it trades against, are packed sixteen to a cache line apart from the MEOrder with the rest
+  /// of the fields. Also keeps the queue_ and qty_ of the MEOrdersAtPrice the orders rest at up to date. Free handles are reused last in first out,
+  /// so a new order mostly lands in a slot which is still cached. The orders linked in with linkClientOrder() are also kept on a list
+  /// per client, so all orders of a client can be found without scanning the book.
+  /// The arrays double whenever every slot is in use, up to max_capacity orders, so like MEOrderIndex their size follows the number
+  /// of live orders, and so does what a fork() of the process copies for MatchingEngine::checkpoint().
+  class MEOrderStore final {
+  public:
+    static constexpr size_t InitialCapacity = 4 * 1024;
+
+    explicit MEOrderStore(size_t max_capacity) : max_capacity_(max_capacity) {
+      client_orders_.fill(OrderHandle_INVALID);
+      ASSERT(max_capacity < OrderHandle_INVALID, "Too many orders for 32 bit handles:" + std::to_string(max_capacity));
+      grow(std::min(InitialCapacity, max_capacity));
+    }
+
+    /// Handles stay valid when the store grows, references to the orders do not.
+    auto allocate(const MEOrder &order, Qty qty) noexcept -> OrderHandle {
+      if (UNLIKELY(free_handles_.empty()))
+        grow(2 * orders_.size());
+      const auto handle = free_handles_.back();
+      free_handles_.pop_back();
+      orders_[handle] = order;
+      qty_[handle] = qty;
+      return handle;
+    }
+
+    auto deallocate(OrderHandle handle) noexcept {
+      free_handles_.push_back(handle);
+    }
+
+    auto qty(OrderHandle handle) noexcept -> Qty & {
+      return qty_[handle];
+    }
+
+    auto qty(OrderHandle handle) const noexcept {
+      return qty_[handle];
+    }
+
+    auto order(OrderHandle handle) noexcept -> MEOrder & {
+      return orders_[handle];
+    }
+
+    auto order(OrderHandle handle) const noexcept -> const MEOrder & {
+      return orders_[handle];
+    }
+
+    /// Append the order to the back of level's queue.
+    auto enqueue(MEOrdersAtPrice *level, OrderHandle handle) noexcept {
+      orders_[handle].queue_index_ = static_cast<uint32_t>(level->queue_.size());
+      level->queue_.push_back(handle);
+      ++level->num_orders_;
+      level->qty_ += qty_[handle];
+    }
+
+    /// Take qty off the order queued at level, a fill or a quantity reduction which keeps its place in the queue.
+    auto reduceQty(MEOrdersAtPrice *level, OrderHandle handle, Qty qty) noexcept {
+      qty_[handle] -= qty;
+      level->qty_ -= qty;
+    }
+
+    /// Take the order out of level's queue, which is empty afterwards if it was the last order.
+    auto dequeue(MEOrdersAtPrice *level, OrderHandle handle) noexcept {
+      auto &queue = level->queue_;
+      queue[orders_[handle].queue_index_] = OrderHandle_INVALID;
+      --level->num_orders_;
+      level->qty_ -= qty_[handle];
+
+      while (level->head_ < queue.size() && queue[level->head_] == OrderHandle_INVALID)
+        ++level->head_;
+      while (!queue.empty() && queue.back() == OrderHandle_INVALID)
+        queue.pop_back();
+      if (queue.empty())
+        level->head_ = 0;
+      else if (UNLIKELY(queue.size() > 2 * level->num_orders_ + MinCompactSize))
+        compact(level);
+    }
+
+    /// Add the order to the front of the list of its client's orders.
+    auto linkClientOrder(OrderHandle handle) noexcept {
+      auto &first = client_orders_[orders_[handle].client_id_];
+      client_links_[handle] = {OrderHandle_INVALID, first};
+      if (first != OrderHandle_INVALID)
+        client_links_[first].prev_ = handle;
+      first = handle;
+    }
+
+    auto unlinkClientOrder(OrderHandle handle) noexcept {
+      const auto &link = client_links_[handle];
+      if (link.prev_ != OrderHandle_INVALID)
+        client_links_[link.prev_].next_ = link.next_;
+      else
+        client_orders_[orders_[handle].client_id_] = link.next_;
+      if (link.next_ != OrderHandle_INVALID)
+        client_links_[link.next_].prev_ = link.prev_;
+    }
+
+    /// The first order on the list of client_id's orders, OrderHandle_INVALID if it has none.
+    auto firstClientOrder(ClientId client_id) const noexcept {
+      return client_orders_[client_id];
+    }
+
+    /// The order after handle on the list of its client's orders, OrderHandle_INVALID at the end of the list.
+    auto nextClientOrder(OrderHandle handle) const noexcept {
+      return client_links_[handle].next_;
+    }
+
+    /// Start loading the order distance places behind the front of level into the cache, so a sweep through the level finds it there.
+    auto prefetch(const MEOrdersAtPrice *level, size_t distance) const noexcept {
+      const auto index = level->head_ + distance;
+      if (index < level->queue_.size() && level->queue_[index] != OrderHandle_INVALID) {
+        __builtin_prefetch(&qty_[level->queue_[index]], 1);
+        __builtin_prefetch(&orders_[level->queue_[index]], 0);
+      }
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    MEOrderStore() = delete;
+
+    MEOrderStore(const MEOrderStore &) = delete;
+
+    MEOrderStore(const MEOrderStore &&) = delete;
+
+    MEOrderStore &operator=(const MEOrderStore &) = delete;
+
+    MEOrderStore &operator=(const MEOrderStore &&) = delete;
+
+  private:
+    /// Queues are only compacted once they are at least this long, so short queues do not get compacted on every other dequeue().
+    static constexpr size_t MinCompactSize = 16;
+
+    /// Make room for capacity orders, whose new slots are handed out lowest first.
+    auto grow(size_t capacity) noexcept -> void {
+      capacity = std::min(capacity, max_capacity_);
+      const auto old_capacity = orders_.size();
+      if (UNLIKELY(capacity == old_capacity))
+        FATAL("Order store out of space.");
+
+      qty_.resize(capacity, 0);
+      orders_.resize(capacity);
+      client_links_.resize(capacity);
+      free_handles_.reserve(capacity);
+      for (auto i = capacity; i > old_capacity; --i)
+        free_handles_.push_back(static_cast<OrderHandle>(i - 1));
+    }
+
+    /// Move the live orders of level to the front of its queue, in order.
+    auto compact(MEOrdersAtPrice *level) noexcept -> void {
+      auto &queue = level->queue_;
+      size_t live = 0;
+      for (auto i = level->head_; i < queue.size(); ++i) {
+        if (queue[i] != OrderHandle_INVALID) {
+          orders_[queue[i]].queue_index_ = static_cast<uint32_t>(live);
+          queue[live++] = queue[i];
+        }
+      }
+      queue.resize(live);
+      level->head_ = 0;
+    }
+
+    /// Links of the per client order lists, apart from the MEOrders as only mass cancels walk them.
+    struct ClientLink {
+      OrderHandle prev_ = OrderHandle_INVALID;
+      OrderHandle next_ = OrderHandle_INVALID;
+    };
+
+    size_t max_capacity_ = 0;
+    std::vector<Qty> qty_;
+    std::vector<MEOrder> orders_;
+    std::vector<ClientLink> client_links_;
+    std::array<OrderHandle, ME_MAX_NUM_CLIENTS> client_orders_;
+    std::vector<OrderHandle> free_handles_;
+  };
+}
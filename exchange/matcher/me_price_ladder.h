@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "common/types.h"
+#include "common/level_bitmap.h"
+
+#include "me_order.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// The price levels of an MEOrderBook as a dense array per side of ME_PRICE_LADDER_LEVELS consecutive prices starting at base_,
+  /// so a level is found, added and removed in O(1) by indexing with price - base_. Both sides can have a level at the same price,
+  /// which the book only does while it is crossed during a call auction. Which levels are live on either side is kept
+  /// in a LevelBitmap per side, which finds the best bid / ask and the next level behind any level with a couple of bit scans.
+  /// When a price outside the window shows up the ladder is recentered around the live levels and the new price, which is rare
+  /// and O(ME_PRICE_LADDER_LEVELS), prices further than that from the far side of the book do not fit.
+  /// Levels keep their queue_ buffers when they empty out, so once warmed up the book queues orders without allocating.
+  class MEPriceLadder final {
+  public:
+    static constexpr size_t NumLevels = ME_PRICE_LADDER_LEVELS;
+
+    /// Orders each level has room for up front.
+    static constexpr size_t ReservedQueueSize = 64;
+
+    MEPriceLadder() {
+      for (auto levels: {&bid_levels_, &ask_levels_}) {
+        for (auto &level: *levels)
+          level.queue_.reserve(ReservedQueueSize);
+      }
+    }
+
+    /// Make sure price falls inside the ladder, recentering it if needed. Returns false if the live levels and price span too many prices,
+    /// or if price is within NumLevels of either end of the Price range, which keeps the window arithmetic below from overflowing.
+    auto makeRoom(Price price) noexcept -> bool {
+      if (LIKELY(inLadder(price)))
+        return true;
+
+      if (UNLIKELY(price < std::numeric_limits<Price>::min() + static_cast<Price>(NumLevels) ||
+                   price > std::numeric_limits<Price>::max() - static_cast<Price>(NumLevels)))
+        return false;
+
+      if (bids_.empty() && asks_.empty()) {
+        base_ = price - static_cast<Price>(NumLevels / 2);
+        return true;
+      }
+
+      const auto low = std::min(price, base_ + static_cast<Price>(std::min(bids_.lowest(), asks_.lowest())));
+      auto high = price;
+      if (!bids_.empty())
+        high = std::max(high, base_ + static_cast<Price>(bids_.highest()));
+      if (!asks_.empty())
+        high = std::max(high, base_ + static_cast<Price>(asks_.highest()));
+      if (high - low >= static_cast<Price>(NumLevels))
+        return false;
+
+      // Share the slack evenly between both ends, so the ladder has room to drift either way.
+      const auto slack = static_cast<Price>(NumLevels) - 1 - (high - low);
+      recenter(high - static_cast<Price>(NumLevels - 1) + slack / 2);
+      return true;
+    }
+
+    /// Live level at price on side, nullptr if there is none.
+    auto getOrdersAtPrice(Side side, Price price) noexcept -> MEOrdersAtPrice * {
+      if (UNLIKELY(!inLadder(price)))
+        return nullptr;
+      auto &level = levels(side)[price - base_];
+      return (level.num_orders_ ? &level : nullptr);
+    }
+
+    /// Create the level at price, which must be inside the ladder and not live yet, it is live once an order is queued at it.
+    auto addOrdersAtPrice(Side side, Price price) noexcept -> MEOrdersAtPrice * {
+      const auto index = static_cast<size_t>(price - base_);
+      auto &level = levels(side)[index];
+      level.side_ = side;
+      level.price_ = price;
+      (side == Side::BUY ? bids_ : asks_).set(index);
+      return &level;
+    }
+
+    /// Drop the level at price, whose queue has to be empty by now.
+    auto removeOrdersAtPrice(Side side, Price price) noexcept -> void {
+      const auto index = static_cast<size_t>(price - base_);
+      resetLevel(levels(side)[index]);
+      (side == Side::BUY ? bids_ : asks_).clear(index);
+    }
+
+    /// Highest bid / lowest ask level, nullptr if that side of the book is empty.
+    auto bestBid() const noexcept -> const MEOrdersAtPrice * {
+      return levelAt(bid_levels_, bids_.highest());
+    }
+
+    auto bestAsk() const noexcept -> const MEOrdersAtPrice * {
+      return levelAt(ask_levels_, asks_.lowest());
+    }
+
+    auto best(Side side) const noexcept -> const MEOrdersAtPrice * {
+      return (side == Side::BUY ? bestBid() : bestAsk());
+    }
+
+    /// The best level of side to trade against or fill from.
+    auto best(Side side) noexcept -> MEOrdersAtPrice * {
+      return const_cast<MEOrdersAtPrice *>(std::as_const(*this).best(side));
+    }
+
+    /// Next less aggressive level on the same side as level, nullptr if level is the last one.
+    auto nextLevel(const MEOrdersAtPrice *level) const noexcept -> const MEOrdersAtPrice * {
+      if (level->side_ == Side::BUY)
+        return levelAt(bid_levels_, bids_.nextBelow(static_cast<size_t>(level - bid_levels_.data())));
+      return levelAt(ask_levels_, asks_.nextAbove(static_cast<size_t>(level - ask_levels_.data())));
+    }
+
+    /// Number of times the ladder had to be recentered.
+    auto recenters() const noexcept {
+      return recenters_;
+    }
+
+    /// Deleted copy & move constructors and assignment-operators.
+    MEPriceLadder(const MEPriceLadder &) = delete;
+
+    MEPriceLadder(const MEPriceLadder &&) = delete;
+
+    MEPriceLadder &operator=(const MEPriceLadder &) = delete;
+
+    MEPriceLadder &operator=(const MEPriceLadder &&) = delete;
+
+  private:
+    /// Unsigned subtraction, so any price, even one far outside the Price range makeRoom() accepts, compares without overflowing.
+    auto inLadder(Price price) const noexcept -> bool {
+      return (static_cast<uint64_t>(price) - static_cast<uint64_t>(base_) < NumLevels);
+    }
+
+    typedef std::array<MEOrdersAtPrice, NumLevels> Levels;
+
+    auto levels(Side side) noexcept -> Levels & {
+      return (side == Side::BUY ? bid_levels_ : ask_levels_);
+    }
+
+    auto levelAt(const Levels &levels, size_t index) const noexcept -> const MEOrdersAtPrice * {
+      return (index == decltype(bids_)::NotFound ? nullptr : &levels[index]);
+    }
+
+    auto resetLevel(MEOrdersAtPrice &level) noexcept -> void {
+      level.side_ = Side::INVALID;
+      level.price_ = Price_INVALID;
+      level.queue_.clear();
+      level.head_ = level.num_orders_ = 0;
+      level.qty_ = 0;
+    }
+
+    /// Move the window to start at new_base, every live level has to fall inside the new window too.
+    /// The levels are rotated rather than copied so their queues keep their buffers, the ones which wrap around are not live anyway.
+    auto recenter(Price new_base) noexcept -> void {
+      const auto shift = new_base - base_;
+      for (auto levels: {&bid_levels_, &ask_levels_}) {
+        if (shift > 0)
+          std::rotate(levels->begin(), levels->begin() + shift, levels->end());
+        else
+          std::rotate(levels->begin(), levels->end() + shift, levels->end());
+      }
+
+      base_ = new_base;
+      bids_.reset();
+      asks_.reset();
+      for (size_t i = 0; i < NumLevels; ++i) {
+        if (bid_levels_[i].num_orders_)
+          bids_.set(i);
+        if (ask_levels_[i].num_orders_)
+          asks_.set(i);
+      }
+      ++recenters_;
+    }
+
+    /// bid_levels_[i] / ask_levels_[i] hold the bids / asks at price base_ + i.
+    Price base_ = 0;
+    Levels bid_levels_, ask_levels_;
+    LevelBitmap<NumLevels> bids_, asks_;
+
+    size_t recenters_ = 0;
+  };
+}
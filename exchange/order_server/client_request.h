@@ -6,6 +6,7 @@ Aditya : Created client_request.h file
 #include<sstream>
 #include "common/types.h"
 #include "common/lf_queue.h"
+#include "common/time_utils.h"
 
 
 using namespace Common;
@@ -22,22 +23,91 @@ namespace Exchange{
    enum class ClientRequestType : uint8_t {
     INVALID = 0,
     NEW = 1,
-    CANCEL =2
+    CANCEL =2,
+    MODIFY = 3,
+    MASS_CANCEL = 4,
+    LOGON = 5,
+    HEARTBEAT = 6,
+    RESEND_REQUEST = 7
    };
    /*
    ClientRequestType enumeration to define what type of order request it is – whether it is 
-   a new order or a cancel request for an existing order.
+   a new order, a cancel request for an existing order or a cancel/replace (MODIFY) of an existing order's price and quantity.
+   A MODIFY carries the new price and the new open quantity of the order.
+   A MASS_CANCEL cancels all orders of the client, only those of ticker_id_ unless it is TickerId_INVALID and only those on side_
+   unless it is Side::INVALID. Each cancelled order gets its own CANCELED response.
+   LOGON, HEARTBEAT and RESEND_REQUEST are session requests the order server answers itself, they never reach the matching engine
+   and do not use up a sequence number, their seq_num_ is the sequence number of the next request the client will send:
+   > LOGON binds the ClientId to the connection it arrives on and makes seq_num_ the next request sequence number the order server
+     expects. order_id_ is the sequence number of the next response the client expects, the order server resends the responses from
+     there on, or none for OrderId_INVALID when the client starts a new session.
+   > HEARTBEAT keeps the session alive, the order server answers it with a HEARTBEAT of its own. A logged on client sends one at least
+     once every CLIENT_HEARTBEAT_INTERVAL it has nothing else to send.
+   > RESEND_REQUEST asks for the responses from sequence number order_id_ on to be sent again.
    */
 
    inline std::string clientRequestTypeToString(ClientRequestType type){
     switch(type){
         case ClientRequestType :: NEW : return "NEW";
         case ClientRequestType :: CANCEL : return "CANCEL";
+        case ClientRequestType :: MODIFY : return "MODIFY";
+        case ClientRequestType :: MASS_CANCEL : return "MASS_CANCEL";
+        case ClientRequestType :: LOGON : return "LOGON";
+        case ClientRequestType :: HEARTBEAT : return "HEARTBEAT";
+        case ClientRequestType :: RESEND_REQUEST : return "RESEND_REQUEST";
         case ClientRequestType :: INVALID : return "INVALID"; 
     }
     return "UNKNOWN";
    }
 
+   inline auto isSessionRequest(ClientRequestType type) noexcept {
+    return type == ClientRequestType::LOGON || type == ClientRequestType::HEARTBEAT || type == ClientRequestType::RESEND_REQUEST;
+   }
+
+   /*
+   A session nothing arrives on for CLIENT_HEARTBEAT_TIMEOUT, i.e. over which a few heartbeats in a row went missing, is half-open or its
+   peer hung. The order server disconnects such a client, which cancels its orders with LLPETM_CANCEL_ON_DISCONNECT=1, and a client
+   connects and logs on again when the exchange went silent.
+   */
+   constexpr Nanos CLIENT_HEARTBEAT_INTERVAL = NANOS_TO_SECS;
+   constexpr Nanos CLIENT_HEARTBEAT_TIMEOUT = 3 * CLIENT_HEARTBEAT_INTERVAL;
+
+   /*
+   OrderType of a NEW order request: a LIMIT order trades at its price or better, a MARKET order at any price, its price is ignored.
+   */
+   enum class OrderType : uint8_t {
+    LIMIT = 0,
+    MARKET = 1
+   };
+
+   inline std::string orderTypeToString(OrderType type){
+    switch(type){
+        case OrderType :: LIMIT : return "LIMIT";
+        case OrderType :: MARKET : return "MARKET";
+    }
+    return "UNKNOWN";
+   }
+
+   /*
+   TimeInForce of a NEW order request: a GTC order rests on the book until it is filled or cancelled, what an IOC order cannot fill
+   right away is cancelled, and a FOK order is cancelled unless it can be filled completely right away.
+   MARKET orders never rest on the book, they are IOC unless they are FOK.
+   */
+   enum class TimeInForce : uint8_t {
+    GTC = 0,
+    IOC = 1,
+    FOK = 2
+   };
+
+   inline std::string timeInForceToString(TimeInForce time_in_force){
+    switch(time_in_force){
+        case TimeInForce :: GTC : return "GTC";
+        case TimeInForce :: IOC : return "IOC";
+        case TimeInForce :: FOK : return "FOK";
+    }
+    return "UNKNOWN";
+   }
+
    struct MEClientRequest{
     ClientRequestType type_ = ClientRequestType::INVALID ;
     ClientId client_id_ = ClientId_INVALID;
@@ -46,6 +116,8 @@ namespace Exchange{
     Side side_ = Side::INVALID;
     Price price_ = Price_INVALID;
     Qty qty_ = Qty_INVALID;
+    OrderType order_type_ = OrderType::LIMIT;
+    TimeInForce time_in_force_ = TimeInForce::GTC;
     auto toString() const {
       std::stringstream ss;
       ss << "MEClientRequest"
@@ -57,6 +129,8 @@ namespace Exchange{
          << " side:" << sideToString(side_)
          << " qty:" << qtyToString(qty_)
          << " price:" << priceToString(price_)
+         << " ord_type:" << orderTypeToString(order_type_)
+         << " tif:" << timeInForceToString(time_in_force_)
          << "]";
       return ss.str();
     }
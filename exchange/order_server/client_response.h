@@ -17,14 +17,33 @@ avoid padding!
     ACCEPTED = 1,
     CANCELED = 2,
     FILLED = 3,
-    CANCEL_REJECTED = 4
+    CANCEL_REJECTED = 4,
+    REJECTED = 5,
+    MODIFIED = 6,
+    MODIFY_REJECTED = 7,
+    THROTTLED = 8,
+    SESSION_REJECTED = 9,
+    LOGGED_ON = 10,
+    HEARTBEAT = 11,
+    SEQUENCE_RESET = 12
   };
 
 /*
 A ClientResponseType enumeration to represent the type of response for
 client orders. In addition to the INVALID sentinel value, it contains 
 values that represent when a request for a new order is accepted, an order
-is canceled, an order is executed, or a cancel request is rejected by the matching engine
+is canceled, an order is executed, a cancel request is rejected, or a new order is rejected by the matching engine,
+or a modify request is carried out or rejected, or a request is rejected by the order server because the client sent it over its rate limit
+
+The rest are session responses of the order server, which do not use up a sequence number:
+  > SESSION_REJECTED echoes a request the order server did not take, because it came on a connection which does not own its ClientId
+    or with a sequence number other than the next one. market_order_id_ is the sequence number the order server expects next,
+    OrderId_INVALID for a connection which does not own the ClientId. Its seq_num_ is 0.
+  > LOGGED_ON and HEARTBEAT answer LOGON and HEARTBEAT requests, SEQUENCE_RESET tells the client the responses before seq_num_
+    it asked for are not retained anymore and cannot be resent. Their seq_num_ is the sequence number of the next response
+    the order server sends the client, so a client learns of responses it missed at the end of the stream too.
+    The market_order_id_ of LOGGED_ON is the request sequence number the order server expected before the LOGON, the requests
+    from there up to the one the LOGON carries never made it, e.g. because they were still in flight when the connection went away.
 */
   inline std::string clientResponseTypeToString(ClientResponseType type) {
     switch (type) {
@@ -36,12 +55,32 @@ is canceled, an order is executed, or a cancel request is rejected by the matchi
         return "FILLED";
       case ClientResponseType::CANCEL_REJECTED:
         return "CANCEL_REJECTED";
+      case ClientResponseType::REJECTED:
+        return "REJECTED";
+      case ClientResponseType::MODIFIED:
+        return "MODIFIED";
+      case ClientResponseType::MODIFY_REJECTED:
+        return "MODIFY_REJECTED";
+      case ClientResponseType::THROTTLED:
+        return "THROTTLED";
+      case ClientResponseType::SESSION_REJECTED:
+        return "SESSION_REJECTED";
+      case ClientResponseType::LOGGED_ON:
+        return "LOGGED_ON";
+      case ClientResponseType::HEARTBEAT:
+        return "HEARTBEAT";
+      case ClientResponseType::SEQUENCE_RESET:
+        return "SEQUENCE_RESET";
       case ClientResponseType::INVALID:
         return "INVALID";
     }
     return "UNKNOWN";
   }
 
+  inline auto isSessionResponse(ClientResponseType type) noexcept {
+    return type >= ClientResponseType::SESSION_REJECTED;
+  }
+
   struct MEClientResponse {
     ClientResponseType type_ = ClientResponseType::INVALID;
     ClientId client_id_ = ClientId_INVALID;
@@ -92,4 +131,7 @@ that the market participants will use to receive and process order responses in.
 #pragma pack(pop)
 
   typedef LFQueue<MEClientResponse> ClientResponseLFQueue;
+
+  /// Sequenced responses routed to the network thread of a multi-threaded OrderServer which owns the client's connection.
+  typedef LFQueue<OMClientResponse> OMClientResponseLFQueue;
 }
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+
+#include "common/macros.h"
+#include "common/types.h"
+
+#include "order_server/client_request.h"
+#include "order_server/client_response.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// Number of the latest responses of every client the order server retains to resend, a client which misses more than these,
+  /// e.g. during a fill storm while it is disconnected, gets a SEQUENCE_RESET past the ones it lost.
+  constexpr size_t ORDER_SESSION_RETAINED_RESPONSES = 16 * 1024;
+  static_assert(!(ORDER_SESSION_RETAINED_RESPONSES & (ORDER_SESSION_RETAINED_RESPONSES - 1)),
+                "ORDER_SESSION_RETAINED_RESPONSES must be a power of 2.");
+
+  /// Session requests the network threads of a multi-threaded OrderServer pass on to the OrderServer thread to answer, the seq_num_ of
+  /// a LOGON being the request sequence number expected before it.
+  typedef LFQueue<OMClientRequest> OMClientRequestLFQueue;
+
+  /// Session response of the order server to client_id, seq_num_ being the sequence number of the next response it sends the client.
+  inline auto sessionResponse(ClientResponseType type, ClientId client_id, size_t next_seq_num) noexcept -> OMClientResponse {
+    return {next_seq_num, {type, client_id, TickerId_INVALID, OrderId_INVALID, OrderId_INVALID, Side::INVALID, Price_INVALID, 0, 0}};
+  }
+
+  /// Take a LOGON of a client whose next request was expected to have sequence number next_exp_seq_num: from now on the next one is
+  /// expected to have that of the LOGON. Returns the session request the LOGON is answered from, carrying the sequence number expected
+  /// before it. Only the thread serving the client's connection or session touches next_exp_seq_num, in a single place for both the
+  /// copy and the reset, whichever thread answers the LOGON only sees the copy.
+  inline auto acceptLogon(const OMClientRequest &logon, size_t &next_exp_seq_num) noexcept -> OMClientRequest {
+    const OMClientRequest session_request{next_exp_seq_num, logon.me_client_request_};
+    next_exp_seq_num = logon.seq_num_;
+    return session_request;
+  }
+
+  /// Response to a request the order server did not take, with the request sequence number it expects next, OrderId_INVALID if the
+  /// client is not logged on over the connection or session the request came on. It echoes the request, the quantity as leaves_qty_.
+  inline auto sessionRejectedResponse(const MEClientRequest &request, size_t next_exp_seq_num) noexcept -> OMClientResponse {
+    return {0, {ClientResponseType::SESSION_REJECTED, request.client_id_, request.ticker_id_, request.order_id_, next_exp_seq_num,
+                request.side_, request.price_, 0, request.qty_}};
+  }
+
+  /// The latest responses sent to a client, by sequence number. Its memory is only allocated with the first response of the client.
+  class RetainedResponses {
+  public:
+    /// Retain response, the next one of the client after those retained already.
+    auto add(const OMClientResponse &response) noexcept {
+      if (UNLIKELY(responses_.empty()))
+        responses_.resize(ORDER_SESSION_RETAINED_RESPONSES);
+
+      responses_[response.seq_num_ & (ORDER_SESSION_RETAINED_RESPONSES - 1)] = response;
+      next_seq_num_ = response.seq_num_ + 1;
+    }
+
+    /// Sequence numbers of the oldest response retained and of the one after the latest.
+    auto first() const noexcept {
+      return next_seq_num_ > ORDER_SESSION_RETAINED_RESPONSES ? next_seq_num_ - ORDER_SESSION_RETAINED_RESPONSES : 1;
+    }
+
+    auto next() const noexcept {
+      return next_seq_num_;
+    }
+
+    /// Response with sequence number seq_num, which has to be in [first(), next()).
+    auto at(size_t seq_num) const noexcept -> const OMClientResponse & {
+      return responses_[seq_num & (ORDER_SESSION_RETAINED_RESPONSES - 1)];
+    }
+
+  private:
+    std::vector<OMClientResponse> responses_;
+    size_t next_seq_num_ = 1;
+  };
+}
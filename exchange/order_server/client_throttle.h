@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <sstream>
+
+#include "common/macros.h"
+#include "common/time_utils.h"
+#include "common/types.h"
+
+#include "order_server/client_request.h"
+#include "order_server/client_response.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// Per client message rate limit: a client may send burst_ requests at once and rate_ requests per second on average.
+  struct ThrottleConfig {
+    double rate_ = 0;
+    double burst_ = 0;
+
+    auto enabled() const noexcept {
+      return rate_ > 0;
+    }
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "ThrottleConfig[rate:" << rate_ << "/s burst:" << burst_ << "]";
+      return ss.str();
+    }
+  };
+
+  /// Throttle from the LLPETM_THROTTLE environment variable, "rate[:burst]" in requests per second, the burst defaulting to a second's
+  /// worth of requests. Clients are not throttled if it is not set.
+  inline auto throttleConfigFromEnv() -> ThrottleConfig {
+    const auto value = getenv("LLPETM_THROTTLE");
+    if (!value)
+      return {};
+
+    char *end = nullptr;
+    ThrottleConfig config{strtod(value, &end), 0};
+    config.burst_ = (*end == ':' ? strtod(end + 1, nullptr) : config.rate_);
+    ASSERT(!config.enabled() || config.burst_ >= 1, "LLPETM_THROTTLE burst has to allow at least one request:" + std::string(value));
+    return config;
+  }
+
+  /// Response to a request the order server rejected because the client sent it over its rate limit, the request never reaches the
+  /// matching engine. It echoes the request, the quantity as leaves_qty_.
+  inline auto throttledResponse(const MEClientRequest &request) noexcept -> MEClientResponse {
+    return {ClientResponseType::THROTTLED, request.client_id_, request.ticker_id_, request.order_id_, OrderId_INVALID, request.side_,
+            request.price_, 0, request.qty_};
+  }
+
+  /// Token bucket of every ClientId. The bucket of a client is only used by the thread serving the client, the counters can be read
+  /// from any thread.
+  class ClientThrottles {
+  public:
+    struct Counters {
+      std::atomic<uint64_t> allowed_ = 0;
+      std::atomic<uint64_t> throttled_ = 0;
+      /// Throttled requests which got no THROTTLED response, because a flood of them filled the queue of those.
+      std::atomic<uint64_t> unanswered_ = 0;
+    };
+
+    explicit ClientThrottles(const ThrottleConfig &config) : config_(config) {
+      for (auto &bucket: buckets_)
+        bucket.tokens_ = config_.burst_;
+    }
+
+    auto enabled() const noexcept {
+      return config_.enabled();
+    }
+
+    /// Take a token from the bucket of client_id for a request received at now, false if there is none and the request is throttled.
+    auto allow(ClientId client_id, Nanos now) noexcept {
+      auto &bucket = buckets_.at(client_id);
+      if (LIKELY(now > bucket.last_time_)) {
+        bucket.tokens_ = std::min(config_.burst_, bucket.tokens_ + static_cast<double>(now - bucket.last_time_) * config_.rate_ / NANOS_TO_SECS);
+        bucket.last_time_ = now;
+      }
+
+      auto &counters = counters_.at(client_id);
+      if (LIKELY(bucket.tokens_ >= 1)) {
+        bucket.tokens_ -= 1;
+        counters.allowed_.store(counters.allowed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+      }
+      counters.throttled_.store(counters.throttled_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    /// Count a throttled request of client_id whose THROTTLED response is dropped.
+    auto unanswered(ClientId client_id) noexcept {
+      auto &counters = counters_.at(client_id);
+      counters.unanswered_.store(counters.unanswered_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    auto counters(ClientId client_id) const noexcept -> const Counters & {
+      return counters_.at(client_id);
+    }
+
+    /// Counters of the clients which have been throttled, allowed/throttled/unanswered.
+    auto toString() const {
+      std::stringstream ss;
+      ss << "ClientThrottles[" << config_.toString();
+      for (size_t client_id = 0; client_id < counters_.size(); ++client_id) {
+        if (counters_[client_id].throttled_.load(std::memory_order_relaxed))
+          ss << " " << client_id << ":" << counters_[client_id].allowed_.load(std::memory_order_relaxed) << "/"
+             << counters_[client_id].throttled_.load(std::memory_order_relaxed) << "/" << counters_[client_id].unanswered_.load(std::memory_order_relaxed);
+      }
+      ss << "]";
+      return ss.str();
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    ClientThrottles() = delete;
+
+    ClientThrottles(const ClientThrottles &) = delete;
+
+    ClientThrottles(const ClientThrottles &&) = delete;
+
+    ClientThrottles &operator=(const ClientThrottles &) = delete;
+
+    ClientThrottles &operator=(const ClientThrottles &&) = delete;
+
+  private:
+    struct Bucket {
+      double tokens_ = 0;
+      Nanos last_time_ = 0;
+    };
+
+    const ThrottleConfig config_;
+    std::array<Bucket, ME_MAX_NUM_CLIENTS> buckets_;
+    std::array<Counters, ME_MAX_NUM_CLIENTS> counters_;
+  };
+}
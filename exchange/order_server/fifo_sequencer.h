@@ -70,53 +70,122 @@
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 #include "common/thread_utils.h"
 #include "common/macros.h"
 
 #include "order_server/client_request.h"
 
 namespace Exchange {
-  /// Maximum number of unprocessed client request messages across all TCP connections in the order server / FIFO sequencer.
-  constexpr size_t ME_MAX_PENDING_REQUESTS = 1024;
+  /// Expected number of connections and shared memory sessions read from in one round, every one of them is at least one run.
+  constexpr size_t ME_MAX_PENDING_RUNS = 2 * ME_MAX_NUM_CLIENTS;
+
+  /// A structure that encapsulates the kernel software receive time (nanosecond SO_TIMESTAMPING) as well as the client request.
+  struct RecvTimeClientRequest {
+    Nanos recv_time_ = 0;
+    MEClientRequest request_;
+  };
+
+  /// Requests the network threads of a multi-threaded OrderServer read and timestamped, for the sequencing thread to merge.
+  typedef LFQueue<RecvTimeClientRequest> RecvTimeClientRequestLFQueue;
 
   class FIFOSequencer {
   public:
-    FIFOSequencer(ClientRequestLFQueue *client_requests, Logger *logger)
-        : incoming_requests_(client_requests), logger_(logger) {
+    /// client_requests holds one queue per matching engine shard, requests are routed to the shard owning their ticker, see tickerToShard().
+    /// As many requests can be pending as the smallest queue holds, so they all fit into the queues once the shards caught up, the last
+    /// ME_MAX_NUM_CLIENTS of them kept for the MASS_CANCELs of clients which disconnect while hasRoom() is false.
+    FIFOSequencer(const std::vector<ClientRequestLFQueue *> &client_requests, Logger *logger)
+        : incoming_requests_(client_requests), logger_(logger), pending_per_shard_(client_requests.size(), 0) {
+      ASSERT(!incoming_requests_.empty(), "FIFOSequencer needs at least one client request queue.");
+      auto capacity = incoming_requests_.front()->capacity();
+      for (auto incoming_requests: incoming_requests_)
+        capacity = std::min(capacity, incoming_requests->capacity());
+      ASSERT(capacity > ME_MAX_NUM_CLIENTS, "FIFOSequencer needs client request queues larger than ME_MAX_NUM_CLIENTS.");
+      pending_client_requests_.resize(capacity);
+      max_pending_ = capacity - ME_MAX_NUM_CLIENTS;
+      runs_.reserve(ME_MAX_PENDING_RUNS);
     }
 
     ~FIFOSequencer() {
     }
 
+    /// Whether another client request can be queued. While it cannot, because a shard fell behind and its queue has no room for what
+    /// is pending, callers take no more requests from their clients, or reject them, MASS_CANCELs excepted.
+    auto hasRoom() const noexcept -> bool {
+      return pending_size_ < max_pending_;
+    }
+
     /// Queue up a client request, not processed immediately, processed when sequenceAndPublish() is called.
+    /// Requests read from one connection or session come in receive time order, so they extend the current run, a request received
+    /// before the one queued last starts a new run.
     auto addClientRequest(Nanos rx_time, const MEClientRequest &request) {
-      if (pending_size_ >= pending_client_requests_.size()) {
-        FATAL("Too many pending requests");
+      if (UNLIKELY(pending_size_ == pending_client_requests_.size())) { // only MASS_CANCELs get past hasRoom(), do not lose one.
+        logger_->log("%:% %() % Pending requests full at %, growing them for %\n", __FILE__, __LINE__, __FUNCTION__,
+                     Common::getCurrentTimeStr(&time_str_), pending_size_, request.toString());
+        pending_client_requests_.resize(pending_client_requests_.size() + ME_MAX_NUM_CLIENTS);
+      }
+
+      if (!pending_size_ || rx_time < pending_client_requests_[pending_size_ - 1].recv_time_)
+        runs_.push_back({rx_time, pending_size_, pending_size_});
+      pending_client_requests_[pending_size_++] = {rx_time, request};
+      ++runs_.back().end_;
+
+      if (UNLIKELY(isMassCancelAll(request))) {
+        for (auto &pending: pending_per_shard_)
+          ++pending;
+      } else {
+        ++pending_per_shard_[tickerToShard(request.ticker_id_, incoming_requests_.size())];
       }
-      pending_client_requests_.at(pending_size_++) = std::move(RecvTimeClientRequest{rx_time, request});
     }
 
-    /// Sort pending client requests in ascending receive time order and then write them to the lock free queue for the matching engine to consume from.
-    auto sequenceAndPublish() {
+    /// Merge the runs of pending client requests in ascending receive time order and then write them to the lock free queues for the matching
+    /// engine shards to consume from, so each shard sees the requests for its tickers in receive time order.
+    /// Requests with the same receive time are published in the order they were queued, e.g. those read from a connection in one go.
+    /// Nothing is published until every shard's queue has room for its pending requests, they stay pending instead of overwriting
+    /// requests the shard has not read yet.
+    auto sequenceAndPublish() -> void {
       if (UNLIKELY(!pending_size_))
         return;
 
-      logger_->log("%:% %() % Processing % requests.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), pending_size_);
-
-      std::sort(pending_client_requests_.begin(), pending_client_requests_.begin() + pending_size_);
-
-      for (size_t i = 0; i < pending_size_; ++i) {
-        const auto &client_request = pending_client_requests_.at(i);
-
-        logger_->log("%:% %() % Writing RX:% Req:% to FIFO.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
-                     client_request.recv_time_, client_request.request_.toString());
-
-        auto next_write = incoming_requests_->getNextToWriteTo();
-        *next_write = std::move(client_request.request_);
-        incoming_requests_->updateWriteIndex();
+      for (size_t shard = 0; shard < incoming_requests_.size(); ++shard) {
+        const auto incoming_requests = incoming_requests_[shard];
+        if (UNLIKELY(incoming_requests->size() + pending_per_shard_[shard] > incoming_requests->capacity())) {
+          if (!blocked_)
+            logger_->log("%:% %() % Holding back % pending requests, shard % has % of % queued.\n", __FILE__, __LINE__, __FUNCTION__,
+                         Common::getCurrentTimeStr(&time_str_), pending_size_, shard, incoming_requests->size(), incoming_requests->capacity());
+          blocked_ = true;
+          return;
+        }
+      }
+      blocked_ = false;
+
+      logger_->log("%:% %() % Processing % requests in % runs.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   pending_size_, runs_.size());
+
+      if (LIKELY(runs_.size() == 1)) {
+        for (size_t i = 0; i < pending_size_; ++i)
+          publish(pending_client_requests_[i]);
+      } else {
+        // Min heap of the runs by the receive time of their next request, ties broken by queue order, O(n log k) for k runs.
+        std::make_heap(runs_.begin(), runs_.end());
+        while (!runs_.empty()) {
+          std::pop_heap(runs_.begin(), runs_.end());
+          auto &run = runs_.back();
+          publish(pending_client_requests_[run.next_++]);
+          if (run.next_ == run.end_) {
+            runs_.pop_back();
+          } else {
+            run.recv_time_ = pending_client_requests_[run.next_].recv_time_;
+            std::push_heap(runs_.begin(), runs_.end());
+          }
+        }
       }
 
+      runs_.clear();
       pending_size_ = 0;
+      std::fill(pending_per_shard_.begin(), pending_per_shard_.end(), 0);
     }
 
     /// Deleted default, copy & move constructors and assignment-operators.
@@ -131,24 +200,57 @@ namespace Exchange {
     FIFOSequencer &operator=(const FIFOSequencer &&) = delete;
 
   private:
-    /// Lock free queue used to publish client requests to, so that the matching engine can consume them.
-    ClientRequestLFQueue *incoming_requests_ = nullptr;
-
-    std::string time_str_;
-    Logger *logger_ = nullptr;
-
-    /// A structure that encapsulates the software receive time as well as the client request.
-    struct RecvTimeClientRequest {
+    /// Pending requests [next_, end_) in receive time order, recv_time_ is that of the request at next_.
+    struct PendingRun {
       Nanos recv_time_ = 0;
-      MEClientRequest request_;
+      size_t next_ = 0;
+      size_t end_ = 0;
 
-      auto operator<(const RecvTimeClientRequest &rhs) const {
-        return (recv_time_ < rhs.recv_time_);
+      /// Reversed, so the std heap algorithms keep the earliest request on top.
+      auto operator<(const PendingRun &rhs) const {
+        return (recv_time_ > rhs.recv_time_ || (recv_time_ == rhs.recv_time_ && next_ > rhs.next_));
       }
     };
 
-    /// Queue of pending client requests, not sorted.
-    std::array<RecvTimeClientRequest, ME_MAX_PENDING_REQUESTS> pending_client_requests_;
+    /// A MASS_CANCEL of the client's orders for every ticker, which goes to every shard.
+    static auto isMassCancelAll(const MEClientRequest &request) noexcept -> bool {
+      return (request.type_ == ClientRequestType::MASS_CANCEL && request.ticker_id_ == TickerId_INVALID);
+    }
+
+    /// Write the request into the next slot of the queue of the shard owning its ticker, sequenceAndPublish() made sure it has room.
+    auto publish(const RecvTimeClientRequest &client_request) noexcept -> void {
+      logger_->log("%:% %() % Writing RX:% Req:% to FIFO.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   client_request.recv_time_, client_request.request_.toString());
+
+      if (UNLIKELY(isMassCancelAll(client_request.request_))) {
+        for (auto incoming_requests: incoming_requests_) { // the client can have orders for the tickers of every shard.
+          *incoming_requests->getNextToWriteTo() = client_request.request_;
+          incoming_requests->updateWriteIndex();
+        }
+        return;
+      }
+
+      auto incoming_requests = incoming_requests_[tickerToShard(client_request.request_.ticker_id_, incoming_requests_.size())];
+      *incoming_requests->getNextToWriteTo() = client_request.request_;
+      incoming_requests->updateWriteIndex();
+    }
+
+    /// Lock free queues, one per matching engine shard, used to publish client requests to, so that the matching engine can consume them.
+    std::vector<ClientRequestLFQueue *> incoming_requests_;
+
+    std::string time_str_;
+    Logger *logger_ = nullptr;
+
+    /// Pending client requests in the order they were queued, a sequence of runs each in receive time order.
+    /// As large as the request queues, so kept out of the matching engine's checkpoint forks like they are.
+    std::vector<RecvTimeClientRequest, NoForkAllocator<RecvTimeClientRequest>> pending_client_requests_;
     size_t pending_size_ = 0;
+    size_t max_pending_ = 0;
+
+    /// Number of pending requests for each shard, and whether sequenceAndPublish() is holding them back for a shard to catch up.
+    std::vector<size_t> pending_per_shard_;
+    bool blocked_ = false;
+
+    std::vector<PendingRun> runs_;
   };
-}
\ No newline at end of file
+}
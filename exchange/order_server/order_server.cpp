@@ -9,18 +9,43 @@ It also accepts a network interface and port to use that the order gateway serve
 */
 
 namespace Exchange {
-  OrderServer::OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, const std::string &iface, int port)
-      : iface_(iface), port_(port), outgoing_responses_(client_responses), logger_("exchange_order_server.log"),
-        tcp_server_(logger_), fifo_sequencer_(client_requests, &logger_) {
+  OrderServer::OrderServer(const std::vector<ClientRequestLFQueue *> &client_requests, const std::vector<ClientResponseLFQueue *> &client_responses,
+                           const std::string &iface, int port, Common::TCPServerBackend backend, Common::TransportType transport,
+                           bool cancel_on_disconnect, size_t num_network_threads, const ThrottleConfig &throttle_config)
+      : iface_(iface), port_(port), outgoing_responses_(client_responses), logger_("exchange_order_server.log"), cancel_on_disconnect_(cancel_on_disconnect),
+        throttles_(throttle_config), throttle_rejects_(throttles_.enabled() ? ME_MAX_CLIENT_UPDATES : 1), tcp_server_(logger_, backend), fifo_sequencer_(client_requests, &logger_) {
     cid_next_outgoing_seq_num_.fill(1);
     cid_next_exp_seq_num_.fill(1);
     cid_tcp_socket_.fill(nullptr);
+    shm_logged_on_.fill(0);
+    cid_shm_attachment_.fill(0);
+    cid_last_recv_time_.fill(0);
 
     /*  set the two callback members, recv_callback_ and recv_finished_callback_,
     to point to the recvCallback() and recvFinishedCallback() member functions. */
         
     tcp_server_.recv_callback_ = [this](auto socket, auto rx_time) { recvCallback(socket, rx_time); };
     tcp_server_.recv_finished_callback_ = [this]() { recvFinishedCallback(); };
+    tcp_server_.disconnect_callback_ = [this](auto socket) { disconnectCallback(socket); };
+    tcp_server_.zerocopy_threshold_ = ORDER_SERVER_ZEROCOPY_THRESHOLD;
+
+    for (size_t i = 0; i < num_network_threads; ++i)
+      network_threads_.push_back(std::make_unique<OrderServerThread>(static_cast<int>(i), backend, cancel_on_disconnect, &cid_network_thread_,
+                                                                     &cid_next_exp_seq_num_, &throttles_));
+    for (auto &network_thread: cid_network_thread_)
+      network_thread = -1;
+
+    // Throttled requests are answered by this thread and the network threads, run() sends them along with the matching engine's responses.
+    if (throttles_.enabled()) {
+      outgoing_responses_.push_back(&throttle_rejects_);
+      for (auto &network_thread: network_threads_)
+        outgoing_responses_.push_back(network_thread->throttleRejects());
+    }
+
+    if (transport == Common::TransportType::SHM) {
+      shm_segment_ = std::make_unique<Common::ShmSegment>(SHM_ORDER_SESSIONS_NAME, sizeof(ShmOrderSessions), true);
+      shm_sessions_ = shm_segment_->as<ShmOrderSessions>();
+    }
   }
 
   OrderServer::~OrderServer() {
@@ -38,7 +63,12 @@ We also initialize the TCPServer member object to start listening
 on the interface and port that OrderServer was provided in the constructor. */
   auto OrderServer::start() -> void {
     run_ = true;
-    tcp_server_.listen(iface_, port_);
+    if (network_threads_.empty()) {
+      tcp_server_.listen(iface_, port_);
+    } else {
+      for (auto &network_thread: network_threads_)
+        network_thread->start(iface_, port_);
+    }
 
     ASSERT(Common::createAndStartThread(-1, "Exchange/OrderServer", [this]() { run(); }) != nullptr, "Failed to start OrderServer thread.");
   }
@@ -46,6 +76,8 @@ on the interface and port that OrderServer was provided in the constructor. */
 /* stop() method will cause the run() method to finish execution */
   auto OrderServer::stop() -> void {
     run_ = false;
+    for (auto &network_thread: network_threads_)
+      network_thread->stop();
   }
 
   
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "common/thread_utils.h"
 #include "common/macros.h"
@@ -8,16 +10,36 @@
 
 #include "order_server/client_request.h"
 #include "order_server/client_response.h"
+#include "order_server/client_session.h"
+#include "order_server/client_throttle.h"
 #include "order_server/fifo_sequencer.h"
+#include "order_server/order_server_thread.h"
+#include "order_server/shm_order_sessions.h"
 
 namespace Exchange {
+  /* A client with more than this many bytes of responses queued on its connection is not keeping up with them. It is disconnected
+     rather than letting its queue grow until responses have to be dropped, which it would only notice as a gap in its sequence numbers. */
+  constexpr size_t ORDER_SERVER_MAX_QUEUED_BYTES = 4 * 1024 * 1024;
+
+  /* Flushes of at least this many bytes of responses, i.e. fill storms, are sent with MSG_ZEROCOPY by the epoll backend.
+     Below this pinning pages and reaping completions costs more than the copy, see benchmarks/zerocopy_benchmark. */
+  constexpr size_t ORDER_SERVER_ZEROCOPY_THRESHOLD = 64 * 1024;
+
+  /* Whether the orders of a client are cancelled when its connection goes away, from the LLPETM_CANCEL_ON_DISCONNECT environment
+     variable, off unless it is set to 1. */
+  inline auto cancelOnDisconnectFromEnv() -> bool {
+    const auto value = getenv("LLPETM_CANCEL_ON_DISCONNECT");
+    return (value && std::string(value) == "1");
+  }
+
   class OrderServer {
   private:
     const std::string iface_;
     const int port_ = 0;
 
-    /* Lock free queue of outgoing client responses to be sent out to connected clients. */
-    ClientResponseLFQueue *outgoing_responses_ = nullptr;
+    /* Lock free queues of outgoing client responses to be sent out to connected clients, one per matching engine shard,
+       followed with throttling by those of the requests rejected by this thread and the network threads. */
+    std::vector<ClientResponseLFQueue *> outgoing_responses_;
 
     volatile bool run_ = false;
 
@@ -27,12 +49,29 @@ namespace Exchange {
     /* Hash map from ClientId -> the next sequence number to be sent on outgoing client responses. */
     std::array<size_t, ME_MAX_NUM_CLIENTS> cid_next_outgoing_seq_num_;
 
-    /* Hash map from ClientId -> the next sequence number expected on incoming client requests. */
+    /* Hash map from ClientId -> the next sequence number expected on incoming client requests. A client is logged on over one connection or
+       shared memory session at a time, and only the thread serving that one touches its entry. */
     std::array<size_t, ME_MAX_NUM_CLIENTS> cid_next_exp_seq_num_;
 
+    /* Hash map from ClientId -> the latest responses sent to the client, to resend those it missed. */
+    std::array<RetainedResponses, ME_MAX_NUM_CLIENTS> retained_responses_;
+
     /* Hash map from ClientId -> TCP socket / client connection. */
     std::array<Common::TCPSocket *, ME_MAX_NUM_CLIENTS> cid_tcp_socket_;
 
+    /* Hash map from ClientId -> when a request of the client last arrived over the connection or shared memory session it is logged on
+       over, and when run() next looks for clients which went silent. */
+    std::array<Nanos, ME_MAX_NUM_CLIENTS> cid_last_recv_time_;
+    Nanos next_liveness_check_time_ = 0;
+
+    /* Mass cancel the orders of a client whose connection or shared memory session went away. */
+    const bool cancel_on_disconnect_ = false;
+
+    /* Per client rate limits, requests over them are answered with ClientResponseType::THROTTLED through throttle_rejects_,
+       which run() sends in sequence with the client's other responses. */
+    ClientThrottles throttles_;
+    ClientResponseLFQueue throttle_rejects_;
+
     /* 
       TCP server instance listening for new client connections. 
      tcp_server_ variable, which is an instance of the Common::TCPServer class, 
@@ -48,9 +87,38 @@ namespace Exchange {
   is responsible for making sure that client requests that come in on different
   TCP connections are processed in the correct order in which they cam */
     FIFOSequencer fifo_sequencer_;
+
+    /* Shared memory order sessions for co-located clients, only created with TransportType::SHM. TCP clients are served either way. */
+    std::unique_ptr<Common::ShmSegment> shm_segment_;
+    ShmOrderSessions *shm_sessions_ = nullptr;
+
+    /* Bitmap of the clients logged on over their shared memory session, and hash map from ClientId -> the attachment of the session
+       they logged on over, requests of a later attachment are rejected until it logs on too. */
+    std::array<uint64_t, (ME_MAX_NUM_CLIENTS + 63) / 64> shm_logged_on_;
+    std::array<uint64_t, ME_MAX_NUM_CLIENTS> cid_shm_attachment_;
+
+    /* Network threads owning the TCP connections, if there are any this thread only sequences their requests and routes them the responses
+       of their clients, instead of serving the TCP connections itself. */
+    std::vector<std::unique_ptr<OrderServerThread>> network_threads_;
+
+    /* Hash map from ClientId -> index of the network thread owning its connection, -1 if none, CLIENT_THREAD_SHM if this thread serves it
+       over its shared memory session. */
+    ClientThreadMap cid_network_thread_;
   
 public:
-    OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, const std::string &iface, int port);
+    /* backend selects how the TCPServer waits for connections and data, IO_URING falls back to EPOLL when the kernel does not support it.
+       transport SHM additionally serves clients over shared memory order sessions.
+       client_requests and client_responses hold one queue per matching engine shard, in shard order.
+       cancel_on_disconnect mass cancels the orders of a client when its TCP connection or shared memory session goes away, including slow
+       consumers disconnected by run() and clients silent for CLIENT_HEARTBEAT_TIMEOUT.
+       num_network_threads other than 0 serves the TCP connections from that many OrderServerThreads, so sending responses to some clients
+       does not hold up reading the requests of others, this thread then merges their requests by receive time.
+       throttle_config limits the rate of requests of every client, the matching engine never sees the requests over it. */
+    OrderServer(const std::vector<ClientRequestLFQueue *> &client_requests, const std::vector<ClientResponseLFQueue *> &client_responses,
+                const std::string &iface, int port,
+                Common::TCPServerBackend backend = Common::TCPServerBackend::EPOLL,
+                Common::TransportType transport = Common::TransportType::SOCKET, bool cancel_on_disconnect = false,
+                size_t num_network_threads = 0, const ThrottleConfig &throttle_config = {});
 
     ~OrderServer();
 
@@ -59,6 +127,15 @@ public:
 
     auto stop() -> void;
 
+    /* Number of requests of a client let through, throttled and throttled without a response, can be read from any thread. */
+    auto throttleCounters(ClientId client_id) const noexcept -> const ClientThrottles::Counters & {
+      return throttles_.counters(client_id);
+    }
+
+    auto throttlesToString() const {
+      return throttles_.toString();
+    }
+
     /* Main run loop for this thread - accepts new client connections, receives client requests from them and sends client responses to them. */
 
 /* (book) A Boolean run_ variable, which will be used to start and stop the OrderServer thread.
@@ -80,28 +157,158 @@ The run() method performs the following two main tasks:
     auto run() noexcept {
       logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
       while (run_) {
-        tcp_server_.poll();
+        if (network_threads_.empty())
+          tcp_server_.poll();
 
-        tcp_server_.sendAndRecv();
+        const auto now = getCurrentNanos();
+        if (UNLIKELY(now >= next_liveness_check_time_))
+          disconnectSilentClients(now);
 
-        for (auto client_response = outgoing_responses_->getNextToRead(); outgoing_responses_->size() && client_response; client_response = outgoing_responses_->getNextToRead()) {
-          auto &next_outgoing_seq_num = cid_next_outgoing_seq_num_[client_response->client_id_];
-          logger_.log("%:% %() % Processing cid:% seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
-                      client_response->client_id_, next_outgoing_seq_num, client_response->toString());
+        if (shm_sessions_) // queued into the FIFO sequencer along with the requests read from TCP connections below.
+          recvShmRequests();
 
-          ASSERT(cid_tcp_socket_[client_response->client_id_] != nullptr,
-                 "Dont have a TCPSocket for ClientId:" + std::to_string(client_response->client_id_));
-          cid_tcp_socket_[client_response->client_id_]->send(&next_outgoing_seq_num, sizeof(next_outgoing_seq_num));
-          cid_tcp_socket_[client_response->client_id_]->send(client_response, sizeof(MEClientResponse));
+        if (network_threads_.empty())
+          tcp_server_.sendAndRecv();
+        else
+          recvNetworkThreadRequests();
 
-          outgoing_responses_->updateReadIndex();
+        // Publishes shared memory requests and the mass cancels of disconnected clients when there was nothing to read from the TCP connections.
+        fifo_sequencer_.sequenceAndPublish();
 
-          ++next_outgoing_seq_num;
+        // Each shard's responses are sent in the order it wrote them, so those to the requests of a client for one ticker stay in order.
+        // Only what a queue held when we got to it is sent, so a shard in the middle of a fill storm does not hold back the others.
+        for (auto outgoing_responses: outgoing_responses_) {
+          for (auto pending = outgoing_responses->size(); pending; --pending) {
+            const auto client_response = outgoing_responses->getNextToRead();
+            auto &next_outgoing_seq_num = cid_next_outgoing_seq_num_[client_response->client_id_];
+            logger_.log("%:% %() % Processing cid:% seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                        client_response->client_id_, next_outgoing_seq_num, client_response->toString());
+
+            // Retained whether or not it can be sent right now, so a client can have it resent after a gap or when it logs on again.
+            const OMClientResponse response{next_outgoing_seq_num, *client_response};
+            retained_responses_[client_response->client_id_].add(response);
+            sendClientResponse(response);
+
+            outgoing_responses->updateReadIndex();
+
+            ++next_outgoing_seq_num;
+          }
         }
       }
     }
 
-    /* Read client request from the TCP receive buffer, check for sequence gaps and forward it to the FIFO sequencer. */
+    /* Send a response to its client over whichever connection, network thread or shared memory session the client is on. */
+    auto sendClientResponse(const OMClientResponse &response) noexcept -> void {
+      const auto client_id = response.me_client_response_.client_id_;
+      auto socket = cid_tcp_socket_[client_id];
+      if (UNLIKELY(socket != nullptr && socket->outboundQueuedBytes() + sizeof(OMClientResponse) > ORDER_SERVER_MAX_QUEUED_BYTES)) {
+        logger_.log("%:% %() % Slow consumer, disconnecting ClientId:% socket:% queued:% partial_sends:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id, socket->socket_fd_, socket->outboundQueuedBytes(), socket->partial_sends_);
+        tcp_server_.disconnectSocket(socket); // disconnectCallback() forgets the socket, so this and later responses are dropped below.
+        socket = nullptr;
+      }
+
+      const auto network_thread = (network_threads_.empty() ? -1 : cid_network_thread_[client_id].load(std::memory_order_acquire));
+
+      if (LIKELY(socket != nullptr)) {
+        socket->send(&response, sizeof(OMClientResponse));
+      } else if (network_thread >= 0) {
+        auto responses = network_threads_[network_thread]->responses();
+        if (LIKELY(responses->size() < responses->capacity())) {
+          *responses->getNextToWriteTo() = response;
+          responses->updateWriteIndex();
+        } else { // the network thread is a whole queue behind, its clients will see a gap in their sequence numbers.
+          logger_.log("%:% %() % Dropping response, network thread % full for ClientId:%\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), network_thread, client_id);
+        }
+      } else if (shm_sessions_ && shm_sessions_->isAttached(client_id)) {
+        auto &responses = shm_sessions_->sessions_[client_id].responses_;
+        auto next_write = responses.getNextToWriteTo();
+        if (LIKELY(next_write != nullptr)) {
+          *next_write = response;
+          responses.updateWriteIndex();
+        } else { // the client stopped reading its session, do not hold up every other client for it.
+          logger_.log("%:% %() % Dropping response, shared memory session full for ClientId:%\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), client_id);
+        }
+      } else { // the client disconnected after sending the request this responds to.
+        logger_.log("%:% %() % Dropping response, no TCPSocket for ClientId:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id);
+      }
+    }
+
+    /* Disconnect the clients nothing arrived from for CLIENT_HEARTBEAT_TIMEOUT over the connection or shared memory session they are
+       logged on over, the network threads look after the connections they own. */
+    auto disconnectSilentClients(Nanos now) noexcept -> void {
+      next_liveness_check_time_ = now + CLIENT_HEARTBEAT_INTERVAL;
+      for (size_t client_id = 0; client_id < ME_MAX_NUM_CLIENTS; ++client_id) {
+        const auto socket = cid_tcp_socket_[client_id];
+        if ((socket == nullptr && !shmLoggedOn(client_id)) || LIKELY(now - cid_last_recv_time_[client_id] <= CLIENT_HEARTBEAT_TIMEOUT))
+          continue;
+        if (socket == nullptr && shm_sessions_->sessions_[client_id].requests_.getNextToRead()) // left unread while a shard is behind.
+          continue;
+
+        logger_.log("%:% %() % ClientId:% silent since % socket:% shm:%, disconnecting\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id, cid_last_recv_time_[client_id], socket ? socket->socket_fd_ : -1,
+                    shmLoggedOn(client_id));
+        if (socket != nullptr)
+          tcp_server_.disconnectSocket(socket); // disconnectCallback() forgets the socket and cancels the client's orders.
+        else
+          logoffShm(static_cast<ClientId>(client_id));
+      }
+    }
+
+    /* Answer a LOGON, HEARTBEAT or RESEND_REQUEST of a client, the thread which read it has already checked the client owns the connection
+       it came on, and taken the request sequence number of a LOGON. The seq_num_ of a LOGON is the request sequence number expected before it. */
+    auto processSessionRequest(const OMClientRequest &session_request) noexcept -> void {
+      const auto &request = session_request.me_client_request_;
+      const auto client_id = request.client_id_;
+      logger_.log("%:% %() % Session request ClientId:% next_outgoing_seq_num:% %\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), client_id, cid_next_outgoing_seq_num_[client_id], session_request.toString());
+
+      switch (request.type_) {
+        case ClientRequestType::LOGON: {
+          auto logged_on = sessionResponse(ClientResponseType::LOGGED_ON, client_id, cid_next_outgoing_seq_num_[client_id]);
+          logged_on.me_client_response_.market_order_id_ = session_request.seq_num_;
+          sendClientResponse(logged_on);
+          resendResponses(client_id, request.order_id_);
+        }
+          break;
+        case ClientRequestType::RESEND_REQUEST:
+          resendResponses(client_id, request.order_id_);
+          break;
+        case ClientRequestType::HEARTBEAT:
+          sendClientResponse(sessionResponse(ClientResponseType::HEARTBEAT, client_id, cid_next_outgoing_seq_num_[client_id]));
+          break;
+        default:
+          break;
+      }
+    }
+
+    /* Send the retained responses of a client from sequence number from_seq_num on again, preceded by a SEQUENCE_RESET past those which
+       are not retained anymore. */
+    auto resendResponses(ClientId client_id, size_t from_seq_num) noexcept -> void {
+      const auto &retained = retained_responses_[client_id];
+      if (from_seq_num >= retained.next())
+        return;
+
+      if (UNLIKELY(from_seq_num < retained.first())) {
+        logger_.log("%:% %() % Responses % to % of ClientId:% not retained anymore\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), from_seq_num, retained.first() - 1, client_id);
+        sendClientResponse(sessionResponse(ClientResponseType::SEQUENCE_RESET, client_id, retained.first()));
+        from_seq_num = retained.first();
+      }
+
+      logger_.log("%:% %() % Resending responses % to % of ClientId:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  from_seq_num, retained.next() - 1, client_id);
+      for (auto seq_num = from_seq_num; seq_num < retained.next(); ++seq_num)
+        sendClientResponse(retained.at(seq_num));
+    }
+
+    /* Read client request from the TCP receive buffer, check for sequence gaps and forward it to the FIFO sequencer.
+       A connection owns a ClientId from the LOGON of the client on it, requests on a connection which does not own their ClientId or with
+       the wrong sequence number, or which come while the FIFO sequencer has no room, are answered with SESSION_REJECTED, session requests
+       are answered right away. */
     auto recvCallback(TCPSocket *socket, Nanos rx_time) noexcept {
       logger_.log("%:% %() % Received socket:% len:% rx:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
                   socket->socket_fd_, socket->next_rcv_valid_index_, rx_time);
@@ -109,36 +316,207 @@ The run() method performs the following two main tasks:
       if (socket->next_rcv_valid_index_ >= sizeof(OMClientRequest)) {
         size_t i = 0;
         for (; i + sizeof(OMClientRequest) <= socket->next_rcv_valid_index_; i += sizeof(OMClientRequest)) {
-          auto request = reinterpret_cast<const OMClientRequest *>(socket->inbound_data_.data() + i);
+          auto request = reinterpret_cast<const OMClientRequest *>(socket->inbound_data_.get() + i);
           logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), request->toString());
 
-          if (UNLIKELY(cid_tcp_socket_[request->me_client_request_.client_id_] == nullptr)) { // first message from this ClientId.
+          const auto is_logon = (request->me_client_request_.type_ == ClientRequestType::LOGON);
+          if (UNLIKELY(cid_tcp_socket_[request->me_client_request_.client_id_] == nullptr) && is_logon &&
+              !shmLoggedOn(request->me_client_request_.client_id_)) { // a LOGON of a ClientId not logged on anywhere.
             cid_tcp_socket_[request->me_client_request_.client_id_] = socket;
           }
 
-          if (cid_tcp_socket_[request->me_client_request_.client_id_] != socket) { // TODO - change this to send a reject back to the client.
-            logger_.log("%:% %() % Received ClientRequest from ClientId:% on different socket:% expected:%\n", __FILE__, __LINE__, __FUNCTION__,
-                        Common::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, socket->socket_fd_,
-                        cid_tcp_socket_[request->me_client_request_.client_id_]->socket_fd_);
+          if (cid_tcp_socket_[request->me_client_request_.client_id_] != socket) { // not logged on yet, or over another connection or session.
+            logger_.log("%:% %() % Received ClientRequest from ClientId:% on socket:% it is not logged on over, logged on socket:% shm:%\n",
+                        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_,
+                        socket->socket_fd_, cid_tcp_socket_[request->me_client_request_.client_id_] ?
+                                            cid_tcp_socket_[request->me_client_request_.client_id_]->socket_fd_ : -1,
+                        shmLoggedOn(request->me_client_request_.client_id_));
+            const auto reject = sessionRejectedResponse(request->me_client_request_, OrderId_INVALID);
+            socket->send(&reject, sizeof(reject));
             continue;
           }
 
+          cid_last_recv_time_[request->me_client_request_.client_id_] = (LIKELY(rx_time) ? rx_time : getCurrentNanos());
+
           auto &next_exp_seq_num = cid_next_exp_seq_num_[request->me_client_request_.client_id_];
-          if (request->seq_num_ != next_exp_seq_num) { // TODO - change this to send a reject back to the client.
+          if (UNLIKELY(isSessionRequest(request->me_client_request_.type_))) {
+            processSessionRequest(is_logon ? acceptLogon(*request, next_exp_seq_num) : OMClientRequest{next_exp_seq_num, request->me_client_request_});
+            continue;
+          }
+
+          if (request->seq_num_ != next_exp_seq_num) {
             logger_.log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
                         Common::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, next_exp_seq_num, request->seq_num_);
+            const auto reject = sessionRejectedResponse(request->me_client_request_, next_exp_seq_num);
+            socket->send(&reject, sizeof(reject));
+            continue;
+          }
+
+          if (UNLIKELY(!fifo_sequencer_.hasRoom())) { // a shard fell behind, the client sends the request again from next_exp_seq_num.
+            logger_.log("%:% %() % Rejecting, pending requests full. ClientId:% SeqNum:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        Common::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, request->seq_num_);
+            const auto reject = sessionRejectedResponse(request->me_client_request_, next_exp_seq_num);
+            socket->send(&reject, sizeof(reject));
             continue;
           }
 
           ++next_exp_seq_num;
 
+          if (UNLIKELY(throttles_.enabled() && !throttles_.allow(request->me_client_request_.client_id_, getCurrentNanos()))) {
+            rejectThrottled(request->me_client_request_);
+            continue;
+          }
+
           fifo_sequencer_.addClientRequest(rx_time, request->me_client_request_);
         }
-        memcpy(socket->inbound_data_.data(), socket->inbound_data_.data() + i, socket->next_rcv_valid_index_ - i);
+        memcpy(socket->inbound_data_.get(), socket->inbound_data_.get() + i, socket->next_rcv_valid_index_ - i);
         socket->next_rcv_valid_index_ -= i;
       }
     }
 
+    /* Is client_id logged on over its shared memory session. */
+    auto shmLoggedOn(ClientId client_id) const noexcept -> bool {
+      return (shm_logged_on_[client_id / 64] & (1ull << (client_id % 64))) != 0;
+    }
+
+    /* Log client_id on over the attachment of its shared memory session, returns false if it is logged on over a TCP connection. */
+    auto logonShm(ClientId client_id, uint64_t attachment) noexcept -> bool {
+      if (!shmLoggedOn(client_id)) {
+        auto owner = -1;
+        if (network_threads_.empty() ? cid_tcp_socket_[client_id] != nullptr :
+            !cid_network_thread_[client_id].compare_exchange_strong(owner, CLIENT_THREAD_SHM, std::memory_order_acq_rel))
+          return false;
+        shm_logged_on_[client_id / 64] |= (1ull << (client_id % 64));
+      }
+      cid_shm_attachment_[client_id] = attachment;
+      return true;
+    }
+
+    /* Log client_id off its shared memory session, with cancel_on_disconnect_ its orders are mass cancelled after the requests it sent
+       before. It can log on again over its session or a TCP connection. */
+    auto logoffShm(ClientId client_id) noexcept -> void {
+      if (cancel_on_disconnect_)
+        fifo_sequencer_.addClientRequest(getCurrentNanos(), {ClientRequestType::MASS_CANCEL, client_id, TickerId_INVALID, OrderId_INVALID,
+                                                             Side::INVALID, Price_INVALID, Qty_INVALID});
+      shm_logged_on_[client_id / 64] &= ~(1ull << (client_id % 64));
+      if (!network_threads_.empty()) // the client can log in again on any thread.
+        cid_network_thread_[client_id].store(-1, std::memory_order_release);
+    }
+
+    /* Read client requests from the attached shared memory sessions, check for sequence gaps and forward them to the FIFO sequencer.
+       A session owns its ClientId from the LOGON of the client on it until the client detaches or goes silent, requests before are answered with
+       SESSION_REJECTED. There is no kernel receive timestamp here, requests are stamped when they are read. */
+    auto recvShmRequests() noexcept -> void {
+      for (size_t word = 0; word < shm_sessions_->attached_.size(); ++word) {
+        const auto attached_word = shm_sessions_->attached_[word].load(std::memory_order_acquire);
+        for (auto detached = shm_logged_on_[word] & ~attached_word; UNLIKELY(detached); detached &= (detached - 1)) {
+          const ClientId client_id = word * 64 + __builtin_ctzll(detached);
+          logger_.log("%:% %() % ClientId:% detached from its shm session\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                      client_id);
+          logoffShm(client_id);
+        }
+
+        for (auto attached = attached_word; attached; attached &= (attached - 1)) {
+          const ClientId client_id = word * 64 + __builtin_ctzll(attached);
+          auto &session = shm_sessions_->sessions_[client_id];
+          const auto attachment = session.attachments_.load(std::memory_order_acquire);
+          auto &requests = session.requests_;
+          // While a shard is behind, requests stay in the session, which the client stops writing to once it is full.
+          for (auto request = requests.getNextToRead(); request && LIKELY(fifo_sequencer_.hasRoom()); request = requests.getNextToRead()) {
+            logger_.log("%:% %() % Received shm %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), request->toString());
+
+            auto &next_exp_seq_num = cid_next_exp_seq_num_[client_id];
+            const auto is_logon = (request->me_client_request_.type_ == ClientRequestType::LOGON);
+            if (UNLIKELY(request->me_client_request_.client_id_ != client_id ||
+                         (is_logon ? !logonShm(client_id, attachment) : !shmLoggedOn(client_id) || cid_shm_attachment_[client_id] != attachment))) {
+              logger_.log("%:% %() % Received ClientRequest from ClientId:% on session:% it is not logged on over, shm:% socket:% thread:%\n",
+                          __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, client_id,
+                          shmLoggedOn(client_id), cid_tcp_socket_[client_id] != nullptr, cid_network_thread_[client_id].load());
+              rejectShmRequest(client_id, sessionRejectedResponse(request->me_client_request_, OrderId_INVALID));
+            } else if (UNLIKELY(isSessionRequest(request->me_client_request_.type_))) {
+              cid_last_recv_time_[client_id] = getCurrentNanos();
+              processSessionRequest(is_logon ? acceptLogon(*request, next_exp_seq_num) : OMClientRequest{next_exp_seq_num, request->me_client_request_});
+            } else if (UNLIKELY(request->seq_num_ != next_exp_seq_num)) {
+              cid_last_recv_time_[client_id] = getCurrentNanos();
+              logger_.log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
+                          Common::getCurrentTimeStr(&time_str_), client_id, next_exp_seq_num, request->seq_num_);
+              rejectShmRequest(client_id, sessionRejectedResponse(request->me_client_request_, next_exp_seq_num));
+            } else {
+              ++next_exp_seq_num;
+              const auto recv_time = getCurrentNanos();
+              cid_last_recv_time_[client_id] = recv_time;
+              if (UNLIKELY(throttles_.enabled() && !throttles_.allow(client_id, recv_time)))
+                rejectThrottled(request->me_client_request_);
+              else
+                fifo_sequencer_.addClientRequest(recv_time, request->me_client_request_);
+            }
+
+            requests.updateReadIndex();
+          }
+        }
+      }
+    }
+
+    /* Answer a request on the shared memory session of client_id the order server did not take, the reject is the session's own
+       since the ClientId of the request may not be client_id. */
+    auto rejectShmRequest(ClientId client_id, const OMClientResponse &reject) noexcept -> void {
+      auto next_write = shm_sessions_->sessions_[client_id].responses_.getNextToWriteTo();
+      if (LIKELY(next_write != nullptr)) {
+        *next_write = reject;
+        shm_sessions_->sessions_[client_id].responses_.updateWriteIndex();
+      }
+    }
+
+    /* Answer a request over its client's rate limit, the matching engine never sees it. */
+    auto rejectThrottled(const MEClientRequest &request) noexcept -> void {
+      logger_.log("%:% %() % Throttled ClientId:% allowed:% throttled:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  request.client_id_, throttles_.counters(request.client_id_).allowed_.load(), throttles_.counters(request.client_id_).throttled_.load(),
+                  request.toString());
+      if (UNLIKELY(throttle_rejects_.size() == throttle_rejects_.capacity())) { // a flood of requests outran sending the responses.
+        throttles_.unanswered(request.client_id_);
+        logger_.log("%:% %() % Dropping THROTTLED response, a whole queue of them is unsent %\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), request.toString());
+        return;
+      }
+      *throttle_rejects_.getNextToWriteTo() = throttledResponse(request);
+      throttle_rejects_.updateWriteIndex();
+    }
+
+    /* Queue the requests the network threads read into the FIFO sequencer, each thread's requests are one or a few runs in receive time order.
+       Their session requests are answered by this thread, which owns the sequence numbers and retained responses of every client. */
+    auto recvNetworkThreadRequests() noexcept -> void {
+      for (auto &network_thread: network_threads_) {
+        auto requests = network_thread->requests();
+        for (auto pending = requests->size(); pending && LIKELY(fifo_sequencer_.hasRoom()); --pending) { // the rest waits while a shard is behind.
+          const auto request = requests->getNextToRead();
+          fifo_sequencer_.addClientRequest(request->recv_time_, request->request_);
+          requests->updateReadIndex();
+        }
+
+        auto session_requests = network_thread->sessionRequests();
+        for (auto pending = session_requests->size(); pending; --pending) {
+          processSessionRequest(*session_requests->getNextToRead());
+          session_requests->updateReadIndex();
+        }
+      }
+    }
+
+    /* A client connection was torn down, forget it so responses are no longer sent to it and the ClientId can log in again on a new connection.
+       With cancel_on_disconnect_ the client's orders are mass cancelled, after the requests it sent before it went away. */
+    auto disconnectCallback(TCPSocket *socket) noexcept {
+      for (size_t client_id = 0; client_id < cid_tcp_socket_.size(); ++client_id) {
+        if (cid_tcp_socket_[client_id] == socket) {
+          logger_.log("%:% %() % Disconnected socket:% ClientId:% cancel_on_disconnect:%\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, client_id, cancel_on_disconnect_);
+          cid_tcp_socket_[client_id] = nullptr;
+
+          if (cancel_on_disconnect_)
+            fifo_sequencer_.addClientRequest(getCurrentNanos(), {ClientRequestType::MASS_CANCEL, static_cast<ClientId>(client_id), TickerId_INVALID,
+                                                                 OrderId_INVALID, Side::INVALID, Price_INVALID, Qty_INVALID});
+        }
+      }
+    }
+
     /* End of reading incoming messages across all the TCP connections, sequence and publish the client requests to the matching engine. */
     auto recvFinishedCallback() noexcept {
       fifo_sequencer_.sequenceAndPublish();
@@ -0,0 +1,214 @@
+#include "order_server_thread.h"
+
+#include "order_server.h"
+
+namespace Exchange {
+  OrderServerThread::OrderServerThread(int index, Common::TCPServerBackend backend, bool cancel_on_disconnect, ClientThreadMap *cid_thread,
+                                       std::array<size_t, ME_MAX_NUM_CLIENTS> *cid_next_exp_seq_num, ClientThrottles *throttles)
+      : index_(index), cancel_on_disconnect_(cancel_on_disconnect), logger_("exchange_order_server_" + std::to_string(index) + ".log"),
+        cid_thread_(cid_thread), cid_next_exp_seq_num_(cid_next_exp_seq_num), throttles_(throttles), incoming_requests_(ME_MAX_CLIENT_UPDATES),
+        session_requests_(ME_MAX_NUM_CLIENTS), outgoing_responses_(ME_MAX_CLIENT_UPDATES), throttle_rejects_(throttles->enabled() ? ME_MAX_CLIENT_UPDATES : 1),
+        tcp_server_(logger_, backend) {
+    cid_tcp_socket_.fill(nullptr);
+    cid_last_recv_time_.fill(0);
+
+    tcp_server_.recv_callback_ = [this](auto socket, auto rx_time) { recvCallback(socket, rx_time); };
+    tcp_server_.recv_finished_callback_ = []() {}; // requests are queued as they are read, the OrderServer thread sequences them.
+    tcp_server_.disconnect_callback_ = [this](auto socket) { disconnectCallback(socket); };
+    tcp_server_.zerocopy_threshold_ = ORDER_SERVER_ZEROCOPY_THRESHOLD;
+  }
+
+  OrderServerThread::~OrderServerThread() {
+    stop();
+  }
+
+  auto OrderServerThread::start(const std::string &iface, int port) -> void {
+    run_ = true;
+    ASSERT(Common::createAndStartThread(-1, "Exchange/OrderServer/" + std::to_string(index_), [this, iface, port]() { run(iface, port); }) != nullptr,
+           "Failed to start OrderServer network thread.");
+  }
+
+  auto OrderServerThread::stop() -> void {
+    run_ = false;
+  }
+
+  auto OrderServerThread::run(const std::string &iface, int port) noexcept -> void {
+    // Listens from this thread, so the io_uring backend's accept operation belongs to the thread which reaps its completions.
+    tcp_server_.listen(iface, port, true);
+
+    logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), index_);
+    while (run_) {
+      tcp_server_.poll();
+
+      const auto now = getCurrentNanos();
+      if (UNLIKELY(now >= next_liveness_check_time_))
+        disconnectSilentClients(now);
+
+      if (UNLIKELY(!unqueued_mass_cancels_.empty()))
+        queueMassCancels();
+
+      tcp_server_.sendAndRecv();
+
+      for (auto pending = outgoing_responses_.size(); pending; --pending) {
+        const auto response = outgoing_responses_.getNextToRead();
+        const auto client_id = response->me_client_response_.client_id_;
+        logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), response->toString());
+
+        auto socket = cid_tcp_socket_[client_id];
+        if (UNLIKELY(socket != nullptr && socket->outboundQueuedBytes() + sizeof(OMClientResponse) > ORDER_SERVER_MAX_QUEUED_BYTES)) {
+          logger_.log("%:% %() % Slow consumer, disconnecting ClientId:% socket:% queued:% partial_sends:%\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), client_id, socket->socket_fd_, socket->outboundQueuedBytes(), socket->partial_sends_);
+          tcp_server_.disconnectSocket(socket);
+          socket = nullptr;
+        }
+
+        if (LIKELY(socket != nullptr)) {
+          socket->send(response, sizeof(OMClientResponse));
+        } else { // the client disconnected after sending the request this responds to.
+          logger_.log("%:% %() % Dropping response, no TCPSocket for ClientId:%\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), client_id);
+        }
+
+        outgoing_responses_.updateReadIndex();
+      }
+    }
+  }
+
+  auto OrderServerThread::recvCallback(Common::TCPSocket *socket, Nanos rx_time) noexcept -> void {
+    logger_.log("%:% %() % Received socket:% len:% rx:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                socket->socket_fd_, socket->next_rcv_valid_index_, rx_time);
+
+    if (socket->next_rcv_valid_index_ < sizeof(OMClientRequest))
+      return;
+
+    size_t i = 0;
+    for (; i + sizeof(OMClientRequest) <= socket->next_rcv_valid_index_; i += sizeof(OMClientRequest)) {
+      auto request = reinterpret_cast<const OMClientRequest *>(socket->inbound_data_.get() + i);
+      const auto client_id = request->me_client_request_.client_id_;
+      logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), request->toString());
+
+      const auto is_logon = (request->me_client_request_.type_ == ClientRequestType::LOGON);
+      if (UNLIKELY(cid_tcp_socket_[client_id] == nullptr) && is_logon) { // a LOGON of a ClientId not on this thread, claim it.
+        auto owner = -1;
+        if ((*cid_thread_)[client_id].compare_exchange_strong(owner, index_, std::memory_order_acq_rel))
+          cid_tcp_socket_[client_id] = socket;
+      }
+
+      if (cid_tcp_socket_[client_id] != socket) { // not logged on yet, or owned by another connection, thread or shared memory session.
+        logger_.log("%:% %() % Received ClientRequest from ClientId:% on socket:% it is not logged on over, owner thread:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id, socket->socket_fd_, (*cid_thread_)[client_id].load());
+        const auto reject = sessionRejectedResponse(request->me_client_request_, OrderId_INVALID);
+        socket->send(&reject, sizeof(reject));
+        continue;
+      }
+
+      cid_last_recv_time_[client_id] = (LIKELY(rx_time) ? rx_time : getCurrentNanos());
+
+      // Owned by this thread from the claim above until disconnectCallback(), the OrderServer thread never touches it.
+      auto &next_exp_seq_num = (*cid_next_exp_seq_num_)[client_id];
+      if (UNLIKELY(isSessionRequest(request->me_client_request_.type_))) { // answered by the OrderServer thread.
+        const auto session_request = (is_logon ? acceptLogon(*request, next_exp_seq_num) : OMClientRequest{next_exp_seq_num, request->me_client_request_});
+        if (LIKELY(session_requests_.size() < session_requests_.capacity())) {
+          *session_requests_.getNextToWriteTo() = session_request;
+          session_requests_.updateWriteIndex();
+        } else { // the client retries a LOGON or HEARTBEAT which goes unanswered.
+          logger_.log("%:% %() % Dropping session request, OrderServer thread is a whole queue behind %\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), request->toString());
+        }
+        continue;
+      }
+
+      if (request->seq_num_ != next_exp_seq_num) {
+        logger_.log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id, next_exp_seq_num, request->seq_num_);
+        const auto reject = sessionRejectedResponse(request->me_client_request_, next_exp_seq_num);
+        socket->send(&reject, sizeof(reject));
+        continue;
+      }
+
+      if (UNLIKELY(!hasRoom())) { // the client sends the request again from next_exp_seq_num.
+        logger_.log("%:% %() % Rejecting, OrderServer thread is a whole queue behind. ClientId:% SeqNum:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id, request->seq_num_);
+        const auto reject = sessionRejectedResponse(request->me_client_request_, next_exp_seq_num);
+        socket->send(&reject, sizeof(reject));
+        continue;
+      }
+
+      ++next_exp_seq_num;
+
+      if (UNLIKELY(throttles_->enabled() && !throttles_->allow(client_id, getCurrentNanos()))) {
+        logger_.log("%:% %() % Throttled ClientId:% allowed:% throttled:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    client_id, throttles_->counters(client_id).allowed_.load(), throttles_->counters(client_id).throttled_.load(), request->toString());
+        if (LIKELY(throttle_rejects_.size() < throttle_rejects_.capacity())) {
+          *throttle_rejects_.getNextToWriteTo() = throttledResponse(request->me_client_request_);
+          throttle_rejects_.updateWriteIndex();
+        } else { // a flood of requests outran the OrderServer thread sending the responses.
+          throttles_->unanswered(client_id);
+          logger_.log("%:% %() % Dropping THROTTLED response, OrderServer thread is a whole queue behind %\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), request->toString());
+        }
+        continue;
+      }
+
+      queueRequest(rx_time, request->me_client_request_);
+    }
+    memcpy(socket->inbound_data_.get(), socket->inbound_data_.get() + i, socket->next_rcv_valid_index_ - i);
+    socket->next_rcv_valid_index_ -= i;
+  }
+
+  auto OrderServerThread::disconnectCallback(Common::TCPSocket *socket) noexcept -> void {
+    for (size_t client_id = 0; client_id < cid_tcp_socket_.size(); ++client_id) {
+      if (cid_tcp_socket_[client_id] == socket) {
+        logger_.log("%:% %() % Disconnected socket:% ClientId:% cancel_on_disconnect:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, client_id, cancel_on_disconnect_);
+        cid_tcp_socket_[client_id] = nullptr;
+
+        if (cancel_on_disconnect_ && UNLIKELY(!hasRoom())) {
+          logger_.log("%:% %() % Holding back mass cancel of ClientId:%, OrderServer thread is a whole queue behind\n", __FILE__, __LINE__,
+                      __FUNCTION__, Common::getCurrentTimeStr(&time_str_), client_id);
+          unqueued_mass_cancels_.push_back(static_cast<ClientId>(client_id));
+          continue;
+        }
+
+        if (cancel_on_disconnect_)
+          queueRequest(getCurrentNanos(), {ClientRequestType::MASS_CANCEL, static_cast<ClientId>(client_id), TickerId_INVALID,
+                                           OrderId_INVALID, Side::INVALID, Price_INVALID, Qty_INVALID});
+
+        (*cid_thread_)[client_id].store(-1, std::memory_order_release); // the client can log in again on any thread.
+      }
+    }
+  }
+
+  auto OrderServerThread::disconnectSilentClients(Nanos now) noexcept -> void {
+    next_liveness_check_time_ = now + CLIENT_HEARTBEAT_INTERVAL;
+    for (size_t client_id = 0; client_id < cid_tcp_socket_.size(); ++client_id) {
+      const auto socket = cid_tcp_socket_[client_id];
+      if (socket == nullptr || LIKELY(now - cid_last_recv_time_[client_id] <= CLIENT_HEARTBEAT_TIMEOUT))
+        continue;
+
+      logger_.log("%:% %() % ClientId:% silent since % socket:%, disconnecting\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), client_id, cid_last_recv_time_[client_id], socket->socket_fd_);
+      tcp_server_.disconnectSocket(socket); // disconnectCallback() gives the client up and cancels its orders.
+    }
+  }
+
+  auto OrderServerThread::hasRoom() const noexcept -> bool {
+    return (unqueued_mass_cancels_.empty() && incoming_requests_.size() < incoming_requests_.capacity());
+  }
+
+  auto OrderServerThread::queueRequest(Nanos rx_time, const MEClientRequest &request) noexcept -> void {
+    *incoming_requests_.getNextToWriteTo() = {rx_time, request};
+    incoming_requests_.updateWriteIndex();
+  }
+
+  auto OrderServerThread::queueMassCancels() noexcept -> void {
+    size_t queued = 0;
+    for (; queued < unqueued_mass_cancels_.size() && incoming_requests_.size() < incoming_requests_.capacity(); ++queued) {
+      const auto client_id = unqueued_mass_cancels_[queued];
+      queueRequest(getCurrentNanos(), {ClientRequestType::MASS_CANCEL, client_id, TickerId_INVALID, OrderId_INVALID, Side::INVALID,
+                                       Price_INVALID, Qty_INVALID});
+      (*cid_thread_)[client_id].store(-1, std::memory_order_release);
+    }
+    unqueued_mass_cancels_.erase(unqueued_mass_cancels_.begin(), unqueued_mass_cancels_.begin() + static_cast<ptrdiff_t>(queued));
+  }
+}
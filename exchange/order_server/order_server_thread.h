@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "common/thread_utils.h"
+#include "common/macros.h"
+#include "common/tcp_server.h"
+
+#include "order_server/client_request.h"
+#include "order_server/client_response.h"
+#include "order_server/client_session.h"
+#include "order_server/client_throttle.h"
+#include "order_server/fifo_sequencer.h"
+
+namespace Exchange {
+  /// Index of the OrderServerThread owning the connection of every ClientId, -1 while no thread does, CLIENT_THREAD_SHM while the
+  /// client is logged on over its shared memory session, which the OrderServer thread serves.
+  typedef std::array<std::atomic<int>, ME_MAX_NUM_CLIENTS> ClientThreadMap;
+
+  constexpr int CLIENT_THREAD_SHM = -2;
+
+  /// Number of network threads of the OrderServer from the LLPETM_ORDER_SERVER_THREADS environment variable, 0 if it is not set,
+  /// in which case the OrderServer serves every connection from its own thread.
+  inline auto orderServerThreadsFromEnv() -> size_t {
+    const auto value = getenv("LLPETM_ORDER_SERVER_THREADS");
+    return (value ? strtoul(value, nullptr, 10) : 0);
+  }
+
+  /// A network thread of a multi-threaded OrderServer. It listens on the order server's port along with the other network threads,
+  /// owns the connections the kernel hands it, reads, checks and timestamps their requests into requests() for the OrderServer thread
+  /// to sequence, and sends the responses the OrderServer thread routes to responses() for the clients it owns.
+  class OrderServerThread {
+  public:
+    /// cid_thread, cid_next_exp_seq_num and throttles are shared by all network threads and the OrderServer thread, a thread only
+    /// touches the sequence number and token bucket of a client while it owns the client in cid_thread, which a network thread claims
+    /// when it accepts a LOGON of the client and gives up when its connection goes away.
+    OrderServerThread(int index, Common::TCPServerBackend backend, bool cancel_on_disconnect, ClientThreadMap *cid_thread,
+                      std::array<size_t, ME_MAX_NUM_CLIENTS> *cid_next_exp_seq_num, ClientThrottles *throttles);
+
+    ~OrderServerThread();
+
+    /// Start listening on iface:port and the thread, and stop it.
+    auto start(const std::string &iface, int port) -> void;
+
+    auto stop() -> void;
+
+    auto requests() noexcept {
+      return &incoming_requests_;
+    }
+
+    auto responses() noexcept {
+      return &outgoing_responses_;
+    }
+
+    /// Session requests of the clients this thread owns, for the OrderServer thread to answer.
+    auto sessionRequests() noexcept {
+      return &session_requests_;
+    }
+
+    /// Responses to the requests this thread throttled, for the OrderServer thread to sequence and route back.
+    auto throttleRejects() noexcept {
+      return &throttle_rejects_;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    OrderServerThread() = delete;
+
+    OrderServerThread(const OrderServerThread &) = delete;
+
+    OrderServerThread(const OrderServerThread &&) = delete;
+
+    OrderServerThread &operator=(const OrderServerThread &) = delete;
+
+    OrderServerThread &operator=(const OrderServerThread &&) = delete;
+
+  private:
+    /// Main loop: listen on iface:port, accept connections, read requests from them, and send them the responses routed to this thread.
+    auto run(const std::string &iface, int port) noexcept -> void;
+
+    /// Read client requests from the TCP receive buffer, check the ClientId logged on over this connection and for sequence gaps, and
+    /// queue them. Requests failing either check, or which come while requests() is full, are answered with SESSION_REJECTED, session
+    /// requests are queued to sessionRequests().
+    auto recvCallback(Common::TCPSocket *socket, Nanos rx_time) noexcept -> void;
+
+    /// Forget a torn down connection and give up its client, queueing a mass cancel for it with cancel_on_disconnect_.
+    /// If requests() is full the client is given up only once queueMassCancels() queued its mass cancel, so it cannot log on again
+    /// and have orders it sends after that cancelled.
+    auto disconnectCallback(Common::TCPSocket *socket) noexcept -> void;
+
+    /// Disconnect the clients this thread owns which nothing arrived from for CLIENT_HEARTBEAT_TIMEOUT.
+    auto disconnectSilentClients(Nanos now) noexcept -> void;
+
+    /// Whether requests() can take a client request, it cannot while the OrderServer thread is a whole queue behind, or while mass
+    /// cancels wait to be queued before them.
+    auto hasRoom() const noexcept -> bool;
+
+    /// Queue a request for the OrderServer thread, the caller made sure there is room for it.
+    auto queueRequest(Nanos rx_time, const MEClientRequest &request) noexcept -> void;
+
+    /// Queue the mass cancels of the clients disconnected while requests() was full, as far as it has room, and give the clients up.
+    auto queueMassCancels() noexcept -> void;
+
+    const int index_ = 0;
+    const bool cancel_on_disconnect_ = false;
+
+    volatile bool run_ = false;
+
+    std::string time_str_;
+    Common::Logger logger_;
+
+    ClientThreadMap *cid_thread_ = nullptr;
+    std::array<size_t, ME_MAX_NUM_CLIENTS> *cid_next_exp_seq_num_ = nullptr;
+    ClientThrottles *throttles_ = nullptr;
+
+    /// ClientId -> connection of the clients this thread owns, and when a request of the client last arrived on it.
+    std::array<Common::TCPSocket *, ME_MAX_NUM_CLIENTS> cid_tcp_socket_;
+    std::array<Nanos, ME_MAX_NUM_CLIENTS> cid_last_recv_time_;
+    Nanos next_liveness_check_time_ = 0;
+
+    RecvTimeClientRequestLFQueue incoming_requests_;
+    std::vector<ClientId> unqueued_mass_cancels_;
+    OMClientRequestLFQueue session_requests_;
+    OMClientResponseLFQueue outgoing_responses_;
+    ClientResponseLFQueue throttle_rejects_;
+
+    Common::TCPServer tcp_server_;
+  };
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common/shm_queue.h"
+
+#include "exchange/order_server/client_request.h"
+#include "exchange/order_server/client_response.h"
+
+namespace Exchange {
+  /// Shared memory segment the order server creates for the order sessions of co-located clients with TransportType::SHM.
+  constexpr auto SHM_ORDER_SESSIONS_NAME = "/llpetm_order_sessions";
+
+  /// Number of requests / responses each session queue holds.
+  constexpr size_t SHM_SESSION_QUEUE_SIZE = 8 * 1024;
+
+  /// The order session of a single client, the same OMClientRequest / OMClientResponse messages as on the TCP connection.
+  struct ShmOrderSession {
+    Common::ShmSPSCQueue<OMClientRequest, SHM_SESSION_QUEUE_SIZE> requests_;
+    Common::ShmSPSCQueue<OMClientResponse, SHM_SESSION_QUEUE_SIZE> responses_;
+
+    /// Number of times a client attached to the session, so the order server tells the attachment it accepted a LOGON on from later ones.
+    std::atomic<uint64_t> attachments_;
+  };
+
+  /// Layout of the order sessions segment: a session per ClientId, and a bitmap of the sessions a client is attached to,
+  /// so the order server only polls the sessions in use.
+  struct ShmOrderSessions {
+    std::array<std::atomic<uint64_t>, (ME_MAX_NUM_CLIENTS + 63) / 64> attached_;
+    std::array<ShmOrderSession, ME_MAX_NUM_CLIENTS> sessions_;
+
+    /// Claim the session for client_id, returns false if another client is attached to it.
+    auto attach(ClientId client_id) noexcept {
+      auto &session = sessions_.at(client_id);
+      if (attached_[client_id / 64].load() & (1ull << (client_id % 64)))
+        return false;
+
+      session.requests_.reset();
+      session.responses_.reset();
+      session.attachments_.fetch_add(1);
+      return !(attached_[client_id / 64].fetch_or(1ull << (client_id % 64)) & (1ull << (client_id % 64)));
+    }
+
+    auto detach(ClientId client_id) noexcept {
+      attached_[client_id / 64].fetch_and(~(1ull << (client_id % 64)));
+    }
+
+    auto isAttached(ClientId client_id) const noexcept {
+      return (attached_[client_id / 64].load(std::memory_order_acquire) & (1ull << (client_id % 64))) != 0;
+    }
+  };
+}
@@ -0,0 +1,30 @@
+#!/bin/bash
+
+# Creates (or with "down" removes) two network namespaces joined by a veth pair, to exercise the AF_XDP market data receive path
+# on a plain Linux box: the publisher namespace llpetm_xdp_pub owns veth_pub 10.77.0.1 and routes multicast out of it,
+# the subscriber namespace llpetm_xdp_sub owns veth_sub 10.77.0.2 which the XDP program is attached to. Needs root.
+#
+# Usage: bash scripts/xdp_veth_setup.sh [up|down]
+# then e.g.: ip netns exec llpetm_xdp_sub ./cmake-build-release/benchmarks/xdp_rx_benchmark
+
+PUB_NS=llpetm_xdp_pub
+SUB_NS=llpetm_xdp_sub
+
+if [ "$1" == "down" ]; then
+  ip netns del $PUB_NS 2>/dev/null
+  ip netns del $SUB_NS 2>/dev/null
+  exit 0
+fi
+
+ip netns add $PUB_NS
+ip netns add $SUB_NS
+ip link add veth_pub netns $PUB_NS type veth peer name veth_sub netns $SUB_NS
+
+ip -n $PUB_NS addr add 10.77.0.1/24 dev veth_pub
+ip -n $SUB_NS addr add 10.77.0.2/24 dev veth_sub
+ip -n $PUB_NS link set lo up
+ip -n $SUB_NS link set lo up
+ip -n $PUB_NS link set veth_pub up
+ip -n $SUB_NS link set veth_sub up
+ip -n $PUB_NS route add 224.0.0.0/4 dev veth_pub
+ip -n $SUB_NS route add 224.0.0.0/4 dev veth_sub
@@ -17,7 +17,8 @@ namespace Trading {
   MarketDataConsumer::MarketDataConsumer(Common::ClientId client_id, Exchange::MEMarketUpdateLFQueue *market_updates,
                                          const std::string &iface,
                                          const std::string &snapshot_ip, int snapshot_port,
-                                         const std::string &incremental_ip, int incremental_port)
+                                         const std::string &incremental_ip, int incremental_port, Common::TransportType transport,
+                                         Common::McastRxPath rx_path)
       : incoming_md_updates_(market_updates), run_(false),
         logger_("trading_market_data_consumer_" + std::to_string(client_id) + ".log"),
         incremental_mcast_socket_(logger_), snapshot_mcast_socket_(logger_),
@@ -27,13 +28,35 @@ namespace Trading {
     };
 
     incremental_mcast_socket_.recv_callback_ = recv_callback;
-    ASSERT(incremental_mcast_socket_.init(incremental_ip, iface, incremental_port, /*is_listening*/ true) >= 0,
-           "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
+    if (transport == Common::TransportType::SHM) { // packets read from shared memory are still processed out of the incremental socket's buffer.
+      shm_segment_ = std::make_unique<Common::ShmSegment>(Exchange::MDP_SHM_NAME, sizeof(Exchange::MDPShmRing), false);
+      shm_reader_ = std::make_unique<Exchange::MDPShmReader>(shm_segment_->as<Exchange::MDPShmRing>());
+    } else {
+      ASSERT(incremental_mcast_socket_.init(incremental_ip, iface, incremental_port, /*is_listening*/ true) >= 0,
+             "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
 
-    ASSERT(incremental_mcast_socket_.join(incremental_ip),
-           "Join failed on:" + std::to_string(incremental_mcast_socket_.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+      ASSERT(incremental_mcast_socket_.join(incremental_ip),
+             "Join failed on:" + std::to_string(incremental_mcast_socket_.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+    }
 
     snapshot_mcast_socket_.recv_callback_ = recv_callback;
+
+    if (rx_path == Common::McastRxPath::XDP) { // only one queue is steered, datagrams arriving on other queues still reach the sockets.
+      std::vector<Common::XdpFlow> flows{{snapshot_ip, snapshot_port}};
+      if (!shm_reader_)
+        flows.push_back({incremental_ip, incremental_port});
+
+      xdp_socket_ = std::make_unique<Common::XdpSocket>();
+      if (xdp_socket_->init(iface, 0, flows)) {
+        snapshot_ip_addr_ = inet_addr(snapshot_ip.c_str());
+        logger_.log("%:% %() % AF_XDP receive path on %\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), xdp_socket_->toString());
+      } else {
+        logger_.log("%:% %() % AF_XDP receive path unavailable, falling back to sockets. %\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), xdp_socket_->error_);
+        xdp_socket_.reset();
+      }
+    }
   }
 
   /// Main loop for this thread - reads and processes messages from the multicast sockets - the heavy lifting is in the recvCallback() and checkSnapshotSync() methods.
@@ -44,11 +67,57 @@ consumes any additional data received on the incremental or snapshot channels an
 auto MarketDataConsumer::run() noexcept -> void {
     logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
     while (run_) {
-      incremental_mcast_socket_.sendAndRecv();
+      if (xdp_socket_)
+        recvXdpPackets();
+      if (shm_reader_)
+        recvShmPackets();
+      else
+        incremental_mcast_socket_.sendAndRecv();
       snapshot_mcast_socket_.sendAndRecv();
     }
   }
 
+  /// Copy the packets published on the shared memory incremental stream into the incremental socket's receive buffer,
+  /// they are then processed exactly like datagrams read from the incremental multicast socket.
+  auto MarketDataConsumer::recvShmPackets() noexcept -> void {
+    auto &socket = incremental_mcast_socket_;
+    bool have_data = false;
+    while (socket.next_rcv_valid_index_ + Exchange::MDP_MAX_PACKET_SIZE <= socket.inbound_data_.size()) {
+      const auto start = socket.next_rcv_valid_index_;
+      const auto result = shm_reader_->read([&socket](const Exchange::MDPShmPacket &packet) {
+        const auto size = std::min(packet.size_, packet.data_.size());
+        memcpy(socket.inbound_data_.data() + socket.next_rcv_valid_index_, packet.data_.data(), size);
+        socket.next_rcv_valid_index_ += size;
+      });
+
+      if (result == Common::ShmReadResult::EMPTY)
+        break;
+
+      if (UNLIKELY(result == Common::ShmReadResult::OVERRUN)) { // the packets we were lapped on show up as a sequence gap and trigger recovery.
+        socket.next_rcv_valid_index_ = start;
+        logger_.log("%:% %() % Overrun on shared memory incremental stream.\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_));
+        continue;
+      }
+
+      have_data = true;
+    }
+
+    if (have_data)
+      recvCallback(&socket);
+  }
+
+  /// Decode the datagrams received on the AF_XDP socket straight out of the UMEM frames, without copying them into a socket buffer first.
+  auto MarketDataConsumer::recvXdpPackets() noexcept -> void {
+    xdp_socket_->recv([this](uint32_t ip, uint16_t port, const char *payload, size_t len) {
+      const auto is_snapshot = (ip == snapshot_ip_addr_ && port == snapshot_port_);
+      if (is_snapshot && !in_recovery_) // the snapshot stream is steered here all the time but only needed while recovering.
+        return;
+
+      processPackets(is_snapshot, payload, len);
+    });
+  }
+
   /// Start the process of snapshot synchronization by subscribing to the snapshot multicast stream.
 
 /*
@@ -227,10 +296,10 @@ auto MarketDataConsumer::queueMessage(bool is_snapshot, const Exchange::MDPMarke
   we simply log a warning, reset the socket receive buffer index, and return:
 
   (PROCESS 2 : Reading MarketUpdate messages from the socket.)
-  Oherwise, we proceed further and read Exchange::MDPMarketUpdate messages from the socket buffer.
-  We go through the data contained in the socket->rcv_buffer_ buffer and read it in chunks of 
-  size equal to the size of Exchange::MDPMarketUpdate. The goal here is to read as many full 
-  MDPMarketUpdate messages as possible until we have read them all from the buffer.
+  Oherwise, we proceed further and read whole market data packets from the socket buffer.
+  Every packet is a Exchange::MDPPacketHeader followed by count_ Exchange::MEMarketUpdate messages with
+  consecutive sequence numbers starting at first_seq_num_. When we are not recovering and the packet starts
+  at the next expected sequence number, the gap check is done once and the whole packet is forwarded.
 
   (PROCESS 3 : Check for recovery and start snapshot sync.)
   Check the already_in_recovery_ flag to see if we were previously not in recovery and 
@@ -239,7 +308,7 @@ auto MarketDataConsumer::queueMessage(bool is_snapshot, const Exchange::MDPMarke
 */
 
 auto MarketDataConsumer::recvCallback(McastSocket *socket) noexcept -> void {
-    const auto is_snapshot = (socket->socket_fd_ == snapshot_mcast_socket_.socket_fd_);
+    const auto is_snapshot = (socket == &snapshot_mcast_socket_);
     if (UNLIKELY(is_snapshot && !in_recovery_)) { // market update was read from the snapshot market data stream and we are not in recovery, so we dont need it and discard it.
       socket->next_rcv_valid_index_ = 0;
 
@@ -249,38 +318,70 @@ auto MarketDataConsumer::recvCallback(McastSocket *socket) noexcept -> void {
       return;
     }
 
-    if (socket->next_rcv_valid_index_ >= sizeof(Exchange::MDPMarketUpdate)) {
-      size_t i = 0;
-      for (; i + sizeof(Exchange::MDPMarketUpdate) <= socket->next_rcv_valid_index_; i += sizeof(Exchange::MDPMarketUpdate)) {
-        auto request = reinterpret_cast<const Exchange::MDPMarketUpdate *>(socket->inbound_data_.data() + i);
-        logger_.log("%:% %() % Received % socket len:% %\n", __FILE__, __LINE__, __FUNCTION__,
-                    Common::getCurrentTimeStr(&time_str_),
-                    (is_snapshot ? "snapshot" : "incremental"), sizeof(Exchange::MDPMarketUpdate), request->toString());
+    if (socket->next_rcv_valid_index_ >= sizeof(Exchange::MDPPacketHeader)) {
+      const auto i = processPackets(is_snapshot, socket->inbound_data_.data(), socket->next_rcv_valid_index_);
+      memcpy(socket->inbound_data_.data(), socket->inbound_data_.data() + i, socket->next_rcv_valid_index_ - i);
+      socket->next_rcv_valid_index_ -= i;
+    }
+  }
+
+  /// Process the whole market data packets in data, returns the number of bytes consumed, a trailing partial packet is left alone.
+  auto MarketDataConsumer::processPackets(bool is_snapshot, const char *data, size_t len) noexcept -> size_t {
+    size_t i = 0;
+    while (i + sizeof(Exchange::MDPPacketHeader) <= len) {
+      auto header = reinterpret_cast<const Exchange::MDPPacketHeader *>(data + i);
+      const auto packet_size = sizeof(Exchange::MDPPacketHeader) + header->count_ * sizeof(Exchange::MEMarketUpdate);
+      if (UNLIKELY(i + packet_size > len))
+        break;
+
+      auto updates = reinterpret_cast<const Exchange::MEMarketUpdate *>(data + i + sizeof(Exchange::MDPPacketHeader));
+      i += packet_size;
+
+      logger_.log("%:% %() % Received % socket len:% %\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_),
+                  (is_snapshot ? "snapshot" : "incremental"), packet_size, header->toString());
+
+      // Common case, an incremental packet in sequence and no recovery in progress, so the sequence gap check is done once for the whole packet.
+      if (LIKELY(!in_recovery_ && !is_snapshot && header->first_seq_num_ == next_exp_inc_seq_num_)) {
+        for (size_t j = 0; j < header->count_; ++j) {
+          logger_.log("%:% %() % seq:% %\n", __FILE__, __LINE__, __FUNCTION__,
+                      Common::getCurrentTimeStr(&time_str_), header->first_seq_num_ + j, updates[j].toString());
+
+          auto next_write = incoming_md_updates_->getNextToWriteTo();
+          *next_write = updates[j];
+          incoming_md_updates_->updateWriteIndex();
+        }
+        next_exp_inc_seq_num_ += header->count_;
+        continue;
+      }
+
+      // Otherwise fall back to checking every update in the packet individually, since recovery can start or complete in the middle of a packet.
+      for (size_t j = 0; j < header->count_; ++j) {
+        const Exchange::MDPMarketUpdate request{header->first_seq_num_ + j, updates[j]};
 
         const bool already_in_recovery = in_recovery_;
-        in_recovery_ = (already_in_recovery || request->seq_num_ != next_exp_inc_seq_num_);
+        in_recovery_ = (already_in_recovery || request.seq_num_ != next_exp_inc_seq_num_);
 
         if (UNLIKELY(in_recovery_)) {
           if (UNLIKELY(!already_in_recovery)) { // if we just entered recovery, start the snapshot synchonization process by subscribing to the snapshot multicast stream.
             logger_.log("%:% %() % Packet drops on % socket. SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
-                        Common::getCurrentTimeStr(&time_str_), (is_snapshot ? "snapshot" : "incremental"), next_exp_inc_seq_num_, request->seq_num_);
+                        Common::getCurrentTimeStr(&time_str_), (is_snapshot ? "snapshot" : "incremental"), next_exp_inc_seq_num_, request.seq_num_);
             startSnapshotSync();
           }
 
-          queueMessage(is_snapshot, request); // queue up the market data update message and check if snapshot recovery / synchronization can be completed successfully.
+          queueMessage(is_snapshot, &request); // queue up the market data update message and check if snapshot recovery / synchronization can be completed successfully.
         } else if (!is_snapshot) { // not in recovery and received a packet in the correct order and without gaps, process it.
           logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__,
-                      Common::getCurrentTimeStr(&time_str_), request->toString());
+                      Common::getCurrentTimeStr(&time_str_), request.toString());
 
           ++next_exp_inc_seq_num_;
 
           auto next_write = incoming_md_updates_->getNextToWriteTo();
-          *next_write = std::move(request->me_market_update_);
+          *next_write = request.me_market_update_;
           incoming_md_updates_->updateWriteIndex();
         }
       }
-      memcpy(socket->inbound_data_.data(), socket->inbound_data_.data() + i, socket->next_rcv_valid_index_ - i);
-      socket->next_rcv_valid_index_ -= i;
     }
+    return i;
   }
-}
+}
\ No newline at end of file
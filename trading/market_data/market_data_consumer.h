@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 
 /*
  chose the std::map type here since it is easier to iterate over sorted keys compared to, 
@@ -19,6 +20,7 @@
 #include "common/lf_queue.h"
 #include "common/macros.h"
 #include "common/mcast_socket.h"
+#include "common/xdp_socket.h"
 
 #include "exchange/market_data/market_update.h"
 
@@ -56,6 +58,16 @@ and the snapshot_port_ variable. These represent the network interface to use, t
     typedef std::map<size_t, Exchange::MEMarketUpdate> QueuedMarketUpdates;
     QueuedMarketUpdates snapshot_queued_msgs_, incremental_queued_msgs_;
 
+    /// With TransportType::SHM the incremental stream is read from the exchange's shared memory ring instead of the incremental multicast socket,
+    /// the snapshot stream used for recovery stays on multicast.
+    std::unique_ptr<Common::ShmSegment> shm_segment_;
+    std::unique_ptr<Exchange::MDPShmReader> shm_reader_;
+
+    /// With McastRxPath::XDP the multicast streams are steered into this AF_XDP socket and decoded straight out of its frames.
+    /// The multicast sockets stay joined and are still polled, for the IGMP subscriptions and for datagrams the XDP program passes on to the kernel.
+    std::unique_ptr<Common::XdpSocket> xdp_socket_;
+    uint32_t snapshot_ip_addr_ = 0;
+
   private:
     /// Main loop for this thread - reads and processes messages from the multicast sockets - the heavy lifting is in the recvCallback() and checkSnapshotSync() methods.
     auto run() noexcept -> void;
@@ -63,6 +75,15 @@ and the snapshot_port_ variable. These represent the network interface to use, t
     /// Process a market data update, the consumer needs to use the socket parameter to figure out whether this came from the snapshot or the incremental stream.
     auto recvCallback(McastSocket *socket) noexcept -> void;
 
+    /// Read the packets published on the shared memory incremental stream and process them through recvCallback().
+    auto recvShmPackets() noexcept -> void;
+
+    /// Decode the datagrams received on the AF_XDP socket in place.
+    auto recvXdpPackets() noexcept -> void;
+
+    /// Process the whole market data packets in data, returns the number of bytes consumed, a trailing partial packet is left alone.
+    auto processPackets(bool is_snapshot, const char *data, size_t len) noexcept -> size_t;
+
     /// Queue up a message in the *_queued_msgs_ containers, first parameter specifies if this update came from the snapshot or the incremental streams.
     auto queueMessage(bool is_snapshot, const Exchange::MDPMarketUpdate *request);
 
@@ -74,7 +95,9 @@ and the snapshot_port_ variable. These represent the network interface to use, t
   public:
     MarketDataConsumer(Common::ClientId client_id, Exchange::MEMarketUpdateLFQueue *market_updates, const std::string &iface,
                        const std::string &snapshot_ip, int snapshot_port,
-                       const std::string &incremental_ip, int incremental_port);
+                       const std::string &incremental_ip, int incremental_port,
+                       Common::TransportType transport = Common::TransportType::SOCKET,
+                       Common::McastRxPath rx_path = Common::McastRxPath::SOCKET);
 
     ~MarketDataConsumer() {
       stop();
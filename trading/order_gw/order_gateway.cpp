@@ -13,9 +13,10 @@ namespace Trading
         ClientId client_id,
         Exchange::ClientRequestLFQueue *client_requests,
         Exchange::ClientResponseLFQueue *client_responses,
-        std::string ip, const std::string &iface, int port)
+        std::string ip, const std::string &iface, int port, Common::TransportType transport)
         : client_id_(client_id), ip_(ip), iface_(iface), port_(port), outgoing_requests_(client_requests), incoming_responses_(client_responses),
-          logger_("trading_order_gateway_" + std::to_string(client_id) + ".log"), tcp_socket_(logger_)
+          logger_("trading_order_gateway_" + std::to_string(client_id) + ".log"), sent_requests_(ORDER_GATEWAY_RETAINED_REQUESTS), tcp_socket_(logger_),
+          transport_(transport)
     {
         tcp_socket_.recv_callback_ = [this](auto socket, auto rx_time)
         { recvCallback(socket, rx_time); };
@@ -29,26 +30,62 @@ namespace Trading
     auto OrderGateway::run() noexcept -> void
     {   
         /*
-        First, it calls the TCPSocket::sendAndRecv() method to send and receive data on the established TCP connection
+        First, it calls the TCPSocket::recvData() and TCPSocket::sendData() methods to receive and send data on the established TCP connection
         */
         logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
+        last_recv_time_ = getCurrentNanos();
         while (run_)
         {
-            tcp_socket_.sendAndRecv();
+            if (shm_session_)
+            {
+                /*
+                With a shared memory order session, responses are read straight out of the session's response queue instead of the socket
+                */
+                auto &responses = shm_session_->responses_;
+                for (auto response = responses.getNextToRead(); response; response = responses.getNextToRead())
+                {
+                    processClientResponse(response);
+                    responses.updateReadIndex();
+                }
+            }
+            else if (LIKELY(tcp_socket_.socket_fd_ >= 0))
+            {
+                checkConnection(tcp_socket_.recvData());
+                if (LIKELY(tcp_socket_.socket_fd_ >= 0))
+                    tcp_socket_.sendData();
+            }
+
+            /*
+            Once a heartbeat interval, it logs on if it is not logged on yet, connecting again first if the connection went away
+            or the exchange went silent, and sends a HEARTBEAT otherwise
+            */
+            const auto now = getCurrentNanos();
+            if (UNLIKELY(now >= next_heartbeat_time_))
+            {
+                next_heartbeat_time_ = now + ORDER_GATEWAY_HEARTBEAT_INTERVAL;
+                checkExchangeAlive(now);
+                if (!shm_session_ && tcp_socket_.socket_fd_ < 0)
+                    reconnect();
+                if (logged_on_)
+                    sendSessionRequest(Exchange::ClientRequestType::HEARTBEAT, OrderId_INVALID);
+                else
+                    sendSessionRequest(Exchange::ClientRequestType::LOGON, has_session_ ? next_exp_seq_num_ : OrderId_INVALID);
+            }
+
             /*
             It also reads any MEClientRequest messages available on the outgoing_requests_ LFQueue sent by the TradeEngine
             engine and writes them to the tcp_socket_ send buffer using the TCPSocket::send() method. Note that it needs 
             to write out OMClientRequest messages, which it achieves by first writing the next_outgoing_seq_num_ field and 
-            then the MEClientRequest object that the TradeEngine sent. This works because we designed the OMClientRequest object 
-            to be a struct that contains a size_t seq_num_ field followed by a MEClientRequest object. We also increment
-            the next_outgoing_seq_num_ instance for the next outgoing socket message
+            then the MEClientRequest object that the TradeEngine sent. We also increment the next_outgoing_seq_num_ instance
+            for the next outgoing socket message. Requests wait in the queue until the exchange answered our LOGON
             */
-            for (auto client_request = outgoing_requests_->getNextToRead(); client_request; client_request = outgoing_requests_->getNextToRead())
+            for (auto client_request = outgoing_requests_->getNextToRead(); logged_on_ && client_request; client_request = outgoing_requests_->getNextToRead())
             {
                 logger_.log("%:% %() % Sending cid:% seq:% %\n", __FILE__, __LINE__, __FUNCTION__,
                             Common::getCurrentTimeStr(&time_str_), client_id_, next_outgoing_seq_num_, client_request->toString());
-                tcp_socket_.send(&next_outgoing_seq_num_, sizeof(next_outgoing_seq_num_));
-                tcp_socket_.send(client_request, sizeof(Exchange::MEClientRequest));
+                if (UNLIKELY(!sendRequest({next_outgoing_seq_num_, *client_request}))) // the exchange has not caught up with this session yet, retry on the next iteration.
+                    break;
+                sent_requests_[next_outgoing_seq_num_ & (ORDER_GATEWAY_RETAINED_REQUESTS - 1)] = *client_request;
                 outgoing_requests_->updateReadIndex();
 
                 next_outgoing_seq_num_++;
@@ -56,11 +93,102 @@ namespace Trading
         }
     }
 
+    /// Send a request to the exchange over either transport.
+    auto OrderGateway::sendRequest(const Exchange::OMClientRequest &request) noexcept -> bool
+    {
+        if (shm_session_)
+        {
+            auto next_write = shm_session_->requests_.getNextToWriteTo();
+            if (UNLIKELY(!next_write))
+                return false;
+            *next_write = request;
+            shm_session_->requests_.updateWriteIndex();
+            return true;
+        }
+        return tcp_socket_.send(&request, sizeof(Exchange::OMClientRequest));
+    }
+
+    /// Send a LOGON, HEARTBEAT or RESEND_REQUEST, they carry the sequence number of our next client request without using it up.
+    auto OrderGateway::sendSessionRequest(Exchange::ClientRequestType type, OrderId order_id) noexcept -> void
+    {
+        const Exchange::OMClientRequest request{next_outgoing_seq_num_, {type, client_id_, TickerId_INVALID, order_id, Side::INVALID, Price_INVALID, Qty_INVALID}};
+        logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), request.toString());
+        sendRequest(request);
+    }
+
+    /// Ask for the responses from next_exp_seq_num_ on to be resent.
+    auto OrderGateway::requestResend() noexcept -> void
+    {
+        if (resend_pending_) // what we are missing now is sent along with the responses we asked for already.
+            return;
+        resend_pending_ = true;
+        sendSessionRequest(Exchange::ClientRequestType::RESEND_REQUEST, next_exp_seq_num_);
+    }
+
+    /// Answer the client requests the exchange never got with SESSION_REJECTED, so the trade engine does not wait for their responses forever.
+    auto OrderGateway::rejectLostRequests(size_t from_seq_num) noexcept -> void
+    {
+        const auto first_retained = (next_outgoing_seq_num_ > ORDER_GATEWAY_RETAINED_REQUESTS ? next_outgoing_seq_num_ - ORDER_GATEWAY_RETAINED_REQUESTS : 1);
+        logger_.log("%:% %() % ERROR Requests lost with the connection. SeqNum % to %, retained from %\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), from_seq_num, next_outgoing_seq_num_ - 1, first_retained);
+        for (auto seq_num = std::max(from_seq_num, first_retained); seq_num < next_outgoing_seq_num_; ++seq_num)
+        {
+            const auto &request = sent_requests_[seq_num & (ORDER_GATEWAY_RETAINED_REQUESTS - 1)];
+            if (request.ticker_id_ == TickerId_INVALID)
+                continue;
+            *incoming_responses_->getNextToWriteTo() = {Exchange::ClientResponseType::SESSION_REJECTED, request.client_id_, request.ticker_id_, request.order_id_,
+                                                        OrderId_INVALID, request.side_, request.price_, 0, request.qty_};
+            incoming_responses_->updateWriteIndex();
+        }
+    }
+
+    /// Close the TCP connection if reading from it found it gone, the next LOGON on a new connection picks up where it left off.
+    auto OrderGateway::checkConnection(ssize_t read_size) noexcept -> void
+    {
+        if (LIKELY(read_size > 0 || (read_size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))))
+            return;
+
+        logger_.log("%:% %() % Connection lost socket:% read:% error:% next_outgoing_seq_num:% next_exp_seq_num:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), tcp_socket_.socket_fd_, read_size, (read_size ? std::strerror(errno) : "closed by peer"),
+                    next_outgoing_seq_num_, next_exp_seq_num_);
+        if (logged_on_) // connect again right away, after that once a heartbeat interval while the exchange is not there.
+            next_heartbeat_time_ = 0;
+        disconnect();
+    }
+
+    /// Drop a connection or session the exchange went silent on, heartbeats it answers keep it alive while there is nothing else to send.
+    auto OrderGateway::checkExchangeAlive(Nanos now) noexcept -> void
+    {
+        if (LIKELY(now - last_recv_time_ <= Exchange::CLIENT_HEARTBEAT_TIMEOUT) || (shm_session_ ? !logged_on_ : tcp_socket_.socket_fd_ < 0))
+            return;
+
+        logger_.log("%:% %() % ERROR Exchange silent since % socket:% logged_on:% next_outgoing_seq_num:% next_exp_seq_num:%\n", __FILE__, __LINE__,
+                    __FUNCTION__, Common::getCurrentTimeStr(&time_str_), last_recv_time_, tcp_socket_.socket_fd_, logged_on_, next_outgoing_seq_num_,
+                    next_exp_seq_num_);
+        disconnect();
+    }
+
+    auto OrderGateway::disconnect() noexcept -> void
+    {
+        if (!shm_session_)
+            tcp_socket_.close();
+        logged_on_ = false;
+        resend_pending_ = false;
+    }
+
+    auto OrderGateway::reconnect() noexcept -> void
+    {
+        const auto socket_fd = tcp_socket_.connect(ip_, iface_, port_, false);
+        last_recv_time_ = getCurrentNanos();
+        logger_.log("%:% %() % Reconnecting to ip:% port:% socket:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    ip_, port_, socket_fd);
+    }
+
     /// Callback when an incoming client response is read, we perform some checks and forward it to the lock free queue connected to the trade engine.
     auto OrderGateway::recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void
     {
         /*
-        The recvCallback() method is called when there is data available on the tcp_socket_ and the TCPSocket::sendAndRecv() method is called from the run() method in the previous section. 
+        The recvCallback() method is called when there is data available on the tcp_socket_ and the TCPSocket::recvData() method is called from the run() method in the previous section. 
         We go through the rcv_buffer_ buffer on TCPSocket and re-interpret the data as OMClientResponse messages
         */
         logger_.log("%:% %() % Received socket:% len:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, socket->next_rcv_valid_index_, rx_time);
@@ -70,45 +198,142 @@ namespace Trading
             size_t i = 0;
             for (; i + sizeof(Exchange::OMClientResponse) <= socket->next_rcv_valid_index_; i += sizeof(Exchange::OMClientResponse))
             {
-                auto response = reinterpret_cast<const Exchange::OMClientResponse *>(socket->inbound_data_.data() + i);
-                logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), response->toString());
+                processClientResponse(reinterpret_cast<const Exchange::OMClientResponse *>(socket->inbound_data_.get() + i));
+            }
+            memcpy(socket->inbound_data_.get(), socket->inbound_data_.get() + i, socket->next_rcv_valid_index_ - i);
+            socket->next_rcv_valid_index_ -= i;
+        }
+    }
 
-                /*
-                For the OMClientResponse message we just read into the response variable, we check to make sure the client ID on the response matches 
-                the OrderGateway’s client ID and ignore the response if it does not match
-                */
+    /// Check a client response received over either transport and forward it to the trade engine.
+    auto OrderGateway::processClientResponse(const Exchange::OMClientResponse *response) noexcept -> void
+    {
+        logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), response->toString());
+        last_recv_time_ = getCurrentNanos();
 
-                if (response->me_client_response_.client_id_ != client_id_)
-                { // this should never happen unless there is a bug at the exchange.
-                    logger_.log("%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
-                                Common::getCurrentTimeStr(&time_str_), client_id_, response->me_client_response_.client_id_);
-                    continue;
-                }
+        /*
+        For the OMClientResponse message we just read into the response variable, we check to make sure the client ID on the response matches 
+        the OrderGateway’s client ID and ignore the response if it does not match
+        */
 
-                /*
-                We also check to make sure that the sequence number on OMClientResponse matches what we expect it to be. If there is a mismatch, 
-                we log an error and ignore the response. There is an opportunity to improve the error handling here, but for the sake of simplicity, 
-                we just log an error and continue:
-                */
-                if (response->seq_num_ != next_exp_seq_num_)
-                { // this should never happen since we use a reliable TCP protocol, unless there is a bug at the exchange.
-                    logger_.log("%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
-                                Common::getCurrentTimeStr(&time_str_), client_id_, next_exp_seq_num_, response->seq_num_);
-                    continue;
-                }
-                /*
-                Finally, we increment the expected sequence number on the next OMClientResponse and write the response we just read to the
-                incoming_responses_ LFQueue for the TradeEngine to read. It also updates the rcv_buffer_ buffer and the next receive 
-                index into the TCPSocket buffer we just consumed some messages from
-                */
-                ++next_exp_seq_num_;
+        if (response->me_client_response_.client_id_ != client_id_)
+        { // this should never happen unless there is a bug at the exchange.
+            logger_.log("%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
+                        Common::getCurrentTimeStr(&time_str_), client_id_, response->me_client_response_.client_id_);
+            return;
+        }
+
+        if (UNLIKELY(Exchange::isSessionResponse(response->me_client_response_.type_)))
+        {
+            processSessionResponse(response);
+            return;
+        }
+
+        /*
+        We also check to make sure that the sequence number on OMClientResponse matches what we expect it to be. A response we have
+        seen already is one the exchange resent along with those we asked for, and is ignored. A gap means the exchange dropped
+        responses, or they were sent while we were not connected, so we ask for them to be resent and ignore the responses after
+        the gap until they arrive, they are resent along with them
+        */
+        if (response->seq_num_ != next_exp_seq_num_)
+        {
+            if (response->seq_num_ > next_exp_seq_num_)
+            {
+                logger_.log("%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:% resend_pending:%.\n", __FILE__, __LINE__, __FUNCTION__,
+                            Common::getCurrentTimeStr(&time_str_), client_id_, next_exp_seq_num_, response->seq_num_, resend_pending_);
+                requestResend();
+            }
+            return;
+        }
+        /*
+        Finally, we increment the expected sequence number on the next OMClientResponse and write the response we just read to the
+        incoming_responses_ LFQueue for the TradeEngine to read. It also updates the rcv_buffer_ buffer and the next receive 
+        index into the TCPSocket buffer we just consumed some messages from
+        */
+        ++next_exp_seq_num_;
+        resend_pending_ = false;
+
+        auto next_write = incoming_responses_->getNextToWriteTo();
+        *next_write = std::move(response->me_client_response_);
+        incoming_responses_->updateWriteIndex();
+    }
+
+    /// Handle a session response of the exchange.
+    auto OrderGateway::processSessionResponse(const Exchange::OMClientResponse *response) noexcept -> void
+    {
+        const auto &client_response = response->me_client_response_;
+        switch (client_response.type_)
+        {
+        case Exchange::ClientResponseType::LOGGED_ON:
+        {
+            /*
+            The exchange resends what we missed right after this, unless we are new or it has sent fewer responses than we have seen,
+            which only happens if it started over, in which case we start from its next response. Unless it started over, the requests
+            from the one it expected before the LOGON on never made it
+            */
+            if (has_session_ && response->seq_num_ >= next_exp_seq_num_ && client_response.market_order_id_ < next_outgoing_seq_num_)
+                rejectLostRequests(client_response.market_order_id_);
 
-                auto next_write = incoming_responses_->getNextToWriteTo();
-                *next_write = std::move(response->me_client_response_);
+            if (!has_session_ || response->seq_num_ < next_exp_seq_num_)
+            {
+                if (has_session_)
+                    logger_.log("%:% %() % ERROR Exchange sequence numbers started over. SeqNum expected:% exchange next:%\n", __FILE__, __LINE__, __FUNCTION__,
+                                Common::getCurrentTimeStr(&time_str_), next_exp_seq_num_, response->seq_num_);
+                next_exp_seq_num_ = response->seq_num_;
+            }
+            logged_on_ = has_session_ = true;
+            resend_pending_ = (response->seq_num_ > next_exp_seq_num_);
+        }
+        break;
+        case Exchange::ClientResponseType::HEARTBEAT:
+        {
+            if (response->seq_num_ > next_exp_seq_num_) // we missed the last responses the exchange sent, or the RESEND_REQUEST for them got lost.
+            {
+                resend_pending_ = false;
+                requestResend();
+            }
+        }
+        break;
+        case Exchange::ClientResponseType::SEQUENCE_RESET:
+        {
+            if (response->seq_num_ > next_exp_seq_num_)
+            {
+                logger_.log("%:% %() % ERROR Responses lost, exchange does not retain them anymore. SeqNum % to %\n", __FILE__, __LINE__, __FUNCTION__,
+                            Common::getCurrentTimeStr(&time_str_), next_exp_seq_num_, response->seq_num_ - 1);
+                next_exp_seq_num_ = response->seq_num_;
+            }
+        }
+        break;
+        case Exchange::ClientResponseType::SESSION_REJECTED:
+        {
+            /*
+            The exchange did not take a request. If it expects another sequence number we use that from now on, and the trade engine
+            is told about rejected client requests. Without one we are not logged on, because it rejected our LOGON, e.g. while it has
+            not noticed our previous connection went away yet, or it logged us off after hearing nothing from us for a while, and the
+            LOGON is retried
+            */
+            logger_.log("%:% %() % ERROR Request rejected by the exchange. SeqNum next:% exchange expects:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        Common::getCurrentTimeStr(&time_str_), next_outgoing_seq_num_, client_response.market_order_id_);
+            if (client_response.market_order_id_ != OrderId_INVALID)
+            {
+                next_outgoing_seq_num_ = client_response.market_order_id_;
+            }
+            else
+            {
+                logged_on_ = false;
+                resend_pending_ = false;
+                next_heartbeat_time_ = getCurrentNanos() + ORDER_GATEWAY_LOGON_RETRY_INTERVAL;
+            }
+
+            if (client_response.ticker_id_ != TickerId_INVALID)
+            {
+                *incoming_responses_->getNextToWriteTo() = client_response;
                 incoming_responses_->updateWriteIndex();
             }
-            memcpy(socket->inbound_data_.data(), socket->inbound_data_.data() + i, socket->next_rcv_valid_index_ - i);
-            socket->next_rcv_valid_index_ -= i;
+        }
+        break;
+        default:
+            break;
         }
     }
-}
\ No newline at end of file
+}
@@ -1,15 +1,37 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "common/thread_utils.h"
 #include "common/macros.h"
 #include "common/tcp_server.h"
+#include "common/time_utils.h"
 
 #include "exchange/order_server/client_request.h"
 #include "exchange/order_server/client_response.h"
+#include "exchange/order_server/shm_order_sessions.h"
 
 namespace Trading {
+  /*
+  Interval at which the order gateway sends a HEARTBEAT to the exchange once it is logged on, and otherwise retries the LOGON,
+  connecting again first if the connection went away. The exchange answers every HEARTBEAT, so a connection or session it sends
+  nothing on for Exchange::CLIENT_HEARTBEAT_TIMEOUT is dropped and we connect and log on again
+  */
+  constexpr Nanos ORDER_GATEWAY_HEARTBEAT_INTERVAL = Exchange::CLIENT_HEARTBEAT_INTERVAL;
+
+  /*
+  A LOGON the exchange rejected, usually because it has not noticed our previous connection went away yet, is retried after this
+  */
+  constexpr Nanos ORDER_GATEWAY_LOGON_RETRY_INTERVAL = 10 * NANOS_TO_MILLIS;
+
+  /*
+  Number of the latest client requests the order gateway retains, to tell the trade engine about those lost with a connection
+  */
+  constexpr size_t ORDER_GATEWAY_RETAINED_REQUESTS = 4 * 1024;
+  static_assert(!(ORDER_GATEWAY_RETAINED_REQUESTS & (ORDER_GATEWAY_RETAINED_REQUESTS - 1)), "ORDER_GATEWAY_RETAINED_REQUESTS must be a power of 2.");
+
   class OrderGateway {
   public:
     OrderGateway(ClientId client_id,
@@ -18,7 +40,12 @@ namespace Trading {
                  Exchange::ClientResponseLFQueue *client_responses,
 
                  
-                 std::string ip, const std::string &iface, int port);
+                 std::string ip, const std::string &iface, int port,
+
+                 /*
+                 SHM talks to a co-located exchange over a shared memory order session instead of the TCP connection
+                 */
+                 Common::TransportType transport = Common::TransportType::SOCKET);
 
     /*
     The destructor for the OrderGateway class calls the stop() method to 
@@ -28,6 +55,9 @@ namespace Trading {
       stop();
       using namespace std::literals::chrono_literals;
       std::this_thread::sleep_for(5s);
+
+      if (shm_sessions_)
+        shm_sessions_->detach(client_id_);
     }
 
     /*
@@ -37,8 +67,15 @@ namespace Trading {
     */
     auto start() {
       run_ = true;
-      ASSERT(tcp_socket_.connect(ip_, iface_, port_, false) >= 0,
-             "Unable to connect to ip:" + ip_ + " port:" + std::to_string(port_) + " on iface:" + iface_ + " error:" + std::string(std::strerror(errno)));
+      if (transport_ == Common::TransportType::SHM) {
+        shm_segment_ = std::make_unique<Common::ShmSegment>(Exchange::SHM_ORDER_SESSIONS_NAME, sizeof(Exchange::ShmOrderSessions), false);
+        shm_sessions_ = shm_segment_->as<Exchange::ShmOrderSessions>();
+        ASSERT(shm_sessions_->attach(client_id_), "Shared memory order session already in use for ClientId:" + std::to_string(client_id_));
+        shm_session_ = &shm_sessions_->sessions_[client_id_];
+      } else {
+        ASSERT(tcp_socket_.connect(ip_, iface_, port_, false) >= 0,
+               "Unable to connect to ip:" + ip_ + " port:" + std::to_string(port_) + " on iface:" + iface_ + " error:" + std::string(std::strerror(errno)));
+      }
       ASSERT(Common::createAndStartThread(-1, "Trading/OrderGateway", [this]() { run(); }) != nullptr, "Failed to start OrderGateway thread.");
     }
 
@@ -100,6 +137,23 @@ namespace Trading {
     size_t next_outgoing_seq_num_ = 1;
     size_t next_exp_seq_num_ = 1;
 
+    /*
+    Session state: whether the exchange answered our LOGON on the current connection, whether it ever did, in which case a new LOGON
+    asks for the responses from next_exp_seq_num_ on, whether a RESEND_REQUEST for a gap is not answered yet, when the next
+    HEARTBEAT or LOGON is due, and when the exchange last sent us anything. Client requests wait in outgoing_requests_ while we are
+    not logged on
+    */
+    bool logged_on_ = false;
+    bool has_session_ = false;
+    bool resend_pending_ = false;
+    Nanos next_heartbeat_time_ = 0;
+    Nanos last_recv_time_ = 0;
+
+    /*
+    The latest client requests sent, by sequence number
+    */
+    std::vector<Exchange::MEClientRequest> sent_requests_;
+
     /*
     It also contains a tcp_socket_ member variable of the TCPSocket type, which is the TCP socket 
     client to be used to connect to the exchange order gateway server and to send and receive messagesIt 
@@ -108,9 +162,64 @@ namespace Trading {
     */
     Common::TCPSocket tcp_socket_;
 
+    /*
+    Shared memory order session used instead of tcp_socket_ with TransportType::SHM
+    */
+    const Common::TransportType transport_;
+    std::unique_ptr<Common::ShmSegment> shm_segment_;
+    Exchange::ShmOrderSessions *shm_sessions_ = nullptr;
+    Exchange::ShmOrderSession *shm_session_ = nullptr;
+
   private:
     auto run() noexcept -> void;
 
     auto recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void;
+
+    /*
+    Check a client response received over either transport and forward it to the trade engine, asking for the responses
+    we missed to be resent when there is a gap in their sequence numbers
+    */
+    auto processClientResponse(const Exchange::OMClientResponse *response) noexcept -> void;
+
+    /*
+    Handle a LOGGED_ON, HEARTBEAT, SEQUENCE_RESET or SESSION_REJECTED response of the exchange
+    */
+    auto processSessionResponse(const Exchange::OMClientResponse *response) noexcept -> void;
+
+    /*
+    Send a request to the exchange over either transport, false if the shared memory session has no room for it
+    */
+    auto sendRequest(const Exchange::OMClientRequest &request) noexcept -> bool;
+
+    auto sendSessionRequest(Exchange::ClientRequestType type, OrderId order_id) noexcept -> void;
+
+    /*
+    Ask for the responses from next_exp_seq_num_ on to be resent, unless an earlier RESEND_REQUEST is still being answered
+    */
+    auto requestResend() noexcept -> void;
+
+    /*
+    Answer the client requests from sequence number from_seq_num on, which the exchange never got, with SESSION_REJECTED to the trade engine
+    */
+    auto rejectLostRequests(size_t from_seq_num) noexcept -> void;
+
+    /*
+    Close the TCP connection if reading read_size bytes from it found it gone, run() connects again right away if we were logged on,
+    at the next heartbeat interval otherwise
+    */
+    auto checkConnection(ssize_t read_size) noexcept -> void;
+
+    /*
+    Drop the TCP connection, or the shared memory session we are logged on over, if the exchange sent nothing on it for
+    Exchange::CLIENT_HEARTBEAT_TIMEOUT, it is half-open or the exchange hung, run() then connects and logs on again
+    */
+    auto checkExchangeAlive(Nanos now) noexcept -> void;
+
+    /*
+    Close the TCP connection, if we are on one, and forget we were logged on
+    */
+    auto disconnect() noexcept -> void;
+
+    auto reconnect() noexcept -> void;
   };
 }
\ No newline at end of file
@@ -71,11 +71,12 @@ namespace Trading {
           Conversely, if it was a sell trade and we wanted to send an aggressive sell order to take liquidity, 
           we would specify a sell price to be bid_price_ in the BBO object and no buy order by specifying a Price_INVALID 
           buy price. Remember that this trading strategy takes a direction in the market by aggressively sending a buy or 
-          sell order one at a time, but not both like the MarketMaker algorithm:
+          sell order one at a time, but not both like the MarketMaker algorithm.
+          The orders are IOC, whatever does not trade right away is cancelled by the exchange instead of resting on the book:
           */
-            order_manager_->moveOrders(market_update->ticker_id_, bbo->ask_price_, Price_INVALID, clip);
+            order_manager_->moveOrders(market_update->ticker_id_, bbo->ask_price_, Price_INVALID, clip, Exchange::TimeInForce::IOC);
           else
-            order_manager_->moveOrders(market_update->ticker_id_, Price_INVALID, bbo->bid_price_, clip);
+            order_manager_->moveOrders(market_update->ticker_id_, Price_INVALID, bbo->bid_price_, clip, Exchange::TimeInForce::IOC);
         }
       }
     }
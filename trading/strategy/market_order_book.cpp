@@ -7,12 +7,14 @@ namespace Trading
 
     /*
     The constructor is straightforward and accepts the TickerId and Logger instances it will use to log.
-    It initializes orders_at_price_pool_ of MarketOrdersAtPrice objects to be of the ME_MAX_PRICE_LEVELS size
+    It initializes orders_at_price_pool_ of MarketOrdersAtPrice objects to be of ME_MAX_PRICE_LEVELS per side
     and order_pool_ of the MarketOrder objects to be of the ME_MAX_ORDER_IDS size
     */
     MarketOrderBook::MarketOrderBook(TickerId ticker_id, Logger *logger)
-        : ticker_id_(ticker_id), orders_at_price_pool_(ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS), logger_(logger)
+        : ticker_id_(ticker_id), orders_at_price_pool_(sideToIndex(Side::MAX) * ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS), logger_(logger)
     {
+        for (auto &orders_at_price : price_orders_at_price_)
+            orders_at_price.fill(nullptr);
     }
 
     /*
@@ -44,8 +46,9 @@ namespace Trading
         checking for Side::SELL on market_update_->side_ and checking if price_ of market_update is less
         than or equal to the price of the best ask (asks_by_price_->price_):
         */
-        const auto bid_updated = (bids_by_price_ && market_update->side_ == Side::BUY && market_update->price_ >= bids_by_price_->price_);
-        const auto ask_updated = (asks_by_price_ && market_update->side_ == Side::SELL && market_update->price_ <= asks_by_price_->price_);
+        auto bid_updated = (bids_by_price_ && market_update->side_ == Side::BUY && market_update->price_ >= bids_by_price_->price_);
+        auto ask_updated = (asks_by_price_ && market_update->side_ == Side::SELL && market_update->price_ <= asks_by_price_->price_);
+        auto book_side = market_update->side_; // the side of the book which changed.
 
         switch (market_update->type_)
         {
@@ -64,10 +67,23 @@ namespace Trading
         {   
             /*
             The handling for the MarketUpdateType::MODIFY case finds the MarketOrder structure for which the 
-            modified message is targeted. It then updates the qty_ attribute on that order
+            modified message is targeted. It then updates the qty_ attribute on that order.
+            An order which was cancel/replaced to a new price or a larger quantity comes with a new price and / or priority, it
+            moves to the back of the queue at its price, and the level it left may have been the best one
             */
             auto order = oid_to_order_.at(market_update->order_id_);
-            order->qty_ = market_update->qty_;
+            if (UNLIKELY(order->price_ != market_update->price_ || order->priority_ != market_update->priority_))
+            {
+                bid_updated |= (market_update->side_ == Side::BUY);
+                ask_updated |= (market_update->side_ == Side::SELL);
+                removeOrder(order);
+                addOrder(order_pool_.allocate(market_update->order_id_, market_update->side_, market_update->price_,
+                                              market_update->qty_, market_update->priority_, nullptr, nullptr));
+            }
+            else
+            {
+                order->qty_ = market_update->qty_;
+            }
         }
         break;
         case Exchange::MarketUpdateType::CANCEL:
@@ -94,6 +110,27 @@ namespace Trading
             return;
         }
         break;
+        case Exchange::MarketUpdateType::EXECUTION:
+        {
+            /*
+            An EXECUTION is a TRADE and the MODIFY or CANCEL of the resting order it traded against in one message. The trade is
+            passed on to the TradeEngine first, with the book as it was before the trade, as a TRADE would have been. Then what is
+            left of the resting order, which is always at the best price on its side, is applied like a MODIFY, or like a CANCEL if nothing is
+            */
+            const Exchange::MEMarketUpdate trade{Exchange::MarketUpdateType::TRADE, OrderId_INVALID, market_update->ticker_id_,
+                                                 market_update->side_, market_update->price_, market_update->qty_, Priority_INVALID};
+            trade_engine_->onTradeUpdate(&trade, this);
+
+            auto order = oid_to_order_.at(market_update->order_id_);
+            book_side = order->side_;
+            bid_updated = (book_side == Side::BUY);
+            ask_updated = (book_side == Side::SELL);
+            if (market_update->leaves_qty_)
+                order->qty_ = market_update->leaves_qty_;
+            else
+                removeOrder(order);
+        }
+        break;
         case Exchange::MarketUpdateType::CLEAR:
         {   
             /*
@@ -127,8 +164,13 @@ namespace Trading
             }
 
             bids_by_price_ = asks_by_price_ = nullptr;
+            for (auto &orders_at_price : price_orders_at_price_)
+                orders_at_price.fill(nullptr);
         }
         break;
+        case Exchange::MarketUpdateType::AUCTION_INDICATIVE:
+            // The book stays as it is until the auction uncrosses, which the trades and order updates of the uncross show.
+            return;
         /*
         The MarketOrderBook class does not need to handle INVALID, SNAPSHOT_START, and SNAPSHOT_END MarketUpdateTypes, 
         so it does nothing with those messages:
@@ -153,7 +195,7 @@ namespace Trading
         logger_->log("%:% %() % % %", __FILE__, __LINE__, __FUNCTION__,
                      Common::getCurrentTimeStr(&time_str_), market_update->toString(), bbo_.toString());
 
-        trade_engine_->onOrderBookUpdate(market_update->ticker_id_, market_update->price_, market_update->side_, this);
+        trade_engine_->onOrderBookUpdate(market_update->ticker_id_, market_update->price_, book_side, this);
     }
 
     auto MarketOrderBook::toString(bool detailed, bool validity_check) const -> std::string
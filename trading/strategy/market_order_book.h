@@ -127,7 +127,8 @@ namespace Trading {
     MarketOrdersAtPrice *bids_by_price_ = nullptr;
     MarketOrdersAtPrice *asks_by_price_ = nullptr;
 
-    OrdersAtPriceHashMap price_orders_at_price_;  //to track OrdersAtPrice objects by Price
+    /// To track OrdersAtPrice objects by Price, per side, as both sides have levels at the same prices while a book is crossed in an auction.
+    std::array<OrdersAtPriceHashMap, sideToIndex(Side::MAX)> price_orders_at_price_;
 
     MemPool<MarketOrder> order_pool_;
 
@@ -144,12 +145,12 @@ namespace Trading {
       return (price % ME_MAX_PRICE_LEVELS);
     }
 
-    auto getOrdersAtPrice(Price price) const noexcept -> MarketOrdersAtPrice * {
-      return price_orders_at_price_.at(priceToIndex(price));
+    auto getOrdersAtPrice(Side side, Price price) const noexcept -> MarketOrdersAtPrice * {
+      return price_orders_at_price_.at(sideToIndex(side)).at(priceToIndex(price));
     }
 
     auto addOrdersAtPrice(MarketOrdersAtPrice *new_orders_at_price) noexcept {
-      price_orders_at_price_.at(priceToIndex(new_orders_at_price->price_)) = new_orders_at_price;
+      price_orders_at_price_.at(sideToIndex(new_orders_at_price->side_)).at(priceToIndex(new_orders_at_price->price_)) = new_orders_at_price;
 
       const auto best_orders_by_price = (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_);
       if (UNLIKELY(!best_orders_by_price)) {
@@ -198,7 +199,7 @@ namespace Trading {
 
     auto removeOrdersAtPrice(Side side, Price price) noexcept {
       const auto best_orders_by_price = (side == Side::BUY ? bids_by_price_ : asks_by_price_);
-      auto orders_at_price = getOrdersAtPrice(price);
+      auto orders_at_price = getOrdersAtPrice(side, price);
 
       if (UNLIKELY(orders_at_price->next_entry_ == orders_at_price)) { // empty side of book.
         (side == Side::BUY ? bids_by_price_ : asks_by_price_) = nullptr;
@@ -213,13 +214,13 @@ namespace Trading {
         orders_at_price->prev_entry_ = orders_at_price->next_entry_ = nullptr;
       }
 
-      price_orders_at_price_.at(priceToIndex(price)) = nullptr;
+      price_orders_at_price_.at(sideToIndex(side)).at(priceToIndex(price)) = nullptr;
 
       orders_at_price_pool_.deallocate(orders_at_price);
     }
 
     auto removeOrder(MarketOrder *order) noexcept -> void {
-      auto orders_at_price = getOrdersAtPrice(order->price_);
+      auto orders_at_price = getOrdersAtPrice(order->side_, order->price_);
 
       if (order->prev_order_ == order) { // only one element.
         removeOrdersAtPrice(order->side_, order->price_);
@@ -241,7 +242,7 @@ namespace Trading {
     }
 
     auto addOrder(MarketOrder *order) noexcept -> void {
-      const auto orders_at_price = getOrdersAtPrice(order->price_);
+      const auto orders_at_price = getOrdersAtPrice(order->side_, order->price_);
 
       if (!orders_at_price) {
         order->next_order_ = order->prev_order_ = order;
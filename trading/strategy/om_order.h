@@ -20,6 +20,9 @@ Like PENDING_NEW, the PENDING_CANCEL state represents the state of an order when
 has been sent to the exchange but has not been processed by the exchange or the response has not been received back
 
 The DEAD state represents an order that does not exist – it has either not been sent yet or fully executed or successfully cancelled
+
+The PENDING_MODIFY state represents a live order for which a cancel/replace has been sent to the exchange, its price_ and qty_
+already hold the requested values
 */
   
   enum class OMOrderState : int8_t {
@@ -27,7 +30,8 @@ The DEAD state represents an order that does not exist – it has either not bee
     PENDING_NEW = 1,
     LIVE = 2,
     PENDING_CANCEL = 3,
-    DEAD = 4
+    DEAD = 4,
+    PENDING_MODIFY = 5
   };
 
 
@@ -41,6 +45,8 @@ The DEAD state represents an order that does not exist – it has either not bee
         return "PENDING_CANCEL";
       case OMOrderState::DEAD:
         return "DEAD";
+      case OMOrderState::PENDING_MODIFY:
+        return "PENDING_MODIFY";
       case OMOrderState::INVALID:
         return "INVALID";
     }
@@ -12,7 +12,7 @@ namespace Trading {
     OMOrder object for which this new order is being sent. It also needs the TickerId, Price, Side, and Qty attributes 
     to be set on the new order that’s being sent out:
     */
-  auto OrderManager::newOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty) noexcept -> void {
+  auto OrderManager::newOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty, Exchange::TimeInForce time_in_force) noexcept -> void {
 
     /*
     It creates a MEClientRequest structure of the ClientRequestType::NEW type and fills in the attributes that are 
@@ -21,7 +21,7 @@ namespace Trading {
     the MEClientRequest object (new_request) it just initialized:
     */
     const Exchange::MEClientRequest new_request{Exchange::ClientRequestType::NEW, trade_engine_->clientId(), ticker_id,
-                                                next_order_id_, side, price, qty};
+                                                next_order_id_, side, price, qty, Exchange::OrderType::LIMIT, time_in_force};
     trade_engine_->sendClientRequest(&new_request);
     /*
     Finally, it updates the OMOrder object pointer it was provided in the method parameters and assigns it the attributes 
@@ -76,4 +76,24 @@ namespace Trading {
                  Common::getCurrentTimeStr(&time_str_),
                  cancel_request.toString().c_str(), order->toString().c_str());
   }
+
+  auto OrderManager::modifyOrder(OMOrder *order, Price price, Qty qty) noexcept -> void {
+    /*
+    OrderManager::modifyOrder() cancel/replaces a live order in a single ClientRequestType::MODIFY request, instead of a cancel followed
+    by a new order once the cancel is confirmed. The order keeps its order_id_, and keeps its place in the exchange's queue only if the
+    price stays the same and the quantity goes down. The OMOrder takes the requested price and quantity right away and waits in
+    OMOrderState::PENDING_MODIFY for the exchange to confirm them
+    */
+    const Exchange::MEClientRequest modify_request{Exchange::ClientRequestType::MODIFY, trade_engine_->clientId(),
+                                                   order->ticker_id_, order->order_id_, order->side_, price, qty};
+    trade_engine_->sendClientRequest(&modify_request);
+
+    order->price_ = price;
+    order->qty_ = qty;
+    order->order_state_ = OMOrderState::PENDING_MODIFY;
+
+    logger_->log("%:% %() % Sent modify % for %\n", __FILE__, __LINE__, __FUNCTION__,
+                 Common::getCurrentTimeStr(&time_str_),
+                 modify_request.toString().c_str(), order->toString().c_str());
+  }
 }
\ No newline at end of file
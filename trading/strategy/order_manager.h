@@ -3,6 +3,7 @@
 #include "common/macros.h"
 #include "common/logging.h"
 
+#include "exchange/order_server/client_request.h"
 #include "exchange/order_server/client_response.h"
 
 #include "om_order.h"
@@ -31,7 +32,25 @@ namespace Trading {
           order->order_state_ = OMOrderState::LIVE;
         }
           break;
-        case Exchange::ClientResponseType::CANCELED: {
+        case Exchange::ClientResponseType::MODIFIED: {
+          order->price_ = client_response->price_;
+          order->qty_ = client_response->leaves_qty_;
+          order->order_state_ = OMOrderState::LIVE;
+        }
+          break;
+        case Exchange::ClientResponseType::MODIFY_REJECTED: {
+          // The exchange reports the order as it still is, or no market order id if it is not live anymore.
+          if (client_response->market_order_id_ == OrderId_INVALID) {
+            order->order_state_ = OMOrderState::DEAD;
+          } else {
+            order->price_ = client_response->price_;
+            order->qty_ = client_response->leaves_qty_;
+            order->order_state_ = OMOrderState::LIVE;
+          }
+        }
+          break;
+        case Exchange::ClientResponseType::CANCELED:
+        case Exchange::ClientResponseType::REJECTED: {
           order->order_state_ = OMOrderState::DEAD;
         }
           break;
@@ -41,22 +60,54 @@ namespace Trading {
             order->order_state_ = OMOrderState::DEAD;
         }
           break;
+        case Exchange::ClientResponseType::THROTTLED:
+        case Exchange::ClientResponseType::SESSION_REJECTED: {
+          // The order server dropped the request, a new order never made it and a cancel or modify left the order as it was.
+          // The price of a modified order is no longer known, invalidating it makes the next moveOrder() send the modify again.
+          if (order->order_state_ == OMOrderState::PENDING_NEW) {
+            order->order_state_ = OMOrderState::DEAD;
+          } else if (order->order_state_ == OMOrderState::PENDING_MODIFY) {
+            order->price_ = Price_INVALID;
+            order->order_state_ = OMOrderState::LIVE;
+          } else if (order->order_state_ == OMOrderState::PENDING_CANCEL) {
+            order->order_state_ = OMOrderState::LIVE;
+          }
+        }
+          break;
         case Exchange::ClientResponseType::CANCEL_REJECTED:
+        case Exchange::ClientResponseType::LOGGED_ON:
+        case Exchange::ClientResponseType::HEARTBEAT:
+        case Exchange::ClientResponseType::SEQUENCE_RESET:
         case Exchange::ClientResponseType::INVALID: {
         }
           break;
       }
     }
 
-    auto newOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty) noexcept -> void;
+    auto newOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty,
+                  Exchange::TimeInForce time_in_force = Exchange::TimeInForce::GTC) noexcept -> void;
 
     auto cancelOrder(OMOrder *order) noexcept -> void;
 
-    auto moveOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty) noexcept {
+    auto modifyOrder(OMOrder *order, Price price, Qty qty) noexcept -> void;
+
+    /// A live order is moved to the new price with a single cancel/replace, or cancelled if there is no price to move it to.
+    /// New orders are sent with time_in_force, IOC for strategies which only want to take liquidity and never rest on the book.
+    auto moveOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty,
+                   Exchange::TimeInForce time_in_force = Exchange::TimeInForce::GTC) noexcept {
       switch (order->order_state_) {
         case OMOrderState::LIVE: {
-          if(order->price_ != price)
-            cancelOrder(order);
+          if (order->price_ != price) {
+            if (UNLIKELY(price == Price_INVALID)) {
+              cancelOrder(order);
+            } else {
+              const auto risk_result = risk_manager_.checkPreTradeRisk(ticker_id, side, qty);
+              if (LIKELY(risk_result == RiskCheckResult::ALLOWED))
+                modifyOrder(order, price, qty);
+              else
+                cancelOrder(order);
+            }
+          }
         }
           break;
         case OMOrderState::INVALID:
@@ -64,7 +115,7 @@ namespace Trading {
           if(LIKELY(price != Price_INVALID)) {
             const auto risk_result = risk_manager_.checkPreTradeRisk(ticker_id, side, qty);
             if(LIKELY(risk_result == RiskCheckResult::ALLOWED))
-              newOrder(order, ticker_id, price, side, qty);
+              newOrder(order, ticker_id, price, side, qty, time_in_force);
             else
               logger_->log("%:% %() % Ticker:% Side:% Qty:% RiskCheckResult:%\n", __FILE__, __LINE__, __FUNCTION__,
                            Common::getCurrentTimeStr(&time_str_),
@@ -75,16 +126,18 @@ namespace Trading {
           break;
         case OMOrderState::PENDING_NEW:
         case OMOrderState::PENDING_CANCEL:
+        case OMOrderState::PENDING_MODIFY:
           break;
       }
     }
 
-    auto moveOrders(TickerId ticker_id, Price bid_price, Price ask_price, Qty clip) noexcept {
+    auto moveOrders(TickerId ticker_id, Price bid_price, Price ask_price, Qty clip,
+                    Exchange::TimeInForce time_in_force = Exchange::TimeInForce::GTC) noexcept {
       auto bid_order = &(ticker_side_order_.at(ticker_id).at(sideToIndex(Side::BUY)));
-      moveOrder(bid_order, ticker_id, bid_price, Side::BUY, clip);
+      moveOrder(bid_order, ticker_id, bid_price, Side::BUY, clip, time_in_force);
 
       auto ask_order = &(ticker_side_order_.at(ticker_id).at(sideToIndex(Side::SELL)));
-      moveOrder(ask_order, ticker_id, ask_price, Side::SELL, clip);
+      moveOrder(ask_order, ticker_id, ask_price, Side::SELL, clip, time_in_force);
     }
 
     /*
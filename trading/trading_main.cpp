@@ -81,12 +81,17 @@ int main(int argc, char **argv) {
     LFQueue variables to consume MEClientRequest messages from and write MEClientResponse messages to, and then 
     we use start() on the main thread
     */
+  // Must match the transport the exchange was started with, selected with LLPETM_TRANSPORT=shm.
+  const auto transport = Common::transportTypeFromEnv();
+  logger->log("%:% %() % Transport:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+              Common::transportTypeToString(transport));
+
   const std::string order_gw_ip = "127.0.0.1";
   const std::string order_gw_iface = "lo";
   const int order_gw_port = 12345;
 
   logger->log("%:% %() % Starting Order Gateway...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  order_gateway = new Trading::OrderGateway(client_id, &client_requests, &client_responses, order_gw_ip, order_gw_iface, order_gw_port);
+  order_gateway = new Trading::OrderGateway(client_id, &client_requests, &client_responses, order_gw_ip, order_gw_iface, order_gw_port, transport);
   order_gateway->start();
 
     /*
@@ -100,8 +105,13 @@ int main(int argc, char **argv) {
   const std::string incremental_ip = "233.252.14.3";
   const int incremental_port = 20001;
 
+  // LLPETM_MCAST_RX=xdp receives the multicast streams through AF_XDP, falling back to the sockets if that is not possible on mkt_data_iface.
+  const auto rx_path = Common::mcastRxPathFromEnv();
+  logger->log("%:% %() % Market data receive path:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+              Common::mcastRxPathToString(rx_path));
+
   logger->log("%:% %() % Starting Market Data Consumer...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  market_data_consumer = new Trading::MarketDataConsumer(client_id, &market_updates, mkt_data_iface, snapshot_ip, snapshot_port, incremental_ip, incremental_port);
+  market_data_consumer = new Trading::MarketDataConsumer(client_id, &market_updates, mkt_data_iface, snapshot_ip, snapshot_port, incremental_ip, incremental_port, transport, rx_path);
   market_data_consumer->start();
 
     /*